@@ -0,0 +1,155 @@
+#include "batch-io.h"
+#include "test-framework.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+const size_t FILE_COUNT = 300;
+
+// More files, than fit in one wave of the ring
+const unsigned QUEUE_DEPTH = 64;
+
+static void write_and_read_back(bool force_threads) {
+    batch_io io = {};
+    TRY batch_io_create(&io, QUEUE_DEPTH, force_threads)
+        ASSERT_SUCCESS();
+
+    if (force_threads)
+        ASSERT_EQUAL(io.backend, BATCH_IO_THREADS);
+
+    static char file_names[FILE_COUNT][L_tmpnam] = {};
+    static char contents[FILE_COUNT][64] = {};
+
+    batch_io_request requests[FILE_COUNT] = {};
+
+    for (size_t i = 0; i < FILE_COUNT; ++ i) {
+        ASSERT_EQUAL(tmpnam(file_names[i]) != NULL, true);
+        snprintf(contents[i], sizeof(contents[i]), "file %zu\nsecond line", i);
+
+        requests[i] = { .file_name = file_names[i], .data = contents[i],
+                        .size = strlen(contents[i]) };
+    }
+
+    TRY batch_write_files(&io, requests, FILE_COUNT)
+        ASSERT_SUCCESS();
+
+    for (size_t i = 0; i < FILE_COUNT; ++ i)
+        requests[i] = { .file_name = file_names[i] };
+
+    TRY batch_read_files(&io, requests, FILE_COUNT)
+        ASSERT_SUCCESS();
+
+    for (size_t i = 0; i < FILE_COUNT; ++ i) {
+        ASSERT_EQUAL(requests[i].size, strlen(contents[i]));
+        ASSERT_EQUAL(strcmp(requests[i].data, contents[i]), 0);
+
+        free(requests[i].data);
+    }
+
+    const char* names[FILE_COUNT] = {};
+    for (size_t i = 0; i < FILE_COUNT; ++ i)
+        names[i] = file_names[i];
+
+    static text texts[FILE_COUNT] = {};
+    TRY batch_get_texts(&io, names, texts, FILE_COUNT)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL((int) texts[7].number_of_lines, 2);
+    ASSERT_EQUAL(wcscmp(texts[7].lines[0].begin, L"file 7"), 0);
+    ASSERT_EQUAL(wcscmp(texts[7].lines[1].begin, L"second line"), 0);
+
+    for (size_t i = 0; i < FILE_COUNT; ++ i)
+        text_destruct(&texts[i]);
+
+    // Missing file fails only it's own request
+    remove(file_names[3]);
+
+    for (size_t i = 0; i < FILE_COUNT; ++ i)
+        requests[i] = { .file_name = file_names[i] };
+
+    stack_trace* missing = batch_read_files(&io, requests, FILE_COUNT);
+    ASSERT_EQUAL(trace_is_success(missing), false);
+    trace_destruct(missing);
+
+    ASSERT_EQUAL(requests[3].error, ENOENT);
+    ASSERT_EQUAL(requests[3].data, (char*) NULL);
+    ASSERT_EQUAL(strcmp(requests[4].data, contents[4]), 0);
+
+    for (size_t i = 0; i < FILE_COUNT; ++ i) {
+        free(requests[i].data);
+        remove(file_names[i]);
+    }
+
+    batch_io_destroy(&io);
+}
+
+TEST(batch_files_with_io_uring_or_fallback) {
+    write_and_read_back(false);
+}
+
+TEST(batch_files_with_threads) {
+    write_and_read_back(true);
+}
+
+TEST(batch_write_digraphs) {
+    batch_io io = {};
+    TRY batch_io_create(&io)
+        ASSERT_SUCCESS();
+
+    const size_t graph_count = 10;
+
+    digraph graphs[graph_count] = {};
+    char file_names[graph_count][L_tmpnam] = {};
+    const char* names[graph_count] = {};
+
+    for (size_t i = 0; i < graph_count; ++ i) {
+        graphs[i] = NEW_GRAPH({
+            NEW_SUBGRAPH(RANK_NONE, {
+                node_id from = NODE("graph %zu", i), to = NODE("end");
+                EDGE(from, to);
+            });
+        });
+
+        names[i] = tmpnam(file_names[i]);
+    }
+
+    TRY batch_write_digraphs(&io, graphs, names, graph_count)
+        ASSERT_SUCCESS();
+
+    batch_io_request requests[graph_count] = {};
+    for (size_t i = 0; i < graph_count; ++ i)
+        requests[i] = { .file_name = names[i] };
+
+    TRY batch_read_files(&io, requests, graph_count)
+        ASSERT_SUCCESS();
+
+    // Files are the same as written by digraph_write
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    for (size_t i = 0; i < graph_count; ++ i) {
+        digraph_write(&writer, &graphs[i]);
+
+        size_t size = 0;
+        char* expected = buffered_writer_take(&writer, &size);
+
+        ASSERT_EQUAL(requests[i].size, size);
+        ASSERT_EQUAL(memcmp(requests[i].data, expected, size), 0);
+
+        free(expected);
+        free(requests[i].data);
+
+        remove(names[i]);
+        digraph_destroy(&graphs[i]);
+    }
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    batch_io_destroy(&io);
+}
+
+TEST_MAIN()
@@ -0,0 +1,619 @@
+#include "batch-io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "graphviz-writer.h"
+#include "safe-alloc.h"
+#include "thread-pool.h"
+#include "trace.h"
+
+// --------------------------------- RING ------------------------------------
+
+static int io_uring_setup(unsigned entries, io_uring_params* params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int io_uring_register(int fd, unsigned opcode, void* argument, unsigned count) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, argument, count);
+}
+
+// Operations every batch needs, they appeared in different kernels
+static const int REQUIRED_OPERATIONS[] = {
+    IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE
+};
+
+static bool ring_supports_operations(int fd) {
+    const unsigned probed = 256;
+
+    io_uring_probe* probe = (io_uring_probe*)
+        calloc(1, sizeof(io_uring_probe) + probed * sizeof(io_uring_probe_op));
+
+    if (probe == NULL)
+        return false;
+
+    bool is_supported = io_uring_register(fd, IORING_REGISTER_PROBE, probe, probed) == 0;
+
+    for (size_t i = 0; is_supported && i < sizeof(REQUIRED_OPERATIONS) / sizeof(int); ++ i) {
+        const int operation = REQUIRED_OPERATIONS[i];
+
+        is_supported = operation <= probe->last_op &&
+                       (probe->ops[operation].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    free(probe);
+    return is_supported;
+}
+
+static void ring_destroy(batch_io_ring* ring) {
+    if (ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqes_size);
+
+    if (ring->cq_map != NULL && ring->cq_map != ring->sq_map)
+        munmap(ring->cq_map, ring->cq_map_size);
+
+    if (ring->sq_map != NULL)
+        munmap(ring->sq_map, ring->sq_map_size);
+
+    if (ring->fd != -1)
+        close(ring->fd);
+
+    *ring = { .fd = -1 };
+}
+
+static void* map_ring(int fd, size_t size, off_t offset) {
+    void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, offset);
+
+    return mapping != MAP_FAILED ? mapping : NULL;
+}
+
+static stack_trace* ring_create(batch_io_ring* ring, unsigned queue_depth) {
+    *ring = { .fd = -1 };
+
+    io_uring_params params = {};
+    ring->fd = io_uring_setup(queue_depth, &params);
+    if (ring->fd == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't set up io_uring: %s", strerror(errno));
+
+    if (!ring_supports_operations(ring->fd)) {
+        ring_destroy(ring);
+        return FAILURE(RUNTIME_ERROR, "Kernel's io_uring lacks file operations!");
+    }
+
+    ring->entries = params.sq_entries;
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_map_size = params.cq_off.cqes  + params.cq_entries * sizeof(io_uring_cqe);
+    ring->sqes_size   = params.sq_entries * sizeof(io_uring_sqe);
+
+    // Both queues share one mapping on newer kernels
+    const bool is_single_map = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (is_single_map) {
+        if (ring->cq_map_size > ring->sq_map_size)
+            ring->sq_map_size = ring->cq_map_size;
+
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = map_ring(ring->fd, ring->sq_map_size, IORING_OFF_SQ_RING);
+    ring->cq_map = is_single_map ? ring->sq_map :
+                   map_ring(ring->fd, ring->cq_map_size, IORING_OFF_CQ_RING);
+
+    ring->sqes = (io_uring_sqe*) map_ring(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+
+    if (ring->sq_map == NULL || ring->cq_map == NULL || ring->sqes == NULL) {
+        ring_destroy(ring);
+        return FAILURE(RUNTIME_ERROR, "Can't map io_uring queues!");
+    }
+
+    char* sq = (char*) ring->sq_map;
+    ring->sq_head  = (unsigned*) (sq + params.sq_off.head);
+    ring->sq_tail  = (unsigned*) (sq + params.sq_off.tail);
+    ring->sq_mask  = (unsigned*) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*) (sq + params.sq_off.array);
+
+    char* cq = (char*) ring->cq_map;
+    ring->cq_head = (unsigned*) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned*) (cq + params.cq_off.ring_mask);
+    ring->cqes    = (io_uring_cqe*) (cq + params.cq_off.cqes);
+
+    return SUCCESS();
+}
+
+stack_trace* batch_io_create(batch_io* io, unsigned queue_depth, bool force_threads) {
+    *io = { .backend = BATCH_IO_THREADS, .ring = { .fd = -1 } };
+
+    if (force_threads)
+        return SUCCESS();
+
+    // Kernel or sandbox without io_uring is not an error, threads are used
+    stack_trace* ring_trace = ring_create(&io->ring, queue_depth);
+
+    if (trace_is_success(ring_trace))
+        io->backend = BATCH_IO_URING;
+
+    trace_destruct(ring_trace);
+    return SUCCESS();
+}
+
+void batch_io_destroy(batch_io* io) {
+    if (io->backend == BATCH_IO_URING)
+        ring_destroy(&io->ring);
+
+    *io = { .backend = BATCH_IO_THREADS, .ring = { .fd = -1 } };
+}
+
+// -------------------------------- STAGES -----------------------------------
+
+/** Stages of reading and writing files */
+enum batch_stage {
+    STAGE_OPEN_READ, STAGE_OPEN_WRITE, STAGE_STAT,
+    STAGE_READ,      STAGE_WRITE,      STAGE_CLOSE
+};
+
+/** Progress of request inside of the batch */
+struct batch_file {
+    batch_io_request* request;
+    int fd;
+
+    size_t done; // Bytes read or written
+    struct statx stats;
+};
+
+// Statx needs path, empty path with AT_EMPTY_PATH means the descriptor itself
+static const char EMPTY_PATH[] = "";
+
+// Length of read or write is 32 bit, bigger files take a few submissions
+const size_t BATCH_IO_MAX_TRANSFER = (size_t) 1 << 30;
+
+static void prepare(io_uring_sqe* sqe, batch_stage stage, batch_file* file) {
+    memset(sqe, 0, sizeof(*sqe));
+
+    batch_io_request* request = file->request;
+
+    switch (stage) {
+    case STAGE_OPEN_READ:
+    case STAGE_OPEN_WRITE:
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = (uint64_t) request->file_name;
+        sqe->open_flags = stage == STAGE_OPEN_READ ? O_RDONLY | O_CLOEXEC
+                        : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        sqe->len = 0644;
+        break;
+
+    case STAGE_STAT:
+        sqe->opcode = IORING_OP_STATX;
+        sqe->fd = file->fd;
+        sqe->addr = (uint64_t) EMPTY_PATH;
+        sqe->len = STATX_SIZE;
+        sqe->off = (uint64_t) &file->stats;
+        sqe->statx_flags = AT_EMPTY_PATH;
+        break;
+
+    case STAGE_READ:
+    case STAGE_WRITE: {
+        const size_t remaining = request->size - file->done;
+
+        sqe->opcode = stage == STAGE_READ ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = file->fd;
+        sqe->addr = (uint64_t) (request->data + file->done);
+        sqe->len = (uint32_t) (remaining < BATCH_IO_MAX_TRANSFER ? remaining
+                                                                 : BATCH_IO_MAX_TRANSFER);
+        sqe->off = file->done;
+        break;
+    }
+
+    case STAGE_CLOSE:
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = file->fd;
+        break;
+    }
+}
+
+// Allocate read buffer, once size of the file is known
+static void allocate_buffer(batch_file* file) {
+    batch_io_request* request = file->request;
+
+    request->data = (char*) calloc(request->size + 1, sizeof(char));
+    if (request->data == NULL)
+        request->error = ENOMEM;
+}
+
+/**
+ * Apply result of finished stage, @arg result is what syscall would
+ * return, or -errno
+ */
+static void complete(batch_stage stage, batch_file* file, long result) {
+    batch_io_request* request = file->request;
+
+    if (result < 0) {
+        request->error = (int) -result;
+
+        if (stage == STAGE_OPEN_READ || stage == STAGE_OPEN_WRITE)
+            file->fd = -1;
+
+        return;
+    }
+
+    switch (stage) {
+    case STAGE_OPEN_READ:
+    case STAGE_OPEN_WRITE:
+        file->fd = (int) result;
+        break;
+
+    case STAGE_STAT:
+        request->size = (size_t) file->stats.stx_size;
+        allocate_buffer(file);
+        break;
+
+    case STAGE_READ:
+        // File got shorter, than it was when it's size was read
+        if (result == 0)
+            request->size = file->done;
+
+        file->done += (size_t) result;
+        break;
+
+    case STAGE_WRITE:
+        if (result == 0)
+            request->error = EIO;
+
+        file->done += (size_t) result;
+        break;
+
+    case STAGE_CLOSE:
+        file->fd = -1;
+        break;
+    }
+}
+
+// Is stage still needed for the file
+static bool is_pending(batch_stage stage, batch_file* file) {
+    if (stage == STAGE_CLOSE)
+        return file->fd != -1;
+
+    if (file->request->error != 0)
+        return false;
+
+    if (stage == STAGE_READ || stage == STAGE_WRITE)
+        return file->done < file->request->size;
+
+    return true;
+}
+
+// User data of entries, that were replaced with no-ops
+const uint64_t RING_CANCELLED = UINT64_MAX;
+
+// Entries, that kernel hasn't consumed yet, become no-ops, so they don't touch files
+static void ring_cancel_unsubmitted(batch_io_ring* ring, unsigned tail) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++ head) {
+        io_uring_sqe* sqe = &ring->sqes[ring->sq_array[head & *ring->sq_mask]];
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = RING_CANCELLED;
+    }
+}
+
+/**
+ * Submit stage for every pending file with one syscall and wait until
+ * all of them complete, @arg count shouldn't exceed ring's entries.
+ * If submission fails, requests in flight are still waited for, since
+ * they point into @arg files, if even that fails ring is broken.
+ */
+static stack_trace* ring_run_stage(batch_io_ring* ring, batch_stage stage,
+                                   batch_file* files, size_t count) {
+    if (ring->is_broken)
+        return FAILURE(RUNTIME_ERROR, "Ring failed to complete previous batch!");
+
+    unsigned tail = *ring->sq_tail, submitted = 0;
+
+    for (size_t i = 0; i < count; ++ i) {
+        if (!is_pending(stage, &files[i]))
+            continue;
+
+        const unsigned slot = tail & *ring->sq_mask;
+
+        prepare(&ring->sqes[slot], stage, &files[i]);
+        ring->sqes[slot].user_data = i;
+
+        ring->sq_array[slot] = slot;
+        ++ tail, ++ submitted;
+    }
+
+    if (submitted == 0)
+        return SUCCESS();
+
+    // Kernel reads entries after it sees the new tail
+    __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+    stack_trace* failure = NULL;
+
+    unsigned to_submit = submitted, completed = 0;
+    while (completed < submitted) {
+        int entered = io_uring_enter(ring->fd, to_submit, submitted - completed,
+                                     IORING_ENTER_GETEVENTS);
+
+        if (entered == -1 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            if (failure != NULL) {
+                ring->is_broken = true;
+                return failure;
+            }
+
+            failure = FAILURE(RUNTIME_ERROR, "Can't submit batch: %s", strerror(errno));
+            ring_cancel_unsubmitted(ring, tail);
+            continue;
+        }
+
+        if (entered > 0)
+            to_submit -= (unsigned) entered;
+
+        unsigned head = *ring->cq_head;
+        const unsigned cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != cq_tail; ++ head, ++ completed) {
+            io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+
+            if (cqe->user_data != RING_CANCELLED)
+                complete(stage, &files[cqe->user_data], cqe->res);
+        }
+
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return failure != NULL ? failure : SUCCESS();
+}
+
+static stack_trace* ring_run_transfer(batch_io_ring* ring, batch_file* files, size_t count,
+                                      bool is_write) {
+
+    TRY ring_run_stage(ring, is_write ? STAGE_OPEN_WRITE : STAGE_OPEN_READ, files, count)
+        FAIL("Can't open files!");
+
+    if (!is_write)
+        TRY ring_run_stage(ring, STAGE_STAT, files, count)
+            FAIL("Can't get sizes of files!");
+
+    // Short reads and writes are resubmitted until every file is done
+    const batch_stage transfer = is_write ? STAGE_WRITE : STAGE_READ;
+
+    bool is_transferring = true;
+    while (is_transferring) {
+        TRY ring_run_stage(ring, transfer, files, count)
+            FAIL("Can't transfer files!");
+
+        is_transferring = false;
+        for (size_t i = 0; i < count; ++ i)
+            is_transferring |= is_pending(transfer, &files[i]);
+    }
+
+    return SUCCESS();
+}
+
+static stack_trace* ring_run_batch(batch_io_ring* ring, batch_file* files, size_t count,
+                                   bool is_write) {
+    stack_trace* transferred = ring_run_transfer(ring, files, count, is_write);
+
+    // Files, that were opened before failure, are still closed
+    stack_trace* closed = ring_run_stage(ring, STAGE_CLOSE, files, count);
+
+    TRY transferred CATCH({
+        trace_destruct(closed);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't transfer files!");
+    });
+
+    TRY closed FAIL("Can't close files!");
+    return SUCCESS();
+}
+
+// Same stages as in ring, but with blocking syscalls
+static void run_blocking(batch_file* file, bool is_write) {
+    batch_io_request* request = file->request;
+
+    file->fd = is_write ? open(request->file_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)
+                        : open(request->file_name, O_RDONLY | O_CLOEXEC);
+
+    if (file->fd == -1) {
+        request->error = errno;
+        return;
+    }
+
+    if (!is_write) {
+        struct stat file_stats;
+
+        if (fstat(file->fd, &file_stats) == -1)
+            request->error = errno;
+        else {
+            request->size = (size_t) file_stats.st_size;
+            allocate_buffer(file);
+        }
+    }
+
+    const batch_stage transfer = is_write ? STAGE_WRITE : STAGE_READ;
+    while (is_pending(transfer, file)) {
+        ssize_t result = is_write ?
+            pwrite(file->fd, request->data + file->done, request->size - file->done, (off_t) file->done) :
+            pread (file->fd, request->data + file->done, request->size - file->done, (off_t) file->done);
+
+        if (result == -1 && errno == EINTR)
+            continue;
+
+        complete(transfer, file, result == -1 ? -errno : result);
+    }
+
+    close(file->fd), file->fd = -1;
+}
+
+struct blocking_batch {
+    batch_file* files;
+    bool is_write;
+};
+
+static void run_blocking_chunk(size_t begin, size_t end, void* argument) {
+    blocking_batch* batch = (blocking_batch*) argument;
+
+    for (size_t i = begin; i < end; ++ i)
+        run_blocking(&batch->files[i], batch->is_write);
+}
+
+static stack_trace* batch_run(batch_io* io, batch_io_request* requests, size_t count,
+                              bool is_write) {
+    batch_file* files = NULL;
+    TRY safe_calloc(count + 1, &files)
+        FAIL("Can't allocate state of %zu files!", count);
+
+    for (size_t i = 0; i < count; ++ i) {
+        files[i] = { .request = &requests[i], .fd = -1 };
+
+        requests[i].error = 0;
+
+        if (!is_write)
+            requests[i].data = NULL, requests[i].size = 0;
+    }
+
+    if (io->backend == BATCH_IO_URING) {
+        // Files are processed in waves, that fit in the ring
+        for (size_t begin = 0; begin < count; begin += io->ring.entries) {
+            size_t wave = count - begin < io->ring.entries ? count - begin : io->ring.entries;
+
+            TRY ring_run_batch(&io->ring, files + begin, wave, is_write) CATCH({
+                // Kernel may still write into files of broken ring, so they are leaked
+                if (!io->ring.is_broken)
+                    free(files);
+
+                return PASS_FAILURE(__trace, RUNTIME_ERROR, "Batch failed in io_uring!");
+            });
+        }
+    } else {
+        blocking_batch batch = { .files = files, .is_write = is_write };
+        TRY thread_pool_parallel_for(thread_pool_default(), count,
+                                     run_blocking_chunk, &batch) CATCH({
+            free(files);
+            return PASS_FAILURE(__trace, RUNTIME_ERROR, "Batch failed on worker threads!");
+        });
+    }
+
+    free(files);
+
+    size_t failed = 0;
+    int first_error = 0;
+
+    for (size_t i = 0; i < count; ++ i) {
+        if (requests[i].error == 0)
+            continue;
+
+        if (failed ++ == 0)
+            first_error = requests[i].error;
+
+        // Failed reads don't hand out partial buffers
+        if (!is_write)
+            free(requests[i].data), requests[i].data = NULL, requests[i].size = 0;
+    }
+
+    if (failed > 0)
+        return FAILURE(RUNTIME_ERROR, "%zu of %zu files failed, first with: %s",
+                       failed, count, strerror(first_error));
+
+    return SUCCESS();
+}
+
+stack_trace* batch_read_files(batch_io* io, batch_io_request* requests, size_t count) {
+    TRY batch_run(io, requests, count, false)
+        FAIL("Can't read batch of files!");
+
+    return SUCCESS();
+}
+
+stack_trace* batch_write_files(batch_io* io, batch_io_request* requests, size_t count) {
+    TRY batch_run(io, requests, count, true)
+        FAIL("Can't write batch of files!");
+
+    return SUCCESS();
+}
+
+// ------------------------------- FRONTENDS ---------------------------------
+
+stack_trace* batch_get_texts(batch_io* io, const char** file_names, text* texts, size_t count) {
+    batch_io_request* requests = NULL;
+    TRY safe_calloc(count + 1, &requests)
+        FAIL("Can't allocate %zu requests!", count);
+
+    for (size_t i = 0; i < count; ++ i)
+        requests[i] = { .file_name = file_names[i] };
+
+    stack_trace* read_trace = batch_read_files(io, requests, count);
+
+    // Texts of files, that were read, are returned even if batch failed
+    for (size_t i = 0; i < count; ++ i) {
+        texts[i] = {};
+
+        if (requests[i].data == NULL)
+            continue;
+
+        stack_trace* text_trace = get_text_from_bytes(requests[i].data, requests[i].size,
+                                                      &texts[i]);
+
+        if (!trace_is_success(text_trace) && trace_is_success(read_trace))
+            read_trace = PASS_FAILURE(text_trace, RUNTIME_ERROR,
+                                      "Can't split %s in lines!", file_names[i]);
+        else
+            trace_destruct(text_trace);
+
+        free(requests[i].data);
+    }
+
+    free(requests);
+
+    TRY read_trace FAIL("Can't read texts!");
+    return SUCCESS();
+}
+
+stack_trace* batch_write_digraphs(batch_io* io, digraph* graphs,
+                                  const char** file_names, size_t count) {
+    batch_io_request* requests = NULL;
+    TRY safe_calloc(count + 1, &requests)
+        FAIL("Can't allocate %zu requests!", count);
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer) CATCH({
+        free(requests);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't create writer!");
+    });
+
+    for (size_t i = 0; i < count; ++ i) {
+        digraph_write(&writer, &graphs[i]);
+
+        requests[i] = { .file_name = file_names[i] };
+        requests[i].data = buffered_writer_take(&writer, &requests[i].size);
+    }
+
+    bool is_serialized = !writer.failed;
+    trace_destruct(buffered_writer_destroy(&writer));
+
+    stack_trace* write_trace = is_serialized ?
+        batch_write_files(io, requests, count) :
+        FAILURE(RUNTIME_ERROR, "Graphs don't fit in memory!");
+
+    for (size_t i = 0; i < count; ++ i)
+        free(requests[i].data);
+
+    free(requests);
+
+    TRY write_trace FAIL("Can't write graphs!");
+    return SUCCESS();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "graphviz.h"
+#include "textlib.h"
+#include "trace.h"
+
+#include <linux/io_uring.h>
+#include <stddef.h>
+
+/** How batches are executed */
+enum batch_io_backend {
+    BATCH_IO_URING,  // Whole stage of batch is one io_uring_enter
+    BATCH_IO_THREADS // Blocking syscalls on worker threads
+};
+
+/** Mappings of io_uring's submission and completion queues */
+struct batch_io_ring {
+    int fd;
+    unsigned entries;
+
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    io_uring_sqe* sqes;
+
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    io_uring_cqe* cqes;
+
+    void *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size, sqes_size;
+
+    bool is_broken; // Requests may still be in flight, ring can't be used anymore
+};
+
+/**
+ * Batched file I/O. Every batch is split in stages (open, stat, read or
+ * write, close), each stage is submitted for all files of the batch at
+ * once and completes in bulk, so syscalls aren't paid per file. Falls
+ * back to worker threads if kernel doesn't support io_uring.
+ */
+struct batch_io {
+    batch_io_backend backend;
+    batch_io_ring ring;
+};
+
+/** One file of the batch */
+struct batch_io_request {
+    const char* file_name;
+
+    // Read: set to a new null terminated buffer, that should be freed by
+    // caller. Write: data that is written, it stays owned by caller
+    char* data;
+    size_t size;
+
+    int error; // errno of the failed stage, zero if request succeeded
+};
+
+// Files of one batch, that are in flight at once
+const unsigned BATCH_IO_DEFAULT_QUEUE_DEPTH = 256;
+
+/**
+ * @arg force_threads disables io_uring, even if kernel supports it
+ */
+stack_trace* batch_io_create(batch_io* io, unsigned queue_depth = BATCH_IO_DEFAULT_QUEUE_DEPTH,
+                             bool force_threads = false);
+
+void batch_io_destroy(batch_io* io);
+
+/**
+ * Read whole files, errors are reported for every request, batch fails
+ * if any of them failed, but other requests are still completed
+ */
+stack_trace* batch_read_files (batch_io* io, batch_io_request* requests, size_t count);
+
+/**
+ * Create or truncate files and write requests' data to them
+ */
+stack_trace* batch_write_files(batch_io* io, batch_io_request* requests, size_t count);
+
+/**
+ * Same as get_text for every file, files are read in one batch
+ */
+stack_trace* batch_get_texts(batch_io* io, const char** file_names, text* texts, size_t count);
+
+/**
+ * Write every graph in graphviz dot's lang to it's file, graphs are
+ * serialized in memory and written in one batch
+ */
+stack_trace* batch_write_digraphs(batch_io* io, digraph* graphs,
+                                  const char** file_names, size_t count);
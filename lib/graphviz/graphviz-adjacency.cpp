@@ -0,0 +1,257 @@
+#include "graphviz-adjacency.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "default-hash-functions.h"
+#include "hash-table.h"
+#include "safe-alloc.h"
+#include "simple-stack.h"
+#include "trace.h"
+
+static size_t digraph_node_capacity(digraph* graph) {
+    size_t capacity = 0;
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current) {
+        // List's elements are indexed from 0 to capacity + 1 inclusive
+        size_t subgraph_capacity = current->element.nodes.capacity + 2;
+
+        if (subgraph_capacity > capacity)
+            capacity = subgraph_capacity;
+    }
+
+    return capacity;
+}
+
+static stack_trace* check_edge(digraph_adjacency* adjacency, edge* current_edge) {
+    if (!digraph_adjacency_has_node(adjacency, current_edge->from) ||
+        !digraph_adjacency_has_node(adjacency, current_edge->to))
+        return FAILURE(RUNTIME_ERROR, "Edge %d -> %d connects missing nodes!",
+                       current_edge->from, current_edge->to);
+
+    return SUCCESS();
+}
+
+stack_trace* digraph_adjacency_create(digraph_adjacency* adjacency, digraph* graph) {
+    *adjacency = {};
+    adjacency->node_capacity = digraph_node_capacity(graph);
+
+    const size_t node_capacity = adjacency->node_capacity;
+
+    FINALIZER(adjacency_destroy, { digraph_adjacency_destroy(adjacency); });
+
+    TRY safe_calloc(node_capacity, &adjacency->owners)
+        FINALIZE_AND_FAIL(adjacency_destroy, "Failed to allocate node owners!");
+
+    TRY safe_calloc(node_capacity + 1, &adjacency->out_offsets)
+        FINALIZE_AND_FAIL(adjacency_destroy, "Failed to allocate out offsets!");
+
+    TRY safe_calloc(node_capacity + 1, &adjacency-> in_offsets)
+        FINALIZE_AND_FAIL(adjacency_destroy, "Failed to allocate in offsets!");
+
+    // First node with the id wins, like it does in dot's output
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current) {
+        subgraph_id current_id = linked_list_get_index(&graph->subgraphs, current);
+
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node) {
+            node_id id = linked_list_get_index(&current->element.nodes, current_node);
+
+            if (adjacency->owners[id] == linked_list_end_index)
+                adjacency->owners[id] = current_id;
+        }
+    }
+
+    // Count degrees, shifted by one, so prefix sums become offsets
+    size_t edge_count = 0;
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.edges, edge, current_edge) {
+            TRY check_edge(adjacency, &current_edge->element)
+                FINALIZE_AND_FAIL(adjacency_destroy, "Can't index edge!");
+
+            ++ adjacency->out_offsets[current_edge->element.from + 1];
+            ++ adjacency-> in_offsets[current_edge->element.to   + 1];
+
+            ++ edge_count;
+        }
+
+    for (size_t i = 1; i <= node_capacity; ++ i) {
+        adjacency->out_offsets[i] += adjacency->out_offsets[i - 1];
+        adjacency-> in_offsets[i] += adjacency-> in_offsets[i - 1];
+    }
+
+    TRY safe_calloc(edge_count, &adjacency->out_edges)
+        FINALIZE_AND_FAIL(adjacency_destroy, "Failed to allocate out edges!");
+
+    TRY safe_calloc(edge_count, &adjacency-> in_edges)
+        FINALIZE_AND_FAIL(adjacency_destroy, "Failed to allocate in edges!");
+
+    // Offsets are used as insertion cursors, and are shifted back afterwards
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current) {
+        subgraph_id current_id = linked_list_get_index(&graph->subgraphs, current);
+
+        LINKED_LIST_TRAVERSE(&current->element.edges, edge, current_edge) {
+            edge* value = &current_edge->element;
+            element_index_t edge_index =
+                linked_list_get_index(&current->element.edges, current_edge);
+
+            adjacency->out_edges[adjacency->out_offsets[value->from] ++] =
+                { .neighbour = value->to,   .subgraph = current_id, .edge = edge_index };
+
+            adjacency-> in_edges[adjacency-> in_offsets[value->to  ] ++] =
+                { .neighbour = value->from, .subgraph = current_id, .edge = edge_index };
+        }
+    }
+
+    for (size_t i = node_capacity; i > 0; -- i) {
+        adjacency->out_offsets[i] = adjacency->out_offsets[i - 1];
+        adjacency-> in_offsets[i] = adjacency-> in_offsets[i - 1];
+    }
+
+    adjacency->out_offsets[0] = adjacency->in_offsets[0] = 0;
+
+    return SUCCESS();
+}
+
+void digraph_adjacency_destroy(digraph_adjacency* adjacency) {
+    free(adjacency->owners);
+
+    free(adjacency->out_offsets);
+    free(adjacency->out_edges);
+
+    free(adjacency-> in_offsets);
+    free(adjacency-> in_edges);
+
+    *adjacency = {};
+}
+
+
+static node copy_node(digraph* graph, digraph_adjacency* adjacency, node_id id) {
+    subgraph* owner = digraph_get_subgraph(graph, adjacency->owners[id]);
+    node copy = linked_list_get_pointer(&owner->nodes, id)->element;
+
+    if (copy.label != NULL)
+        copy.label = strdup(copy.label);
+
+    return copy;
+}
+
+static edge copy_edge(digraph* graph, adjacency_entry* entry) {
+    subgraph* owner = digraph_get_subgraph(graph, entry->subgraph);
+    edge copy = linked_list_get_pointer(&owner->edges, entry->edge)->element;
+
+    if (copy.label != NULL)
+        copy.label = strdup(copy.label);
+
+    return copy;
+}
+
+struct neighborhood_state {
+    digraph* graph;
+    digraph_adjacency* adjacency;
+
+    // Maps ids in the original graph to ids in the extracted one
+    hash_table<int, node_id> remapped;
+    simple_stack<node_id> queue; // Nodes in the order they were found
+
+    digraph extracted;
+    subgraph_id extracted_subgraph;
+
+    size_t budget;
+};
+
+static bool visit(neighborhood_state* state, node_id id) {
+    if (state->queue.used >= state->budget)
+        return false;
+
+    if (hash_table_contains(&state->remapped, (int) id))
+        return true;
+
+    node_id new_id = subgraph_insert_node(&state->extracted, state->extracted_subgraph,
+                                          copy_node(state->graph, state->adjacency, id));
+
+    hash_table_insert(&state->remapped, (int) id, new_id);
+    simple_stack_push(&state->queue, id);
+
+    return true;
+}
+
+static bool visit_neighbours(neighborhood_state* state, size_t* offsets,
+                             adjacency_entry* entries, node_id id) {
+
+    for (size_t i = offsets[id]; i < offsets[id + 1]; ++ i)
+        if (!visit(state, entries[i].neighbour))
+            return false;
+
+    return true;
+}
+
+digraph digraph_extract_neighborhood(digraph* graph, digraph_adjacency* adjacency,
+                                     const node_id* seeds, size_t seed_count,
+                                     int max_hops, graphviz_direction direction,
+                                     size_t budget) {
+    neighborhood_state state = {
+        .graph = graph, .adjacency = adjacency,
+        .remapped = {}, .queue = {},
+        .extracted = digraph_create(), .extracted_subgraph = linked_list_end_index,
+        .budget = budget
+    };
+
+    state.extracted_subgraph = digraph_create_subgraph(&state.extracted, RANK_NONE);
+
+    TRY hash_table_create(&state.remapped, int_hash)
+        THROW("Failed to create node remapping table!");
+
+    simple_stack_create(&state.queue);
+
+    bool has_budget = true;
+    for (size_t i = 0; i < seed_count && has_budget; ++ i)
+        if (digraph_adjacency_has_node(adjacency, seeds[i]))
+            has_budget = visit(&state, seeds[i]);
+
+    // Breadth first search, one layer of nodes per hop
+    size_t layer_begin = 0;
+    for (int hop = 0; hop < max_hops && has_budget; ++ hop) {
+        size_t layer_end = state.queue.used;
+
+        for (size_t i = layer_begin; i < layer_end && has_budget; ++ i) {
+            node_id current = state.queue.elements[i];
+
+            if (direction == DIRECTION_OUT || direction == DIRECTION_BOTH)
+                has_budget = visit_neighbours(&state, adjacency->out_offsets,
+                                              adjacency->out_edges, current);
+
+            if (direction == DIRECTION_IN  || direction == DIRECTION_BOTH)
+                has_budget = has_budget &&
+                             visit_neighbours(&state, adjacency-> in_offsets,
+                                              adjacency-> in_edges, current);
+        }
+
+        layer_begin = layer_end;
+    }
+
+    // Copy every edge between extracted nodes, outgoing edges see each once
+    SIMPLE_STACK_TRAVERSE(&state.queue, node_id, current) {
+        node_id from = *current;
+
+        for (size_t i = adjacency->out_offsets[from];
+                    i < adjacency->out_offsets[from + 1]; ++ i) {
+
+            adjacency_entry* entry = &adjacency->out_edges[i];
+
+            node_id* to = hash_table_lookup(&state.remapped, (int) entry->neighbour);
+            if (to == NULL)
+                continue;
+
+            edge copy = copy_edge(graph, entry);
+            copy.from = *hash_table_lookup(&state.remapped, (int) from);
+            copy.to   = *to;
+
+            subgraph_insert_edge(&state.extracted, state.extracted_subgraph, copy);
+        }
+    }
+
+    hash_table_destroy(&state.remapped);
+    simple_stack_destruct(&state.queue);
+
+    return state.extracted;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "graphviz.h"
+#include "trace.h"
+
+#include <stddef.h>
+
+/** Edge as seen from one of it's endpoints */
+struct adjacency_entry {
+    node_id neighbour;
+
+    // Where edge itself is stored, to get it's style and label
+    subgraph_id subgraph;
+    element_index_t edge;
+};
+
+/**
+ * Compressed (CSR) index of incoming and outgoing edges of every node,
+ * it's a snapshot, and should be recreated after graph is changed
+ *
+ * Node ids are shared between subgraphs, the same way they are in dot's
+ * output, so edge can connect nodes from different subgraphs
+ */
+struct digraph_adjacency {
+    size_t node_capacity; // Every node id is less than this
+
+    // Subgraph that holds node, linked_list_end_index if there's no node
+    subgraph_id* owners;
+
+    size_t* out_offsets; // Edges of node i are in [offsets[i], offsets[i + 1])
+    adjacency_entry* out_edges;
+
+    size_t*  in_offsets;
+    adjacency_entry*  in_edges;
+};
+
+enum graphviz_direction {
+    DIRECTION_OUT, DIRECTION_IN, DIRECTION_BOTH
+};
+
+stack_trace* digraph_adjacency_create(digraph_adjacency* adjacency, digraph* graph);
+
+void digraph_adjacency_destroy(digraph_adjacency* adjacency);
+
+inline bool digraph_adjacency_has_node(digraph_adjacency* adjacency, node_id id) {
+    return id > linked_list_end_index && (size_t) id < adjacency->node_capacity &&
+           adjacency->owners[id] != linked_list_end_index;
+}
+
+/**
+ * Extract nodes that are at most @arg max_hops edges away from one of the
+ * @arg seeds, with all edges between them, into a new graph. Search stops
+ * early when @arg budget nodes were found, closest nodes are kept.
+ *
+ * Work is proportional to the size of extracted neighbourhood, not to
+ * the size of the whole graph, so @arg adjacency can be reused.
+ *
+ * @return New graph with a single subgraph, node ids are remapped.
+ * Labels are copied, so it should be destroyed with digraph_destroy
+ */
+digraph digraph_extract_neighborhood(digraph* graph, digraph_adjacency* adjacency,
+                                     const node_id* seeds, size_t seed_count,
+                                     int max_hops, graphviz_direction direction,
+                                     size_t budget);
@@ -0,0 +1,580 @@
+#include "graphviz-analytics.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphviz-parallel.h"
+#include "safe-alloc.h"
+#include "simple-stack.h"
+#include "trace.h"
+
+static double entry_weight(digraph* graph, adjacency_entry* entry) {
+    subgraph* owner = digraph_get_subgraph(graph, entry->subgraph);
+    return edge_weight(&linked_list_get_pointer(&owner->edges, entry->edge)->element);
+}
+
+stack_trace* digraph_analytics_create(digraph_analytics* analytics, digraph* graph) {
+    *analytics = {};
+
+    TRY digraph_adjacency_create(&analytics->adjacency, graph)
+        FAIL("Can't index edges of the graph!");
+
+    digraph_adjacency* adjacency = &analytics->adjacency;
+    const size_t capacity = adjacency->node_capacity,
+                 edge_count = adjacency->out_offsets[capacity];
+
+    FINALIZER(analytics_destroy, { digraph_analytics_destroy(analytics); });
+
+    TRY safe_calloc(edge_count + 1, &analytics->out_weights)
+        FINALIZE_AND_FAIL(analytics_destroy, "Can't allocate out weights!");
+
+    TRY safe_calloc(edge_count + 1, &analytics-> in_weights)
+        FINALIZE_AND_FAIL(analytics_destroy, "Can't allocate in weights!");
+
+    TRY safe_calloc(capacity, &analytics->out_weight_sums)
+        FINALIZE_AND_FAIL(analytics_destroy, "Can't allocate weight sums!");
+
+    for (node_id id = 0; (size_t) id < capacity; ++ id) {
+        if (!digraph_adjacency_has_node(adjacency, id))
+            continue;
+
+        ++ analytics->node_count;
+
+        for (size_t i = adjacency->out_offsets[id]; i < adjacency->out_offsets[id + 1]; ++ i) {
+            analytics->out_weights[i] = entry_weight(graph, &adjacency->out_edges[i]);
+            analytics->out_weight_sums[id] += analytics->out_weights[i];
+        }
+
+        for (size_t i = adjacency-> in_offsets[id]; i < adjacency-> in_offsets[id + 1]; ++ i)
+            analytics-> in_weights[i] = entry_weight(graph, &adjacency-> in_edges[i]);
+    }
+
+    return SUCCESS();
+}
+
+void digraph_analytics_destroy(digraph_analytics* analytics) {
+    digraph_adjacency_destroy(&analytics->adjacency);
+
+    free(analytics->out_weights);
+    free(analytics-> in_weights);
+    free(analytics->out_weight_sums);
+
+    *analytics = {};
+}
+
+// ----------------------------- SHORTEST PATHS -------------------------------
+
+struct relax_request {
+    node_id target; // linked_list_end_index if there's no request
+    double distance;
+};
+
+struct delta_stepping {
+    digraph_analytics* analytics;
+    double delta;
+    double* distances;
+
+    simple_stack<node_id>* buckets;
+    size_t bucket_count;
+
+    simple_stack<node_id> frontier, settled;
+    size_t* frontier_marks; // Last round, in which node joined frontier
+    size_t* settled_marks;  // Last bucket + 1, in which node was settled
+
+    size_t* request_offsets;
+
+    relax_request* requests;
+    size_t request_capacity;
+
+    bool is_light; // Light edges are relaxed inside of bucket, heavy after
+};
+
+static void delta_stepping_destroy(delta_stepping* state) {
+    for (size_t i = 0; i < state->bucket_count; ++ i)
+        simple_stack_destruct(&state->buckets[i]);
+
+    free(state->buckets);
+
+    simple_stack_destruct(&state->frontier);
+    simple_stack_destruct(&state->settled);
+
+    free(state->frontier_marks);
+    free(state->settled_marks);
+    free(state->request_offsets);
+    free(state->requests);
+}
+
+static stack_trace* reserve_buckets(delta_stepping* state, size_t bucket) {
+    if (bucket < state->bucket_count)
+        return SUCCESS();
+
+    size_t new_count = state->bucket_count > 0 ? state->bucket_count : 1;
+    while (new_count <= bucket)
+        new_count *= 2;
+
+    simple_stack<node_id>* new_buckets = (simple_stack<node_id>*)
+        realloc(state->buckets, new_count * sizeof(*new_buckets));
+
+    if (new_buckets == NULL)
+        return FAILURE(RUNTIME_ERROR, "Can't allocate %zu buckets!", new_count);
+
+    state->buckets = new_buckets;
+    for (; state->bucket_count < new_count; ++ state->bucket_count)
+        simple_stack_create(&state->buckets[state->bucket_count]);
+
+    return SUCCESS();
+}
+
+static inline size_t bucket_of(delta_stepping* state, double distance) {
+    return (size_t) (distance / state->delta);
+}
+
+static void relax(delta_stepping* state, node_id target, double distance) {
+    if (distance >= state->distances[target])
+        return;
+
+    state->distances[target] = distance;
+
+    // Node may stay in old bucket, it's skipped there
+    const size_t bucket = bucket_of(state, distance);
+    TRY reserve_buckets(state, bucket)
+        THROW("Can't put node in bucket %zu!", bucket);
+
+    simple_stack_push(&state->buckets[bucket], target);
+}
+
+static void generate_requests(size_t begin, size_t end, void* argument) {
+    delta_stepping* state = (delta_stepping*) argument;
+    digraph_analytics* analytics = state->analytics;
+    digraph_adjacency* adjacency = &analytics->adjacency;
+
+    simple_stack<node_id>* sources = state->is_light ? &state->frontier : &state->settled;
+
+    for (size_t i = begin; i < end; ++ i) {
+        const node_id id = sources->elements[i];
+        relax_request* request = state->requests + state->request_offsets[i];
+
+        for (size_t edge = adjacency->out_offsets[id];
+             edge < adjacency->out_offsets[id + 1]; ++ edge, ++ request) {
+
+            const double weight = analytics->out_weights[edge];
+
+            if ((weight <= state->delta) != state->is_light) {
+                request->target = linked_list_end_index;
+                continue;
+            }
+
+            *request = { .target   = adjacency->out_edges[edge].neighbour,
+                         .distance = state->distances[id] + weight };
+        }
+    }
+}
+
+/**
+ * Requests are made concurrently, each source writes to it's own range,
+ * then they are applied in order, so result doesn't depend on scheduling
+ */
+static stack_trace* relax_edges(delta_stepping* state, bool is_light) {
+    digraph_adjacency* adjacency = &state->analytics->adjacency;
+    simple_stack<node_id>* sources = is_light ? &state->frontier : &state->settled;
+
+    size_t request_count = 0;
+    for (size_t i = 0; i < sources->used; ++ i) {
+        const node_id id = sources->elements[i];
+
+        state->request_offsets[i] = request_count;
+        request_count += adjacency->out_offsets[id + 1] - adjacency->out_offsets[id];
+    }
+
+    if (state->request_capacity < request_count) {
+        relax_request* new_requests = (relax_request*)
+            realloc(state->requests, request_count * sizeof(*new_requests));
+
+        if (new_requests == NULL)
+            return FAILURE(RUNTIME_ERROR, "Can't allocate %zu requests!", request_count);
+
+        state->requests = new_requests;
+        state->request_capacity = request_count;
+    }
+
+    state->is_light = is_light;
+    graphviz_parallel_for(sources->used, generate_requests, state);
+
+    for (size_t i = 0; i < request_count; ++ i) {
+        relax_request* request = &state->requests[i];
+
+        if (request->target != linked_list_end_index)
+            relax(state, request->target, request->distance);
+    }
+
+    return SUCCESS();
+}
+
+stack_trace* digraph_shortest_paths(digraph_analytics* analytics, node_id source,
+                                    double delta, double* distances) {
+    digraph_adjacency* adjacency = &analytics->adjacency;
+    const size_t capacity = adjacency->node_capacity;
+
+    if (!digraph_adjacency_has_node(adjacency, source))
+        return FAILURE(RUNTIME_ERROR, "There's no source node %d!", source);
+
+    if (!(delta > 0))
+        return FAILURE(RUNTIME_ERROR, "Bucket width should be positive, not %lf!", delta);
+
+    for (size_t i = 0; i < adjacency->out_offsets[capacity]; ++ i)
+        if (analytics->out_weights[i] < 0)
+            return FAILURE(RUNTIME_ERROR, "Edge weights should be non negative!");
+
+    for (size_t i = 0; i < capacity; ++ i)
+        distances[i] = INFINITY;
+
+    delta_stepping state = { .analytics = analytics, .delta = delta, .distances = distances };
+    simple_stack_create(&state.frontier);
+    simple_stack_create(&state.settled);
+
+    FINALIZER(state_destroy, { delta_stepping_destroy(&state); });
+
+    TRY safe_calloc(capacity, &state.frontier_marks)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate frontier marks!");
+
+    TRY safe_calloc(capacity, &state.settled_marks)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate settled marks!");
+
+    TRY safe_calloc(capacity + 1, &state.request_offsets)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate request offsets!");
+
+    relax(&state, source, 0);
+
+    size_t round = 0;
+    for (size_t bucket = 0; bucket < state.bucket_count; ++ bucket) {
+        state.settled.used = 0;
+
+        while (state.buckets[bucket].used > 0) {
+            // Take every node, that is still in this bucket, once
+            ++ round, state.frontier.used = 0;
+
+            SIMPLE_STACK_TRAVERSE(&state.buckets[bucket], node_id, current) {
+                if (bucket_of(&state, distances[*current]) != bucket ||
+                    state.frontier_marks[*current] == round)
+                    continue;
+
+                state.frontier_marks[*current] = round;
+                simple_stack_push(&state.frontier, *current);
+
+                if (state.settled_marks[*current] != bucket + 1) {
+                    state.settled_marks[*current] = bucket + 1;
+                    simple_stack_push(&state.settled, *current);
+                }
+            }
+
+            state.buckets[bucket].used = 0;
+
+            // Light edges can put nodes back in this bucket
+            TRY relax_edges(&state, true)
+                FINALIZE_AND_FAIL(state_destroy, "Can't relax light edges!");
+        }
+
+        // Heavy edges always lead to the later buckets
+        TRY relax_edges(&state, false)
+            FINALIZE_AND_FAIL(state_destroy, "Can't relax heavy edges!");
+    }
+
+    CALL_FINALIZER(state_destroy);
+    return SUCCESS();
+}
+
+// -------------------------------- PAGE RANK ---------------------------------
+
+struct page_rank_iteration {
+    digraph_analytics* analytics;
+    const double *ranks;
+    double* new_ranks;
+
+    double damping, base; // Rank every node gets regardless of edges
+};
+
+static void pull_ranks(size_t begin, size_t end, void* argument) {
+    page_rank_iteration* iteration = (page_rank_iteration*) argument;
+    digraph_analytics* analytics = iteration->analytics;
+    digraph_adjacency* adjacency = &analytics->adjacency;
+
+    for (node_id id = (node_id) begin; id < (node_id) end; ++ id) {
+        if (!digraph_adjacency_has_node(adjacency, id))
+            continue;
+
+        double pulled = 0;
+        for (size_t edge = adjacency->in_offsets[id];
+             edge < adjacency->in_offsets[id + 1]; ++ edge) {
+
+            const node_id source = adjacency->in_edges[edge].neighbour;
+            pulled += iteration->ranks[source] * analytics->in_weights[edge] /
+                      analytics->out_weight_sums[source];
+        }
+
+        iteration->new_ranks[id] = iteration->base + iteration->damping * pulled;
+    }
+}
+
+stack_trace* digraph_page_rank(digraph_analytics* analytics, double* ranks,
+                               double damping, double tolerance, size_t max_iterations) {
+    digraph_adjacency* adjacency = &analytics->adjacency;
+    const size_t capacity = adjacency->node_capacity;
+
+    if (analytics->node_count == 0)
+        return SUCCESS();
+
+    double* new_ranks = NULL;
+    TRY safe_calloc(capacity, &new_ranks)
+        FAIL("Can't allocate ranks!");
+
+    const double node_count = (double) analytics->node_count;
+    for (node_id id = 0; (size_t) id < capacity; ++ id)
+        ranks[id] = digraph_adjacency_has_node(adjacency, id) ? 1 / node_count : 0;
+
+    for (size_t iteration = 0; iteration < max_iterations; ++ iteration) {
+        // Nodes without out edges pass their rank to everyone
+        double dangling = 0;
+        for (node_id id = 0; (size_t) id < capacity; ++ id)
+            if (analytics->out_weight_sums[id] == 0)
+                dangling += ranks[id];
+
+        page_rank_iteration step = {
+            .analytics = analytics, .ranks = ranks, .new_ranks = new_ranks,
+            .damping = damping,
+            .base = (1 - damping) / node_count + damping * dangling / node_count
+        };
+
+        graphviz_parallel_for(capacity, pull_ranks, &step);
+
+        double change = 0;
+        for (size_t id = 0; id < capacity; ++ id)
+            change += fabs(new_ranks[id] - ranks[id]);
+
+        memcpy(ranks, new_ranks, capacity * sizeof(*ranks));
+
+        if (change < tolerance)
+            break;
+    }
+
+    free(new_ranks);
+    return SUCCESS();
+}
+
+// ------------------------------- BETWEENNESS --------------------------------
+
+struct betweenness_sampling {
+    digraph_analytics* analytics;
+    const node_id* sources;
+
+    double* centrality;
+    pthread_mutex_t lock; // Guards centrality
+};
+
+struct brandes_state {
+    int* hops;
+    double* paths;      // Number of shortest paths from source
+    double* dependency;
+    node_id* order;     // Nodes in order of discovery
+    double* centrality; // Sum for sources of this chunk
+};
+
+static void brandes_state_destroy(brandes_state* state) {
+    free(state->hops);
+    free(state->paths);
+    free(state->dependency);
+    free(state->order);
+    free(state->centrality);
+
+    *state = {};
+}
+
+static stack_trace* brandes_state_create(brandes_state* state, size_t capacity) {
+    FINALIZER(state_destroy, { brandes_state_destroy(state); });
+
+    TRY safe_calloc(capacity, &state->hops)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate hops!");
+
+    TRY safe_calloc(capacity, &state->paths)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate path counts!");
+
+    TRY safe_calloc(capacity, &state->dependency)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate dependencies!");
+
+    TRY safe_calloc(capacity, &state->order)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate order!");
+
+    TRY safe_calloc(capacity, &state->centrality)
+        FINALIZE_AND_FAIL(state_destroy, "Can't allocate centrality!");
+
+    // Nodes are unreached, until search from source finds them
+    for (size_t i = 0; i < capacity; ++ i)
+        state->hops[i] = -1;
+
+    return SUCCESS();
+}
+
+static void brandes_from(digraph_adjacency* adjacency, brandes_state* state, node_id source) {
+    size_t discovered = 0, processed = 0;
+
+    state->order[discovered ++] = source;
+    state->hops[source] = 0, state->paths[source] = 1;
+
+    while (processed < discovered) {
+        const node_id current = state->order[processed ++];
+
+        for (size_t edge = adjacency->out_offsets[current];
+             edge < adjacency->out_offsets[current + 1]; ++ edge) {
+
+            const node_id next = adjacency->out_edges[edge].neighbour;
+
+            if (state->hops[next] < 0) {
+                state->hops[next] = state->hops[current] + 1;
+                state->order[discovered ++] = next;
+            }
+
+            if (state->hops[next] == state->hops[current] + 1)
+                state->paths[next] += state->paths[current];
+        }
+    }
+
+    // Dependencies are accumulated from the farthest nodes back
+    for (size_t i = discovered; i-- > 0; ) {
+        const node_id current = state->order[i];
+
+        for (size_t edge = adjacency->in_offsets[current];
+             edge < adjacency->in_offsets[current + 1]; ++ edge) {
+
+            const node_id previous = adjacency->in_edges[edge].neighbour;
+
+            if (state->hops[previous] >= 0 &&
+                state->hops[previous] == state->hops[current] - 1)
+                state->dependency[previous] += state->paths[previous] /
+                    state->paths[current] * (1 + state->dependency[current]);
+        }
+
+        if (current != source)
+            state->centrality[current] += state->dependency[current];
+    }
+
+    // Only visited nodes are reset, so each source costs what it visits
+    for (size_t i = 0; i < discovered; ++ i) {
+        const node_id current = state->order[i];
+
+        state->hops[current] = -1;
+        state->paths[current] = state->dependency[current] = 0;
+    }
+}
+
+static void sample_sources(size_t begin, size_t end, void* argument) {
+    betweenness_sampling* sampling = (betweenness_sampling*) argument;
+    digraph_adjacency* adjacency = &sampling->analytics->adjacency;
+    const size_t capacity = adjacency->node_capacity;
+
+    brandes_state state = {};
+    TRY brandes_state_create(&state, capacity)
+        THROW("Can't allocate betweenness state!");
+
+    for (size_t i = begin; i < end; ++ i)
+        brandes_from(adjacency, &state, sampling->sources[i]);
+
+    pthread_mutex_lock(&sampling->lock);
+
+    for (size_t i = 0; i < capacity; ++ i)
+        sampling->centrality[i] += state.centrality[i];
+
+    pthread_mutex_unlock(&sampling->lock);
+
+    brandes_state_destroy(&state);
+}
+
+static inline uint64_t splitmix64(uint64_t* state) {
+    uint64_t value = (*state += 0x9E3779B97F4A7C15);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EB;
+
+    return value ^ (value >> 31);
+}
+
+stack_trace* digraph_betweenness(digraph_analytics* analytics, double* centrality,
+                                 size_t samples, uint64_t seed) {
+    digraph_adjacency* adjacency = &analytics->adjacency;
+    const size_t capacity = adjacency->node_capacity;
+
+    memset(centrality, 0, capacity * sizeof(*centrality));
+
+    if (analytics->node_count == 0 || samples == 0)
+        return SUCCESS();
+
+    node_id* sources = NULL;
+    TRY safe_calloc(analytics->node_count, &sources)
+        FAIL("Can't allocate sources!");
+
+    size_t node_count = 0;
+    for (node_id id = 0; (size_t) id < capacity; ++ id)
+        if (digraph_adjacency_has_node(adjacency, id))
+            sources[node_count ++] = id;
+
+    // Partial Fisher-Yates shuffle, first /samples/ nodes become sources
+    if (samples > node_count)
+        samples = node_count;
+
+    for (size_t i = 0; i < samples; ++ i) {
+        size_t chosen = i + (size_t) (splitmix64(&seed) % (node_count - i));
+
+        node_id temporary = sources[i];
+        sources[i] = sources[chosen], sources[chosen] = temporary;
+    }
+
+    betweenness_sampling sampling = {
+        .analytics = analytics, .sources = sources, .centrality = centrality
+    };
+
+    pthread_mutex_init(&sampling.lock, NULL);
+    graphviz_parallel_for(samples, sample_sources, &sampling);
+    pthread_mutex_destroy(&sampling.lock);
+
+    // Every source contributes about the same, so sum is scaled to all of them
+    const double scale = (double) node_count / (double) samples;
+    for (size_t i = 0; i < capacity; ++ i)
+        centrality[i] *= scale;
+
+    free(sources);
+    return SUCCESS();
+}
+
+// --------------------------------- COLORING ---------------------------------
+
+void digraph_color_by_score(digraph* graph, const double* scores, size_t node_capacity) {
+    // From the least to the most important
+    static const graphviz_color ramp[] = {
+        GRAPHVIZ_BLACK,  GRAPHVIZ_BLUE,   GRAPHVIZ_GREEN,
+        GRAPHVIZ_YELLOW, GRAPHVIZ_ORANGE, GRAPHVIZ_RED
+    };
+
+    const size_t ramp_size = sizeof(ramp) / sizeof(*ramp);
+
+    double min = INFINITY, max = -INFINITY;
+    for (size_t i = 0; i < node_capacity; ++ i)
+        if (isfinite(scores[i])) {
+            if (scores[i] < min) min = scores[i];
+            if (scores[i] > max) max = scores[i];
+        }
+
+    if (min > max)
+        return; // There's no finite scores
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node) {
+            node_id id = linked_list_get_index(&current->element.nodes, current_node);
+
+            if ((size_t) id >= node_capacity || !isfinite(scores[id]))
+                continue;
+
+            double position = max > min ? (scores[id] - min) / (max - min) : 0;
+            size_t step = (size_t) (position * (double) ramp_size);
+
+            current_node->element.color = ramp[step < ramp_size ? step : ramp_size - 1];
+        }
+}
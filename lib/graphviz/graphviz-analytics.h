@@ -0,0 +1,63 @@
+#pragma once
+
+#include "graphviz.h"
+#include "graphviz-adjacency.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Weighted CSR snapshot of graph for analytics, like digraph_adjacency
+ * it should be recreated after graph is changed. Every result is an
+ * array of adjacency.node_capacity values, indexed by node id.
+ */
+struct digraph_analytics {
+    digraph_adjacency adjacency;
+
+    double* out_weights; // Weight of adjacency.out_edges[i]
+    double*  in_weights; // Weight of adjacency. in_edges[i]
+
+    double* out_weight_sums; // Sum of weights of edges going out of node
+    size_t node_count;
+};
+
+stack_trace* digraph_analytics_create(digraph_analytics* analytics, digraph* graph);
+
+void digraph_analytics_destroy(digraph_analytics* analytics);
+
+/**
+ * Find weighted distances from @arg source with delta-stepping. Nodes are
+ * put in buckets of width @arg delta by distance, nodes of a bucket are
+ * relaxed together, concurrently. Weights should be non negative.
+ *
+ * @arg distances is set to distance of every node, INFINITY if it's
+ * unreachable
+ */
+stack_trace* digraph_shortest_paths(digraph_analytics* analytics, node_id source,
+                                    double delta, double* distances);
+
+/**
+ * Find PageRank of every node, edges pass rank in proportion to weights.
+ * Each iteration is a product of sparse matrix of in edges and a vector,
+ * nodes pull rank from their sources concurrently. Stops after
+ * @arg max_iterations, or when ranks change by less than @arg tolerance.
+ */
+stack_trace* digraph_page_rank(digraph_analytics* analytics, double* ranks,
+                               double damping = 0.85, double tolerance = 1e-6,
+                               size_t max_iterations = 100);
+
+/**
+ * Estimate betweenness of every node by paths, that start from
+ * @arg samples random sources, paths are counted in hops. Sources are
+ * processed concurrently, estimate is scaled to all sources.
+ */
+stack_trace* digraph_betweenness(digraph_analytics* analytics, double* centrality,
+                                 size_t samples, uint64_t seed = 42);
+
+/**
+ * Color nodes by @arg scores, from black for the lowest to red for the
+ * highest, scores are indexed by node id, like analytics results.
+ * Non finite scores (like distance to unreachable node) are left as is.
+ */
+void digraph_color_by_score(digraph* graph, const double* scores, size_t node_capacity);
@@ -0,0 +1,229 @@
+#include "graphviz-attributes.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "default-hash-functions.h"
+#include "hash-table.h"
+#include "trace.h"
+
+static const char* const builtin_names[ATTRIBUTE_BUILTIN_COUNT] = {
+    "fillcolor", "penwidth", "fontsize", "fontcolor", "tooltip", "URL"
+};
+
+// Run, that is created for element's first attribute
+const uint32_t ATTRIBUTE_RUN_CAPACITY = 2;
+
+/** Names of interned keys, shared by every graph */
+struct attribute_names {
+    pthread_mutex_t lock;
+
+    hash_table<const char*, attribute_key> ids;
+
+    // Names of keys, that aren't builtin, strings are owned by table
+    char** names;
+    size_t count, capacity;
+};
+
+static attribute_names interned = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static void intern_builtin_names() {
+    TRY hash_table_create(&interned.ids, str_hash, 32, 10, str_equals)
+        THROW("Failed to create table of attribute names!");
+
+    for (attribute_key key = 0; key < ATTRIBUTE_BUILTIN_COUNT; ++ key)
+        hash_table_insert(&interned.ids, builtin_names[key], key);
+}
+
+static stack_trace* intern_new_name(const char* name, attribute_key* key) {
+    if (ATTRIBUTE_BUILTIN_COUNT + interned.count > UINT16_MAX)
+        return FAILURE(RUNTIME_ERROR, "Too many attribute names!");
+
+    if (interned.count == interned.capacity) {
+        size_t new_capacity = interned.capacity > 0 ? interned.capacity * 2 : 16;
+
+        char** new_names = (char**) realloc(interned.names, new_capacity * sizeof(*new_names));
+        if (new_names == NULL)
+            return FAILURE(RUNTIME_ERROR, "Can't intern %zu attribute names!", new_capacity);
+
+        interned.names = new_names, interned.capacity = new_capacity;
+    }
+
+    char* own_name = strdup(name);
+    if (own_name == NULL)
+        return FAILURE(RUNTIME_ERROR, "Can't copy attribute name!");
+
+    *key = (attribute_key) (ATTRIBUTE_BUILTIN_COUNT + interned.count);
+    interned.names[interned.count ++] = own_name;
+
+    hash_table_insert(&interned.ids, (const char*) own_name, *key);
+    return SUCCESS();
+}
+
+attribute_key attribute_key_intern(const char* name) {
+    pthread_mutex_lock(&interned.lock);
+
+    if (interned.ids.hash_table == NULL)
+        intern_builtin_names();
+
+    attribute_key key = 0;
+
+    stack_trace* result = SUCCESS();
+
+    attribute_key* existing = hash_table_lookup(&interned.ids, name);
+    if (existing != NULL)
+        key = *existing;
+    else
+        result = intern_new_name(name, &key);
+
+    pthread_mutex_unlock(&interned.lock);
+
+    TRY result THROW("Failed to intern attribute \"%s\"!", name);
+    return key;
+}
+
+const char* attribute_key_name(attribute_key key) {
+    if (key < ATTRIBUTE_BUILTIN_COUNT)
+        return builtin_names[key];
+
+    pthread_mutex_lock(&interned.lock);
+
+    // Names themselves are never moved, so pointer outlives the lock
+    size_t index = (size_t) (key - ATTRIBUTE_BUILTIN_COUNT);
+    const char* name = index < interned.count ? interned.names[index] : NULL;
+
+    pthread_mutex_unlock(&interned.lock);
+    return name;
+}
+
+static void attribute_destroy(attribute* value) {
+    if (value->type == ATTRIBUTE_STRING)
+        free(value->string), value->string = NULL;
+}
+
+stack_trace* attribute_run_set(attribute_run** run, attribute value) {
+    if (value.type == ATTRIBUTE_STRING) {
+        value.string = strdup(value.string != NULL ? value.string : "");
+
+        if (value.string == NULL)
+            return FAILURE(RUNTIME_ERROR, "Can't copy value of attribute %u!", value.key);
+    }
+
+    attribute_run* current = *run;
+
+    // Position, that keeps run sorted
+    uint32_t position = 0;
+    while (current != NULL && position < current->count &&
+           current->attributes[position].key < value.key)
+        ++ position;
+
+    if (current != NULL && position < current->count &&
+        current->attributes[position].key == value.key) {
+
+        attribute_destroy(&current->attributes[position]);
+        current->attributes[position] = value;
+
+        return SUCCESS();
+    }
+
+    if (current == NULL || current->count == current->capacity) {
+        uint32_t new_capacity = current != NULL ? current->capacity * 2 : ATTRIBUTE_RUN_CAPACITY;
+
+        attribute_run* grown = (attribute_run*)
+            realloc(current, sizeof(attribute_run) + new_capacity * sizeof(attribute));
+
+        if (grown == NULL) {
+            attribute_destroy(&value);
+            return FAILURE(RUNTIME_ERROR, "Can't grow run to %u attributes!", new_capacity);
+        }
+
+        if (current == NULL)
+            grown->count = 0;
+
+        grown->capacity = new_capacity;
+        *run = current = grown;
+    }
+
+    memmove(&current->attributes[position + 1], &current->attributes[position],
+            (current->count - position) * sizeof(attribute));
+
+    current->attributes[position] = value;
+    ++ current->count;
+
+    return SUCCESS();
+}
+
+const attribute* attribute_run_get(const attribute_run* run, attribute_key key) {
+    if (run == NULL)
+        return NULL;
+
+    for (uint32_t i = 0; i < run->count; ++ i)
+        if (run->attributes[i].key == key)
+            return &run->attributes[i];
+
+    return NULL;
+}
+
+bool attribute_run_remove(attribute_run* run, attribute_key key) {
+    attribute* found = (attribute*) attribute_run_get(run, key);
+    if (found == NULL)
+        return false;
+
+    attribute_destroy(found);
+
+    uint32_t position = (uint32_t) (found - run->attributes);
+    memmove(found, found + 1, (run->count - position - 1) * sizeof(attribute));
+
+    -- run->count;
+    return true;
+}
+
+void attribute_run_destroy(attribute_run* run) {
+    if (run == NULL)
+        return;
+
+    for (uint32_t i = 0; i < run->count; ++ i)
+        attribute_destroy(&run->attributes[i]);
+
+    free(run);
+}
+
+// Quotes and backslashes are escaped, so value stays one quoted string
+static void write_quoted(buffered_writer* writer, const char* string) {
+    buffered_writer_putc(writer, '"');
+
+    for (const char* current = string; *current != '\0'; ++ current) {
+        if (*current == '"' || *current == '\\')
+            buffered_writer_putc(writer, '\\');
+
+        buffered_writer_putc(writer, *current);
+    }
+
+    buffered_writer_putc(writer, '"');
+}
+
+void attribute_run_write(buffered_writer* writer, const attribute_run* run) {
+    if (run == NULL)
+        return;
+
+    for (uint32_t i = 0; i < run->count; ++ i) {
+        const attribute* current = &run->attributes[i];
+
+        buffered_writer_printf(writer, ", %s = ", attribute_key_name(current->key));
+
+        switch (current->type) {
+        case ATTRIBUTE_NUMBER:
+            buffered_writer_printf(writer, "%g", current->number);
+            break;
+
+        case ATTRIBUTE_RGB:
+            buffered_writer_printf(writer, "\"#%06x\"", current->rgb);
+            break;
+
+        case ATTRIBUTE_STRING:
+            write_quoted(writer, current->string);
+            break;
+        }
+    }
+}
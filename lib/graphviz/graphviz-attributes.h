@@ -0,0 +1,96 @@
+#pragma once
+
+#include "graphviz-writer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Interned name of graphviz attribute. Builtin keys are known up front,
+ * other names get their ids from attribute_key_intern
+ */
+typedef uint16_t attribute_key;
+
+enum graphviz_attribute_key : attribute_key {
+    ATTRIBUTE_FILLCOLOR, ATTRIBUTE_PENWIDTH, ATTRIBUTE_FONTSIZE,
+    ATTRIBUTE_FONTCOLOR, ATTRIBUTE_TOOLTIP,  ATTRIBUTE_URL,
+
+    ATTRIBUTE_BUILTIN_COUNT
+};
+
+enum attribute_type : uint8_t {
+    ATTRIBUTE_NUMBER, // Written as is, like penwidth = 2.5
+    ATTRIBUTE_RGB,    // Written as quoted "#rrggbb"
+    ATTRIBUTE_STRING  // Written quoted, string is owned by attribute
+};
+
+/** Extra attribute of node or edge, that doesn't fit in the fixed enums */
+struct attribute {
+    attribute_key key;
+    attribute_type type;
+
+    union {
+        double number;
+        uint32_t rgb;
+        char* string;
+    };
+};
+
+/**
+ * Extra attributes of one element, sorted by key. Only elements, that
+ * have extras, have runs, so others cost nothing
+ */
+struct attribute_run {
+    uint32_t count, capacity;
+    attribute attributes[];
+};
+
+/**
+ * @return id of attribute named @arg name, same name always gets same id
+ */
+attribute_key attribute_key_intern(const char* name);
+
+const char* attribute_key_name(attribute_key key);
+
+inline attribute attribute_number(attribute_key key, double number) {
+    attribute value = { .key = key, .type = ATTRIBUTE_NUMBER, .number = number };
+    return value;
+}
+
+inline attribute attribute_rgb(attribute_key key, uint8_t red, uint8_t green, uint8_t blue) {
+    attribute value = {
+        .key = key, .type = ATTRIBUTE_RGB,
+        .rgb = (uint32_t) red << 16 | (uint32_t) green << 8 | blue
+    };
+
+    return value;
+}
+
+/**
+ * @arg string is copied, when attribute is set
+ */
+inline attribute attribute_string(attribute_key key, const char* string) {
+    attribute value = { .key = key, .type = ATTRIBUTE_STRING, .string = (char*) string };
+    return value;
+}
+
+/**
+ * Set attribute in @arg run, replacing old value with the same key,
+ * run is created or moved, when it grows
+ */
+stack_trace* attribute_run_set(attribute_run** run, attribute value);
+
+const attribute* attribute_run_get(const attribute_run* run, attribute_key key);
+
+/**
+ * @return false if there's no attribute with such key
+ */
+bool attribute_run_remove(attribute_run* run, attribute_key key);
+
+void attribute_run_destroy(attribute_run* run);
+
+/**
+ * Write attributes of run as continuation of element's attribute list
+ */
+void attribute_run_write(buffered_writer* writer, const attribute_run* run);
@@ -0,0 +1,386 @@
+#include "graphviz-compressed.h"
+#include "graphviz-adjacency.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash-table.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+// --------------------------------- VARINTS ----------------------------------
+
+// Longest varint encoding of a 64 bit number
+const size_t VARINT_MAX_SIZE = 10;
+
+static inline size_t varint_write(uint8_t* output, uint64_t value) {
+    size_t size = 0;
+
+    // Seven bits per byte, high bit marks that there are more bytes
+    while (value >= 0x80) {
+        output[size ++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+
+    output[size ++] = (uint8_t) value;
+    return size;
+}
+
+static inline uint64_t varint_read(const uint8_t* input, size_t* position) {
+    uint64_t value = 0;
+
+    for (int shift = 0; ; shift += 7) {
+        uint8_t byte = input[(*position) ++];
+        value |= (uint64_t) (byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+}
+
+// Map small negative numbers to small positive ones: 0, -1, 1, -2...
+static inline uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+// --------------------------------- BUILDING ---------------------------------
+
+static edge* entry_edge(digraph* graph, adjacency_entry* entry) {
+    subgraph* owner = digraph_get_subgraph(graph, entry->subgraph);
+    return &linked_list_get_pointer(&owner->edges, entry->edge)->element;
+}
+
+static int compare_entries(const void* first, const void* second) {
+    const adjacency_entry* lhs = (const adjacency_entry*) first;
+    const adjacency_entry* rhs = (const adjacency_entry*) second;
+
+    if (lhs->neighbour != rhs->neighbour)
+        return lhs->neighbour < rhs->neighbour ? -1 : 1;
+
+    // Parallel edges are ordered by their place in graph, for determinism
+    if (lhs->subgraph  != rhs->subgraph)
+        return lhs->subgraph  < rhs->subgraph  ? -1 : 1;
+
+    return (lhs->edge > rhs->edge) - (lhs->edge < rhs->edge);
+}
+
+static inline bool is_empty_label(const char* label) {
+    return label == NULL || label[0] == '\0';
+}
+
+static size_t copy_label(compressed_digraph* compressed, const char* label) {
+    size_t offset = compressed->labels_size;
+    size_t length = label != NULL ? strlen(label) : 0;
+
+    memcpy(compressed->labels + offset, label != NULL ? label : "", length);
+    compressed->labels[offset + length] = '\0';
+
+    compressed->labels_size += length + 1;
+    return offset;
+}
+
+// Most common color and style become defaults, they aren't stored per edge
+static void choose_edge_defaults(compressed_digraph* compressed, digraph* graph) {
+    const int colors = GRAPHVIZ_ORANGE + 1, styles = STYLE_SOLID + 1;
+    size_t counts[colors][styles] = {};
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.edges, edge, current_edge)
+            ++ counts[current_edge->element.color][current_edge->element.style];
+
+    for (int color = 0; color < colors; ++ color)
+        for (int style = 0; style < styles; ++ style)
+            if (counts[color][style] > counts[compressed->default_edge_color]
+                                             [compressed->default_edge_style]) {
+                compressed->default_edge_color = (uint8_t) color;
+                compressed->default_edge_style = (uint8_t) style;
+            }
+}
+
+static bool is_default_edge(compressed_digraph* compressed, edge* current_edge) {
+    return current_edge->color == compressed->default_edge_color &&
+           current_edge->style == compressed->default_edge_style &&
+           is_empty_label(current_edge->label) && current_edge->weight == 0;
+}
+
+static stack_trace* allocate_columns(compressed_digraph* compressed, digraph* graph,
+                                     digraph_adjacency* adjacency) {
+    const size_t capacity = compressed->node_capacity;
+
+    TRY safe_calloc(capacity, &compressed->node_styles) FAIL("Can't allocate styles!");
+    TRY safe_calloc(capacity, &compressed->node_colors) FAIL("Can't allocate colors!");
+    TRY safe_calloc(capacity, &compressed->node_shapes) FAIL("Can't allocate shapes!");
+    TRY safe_calloc(capacity, &compressed->node_labels) FAIL("Can't allocate labels!");
+
+    TRY safe_calloc(capacity + 1, &compressed->neighbour_offsets)
+        FAIL("Can't allocate neighbour offsets!");
+
+    size_t labels_size = 0, attribute_count = 0;
+
+    for (size_t id = 0; id < capacity; ++ id)
+        if (digraph_adjacency_has_node(adjacency, (node_id) id)) {
+            subgraph* owner = digraph_get_subgraph(graph, adjacency->owners[id]);
+            const char* label = linked_list_get_pointer(&owner->nodes,
+                                                        (node_id) id)->element.label;
+
+            labels_size += (label != NULL ? strlen(label) : 0) + 1;
+        }
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.edges, edge, current_edge)
+            if (!is_default_edge(compressed, &current_edge->element)) {
+                labels_size += (is_empty_label(current_edge->element.label) ?
+                                0 : strlen(current_edge->element.label)) + 1;
+                ++ attribute_count;
+            }
+
+    TRY safe_calloc(labels_size, &compressed->labels)
+        FAIL("Can't allocate %zu bytes of labels!", labels_size);
+
+    TRY safe_calloc(attribute_count, &compressed->edge_attributes)
+        FAIL("Can't allocate %zu edge attributes!", attribute_count);
+
+    // Every target takes at most one 64 bit varint
+    const size_t edge_count = adjacency->out_offsets[capacity];
+    TRY safe_calloc(edge_count * VARINT_MAX_SIZE, &compressed->neighbours)
+        FAIL("Can't allocate neighbours of %zu edges!", edge_count);
+
+    return SUCCESS();
+}
+
+static void compress_nodes(compressed_digraph* compressed, digraph* graph,
+                           digraph_adjacency* adjacency) {
+
+    for (size_t id = 0; id < compressed->node_capacity; ++ id) {
+        if (!digraph_adjacency_has_node(adjacency, (node_id) id)) {
+            compressed->node_labels[id] = COMPRESSED_NO_NODE;
+            continue;
+        }
+
+        subgraph* owner = digraph_get_subgraph(graph, adjacency->owners[id]);
+        node* current_node = &linked_list_get_pointer(&owner->nodes, (node_id) id)->element;
+
+        compressed->node_styles[id] = (uint8_t) current_node->style;
+        compressed->node_colors[id] = (uint8_t) current_node->color;
+        compressed->node_shapes[id] = (uint8_t) current_node->shape;
+        compressed->node_labels[id] = copy_label(compressed, current_node->label);
+
+        ++ compressed->node_count;
+    }
+}
+
+static void compress_edges(compressed_digraph* compressed, digraph* graph,
+                           digraph_adjacency* adjacency) {
+    size_t position = 0;
+
+    for (size_t from = 0; from < compressed->node_capacity; ++ from) {
+        compressed->neighbour_offsets[from] = position;
+
+        adjacency_entry* entries = adjacency->out_edges + adjacency->out_offsets[from];
+        size_t degree = adjacency->out_offsets[from + 1] - adjacency->out_offsets[from];
+
+        qsort(entries, degree, sizeof(*entries), compare_entries);
+
+        // First target is relative to source, others are relative to previous
+        int64_t previous = (int64_t) from;
+        for (size_t i = 0; i < degree; ++ i) {
+            int64_t delta = (int64_t) entries[i].neighbour - previous;
+            previous = entries[i].neighbour;
+
+            position += varint_write(compressed->neighbours + position,
+                                     i == 0 ? zigzag_encode(delta) : (uint64_t) delta);
+
+            edge* current_edge = entry_edge(graph, &entries[i]);
+            if (!is_default_edge(compressed, current_edge))
+                compressed->edge_attributes[compressed->edge_attribute_count ++] = {
+                    .edge  = compressed->edge_count,
+                    .color = (uint8_t) current_edge->color,
+                    .style = (uint8_t) current_edge->style,
+                    .label = copy_label(compressed, current_edge->label),
+                    .weight = current_edge->weight
+                };
+
+            ++ compressed->edge_count;
+        }
+    }
+
+    compressed->neighbour_offsets[compressed->node_capacity] = position;
+
+    // Buffer was allocated for the worst case, give back the rest
+    uint8_t* shrinked = (uint8_t*) realloc(compressed->neighbours, position + 1);
+    if (shrinked != NULL)
+        compressed->neighbours = shrinked;
+}
+
+stack_trace* compressed_digraph_create(compressed_digraph* compressed, digraph* graph) {
+    *compressed = {};
+
+    // Adjacency already groups edges by source, they just need sorting
+    digraph_adjacency adjacency = {};
+    TRY digraph_adjacency_create(&adjacency, graph)
+        FAIL("Failed to group edges by their source!");
+
+    compressed->node_capacity = adjacency.node_capacity;
+    choose_edge_defaults(compressed, graph);
+
+    FINALIZER(cleanup, {
+        digraph_adjacency_destroy(&adjacency);
+        compressed_digraph_destroy(compressed);
+    });
+
+    TRY allocate_columns(compressed, graph, &adjacency)
+        FINALIZE_AND_FAIL(cleanup, "Failed to allocate compressed graph!");
+
+    compress_nodes(compressed, graph, &adjacency);
+    compress_edges(compressed, graph, &adjacency);
+
+    digraph_adjacency_destroy(&adjacency);
+    return SUCCESS();
+}
+
+void compressed_digraph_destroy(compressed_digraph* compressed) {
+    free(compressed->node_styles);
+    free(compressed->node_colors);
+    free(compressed->node_shapes);
+    free(compressed->node_labels);
+
+    free(compressed->neighbour_offsets);
+    free(compressed->neighbours);
+
+    free(compressed->edge_attributes);
+    free(compressed->labels);
+
+    *compressed = {};
+}
+
+size_t compressed_digraph_size(compressed_digraph* compressed) {
+    const size_t capacity = compressed->node_capacity;
+
+    return capacity * (3 * sizeof(uint8_t) + sizeof(size_t)) /* Node columns */ +
+           (capacity + 1) * sizeof(size_t) + compressed->neighbour_offsets[capacity] +
+           compressed->edge_attribute_count * sizeof(compressed_edge_attributes) +
+           compressed->labels_size;
+}
+
+// --------------------------------- DECODING ---------------------------------
+
+size_t compressed_digraph_out_degree(compressed_digraph* compressed, node_id id) {
+    size_t degree = 0;
+
+    // Every varint ends with exactly one byte that has high bit clear
+    for (size_t i = compressed->neighbour_offsets[id];
+                i < compressed->neighbour_offsets[id + 1]; ++ i)
+        degree += (compressed->neighbours[i] & 0x80) == 0;
+
+    return degree;
+}
+
+size_t compressed_digraph_decode_neighbours(compressed_digraph* compressed,
+                                            node_id id, node_id* targets) {
+    size_t position = compressed->neighbour_offsets[id];
+    const size_t end = compressed->neighbour_offsets[id + 1];
+
+    size_t count = 0;
+    int64_t previous = id;
+
+    while (position < end) {
+        uint64_t encoded = varint_read(compressed->neighbours, &position);
+
+        previous += count == 0 ? zigzag_decode(encoded) : (int64_t) encoded;
+        targets[count ++] = (node_id) previous;
+    }
+
+    return count;
+}
+
+bool compressed_digraph_next_edge(compressed_digraph* compressed,
+                                  compressed_edge_cursor* cursor, edge* decoded) {
+    if (cursor->edge == compressed->edge_count)
+        return false;
+
+    // Skip nodes, whose edges are over (or that don't have any)
+    while (cursor->position == compressed->neighbour_offsets[cursor->from + 1])
+        ++ cursor->from;
+
+    bool is_first = cursor->position == compressed->neighbour_offsets[cursor->from];
+
+    uint64_t encoded = varint_read(compressed->neighbours, &cursor->position);
+    cursor->previous_to = is_first ? (node_id) (cursor->from + zigzag_decode(encoded))
+                                   : (node_id) (cursor->previous_to + (int64_t) encoded);
+
+    *decoded = {
+        .from  = cursor->from, .to = cursor->previous_to,
+        .color = (graphviz_color) compressed->default_edge_color,
+        .style = (graphviz_style) compressed->default_edge_style,
+        .label = NULL
+    };
+
+    if (cursor->attribute < compressed->edge_attribute_count) {
+        compressed_edge_attributes* attributes =
+            &compressed->edge_attributes[cursor->attribute];
+
+        if (attributes->edge == cursor->edge) {
+            decoded->color = (graphviz_color) attributes->color;
+            decoded->style = (graphviz_style) attributes->style;
+            decoded->label = compressed->labels + attributes->label;
+            decoded->weight = attributes->weight;
+
+            ++ cursor->attribute;
+        }
+    }
+
+    ++ cursor->edge;
+    return true;
+}
+
+void compressed_digraph_write_to_file(FILE* file, compressed_digraph* compressed) {
+    fprintf(file, "digraph {" "\n");
+    fprintf(file, "\t" "subgraph {" "\n");
+
+    for (size_t id = 0; id < compressed->node_capacity; ++ id) {
+        if (!compressed_digraph_has_node(compressed, (node_id) id))
+            continue;
+
+        const char* shape =
+            *hash_table_lookup(&graphviz_node_shapes, (int) compressed->node_shapes[id]);
+
+        const char* color =
+            *hash_table_lookup(&graphviz_colors,      (int) compressed->node_colors[id]);
+
+        const char* style =
+            *hash_table_lookup(&graphviz_styles,      (int) compressed->node_styles[id]);
+
+        fprintf(file, "\t\t" "node_%d [" "label = \"%s\","
+                "shape = \"%s\", color = \"%s\", style = \"%s\"];" "\n",
+                (node_id) id, compressed->labels + compressed->node_labels[id],
+                shape, color, style);
+    }
+
+    compressed_edge_cursor cursor = {};
+
+    edge current_edge = {};
+    while (compressed_digraph_next_edge(compressed, &cursor, &current_edge)) {
+        const char* color =
+            *hash_table_lookup(&graphviz_colors, (int) current_edge.color);
+
+        const char* style =
+            *hash_table_lookup(&graphviz_styles, (int) current_edge.style);
+
+        fprintf(file, "\t\t" "node_%d -> node_%d [label = \" %s \","
+                "color = %s, style = %s, margin = \"1.5\"",
+                current_edge.from, current_edge.to,
+                current_edge.label != NULL ? current_edge.label : "", color, style);
+
+        if (current_edge.weight != 0)
+            fprintf(file, ", weight = %d", edge_dot_weight(current_edge.weight));
+
+        fprintf(file, "];" "\n");
+    }
+
+    fprintf(file, "\t" "}" "\n");
+    fprintf(file, "}"  "\n");
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "graphviz.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Label offset of node ids that aren't used by any node
+const size_t COMPRESSED_NO_NODE = SIZE_MAX;
+
+/** Edge whose color, style, label or weight differ from graph's defaults */
+struct compressed_edge_attributes {
+    size_t edge; // Position of edge in order of decoding
+
+    uint8_t color, style;
+    size_t label; // Offset in label heap
+
+    double weight;
+};
+
+/**
+ * Read-only compact copy of a digraph. Edges are sorted by source, then
+ * by target, each node's targets are stored as varint encoded deltas.
+ * Attributes are stored in columns, and for edges only if they differ
+ * from the most common ones, so typical edge takes 1-2 bytes.
+ *
+ * Subgraphs are flattened, node ids are preserved. Extra attributes of
+ * nodes and edges (see subgraph_set_node_attribute) aren't kept.
+ */
+struct compressed_digraph {
+    size_t node_capacity; // Every node id is less than this
+    size_t node_count, edge_count;
+
+    // Node columns, indexed by node id
+    uint8_t *node_styles, *node_colors, *node_shapes;
+    size_t* node_labels; // COMPRESSED_NO_NODE if there's no such node
+
+    // Targets of node i are encoded in neighbours [offsets[i], offsets[i + 1])
+    size_t* neighbour_offsets;
+    uint8_t* neighbours;
+
+    uint8_t default_edge_color, default_edge_style;
+
+    // Sorted by edge position, so they can be merged during decoding
+    compressed_edge_attributes* edge_attributes;
+    size_t edge_attribute_count;
+
+    char* labels; // Null terminated labels of nodes and edges
+    size_t labels_size;
+};
+
+stack_trace* compressed_digraph_create(compressed_digraph* compressed, digraph* graph);
+
+void compressed_digraph_destroy(compressed_digraph* compressed);
+
+// Total memory used by compressed graph, in bytes
+size_t compressed_digraph_size(compressed_digraph* compressed);
+
+inline bool compressed_digraph_has_node(compressed_digraph* compressed, node_id id) {
+    return id > linked_list_end_index && (size_t) id < compressed->node_capacity &&
+           compressed->node_labels[id] != COMPRESSED_NO_NODE;
+}
+
+// Number of edges going out of node @arg id
+size_t compressed_digraph_out_degree(compressed_digraph* compressed, node_id id);
+
+/**
+ * Decode targets of edges going out of node @arg id, in ascending order,
+ * @arg targets should fit compressed_digraph_out_degree of them
+ *
+ * @return number of decoded targets
+ */
+size_t compressed_digraph_decode_neighbours(compressed_digraph* compressed,
+                                            node_id id, node_id* targets);
+
+/** Position of sequential edge decoding, should be zero initialized */
+struct compressed_edge_cursor {
+    node_id from, previous_to;
+
+    size_t position;  // Byte in neighbours
+    size_t edge;      // Number of decoded edges
+    size_t attribute; // Next unused entry in edge attributes
+};
+
+/**
+ * Decode next edge in order of sources, then targets
+ *
+ * @return false if there's no edges left. Label of @arg decoded points
+ * into compressed graph, and shouldn't be freed
+ */
+bool compressed_digraph_next_edge(compressed_digraph* compressed,
+                                  compressed_edge_cursor* cursor, edge* decoded);
+
+/**
+ * Write to @arg file description of the @arg compressed graph in graphviz
+ * dot's lang, same as digraph_write_to_file, with a single subgraph
+ */
+void compressed_digraph_write_to_file(FILE* file, compressed_digraph* compressed);
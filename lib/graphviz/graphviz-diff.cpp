@@ -0,0 +1,304 @@
+#include "graphviz-diff.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "default-hash-functions.h"
+#include "hash-table.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+static inline const char* label_or_empty(const char* label) {
+    return label != NULL ? label : "";
+}
+
+/** Nodes of one of compared graphs, by label and by id */
+struct diff_side {
+    hash_table<const char*, node*> nodes;
+
+    node** by_id;
+    size_t node_capacity;
+};
+
+// Buckets for @arg count keys, table never grows with them: it grows when
+// used buckets reach HASH_TABLE_MAX_LOAD_FACTOR, so there should be more
+// than count / HASH_TABLE_MAX_LOAD_FACTOR of them
+static size_t buckets_for(size_t count) {
+    return (size_t) ((double) (count + 1) / HASH_TABLE_MAX_LOAD_FACTOR) + 1;
+}
+
+static void diff_side_destroy(diff_side* side) {
+    if (side->nodes.hash_table != NULL)
+        hash_table_destroy(&side->nodes);
+
+    free(side->by_id);
+    *side = {};
+}
+
+static stack_trace* diff_side_create(diff_side* side, digraph* graph) {
+    *side = {};
+
+    size_t node_count = 0;
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current) {
+        // List's elements are indexed from 0 to capacity + 1 inclusive
+        size_t subgraph_capacity = current->element.nodes.capacity + 2;
+
+        if (subgraph_capacity > side->node_capacity)
+            side->node_capacity = subgraph_capacity;
+
+        node_count += current->element.nodes.used;
+    }
+
+    FINALIZER(side_destroy, { diff_side_destroy(side); });
+
+    TRY safe_calloc(side->node_capacity, &side->by_id)
+        FINALIZE_AND_FAIL(side_destroy, "Failed to allocate nodes by id!");
+
+    TRY hash_table_create(&side->nodes, str_hash, buckets_for(node_count),
+                          node_count + 1, str_equals)
+        FINALIZE_AND_FAIL(side_destroy, "Failed to create nodes by label!");
+
+    // First node with the same id or label wins, like it does in dot's output
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node) {
+            node_id id = linked_list_get_index(&current->element.nodes, current_node);
+
+            if (side->by_id[id] == NULL)
+                side->by_id[id] = &current_node->element;
+
+            hash_table_lookup_or_insert(&side->nodes,
+                label_or_empty(current_node->element.label), &current_node->element);
+        }
+
+    return SUCCESS();
+}
+
+static node* diff_side_node(diff_side* side, node_id id) {
+    if (id <= linked_list_end_index || (size_t) id >= side->node_capacity)
+        return NULL;
+
+    return side->by_id[id];
+}
+
+
+/**
+ * Edges are identified by labels of their endpoints and their own. Parallel
+ * edges with the same labels are told apart by their order in graph
+ */
+struct diff_edge_key {
+    const char *from, *to, *label;
+    size_t occurrence;
+};
+
+static uint32_t diff_edge_hash(diff_edge_key key) {
+    uint32_t hash = str_hash(key.from);
+    hash = hash * 31 + str_hash(key.to);
+    hash = hash * 31 + str_hash(key.label);
+    hash = hash * 31 + (uint32_t) key.occurrence;
+
+    return hash;
+}
+
+static bool diff_edge_equals(diff_edge_key* first, diff_edge_key* second) {
+    return strcmp(first->from,  second->from)  == 0 &&
+           strcmp(first->to,    second->to)    == 0 &&
+           strcmp(first->label, second->label) == 0 &&
+           first->occurrence == second->occurrence;
+}
+
+// Number of edges with the same labels, keys of this table have zero occurrence
+typedef hash_table<diff_edge_key, size_t> diff_occurrences;
+
+struct diff_edge {
+    edge* found;
+    bool is_matched; // Edge with the same key exists in the other graph
+};
+
+typedef hash_table_pair<diff_edge_key, diff_edge> diff_edge_pair;
+
+// @return false if edge connects missing nodes, it's skipped then
+static bool diff_edge_key_create(diff_side* side, diff_occurrences* occurrences,
+                                 edge* current, diff_edge_key* key) {
+    node *from = diff_side_node(side, current->from),
+         *to   = diff_side_node(side, current->to);
+
+    if (from == NULL || to == NULL)
+        return false;
+
+    *key = { .from  = label_or_empty(from->label),
+             .to    = label_or_empty(to->label),
+             .label = label_or_empty(current->label),
+             .occurrence = 0 };
+
+    // K-th of parallel edges is matched with k-th of them in the other graph
+    key->occurrence = hash_table_lookup_or_insert(occurrences, *key, (size_t) 0)->value ++;
+    return true;
+}
+
+
+static inline bool node_style_equals(node* first, node* second) {
+    return first->shape == second->shape && first->color == second->color &&
+           first->style == second->style;
+}
+
+static inline bool edge_style_equals(edge* first, edge* second) {
+    return first->color == second->color && first->style == second->style &&
+           edge_weight(first) == edge_weight(second);
+}
+
+static node_id diff_insert_node(digraph* diff, subgraph_id changes, const char* label,
+                                node* original, graphviz_color color) {
+    node styled = *original;
+    styled.label = NULL;
+    styled.color = color;
+
+    if (color == GRAPHVIZ_RED)
+        styled.style = STYLE_DASHED;
+
+    return subgraph_get_or_insert_node(diff, changes, label, styled);
+}
+
+static void diff_insert_edge(digraph* diff, subgraph_id changes, diff_edge_key* key,
+                             edge* original, node* from, node* to, graphviz_color color) {
+
+    // Endpoints that didn't change are only context for the edge
+    edge styled = *original;
+    styled.from  = diff_insert_node(diff, changes, key->from, from, GRAPHVIZ_BLACK);
+    styled.to    = diff_insert_node(diff, changes, key->to,   to,   GRAPHVIZ_BLACK);
+    styled.label = original->label != NULL ? strdup(original->label) : NULL;
+    styled.color = color;
+
+    if (color == GRAPHVIZ_RED)
+        styled.style = STYLE_DASHED;
+
+    subgraph_insert_edge(diff, changes, styled);
+}
+
+digraph digraph_diff(digraph* before, digraph* after, digraph_diff_stats* stats) {
+    digraph_diff_stats counted = {};
+
+    diff_side old_side = {}, new_side = {};
+
+    TRY diff_side_create(&old_side, before)
+        THROW("Failed to index nodes of the old graph!");
+
+    TRY diff_side_create(&new_side, after)
+        THROW("Failed to index nodes of the new graph!");
+
+    digraph diff = digraph_create();
+    subgraph_id changes = digraph_create_subgraph(&diff, RANK_NONE);
+
+    // Nodes go first, so they keep their colors when edges refer to them
+    LINKED_LIST_TRAVERSE(&after->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node) {
+            node* new_node = &current_node->element;
+            const char* label = label_or_empty(new_node->label);
+
+            // Only the first node with this label counts
+            if (*hash_table_lookup(&new_side.nodes, label) != new_node)
+                continue;
+
+            node** old_node = hash_table_lookup(&old_side.nodes, label);
+
+            if (old_node == NULL) {
+                diff_insert_node(&diff, changes, label, new_node, GRAPHVIZ_GREEN);
+                ++ counted.added_nodes;
+            } else if (!node_style_equals(*old_node, new_node)) {
+                diff_insert_node(&diff, changes, label, new_node, GRAPHVIZ_ORANGE);
+                ++ counted.changed_nodes;
+            }
+        }
+
+    LINKED_LIST_TRAVERSE(&before->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node) {
+            node* old_node = &current_node->element;
+            const char* label = label_or_empty(old_node->label);
+
+            if (*hash_table_lookup(&old_side.nodes, label) != old_node ||
+                hash_table_lookup(&new_side.nodes, label) != NULL)
+                continue;
+
+            diff_insert_node(&diff, changes, label, old_node, GRAPHVIZ_RED);
+            ++ counted.removed_nodes;
+        }
+
+    size_t old_edge_count = 0, new_edge_count = 0;
+    LINKED_LIST_TRAVERSE(&before->subgraphs, subgraph, current)
+        old_edge_count += current->element.edges.used;
+
+    LINKED_LIST_TRAVERSE(&after->subgraphs, subgraph, current)
+        new_edge_count += current->element.edges.used;
+
+    hash_table<diff_edge_key, diff_edge> old_edges = {};
+    TRY hash_table_create(&old_edges, diff_edge_hash, buckets_for(old_edge_count),
+                          old_edge_count + 1, diff_edge_equals)
+        THROW("Failed to create index of old edges!");
+
+    diff_occurrences old_occurrences = {}, new_occurrences = {};
+
+    TRY hash_table_create(&old_occurrences, diff_edge_hash, buckets_for(old_edge_count),
+                          old_edge_count + 1, diff_edge_equals)
+        THROW("Failed to create counts of old parallel edges!");
+
+    TRY hash_table_create(&new_occurrences, diff_edge_hash, buckets_for(new_edge_count),
+                          new_edge_count + 1, diff_edge_equals)
+        THROW("Failed to create counts of new parallel edges!");
+
+    LINKED_LIST_TRAVERSE(&before->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.edges, edge, current_edge) {
+            diff_edge_key key = {};
+            if (diff_edge_key_create(&old_side, &old_occurrences, &current_edge->element, &key))
+                hash_table_insert(&old_edges, key,
+                    (diff_edge) { .found = &current_edge->element, .is_matched = false });
+        }
+
+    LINKED_LIST_TRAVERSE(&after->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.edges, edge, current_edge) {
+            edge* new_edge = &current_edge->element;
+
+            diff_edge_key key = {};
+            if (!diff_edge_key_create(&new_side, &new_occurrences, new_edge, &key))
+                continue;
+
+            node *from = diff_side_node(&new_side, new_edge->from),
+                 *to   = diff_side_node(&new_side, new_edge->to);
+
+            diff_edge* old_edge = hash_table_lookup(&old_edges, key);
+
+            if (old_edge == NULL) {
+                diff_insert_edge(&diff, changes, &key, new_edge, from, to, GRAPHVIZ_GREEN);
+                ++ counted.added_edges;
+                continue;
+            }
+
+            old_edge->is_matched = true;
+
+            if (!edge_style_equals(old_edge->found, new_edge)) {
+                diff_insert_edge(&diff, changes, &key, new_edge, from, to, GRAPHVIZ_ORANGE);
+                ++ counted.changed_edges;
+            }
+        }
+
+    LINKED_LIST_TRAVERSE(&old_edges.values, diff_edge_pair, current) {
+        diff_edge* old_edge = &current->element.value;
+        if (old_edge->is_matched)
+            continue;
+
+        diff_insert_edge(&diff, changes, &current->element.key, old_edge->found,
+                         diff_side_node(&old_side, old_edge->found->from),
+                         diff_side_node(&old_side, old_edge->found->to), GRAPHVIZ_RED);
+        ++ counted.removed_edges;
+    }
+
+    hash_table_destroy(&old_edges);
+    hash_table_destroy(&old_occurrences);
+    hash_table_destroy(&new_occurrences);
+
+    diff_side_destroy(&old_side);
+    diff_side_destroy(&new_side);
+
+    if (stats != NULL)
+        *stats = counted;
+
+    return diff;
+}
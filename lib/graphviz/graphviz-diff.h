@@ -0,0 +1,28 @@
+#pragma once
+
+#include "graphviz.h"
+#include "trace.h"
+
+#include <stddef.h>
+
+/** How many elements differ between two versions of a graph */
+struct digraph_diff_stats {
+    size_t added_nodes, removed_nodes, changed_nodes;
+    size_t added_edges, removed_edges, changed_edges;
+};
+
+/**
+ * Compare @arg before and @arg after, nodes are matched by their labels
+ * and edges by labels of their endpoints and their own, so ids may differ
+ * between versions. Node or edge is changed, if it's style (or weight of
+ * edge) differs. Nodes with the same label in one graph are the same node,
+ * first wins. Parallel edges with the same labels are matched in order, so
+ * extra ones are added or removed.
+ *
+ * Takes time proportional to the size of both graphs.
+ *
+ * @return New graph with only differences: added elements are green,
+ * removed are red and dashed, changed are orange, unchanged endpoints
+ * of changed edges are black. Should be destroyed with digraph_destroy
+ */
+digraph digraph_diff(digraph* before, digraph* after, digraph_diff_stats* stats = NULL);
@@ -0,0 +1,545 @@
+#include "graphviz-export.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "default-hash-functions.h"
+#include "hash-table.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+// ----------------------------------- JSON -----------------------------------
+
+static void write_json_string(buffered_writer* writer, const char* string) {
+    if (string == NULL) {
+        buffered_writer_puts(writer, "null");
+        return;
+    }
+
+    buffered_writer_putc(writer, '"');
+
+    for (const char* current = string; *current != '\0'; ++ current) {
+        char symbol = *current;
+
+        if (symbol == '"' || symbol == '\\') {
+            buffered_writer_putc(writer, '\\');
+            buffered_writer_putc(writer, symbol);
+        } else if ((unsigned char) symbol < 0x20)
+            buffered_writer_printf(writer, "\\u%04x", (unsigned) symbol);
+        else
+            buffered_writer_putc(writer, symbol);
+    }
+
+    buffered_writer_putc(writer, '"');
+}
+
+static void write_json_attribute(buffered_writer* writer, const char* name,
+                                 hash_table<int, const char*>* names, int value) {
+    buffered_writer_printf(writer, ", \"%s\": ", name);
+
+    const char** value_name = hash_table_lookup(names, value);
+    write_json_string(writer, value_name != NULL ? *value_name : NULL);
+}
+
+static void write_json_subgraph(buffered_writer* writer, subgraph* graph) {
+    buffered_writer_puts(writer, "{\"rank\": ");
+
+    const char** rank = hash_table_lookup(&graphviz_rank_names, (int) graph->rank);
+    write_json_string(writer, rank != NULL ? *rank : NULL);
+
+    buffered_writer_puts(writer, ", \"nodes\": [");
+
+    bool is_first = true;
+    LINKED_LIST_TRAVERSE(&graph->nodes, node, current) {
+        node* current_node = &current->element;
+
+        buffered_writer_puts(writer, is_first ? "\n    {\"id\": " : ",\n    {\"id\": ");
+        buffered_writer_write_int(writer, linked_list_get_index(&graph->nodes, current));
+
+        buffered_writer_puts(writer, ", \"label\": ");
+        write_json_string(writer, current_node->label);
+
+        write_json_attribute(writer, "shape", &graphviz_node_shapes, current_node->shape);
+        write_json_attribute(writer, "color", &graphviz_colors,      current_node->color);
+        write_json_attribute(writer, "style", &graphviz_styles,      current_node->style);
+
+        buffered_writer_putc(writer, '}');
+        is_first = false;
+    }
+
+    buffered_writer_puts(writer, "], \"edges\": [");
+
+    is_first = true;
+    LINKED_LIST_TRAVERSE(&graph->edges, edge, current) {
+        edge* current_edge = &current->element;
+
+        buffered_writer_puts(writer, is_first ? "\n    {\"from\": " : ",\n    {\"from\": ");
+        buffered_writer_write_int(writer, current_edge->from);
+
+        buffered_writer_puts(writer, ", \"to\": ");
+        buffered_writer_write_int(writer, current_edge->to);
+
+        buffered_writer_puts(writer, ", \"label\": ");
+        write_json_string(writer, current_edge->label);
+
+        write_json_attribute(writer, "color", &graphviz_colors, current_edge->color);
+        write_json_attribute(writer, "style", &graphviz_styles, current_edge->style);
+
+        if (current_edge->weight != 0)
+            buffered_writer_printf(writer, ", \"weight\": %.17g", current_edge->weight);
+
+        buffered_writer_putc(writer, '}');
+        is_first = false;
+    }
+
+    buffered_writer_puts(writer, "]}");
+}
+
+void digraph_write_json(buffered_writer* writer, digraph* graph) {
+    buffered_writer_puts(writer, "{\"subgraphs\": [");
+
+    bool is_first = true;
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current) {
+        buffered_writer_puts(writer, is_first ? "\n  " : ",\n  ");
+        write_json_subgraph(writer, &current->element);
+
+        is_first = false;
+    }
+
+    buffered_writer_puts(writer, "\n]}\n");
+}
+
+// --------------------------------- GRAPHML ----------------------------------
+
+static void write_xml_string(buffered_writer* writer, const char* string) {
+    if (string == NULL)
+        return;
+
+    for (const char* current = string; *current != '\0'; ++ current)
+        switch (*current) {
+        case '&':  buffered_writer_puts(writer, "&amp;");  break;
+        case '<':  buffered_writer_puts(writer, "&lt;");   break;
+        case '>':  buffered_writer_puts(writer, "&gt;");   break;
+        case '"':  buffered_writer_puts(writer, "&quot;"); break;
+        case '\'': buffered_writer_puts(writer, "&apos;"); break;
+        default:   buffered_writer_putc(writer, *current); break;
+        }
+}
+
+static void write_graphml_data(buffered_writer* writer, const char* key,
+                               const char* value) {
+    buffered_writer_printf(writer, "<data key=\"%s\">", key);
+    write_xml_string(writer, value);
+    buffered_writer_puts(writer, "</data>");
+}
+
+static void write_graphml_attribute(buffered_writer* writer, const char* key,
+                                    hash_table<int, const char*>* names, int value) {
+    const char** value_name = hash_table_lookup(names, value);
+    if (value_name != NULL)
+        write_graphml_data(writer, key, *value_name);
+}
+
+void digraph_write_graphml(buffered_writer* writer, digraph* graph) {
+    buffered_writer_puts(writer,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"                                   "\n"
+        "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">"                     "\n"
+        "  <key id=\"label\"    for=\"all\"  attr.name=\"label\"    attr.type=\"string\"/>" "\n"
+        "  <key id=\"shape\"    for=\"node\" attr.name=\"shape\"    attr.type=\"string\"/>" "\n"
+        "  <key id=\"color\"    for=\"all\"  attr.name=\"color\"    attr.type=\"string\"/>" "\n"
+        "  <key id=\"style\"    for=\"all\"  attr.name=\"style\"    attr.type=\"string\"/>" "\n"
+        "  <key id=\"subgraph\" for=\"all\"  attr.name=\"subgraph\" attr.type=\"int\"/>"    "\n"
+        "  <key id=\"weight\"   for=\"edge\" attr.name=\"weight\"   attr.type=\"double\">"
+        "<default>1</default></key>"                                                     "\n"
+        "  <graph id=\"G\" edgedefault=\"directed\">"                                    "\n");
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current_subgraph) {
+        subgraph* current = &current_subgraph->element;
+        subgraph_id id = linked_list_get_index(&graph->subgraphs, current_subgraph);
+
+        LINKED_LIST_TRAVERSE(&current->nodes, node, current_node) {
+            buffered_writer_puts(writer, "    <node id=\"n");
+            buffered_writer_write_int(writer, linked_list_get_index(&current->nodes,
+                                                                    current_node));
+            buffered_writer_puts(writer, "\">");
+
+            write_graphml_data(writer, "label", current_node->element.label);
+
+            write_graphml_attribute(writer, "shape", &graphviz_node_shapes,
+                                    current_node->element.shape);
+            write_graphml_attribute(writer, "color", &graphviz_colors,
+                                    current_node->element.color);
+            write_graphml_attribute(writer, "style", &graphviz_styles,
+                                    current_node->element.style);
+
+            buffered_writer_printf(writer, "<data key=\"subgraph\">%d</data></node>\n", id);
+        }
+
+        LINKED_LIST_TRAVERSE(&current->edges, edge, current_edge) {
+            buffered_writer_puts(writer, "    <edge source=\"n");
+            buffered_writer_write_int(writer, current_edge->element.from);
+            buffered_writer_puts(writer, "\" target=\"n");
+            buffered_writer_write_int(writer, current_edge->element.to);
+            buffered_writer_puts(writer, "\">");
+
+            write_graphml_data(writer, "label", current_edge->element.label);
+
+            write_graphml_attribute(writer, "color", &graphviz_colors,
+                                    current_edge->element.color);
+            write_graphml_attribute(writer, "style", &graphviz_styles,
+                                    current_edge->element.style);
+
+            if (current_edge->element.weight != 0)
+                buffered_writer_printf(writer, "<data key=\"weight\">%.17g</data>",
+                                       current_edge->element.weight);
+
+            buffered_writer_printf(writer, "<data key=\"subgraph\">%d</data></edge>\n", id);
+        }
+    }
+
+    buffered_writer_puts(writer, "  </graph>" "\n" "</graphml>" "\n");
+}
+
+// --------------------------------- COLUMNAR ---------------------------------
+
+struct columnar_columns {
+    int32_t  *node_ids, *node_subgraphs;
+    uint32_t *node_labels;
+    uint8_t  *node_shapes, *node_colors, *node_styles;
+
+    int32_t  *edge_froms, *edge_tos, *edge_subgraphs;
+    uint32_t *edge_labels;
+    uint8_t  *edge_colors, *edge_styles;
+    double   *edge_weights;
+
+    // Distinct strings, they point into graph's labels
+    hash_table<const char*, uint32_t> dictionary;
+    const char** strings;
+    size_t string_count, string_capacity, string_bytes;
+};
+
+static void columns_destroy(columnar_columns* columns) {
+    free(columns->node_ids);    free(columns->node_subgraphs); free(columns->node_labels);
+    free(columns->node_shapes); free(columns->node_colors);    free(columns->node_styles);
+
+    free(columns->edge_froms);  free(columns->edge_tos);       free(columns->edge_subgraphs);
+    free(columns->edge_labels); free(columns->edge_colors);    free(columns->edge_styles);
+    free(columns->edge_weights);
+
+    if (columns->dictionary.hash_table != NULL)
+        hash_table_destroy(&columns->dictionary);
+
+    free(columns->strings);
+
+    *columns = {};
+}
+
+static stack_trace* columns_allocate(columnar_columns* columns,
+                                     size_t node_count, size_t edge_count) {
+
+    TRY safe_calloc(node_count, &columns->node_ids)       FAIL("Can't allocate column!");
+    TRY safe_calloc(node_count, &columns->node_subgraphs) FAIL("Can't allocate column!");
+    TRY safe_calloc(node_count, &columns->node_labels)    FAIL("Can't allocate column!");
+    TRY safe_calloc(node_count, &columns->node_shapes)    FAIL("Can't allocate column!");
+    TRY safe_calloc(node_count, &columns->node_colors)    FAIL("Can't allocate column!");
+    TRY safe_calloc(node_count, &columns->node_styles)    FAIL("Can't allocate column!");
+
+    TRY safe_calloc(edge_count, &columns->edge_froms)     FAIL("Can't allocate column!");
+    TRY safe_calloc(edge_count, &columns->edge_tos)       FAIL("Can't allocate column!");
+    TRY safe_calloc(edge_count, &columns->edge_subgraphs) FAIL("Can't allocate column!");
+    TRY safe_calloc(edge_count, &columns->edge_labels)    FAIL("Can't allocate column!");
+    TRY safe_calloc(edge_count, &columns->edge_colors)    FAIL("Can't allocate column!");
+    TRY safe_calloc(edge_count, &columns->edge_styles)    FAIL("Can't allocate column!");
+    TRY safe_calloc(edge_count, &columns->edge_weights)   FAIL("Can't allocate column!");
+
+    // Every label could be distinct
+    columns->string_capacity = node_count + edge_count + 1;
+    TRY safe_calloc(columns->string_capacity, &columns->strings)
+        FAIL("Can't allocate string dictionary!");
+
+    TRY hash_table_create(&columns->dictionary, str_hash, 32, 10, str_equals)
+        FAIL("Can't create string dictionary!");
+
+    return SUCCESS();
+}
+
+// Find string in dictionary, or add it there, NULL is the same as empty string
+static uint32_t intern(columnar_columns* columns, const char* string) {
+    if (string == NULL)
+        string = "";
+
+    bool inserted = false;
+    hash_table_pair<const char*, uint32_t>* pair =
+        hash_table_lookup_or_insert(&columns->dictionary, string,
+                                    (uint32_t) columns->string_count, &inserted);
+
+    if (inserted) {
+        columns->strings[columns->string_count ++] = string;
+        columns->string_bytes += strlen(string) + 1;
+    }
+
+    return pair->value;
+}
+
+static void columns_fill(columnar_columns* columns, digraph* graph) {
+    size_t node = 0, edge = 0;
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current_subgraph) {
+        subgraph* current = &current_subgraph->element;
+        subgraph_id id = linked_list_get_index(&graph->subgraphs, current_subgraph);
+
+        LINKED_LIST_TRAVERSE(&current->nodes, ::node, current_node) {
+            columns->node_ids      [node] = linked_list_get_index(&current->nodes, current_node);
+            columns->node_subgraphs[node] = id;
+            columns->node_labels   [node] = intern(columns, current_node->element.label);
+            columns->node_shapes   [node] = (uint8_t) current_node->element.shape;
+            columns->node_colors   [node] = (uint8_t) current_node->element.color;
+            columns->node_styles   [node] = (uint8_t) current_node->element.style;
+
+            ++ node;
+        }
+
+        LINKED_LIST_TRAVERSE(&current->edges, ::edge, current_edge) {
+            columns->edge_froms    [edge] = current_edge->element.from;
+            columns->edge_tos      [edge] = current_edge->element.to;
+            columns->edge_subgraphs[edge] = id;
+            columns->edge_labels   [edge] = intern(columns, current_edge->element.label);
+            columns->edge_colors   [edge] = (uint8_t) current_edge->element.color;
+            columns->edge_styles   [edge] = (uint8_t) current_edge->element.style;
+            columns->edge_weights  [edge] = current_edge->element.weight;
+
+            ++ edge;
+        }
+    }
+}
+
+static const size_t COLUMN_ALIGNMENT = 8;
+
+static inline uint64_t align(uint64_t offset) {
+    return (offset + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+}
+
+// Place column of @arg size bytes after the previous one
+static uint64_t place_column(uint64_t* end, uint64_t size) {
+    uint64_t offset = align(*end);
+    *end = offset + size;
+
+    return offset;
+}
+
+static void layout_columns(columnar_header* header, columnar_columns* columns) {
+    const uint64_t nodes = header->node_count, edges = header->edge_count;
+    uint64_t end = sizeof(*header);
+
+    header->node_ids       = place_column(&end, nodes * sizeof(int32_t));
+    header->node_subgraphs = place_column(&end, nodes * sizeof(int32_t));
+    header->node_labels    = place_column(&end, nodes * sizeof(uint32_t));
+    header->node_shapes    = place_column(&end, nodes * sizeof(uint8_t));
+    header->node_colors    = place_column(&end, nodes * sizeof(uint8_t));
+    header->node_styles    = place_column(&end, nodes * sizeof(uint8_t));
+
+    header->edge_froms     = place_column(&end, edges * sizeof(int32_t));
+    header->edge_tos       = place_column(&end, edges * sizeof(int32_t));
+    header->edge_subgraphs = place_column(&end, edges * sizeof(int32_t));
+    header->edge_labels    = place_column(&end, edges * sizeof(uint32_t));
+    header->edge_colors    = place_column(&end, edges * sizeof(uint8_t));
+    header->edge_styles    = place_column(&end, edges * sizeof(uint8_t));
+    header->edge_weights   = place_column(&end, edges * sizeof(double));
+
+    header->string_offsets = place_column(&end, (columns->string_count + 1) * sizeof(uint64_t));
+    header->string_bytes   = place_column(&end, columns->string_bytes);
+
+    header->size = align(end);
+}
+
+// Write column at it's offset, padding the gap after the previous one
+static void write_column(buffered_writer* writer, uint64_t* written,
+                         uint64_t offset, const void* column, size_t size) {
+    static const char padding[COLUMN_ALIGNMENT] = {};
+
+    buffered_writer_write(writer, padding, offset - *written);
+    buffered_writer_write(writer, column, size);
+
+    *written = offset + size;
+}
+
+static void write_strings(buffered_writer* writer, uint64_t* written,
+                          columnar_header* header, columnar_columns* columns) {
+    static const char padding[COLUMN_ALIGNMENT] = {};
+    buffered_writer_write(writer, padding, header->string_offsets - *written);
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < columns->string_count; ++ i) {
+        buffered_writer_write(writer, &offset, sizeof(offset));
+        offset += strlen(columns->strings[i]) + 1;
+    }
+
+    buffered_writer_write(writer, &offset, sizeof(offset));
+
+    buffered_writer_write(writer, padding, header->string_bytes -
+        (header->string_offsets + (columns->string_count + 1) * sizeof(uint64_t)));
+
+    for (size_t i = 0; i < columns->string_count; ++ i)
+        buffered_writer_write(writer, columns->strings[i], strlen(columns->strings[i]) + 1);
+
+    *written = header->string_bytes + columns->string_bytes;
+    buffered_writer_write(writer, padding, header->size - *written);
+}
+
+stack_trace* digraph_write_columnar(buffered_writer* writer, digraph* graph) {
+    columnar_header header = {};
+    memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current) {
+        header.node_count += current->element.nodes.used;
+        header.edge_count += current->element.edges.used;
+    }
+
+    columnar_columns columns = {};
+    TRY columns_allocate(&columns, header.node_count, header.edge_count) CATCH({
+        columns_destroy(&columns);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate columns!");
+    });
+
+    columns_fill(&columns, graph);
+
+    header.string_count = columns.string_count;
+    layout_columns(&header, &columns);
+
+    const size_t nodes = header.node_count, edges = header.edge_count;
+
+    uint64_t written = sizeof(header);
+    buffered_writer_write(writer, &header, sizeof(header));
+
+    // Columns are big contiguous arrays, so they mostly bypass the buffer
+    write_column(writer, &written, header.node_ids,       columns.node_ids,       nodes * 4);
+    write_column(writer, &written, header.node_subgraphs, columns.node_subgraphs, nodes * 4);
+    write_column(writer, &written, header.node_labels,    columns.node_labels,    nodes * 4);
+    write_column(writer, &written, header.node_shapes,    columns.node_shapes,    nodes);
+    write_column(writer, &written, header.node_colors,    columns.node_colors,    nodes);
+    write_column(writer, &written, header.node_styles,    columns.node_styles,    nodes);
+
+    write_column(writer, &written, header.edge_froms,     columns.edge_froms,     edges * 4);
+    write_column(writer, &written, header.edge_tos,       columns.edge_tos,       edges * 4);
+    write_column(writer, &written, header.edge_subgraphs, columns.edge_subgraphs, edges * 4);
+    write_column(writer, &written, header.edge_labels,    columns.edge_labels,    edges * 4);
+    write_column(writer, &written, header.edge_colors,    columns.edge_colors,    edges);
+    write_column(writer, &written, header.edge_styles,    columns.edge_styles,    edges);
+    write_column(writer, &written, header.edge_weights,   columns.edge_weights,   edges * 8);
+
+    write_strings(writer, &written, &header, &columns);
+
+    columns_destroy(&columns);
+
+    if (writer->failed)
+        return FAILURE(RUNTIME_ERROR, "Failed to write columnar graph!");
+
+    return SUCCESS();
+}
+
+// Column of @arg count elements is aligned, and doesn't overlap header or go past the end
+static bool is_column_valid(const columnar_header* header, uint64_t offset,
+                            uint64_t count, uint64_t element_size) {
+    return offset % COLUMN_ALIGNMENT == 0 && offset >= sizeof(*header) &&
+           offset <= header->size && count <= (header->size - offset) / element_size;
+}
+
+static bool are_labels_valid(const uint32_t* labels, uint64_t count, uint64_t string_count) {
+    for (uint64_t i = 0; i < count; ++ i)
+        if (labels[i] >= string_count)
+            return false;
+
+    return true;
+}
+
+// Offsets don't go back or past the end, and every string is null terminated
+static bool are_strings_valid(const columnar_header* header, const uint64_t* offsets,
+                              const char* strings) {
+    const uint64_t available = header->size - header->string_bytes;
+
+    for (uint64_t i = 0; i < header->string_count; ++ i)
+        if (offsets[i] >= offsets[i + 1] || offsets[i + 1] > available ||
+            strings[offsets[i + 1] - 1] != '\0')
+            return false;
+
+    return true;
+}
+
+stack_trace* columnar_view_open(columnar_view* view, const void* data, size_t size) {
+    const columnar_header* header = (const columnar_header*) data;
+
+    // Columns are read in place, so data should be aligned as they are
+    if ((uintptr_t) data % COLUMN_ALIGNMENT != 0)
+        return FAILURE(RUNTIME_ERROR, "Columnar graph isn't aligned to %zu bytes!",
+                       COLUMN_ALIGNMENT);
+
+    if (size < sizeof(*header) || memcmp(header->magic, COLUMNAR_MAGIC,
+                                         sizeof(header->magic)) != 0)
+        return FAILURE(RUNTIME_ERROR, "Data isn't a columnar graph!");
+
+    if (header->size > size)
+        return FAILURE(RUNTIME_ERROR, "Columnar graph is truncated, "
+                       "%zu bytes instead of %zu!", size, (size_t) header->size);
+
+    const uint64_t nodes = header->node_count, edges = header->edge_count;
+
+    bool is_valid =
+        is_column_valid(header, header->node_ids,       nodes, sizeof(int32_t))  &&
+        is_column_valid(header, header->node_subgraphs, nodes, sizeof(int32_t))  &&
+        is_column_valid(header, header->node_labels,    nodes, sizeof(uint32_t)) &&
+        is_column_valid(header, header->node_shapes,    nodes, sizeof(uint8_t))  &&
+        is_column_valid(header, header->node_colors,    nodes, sizeof(uint8_t))  &&
+        is_column_valid(header, header->node_styles,    nodes, sizeof(uint8_t))  &&
+
+        is_column_valid(header, header->edge_froms,     edges, sizeof(int32_t))  &&
+        is_column_valid(header, header->edge_tos,       edges, sizeof(int32_t))  &&
+        is_column_valid(header, header->edge_subgraphs, edges, sizeof(int32_t))  &&
+        is_column_valid(header, header->edge_labels,    edges, sizeof(uint32_t)) &&
+        is_column_valid(header, header->edge_colors,    edges, sizeof(uint8_t))  &&
+        is_column_valid(header, header->edge_styles,    edges, sizeof(uint8_t))  &&
+        is_column_valid(header, header->edge_weights,   edges, sizeof(double))   &&
+
+        header->string_count < header->size / sizeof(uint64_t) &&
+        is_column_valid(header, header->string_offsets, header->string_count + 1,
+                        sizeof(uint64_t)) &&
+        is_column_valid(header, header->string_bytes, 0, sizeof(char));
+
+    if (!is_valid)
+        return FAILURE(RUNTIME_ERROR, "Columnar graph has columns out of it's bounds!");
+
+    const char* bytes = (const char*) data;
+
+    if (!are_strings_valid(header, (const uint64_t*) (bytes + header->string_offsets),
+                           bytes + header->string_bytes))
+        return FAILURE(RUNTIME_ERROR, "Columnar graph has invalid strings!");
+
+    if (!are_labels_valid((const uint32_t*) (bytes + header->node_labels), nodes,
+                          header->string_count) ||
+        !are_labels_valid((const uint32_t*) (bytes + header->edge_labels), edges,
+                          header->string_count))
+        return FAILURE(RUNTIME_ERROR, "Columnar graph has labels out of dictionary!");
+
+    *view = {
+        .header = header,
+
+        .node_ids       = (const int32_t*)  (bytes + header->node_ids),
+        .node_subgraphs = (const int32_t*)  (bytes + header->node_subgraphs),
+        .node_labels    = (const uint32_t*) (bytes + header->node_labels),
+        .node_shapes    = (const uint8_t*)  (bytes + header->node_shapes),
+        .node_colors    = (const uint8_t*)  (bytes + header->node_colors),
+        .node_styles    = (const uint8_t*)  (bytes + header->node_styles),
+
+        .edge_froms     = (const int32_t*)  (bytes + header->edge_froms),
+        .edge_tos       = (const int32_t*)  (bytes + header->edge_tos),
+        .edge_subgraphs = (const int32_t*)  (bytes + header->edge_subgraphs),
+        .edge_labels    = (const uint32_t*) (bytes + header->edge_labels),
+        .edge_colors    = (const uint8_t*)  (bytes + header->edge_colors),
+        .edge_styles    = (const uint8_t*)  (bytes + header->edge_styles),
+        .edge_weights   = (const double*)   (bytes + header->edge_weights),
+
+        .string_offsets = (const uint64_t*) (bytes + header->string_offsets),
+        .string_bytes   = bytes + header->string_bytes
+    };
+
+    return SUCCESS();
+}
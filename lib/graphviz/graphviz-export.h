@@ -0,0 +1,95 @@
+#pragma once
+
+#include "graphviz.h"
+#include "graphviz-writer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Write @arg graph as a JSON object with a list of subgraphs, each with
+ * lists of nodes and edges, attributes are written by their names
+ */
+void digraph_write_json(buffered_writer* writer, digraph* graph);
+
+/**
+ * Write @arg graph as a GraphML document, subgraphs are flattened,
+ * subgraph of each element is written as it's data
+ */
+void digraph_write_graphml(buffered_writer* writer, digraph* graph);
+
+
+// First bytes of every columnar file, includes format version
+const char COLUMNAR_MAGIC[8] = "GVCOL02";
+
+/**
+ * Header of columnar binary format, followed by columns. Every column is
+ * an array aligned to 8 bytes, which starts at given offset from the start
+ * of the file, so file can be memory mapped and used as is. Labels are
+ * indexes into a dictionary of distinct strings, attributes are enums.
+ *
+ * Extra attributes of nodes and edges (see subgraph_set_node_attribute)
+ * aren't kept, columns hold only attributes every element has.
+ */
+struct columnar_header {
+    char magic[8];
+
+    uint64_t node_count, edge_count, string_count;
+
+    uint64_t node_ids;       // int32_t
+    uint64_t node_subgraphs; // int32_t
+    uint64_t node_labels;    // uint32_t, index in dictionary
+    uint64_t node_shapes;    // uint8_t
+    uint64_t node_colors;    // uint8_t
+    uint64_t node_styles;    // uint8_t
+
+    uint64_t edge_froms;     // int32_t
+    uint64_t edge_tos;       // int32_t
+    uint64_t edge_subgraphs; // int32_t
+    uint64_t edge_labels;    // uint32_t, index in dictionary
+    uint64_t edge_colors;    // uint8_t
+    uint64_t edge_styles;    // uint8_t
+    uint64_t edge_weights;   // double, 0 is the default weight
+
+    // String i is in bytes [offsets[i], offsets[i + 1]), it's null terminated
+    uint64_t string_offsets; // uint64_t, string_count + 1 of them
+    uint64_t string_bytes;   // char
+
+    uint64_t size; // Size of the whole file
+};
+
+/**
+ * Write @arg graph in columnar binary format, see columnar_header
+ */
+stack_trace* digraph_write_columnar(buffered_writer* writer, digraph* graph);
+
+/** Typed columns of mapped columnar file */
+struct columnar_view {
+    const columnar_header* header;
+
+    const int32_t  *node_ids, *node_subgraphs;
+    const uint32_t *node_labels;
+    const uint8_t  *node_shapes, *node_colors, *node_styles;
+
+    const int32_t  *edge_froms, *edge_tos, *edge_subgraphs;
+    const uint32_t *edge_labels;
+    const uint8_t  *edge_colors, *edge_styles;
+    const double   *edge_weights;
+
+    const uint64_t *string_offsets;
+    const char* string_bytes;
+};
+
+/**
+ * Check that @arg size bytes of @arg data are a columnar file, and
+ * find it's columns. Data can come from anyone, so every column is
+ * checked to be aligned and inside of it, every label to be in the
+ * dictionary, and every string to be terminated. @arg data should be
+ * aligned to 8 bytes
+ */
+stack_trace* columnar_view_open(columnar_view* view, const void* data, size_t size);
+
+inline const char* columnar_view_string(columnar_view* view, uint32_t string) {
+    return view->string_bytes + view->string_offsets[string];
+}
@@ -0,0 +1,283 @@
+#include "graphviz-generators.h"
+
+#include <stdlib.h>
+
+#include "graphviz-parallel.h"
+#include "printf-utils.h"
+#include "trace.h"
+
+// Edges, that are generated from one random stream
+const size_t GENERATOR_BLOCK_EDGES = 64 * 1024;
+
+enum generator_kind {
+    GENERATE_KARY_TREE, GENERATE_GRID,
+    GENERATE_RANDOM_EDGES, GENERATE_RANDOM_DAG, GENERATE_RMAT
+};
+
+struct generator_job {
+    generator_kind kind;
+    graph_generator_options options;
+
+    size_t node_count, edge_count;
+
+    size_t arity, width;
+    unsigned scale;
+    rmat_probabilities probabilities;
+
+    // Where nodes and edges are, both lists are linearized
+    subgraph* target;
+    element_index_t first_node, first_edge;
+};
+
+template <typename E>
+static stack_trace* append_elements(linked_list<E>* list, size_t count, E value,
+                                    element_index_t* first) {
+    if (count > list->capacity)
+        TRY linked_list_resize(list, count)
+            FAIL("Can't reserve %zu elements!", count);
+
+    for (size_t i = 0; i < count; ++ i)
+        TRY linked_list_push_back(list, value)
+            FAIL("Can't append element %zu!", i);
+
+    // Fresh list is filled in order, so element number i is at first + i
+    if (!list->is_linearized)
+        return FAILURE(RUNTIME_ERROR, "List isn't linearized after appending!");
+
+    *first = linked_list_head_index(list);
+    return SUCCESS();
+}
+
+static stack_trace* reserve_graph(digraph* graph, generator_job* job) {
+    *graph = digraph_create();
+
+    subgraph_id target = digraph_create_subgraph(graph, RANK_NONE);
+    job->target = digraph_get_subgraph(graph, target);
+
+    // Labels are set for every element separately, and owned by them
+    job->options.default_node.label = NULL;
+    job->options.default_edge.label = NULL;
+
+    TRY append_elements(&job->target->nodes, job->node_count, job->options.default_node,
+                        &job->first_node) CATCH({
+        digraph_destroy(graph);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to append %zu nodes!",
+                            job->node_count);
+    });
+
+    TRY append_elements(&job->target->edges, job->edge_count, job->options.default_edge,
+                        &job->first_edge) CATCH({
+        digraph_destroy(graph);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to append %zu edges!",
+                            job->edge_count);
+    });
+
+    return SUCCESS();
+}
+
+static void fill_nodes(size_t begin, size_t end, void* argument) {
+    generator_job* job = (generator_job*) argument;
+
+    if (!job->options.has_labels)
+        return;
+
+    for (size_t i = begin; i < end; ++ i)
+        linked_list_get_pointer(&job->target->nodes, job->first_node + (element_index_t) i)
+            ->element.label = sprintf_to_new_buffer("%zu", i);
+}
+
+static void uniform_pair(generator_job* job, splitmix64* random, uint64_t* from, uint64_t* to) {
+    // Second endpoint skips the first one, so there are no loops
+    *from = splitmix64_below(random, job->node_count);
+    *to   = splitmix64_below(random, job->node_count - 1);
+
+    if (*to >= *from)
+        ++ *to;
+}
+
+static void rmat_pair(generator_job* job, splitmix64* random, uint64_t* from, uint64_t* to) {
+    const double a = job->probabilities.a, ab = a + job->probabilities.b,
+                 abc = ab + job->probabilities.c;
+
+    *from = *to = 0;
+
+    // Every level picks one of four quadrants of adjacency matrix
+    for (unsigned level = 0; level < job->scale; ++ level) {
+        double quadrant = splitmix64_double(random);
+
+        *from <<= 1, *to <<= 1;
+
+        if (quadrant >= abc)
+            *from |= 1, *to |= 1;
+        else if (quadrant >= ab)
+            *from |= 1;
+        else if (quadrant >= a)
+            *to |= 1;
+    }
+}
+
+static void generate_edge(generator_job* job, size_t number, splitmix64* random,
+                          uint64_t* from, uint64_t* to) {
+    switch (job->kind) {
+    case GENERATE_KARY_TREE:
+        *from = number / job->arity, *to = number + 1;
+        break;
+
+    case GENERATE_GRID: {
+        size_t width = job->width, height = job->node_count / width,
+               horizontal = (width - 1) * height;
+
+        if (number < horizontal)
+            *from = number / (width - 1) * width + number % (width - 1), *to = *from + 1;
+        else
+            *from = number - horizontal, *to = *from + width;
+
+        break;
+    }
+
+    case GENERATE_RANDOM_EDGES:
+        uniform_pair(job, random, from, to);
+        break;
+
+    case GENERATE_RANDOM_DAG:
+        uniform_pair(job, random, from, to);
+
+        if (*from > *to) {
+            uint64_t swapped = *from;
+            *from = *to, *to = swapped;
+        }
+
+        break;
+
+    case GENERATE_RMAT:
+        rmat_pair(job, random, from, to);
+        break;
+    }
+}
+
+static void fill_edge_blocks(size_t begin, size_t end, void* argument) {
+    generator_job* job = (generator_job*) argument;
+
+    for (size_t block = begin; block < end; ++ block) {
+        splitmix64 random = splitmix64_stream(job->options.seed, block);
+
+        size_t first = block * GENERATOR_BLOCK_EDGES,
+               last  = first + GENERATOR_BLOCK_EDGES < job->edge_count ?
+                       first + GENERATOR_BLOCK_EDGES : job->edge_count;
+
+        for (size_t number = first; number < last; ++ number) {
+            uint64_t from = 0, to = 0;
+            generate_edge(job, number, &random, &from, &to);
+
+            edge* current = &linked_list_get_pointer(&job->target->edges,
+                                                     job->first_edge + (element_index_t) number)
+                                 ->element;
+
+            current->from = job->first_node + (node_id) from;
+            current->to   = job->first_node + (node_id) to;
+        }
+    }
+}
+
+static stack_trace* generate(digraph* graph, generator_job* job) {
+    // Node ids are ints, and lists keep two terminal elements
+    if (job->node_count > (size_t) INT32_MAX - 2 || job->edge_count > (size_t) INT32_MAX - 2)
+        return FAILURE(RUNTIME_ERROR, "Graph with %zu nodes and %zu edges is too big!",
+                       job->node_count, job->edge_count);
+
+    TRY reserve_graph(graph, job)
+        FAIL("Failed to reserve graph!");
+
+    graphviz_parallel_for(job->node_count, fill_nodes, job);
+
+    size_t blocks = (job->edge_count + GENERATOR_BLOCK_EDGES - 1) / GENERATOR_BLOCK_EDGES;
+    graphviz_parallel_for(blocks, fill_edge_blocks, job);
+
+    return SUCCESS();
+}
+
+stack_trace* generate_kary_tree(digraph* graph, size_t node_count, size_t arity,
+                                graph_generator_options options) {
+    if (arity == 0)
+        return FAILURE(RUNTIME_ERROR, "Tree should have positive arity!");
+
+    generator_job job = {
+        .kind = GENERATE_KARY_TREE, .options = options,
+        .node_count = node_count, .edge_count = node_count > 0 ? node_count - 1 : 0,
+        .arity = arity
+    };
+
+    TRY generate(graph, &job)
+        FAIL("Failed to generate %zu-ary tree of %zu nodes!", arity, node_count);
+
+    return SUCCESS();
+}
+
+stack_trace* generate_grid(digraph* graph, size_t width, size_t height,
+                           graph_generator_options options) {
+    if (width == 0 || height == 0)
+        return FAILURE(RUNTIME_ERROR, "Grid %zu x %zu is empty!", width, height);
+
+    // Divide, since product itself may overflow
+    if (height > ((size_t) INT32_MAX - 2) / width)
+        return FAILURE(RUNTIME_ERROR, "Grid %zu x %zu is too big!", width, height);
+
+    generator_job job = {
+        .kind = GENERATE_GRID, .options = options,
+        .node_count = width * height,
+        .edge_count = (width - 1) * height + width * (height - 1),
+        .width = width
+    };
+
+    TRY generate(graph, &job)
+        FAIL("Failed to generate grid %zu x %zu!", width, height);
+
+    return SUCCESS();
+}
+
+static stack_trace* generate_uniform(digraph* graph, generator_kind kind, size_t node_count,
+                                     size_t edge_count, graph_generator_options options) {
+    if (node_count < 2 && edge_count > 0)
+        return FAILURE(RUNTIME_ERROR, "Edges without loops need two nodes at least!");
+
+    generator_job job = {
+        .kind = kind, .options = options,
+        .node_count = node_count, .edge_count = edge_count
+    };
+
+    TRY generate(graph, &job)
+        FAIL("Failed to generate %zu random edges between %zu nodes!", edge_count, node_count);
+
+    return SUCCESS();
+}
+
+stack_trace* generate_random_edges(digraph* graph, size_t node_count, size_t edge_count,
+                                   graph_generator_options options) {
+    return generate_uniform(graph, GENERATE_RANDOM_EDGES, node_count, edge_count, options);
+}
+
+stack_trace* generate_random_dag(digraph* graph, size_t node_count, size_t edge_count,
+                                 graph_generator_options options) {
+    return generate_uniform(graph, GENERATE_RANDOM_DAG, node_count, edge_count, options);
+}
+
+stack_trace* generate_rmat(digraph* graph, unsigned scale, size_t edge_count,
+                           rmat_probabilities probabilities, graph_generator_options options) {
+    if (scale > 30)
+        return FAILURE(RUNTIME_ERROR, "Scale %u overflows node ids!", scale);
+
+    const double a = probabilities.a, b = probabilities.b, c = probabilities.c;
+    if (a < 0 || b < 0 || c < 0 || a + b + c > 1)
+        return FAILURE(RUNTIME_ERROR, "Probabilities %g, %g, %g aren't valid!", a, b, c);
+
+    generator_job job = {
+        .kind = GENERATE_RMAT, .options = options,
+        .node_count = (size_t) 1 << scale, .edge_count = edge_count,
+        .scale = scale, .probabilities = probabilities
+    };
+
+    TRY generate(graph, &job)
+        FAIL("Failed to generate R-MAT graph of scale %u!", scale);
+
+    return SUCCESS();
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "graphviz.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Splittable random generator, every block of generated edges gets a
+ * stream of it's own, so output depends only on seed, not on how blocks
+ * are spread between threads
+ */
+struct splitmix64 {
+    uint64_t state;
+};
+
+inline uint64_t splitmix64_mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
+
+inline uint64_t splitmix64_next(splitmix64* random) {
+    return splitmix64_mix(random->state += 0x9e3779b97f4a7c15ull);
+}
+
+inline splitmix64 splitmix64_stream(uint64_t seed, uint64_t stream) {
+    splitmix64 random = { .state = splitmix64_mix(seed ^ splitmix64_mix(stream + 1)) };
+    return random;
+}
+
+// Uniform number in [0, @arg bound), without division
+inline uint64_t splitmix64_below(splitmix64* random, uint64_t bound) {
+    return (uint64_t) (((unsigned __int128) splitmix64_next(random) * bound) >> 64);
+}
+
+// Uniform number in [0, 1)
+inline double splitmix64_double(splitmix64* random) {
+    return (double) (splitmix64_next(random) >> 11) * 0x1.0p-53;
+}
+
+/**
+ * Generators create graph with a single subgraph, where node number i
+ * has node id i + 1. Nodes and edges are appended at once and filled
+ * concurrently, graph is destroyed with digraph_destroy. Labels of
+ * default node and edge are ignored
+ */
+struct graph_generator_options {
+    uint64_t seed;
+
+    // Label nodes with their numbers, otherwise labels are empty
+    bool has_labels;
+
+    node default_node;
+    edge default_edge;
+};
+
+/**
+ * Tree where node i is child of node (i - 1) / @arg arity
+ */
+stack_trace* generate_kary_tree(digraph* graph, size_t node_count, size_t arity,
+                                graph_generator_options options = {});
+
+/**
+ * Grid of @arg width by @arg height nodes, edges go right and down
+ */
+stack_trace* generate_grid(digraph* graph, size_t width, size_t height,
+                           graph_generator_options options = {});
+
+/**
+ * @arg edge_count random edges with replacement: endpoints are chosen
+ * uniformly, without loops, and the same edge may be drawn more than once,
+ * so unlike Erdős–Rényi G(n, m) graph this one is a multigraph
+ */
+stack_trace* generate_random_edges(digraph* graph, size_t node_count, size_t edge_count,
+                                   graph_generator_options options = {});
+
+/**
+ * Same as generate_random_edges, but every edge goes from smaller node
+ * number to bigger, so graph is acyclic
+ */
+stack_trace* generate_random_dag(digraph* graph, size_t node_count, size_t edge_count,
+                                 graph_generator_options options = {});
+
+/** Quadrant probabilities of R-MAT, the fourth one is what's left */
+struct rmat_probabilities {
+    double a, b, c;
+};
+
+// Probabilities used by Graph500
+const rmat_probabilities RMAT_GRAPH500 = { .a = 0.57, .b = 0.19, .c = 0.19 };
+
+/**
+ * R-MAT (recursive Kronecker) graph of 2^@arg scale nodes, with skewed
+ * degrees and communities, like real networks
+ */
+stack_trace* generate_rmat(digraph* graph, unsigned scale, size_t edge_count,
+                           rmat_probabilities probabilities = RMAT_GRAPH500,
+                           graph_generator_options options = {});
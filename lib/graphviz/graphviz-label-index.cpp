@@ -0,0 +1,354 @@
+#include "graphviz-label-index.h"
+#include "graphviz-parallel.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "safe-alloc.h"
+#include "trace.h"
+
+// ------------------------------- PARALLEL SORT -------------------------------
+
+struct parallel_sort_state {
+    char* source;
+    char* destination;
+
+    size_t count, size;
+    int (*compare)(const void* first, const void* second);
+
+    size_t width; // Length of already sorted runs
+};
+
+static void sort_runs(size_t begin, size_t end, void* argument) {
+    parallel_sort_state* state = (parallel_sort_state*) argument;
+
+    for (size_t run = begin; run < end; ++ run) {
+        size_t first = run * state->width;
+        size_t count = state->count - first < state->width ?
+                       state->count - first : state->width;
+
+        qsort(state->source + first * state->size, count, state->size, state->compare);
+    }
+}
+
+static void merge_runs(size_t begin, size_t end, void* argument) {
+    parallel_sort_state* state = (parallel_sort_state*) argument;
+    const size_t size = state->size;
+
+    for (size_t pair = begin; pair < end; ++ pair) {
+        size_t left  = pair * 2 * state->width;
+        size_t left_end  = left + state->width < state->count ?
+                           left + state->width : state->count;
+
+        size_t right = left_end;
+        size_t right_end = right + state->width < state->count ?
+                           right + state->width : state->count;
+
+        char* output = state->destination + left * size;
+
+        while (left < left_end && right < right_end) {
+            char* left_element  = state->source + left  * size;
+            char* right_element = state->source + right * size;
+
+            // Take from the left on equality, so merge is stable
+            if (state->compare(right_element, left_element) < 0)
+                memcpy(output, right_element, size), ++ right;
+            else
+                memcpy(output,  left_element, size), ++ left;
+
+            output += size;
+        }
+
+        memcpy(output, state->source + left * size, (left_end - left) * size);
+        output += (left_end - left) * size;
+
+        memcpy(output, state->source + right * size, (right_end - right) * size);
+    }
+}
+
+// Sort runs concurrently with qsort, then merge them pairwise in parallel
+static stack_trace* parallel_sort(void* base, size_t count, size_t size,
+                                  int (*compare)(const void* first, const void* second)) {
+
+    const size_t threads = graphviz_parallel_thread_count();
+    if (threads <= 1 || count < 2 * threads) {
+        qsort(base, count, size, compare);
+        return SUCCESS();
+    }
+
+    char* buffer = NULL;
+    TRY safe_calloc(count * size, &buffer)
+        FAIL("Failed to allocate merge buffer for %zu elements!", count);
+
+    parallel_sort_state state = {
+        .source = (char*) base, .destination = buffer,
+        .count = count, .size = size, .compare = compare,
+        .width = (count + threads - 1) / threads
+    };
+
+    // Rounding width up can leave trailing threads without a run
+    graphviz_parallel_for((count + state.width - 1) / state.width, sort_runs, &state);
+
+    for (; state.width < count; state.width *= 2) {
+        size_t pairs = (count + 2 * state.width - 1) / (2 * state.width);
+        graphviz_parallel_for(pairs, merge_runs, &state);
+
+        char* merged = state.destination;
+        state.destination = state.source;
+        state.source = merged;
+    }
+
+    if (state.source != base)
+        memcpy(base, state.source, count * size);
+
+    free(buffer), buffer = NULL;
+    return SUCCESS();
+}
+
+// --------------------------------- TRIGRAMS ---------------------------------
+
+static inline uint32_t trigram_at(const char* string) {
+    return (uint32_t) (unsigned char) string[0] << 16 |
+           (uint32_t) (unsigned char) string[1] <<  8 |
+           (uint32_t) (unsigned char) string[2];
+}
+
+static inline size_t trigrams_in(const char* string) {
+    size_t length = strlen(string);
+    return length >= 3 ? length - 2 : 0;
+}
+
+struct trigram_state {
+    label_index* index;
+
+    size_t* pair_offsets; // Where pairs of entry i start
+    uint64_t* pairs;      // Trigram in high half, entry in low half
+};
+
+static void count_trigrams(size_t begin, size_t end, void* argument) {
+    trigram_state* state = (trigram_state*) argument;
+
+    for (size_t i = begin; i < end; ++ i)
+        state->pair_offsets[i + 1] = trigrams_in(state->index->entries[i].label);
+}
+
+static void emit_trigrams(size_t begin, size_t end, void* argument) {
+    trigram_state* state = (trigram_state*) argument;
+
+    for (size_t i = begin; i < end; ++ i) {
+        const char* label = state->index->entries[i].label;
+        uint64_t* output = state->pairs + state->pair_offsets[i];
+
+        for (size_t j = 0; j < trigrams_in(label); ++ j)
+            output[j] = (uint64_t) trigram_at(label + j) << 32 | (uint64_t) i;
+    }
+}
+
+static int compare_pairs(const void* first, const void* second) {
+    uint64_t lhs = *(const uint64_t*) first, rhs = *(const uint64_t*) second;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static int compare_entries(const void* first, const void* second) {
+    return strcmp(((const label_index_entry*) first )->label,
+                  ((const label_index_entry*) second)->label);
+}
+
+static stack_trace* build_trigrams(label_index* index) {
+    trigram_state state = { .index = index, .pair_offsets = NULL, .pairs = NULL };
+
+    TRY safe_calloc(index->entry_count + 1, &state.pair_offsets)
+        FAIL("Failed to allocate trigram offsets!");
+
+    FINALIZER(free_pairs, {
+        free(state.pair_offsets); state.pair_offsets = NULL;
+        free(state.pairs);        state.pairs        = NULL;
+    });
+
+    graphviz_parallel_for(index->entry_count, count_trigrams, &state);
+
+    for (size_t i = 1; i <= index->entry_count; ++ i)
+        state.pair_offsets[i] += state.pair_offsets[i - 1];
+
+    const size_t pair_count = state.pair_offsets[index->entry_count];
+
+    TRY safe_calloc(pair_count, &state.pairs)
+        FINALIZE_AND_FAIL(free_pairs, "Failed to allocate %zu trigrams!", pair_count);
+
+    graphviz_parallel_for(index->entry_count, emit_trigrams, &state);
+
+    // After sorting pairs are grouped by trigram, with entries ascending
+    TRY parallel_sort(state.pairs, pair_count, sizeof(*state.pairs), compare_pairs)
+        FINALIZE_AND_FAIL(free_pairs, "Failed to sort trigrams!");
+
+    // Only distinct pairs become postings, trigram can repeat in a label
+    size_t posting_count = 0, trigram_count = 0;
+    for (size_t i = 0; i < pair_count; ++ i) {
+        if (i > 0 && state.pairs[i] == state.pairs[i - 1])
+            continue;
+
+        if (i == 0 || state.pairs[i] >> 32 != state.pairs[i - 1] >> 32)
+            ++ trigram_count;
+
+        state.pairs[posting_count ++] = state.pairs[i];
+    }
+
+    TRY safe_calloc(trigram_count, &index->trigrams)
+        FINALIZE_AND_FAIL(free_pairs, "Failed to allocate trigrams!");
+
+    TRY safe_calloc(trigram_count + 1, &index->trigram_offsets)
+        FINALIZE_AND_FAIL(free_pairs, "Failed to allocate trigram offsets!");
+
+    TRY safe_calloc(posting_count, &index->postings)
+        FINALIZE_AND_FAIL(free_pairs, "Failed to allocate postings!");
+
+    size_t current_trigram = 0;
+    for (size_t i = 0; i < posting_count; ++ i) {
+        uint32_t trigram = (uint32_t) (state.pairs[i] >> 32);
+
+        if (i == 0 || trigram != index->trigrams[current_trigram - 1]) {
+            index->trigram_offsets[current_trigram] = i;
+            index->trigrams[current_trigram ++] = trigram;
+        }
+
+        index->postings[i] = (uint32_t) state.pairs[i];
+    }
+
+    index->trigram_count = trigram_count;
+    index->trigram_offsets[trigram_count] = posting_count;
+
+    CALL_FINALIZER(free_pairs);
+    return SUCCESS();
+}
+
+// ---------------------------------- INDEX -----------------------------------
+
+stack_trace* label_index_create(label_index* index, digraph* graph) {
+    *index = {};
+
+    size_t labeled_nodes = 0;
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node)
+            labeled_nodes += current_node->element.label != NULL;
+
+    FINALIZER(index_destroy, { label_index_destroy(index); });
+
+    TRY safe_calloc(labeled_nodes, &index->entries)
+        FINALIZE_AND_FAIL(index_destroy, "Failed to allocate %zu entries!", labeled_nodes);
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node)
+            if (current_node->element.label != NULL)
+                index->entries[index->entry_count ++] = {
+                    .label = current_node->element.label,
+                    .id = linked_list_get_index(&current->element.nodes, current_node)
+                };
+
+    TRY parallel_sort(index->entries, index->entry_count,
+                      sizeof(*index->entries), compare_entries)
+        FINALIZE_AND_FAIL(index_destroy, "Failed to sort labels!");
+
+    TRY build_trigrams(index)
+        FINALIZE_AND_FAIL(index_destroy, "Failed to build trigram index!");
+
+    return SUCCESS();
+}
+
+void label_index_destroy(label_index* index) {
+    free(index->entries);
+
+    free(index->trigrams);
+    free(index->trigram_offsets);
+    free(index->postings);
+
+    *index = {};
+}
+
+// Index of first entry that starts with @arg prefix, or of first
+// entry after all of them if @arg or_equal is set
+static size_t partition_point(label_index* index, const char* prefix, bool or_equal) {
+    size_t prefix_length = strlen(prefix);
+    size_t low = 0, high = index->entry_count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int comparison = strncmp(index->entries[middle].label, prefix, prefix_length);
+
+        if (comparison < 0 || (or_equal && comparison == 0))
+            low  = middle + 1;
+        else
+            high = middle;
+    }
+
+    return low;
+}
+
+size_t label_index_find_prefix(label_index* index, const char* prefix,
+                               node_id* found, size_t max_found) {
+
+    size_t begin = partition_point(index, prefix, false),
+           end   = partition_point(index, prefix, true);
+
+    size_t found_count = 0;
+    for (size_t i = begin; i < end && found_count < max_found; ++ i)
+        found[found_count ++] = index->entries[i].id;
+
+    return found_count;
+}
+
+// Find posting list of @arg trigram, returns false if there's none
+static bool find_postings(label_index* index, uint32_t trigram,
+                          size_t* begin, size_t* end) {
+    size_t low = 0, high = index->trigram_count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+
+        if (index->trigrams[middle] < trigram)
+            low  = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == index->trigram_count || index->trigrams[low] != trigram)
+        return false;
+
+    *begin = index->trigram_offsets[low];
+    *end   = index->trigram_offsets[low + 1];
+
+    return true;
+}
+
+size_t label_index_find_substring(label_index* index, const char* pattern,
+                                  node_id* found, size_t max_found) {
+    size_t found_count = 0;
+
+    // Too short to have a trigram, the only option is checking everything
+    if (trigrams_in(pattern) == 0) {
+        for (size_t i = 0; i < index->entry_count && found_count < max_found; ++ i)
+            if (strstr(index->entries[i].label, pattern) != NULL)
+                found[found_count ++] = index->entries[i].id;
+
+        return found_count;
+    }
+
+    // Candidates come from the rarest trigram, others are checked by strstr
+    size_t best_begin = 0, best_end = index->entry_count + 1;
+    for (size_t i = 0; i < trigrams_in(pattern); ++ i) {
+        size_t begin = 0, end = 0;
+        if (!find_postings(index, trigram_at(pattern + i), &begin, &end))
+            return 0; // Some trigram is in no label at all
+
+        if (end - begin < best_end - best_begin)
+            best_begin = begin, best_end = end;
+    }
+
+    for (size_t i = best_begin; i < best_end && found_count < max_found; ++ i) {
+        label_index_entry* entry = &index->entries[index->postings[i]];
+
+        if (strstr(entry->label, pattern) != NULL)
+            found[found_count ++] = entry->id;
+    }
+
+    return found_count;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "graphviz.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct label_index_entry {
+    const char* label; // Points to node's own label
+    node_id id;
+};
+
+/**
+ * Search index over node labels. Entries sorted by label answer prefix
+ * queries with binary search, trigram posting lists answer substring
+ * queries. It's a snapshot that borrows labels from the graph, so graph
+ * should outlive it, and index should be recreated after graph changes.
+ */
+struct label_index {
+    label_index_entry* entries; // Sorted by label
+    size_t entry_count;
+
+    uint32_t* trigrams;         // Distinct trigrams, sorted
+    size_t trigram_count;
+
+    // Entries containing trigram i are in postings [offsets[i], offsets[i + 1])
+    size_t* trigram_offsets;
+    uint32_t* postings;         // Indexes of entries, ascending in each list
+};
+
+/**
+ * Index every labeled node in @arg graph, sorting and trigram extraction
+ * are done in parallel
+ */
+stack_trace* label_index_create(label_index* index, digraph* graph);
+
+void label_index_destroy(label_index* index);
+
+/**
+ * Find nodes whose labels start with @arg prefix, in label order
+ *
+ * @return number of ids written to @arg found, at most @arg max_found
+ */
+size_t label_index_find_prefix(label_index* index, const char* prefix,
+                               node_id* found, size_t max_found);
+
+/**
+ * Find nodes whose labels contain @arg pattern, in label order
+ *
+ * @return number of ids written to @arg found, at most @arg max_found
+ */
+size_t label_index_find_substring(label_index* index, const char* pattern,
+                                  node_id* found, size_t max_found);
@@ -0,0 +1,239 @@
+#include "graphviz-label-template.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "safe-alloc.h"
+#include "trace.h"
+
+// Replacement for @arg symbol, or NULL if it's kept as is
+static const char* escape_symbol(char symbol, label_escape escape) {
+    if (escape == LABEL_ESCAPE_QUOTED)
+        switch (symbol) {
+        case '"':  return "\\\"";
+        case '\\': return "\\\\";
+        default:   return NULL;
+        }
+
+    if (escape == LABEL_ESCAPE_HTML)
+        switch (symbol) {
+        case '&': return "&amp;";
+        case '<': return "&lt;";
+        case '>': return "&gt;";
+        case '"': return "&quot;";
+        default:  return NULL;
+        }
+
+    return NULL;
+}
+
+static size_t escaped_length(const char* string, label_escape escape) {
+    if (escape == LABEL_ESCAPE_NONE)
+        return strlen(string);
+
+    size_t length = 0;
+    for (const char* current = string; *current != '\0'; ++ current) {
+        const char* replacement = escape_symbol(*current, escape);
+        length += replacement != NULL ? strlen(replacement) : 1;
+    }
+
+    return length;
+}
+
+// @return end of written string
+static char* write_escaped(char* output, const char* string, size_t length,
+                           label_escape escape) {
+    if (escape == LABEL_ESCAPE_NONE) {
+        memcpy(output, string, length);
+        return output + length;
+    }
+
+    for (size_t i = 0; i < length; ++ i) {
+        const char* replacement = escape_symbol(string[i], escape);
+
+        if (replacement == NULL)
+            *output ++ = string[i];
+        else
+            for (; *replacement != '\0'; ++ replacement)
+                *output ++ = *replacement;
+    }
+
+    return output;
+}
+
+stack_trace* label_template_create(label_template* label, const char* format,
+                                   label_escape escape) {
+    *label = { .literals = NULL, .literals_size = 0,
+               .segments = NULL, .segment_count = 0, .escape = escape };
+
+    // Markup of HTML template is kept, only values are escaped
+    const label_escape literal_escape =
+        escape == LABEL_ESCAPE_HTML ? LABEL_ESCAPE_NONE : escape;
+
+    // Every slot takes at least two symbols, so this is enough
+    const size_t format_length = strlen(format);
+
+    TRY safe_calloc(format_length / 2 + 1, &label->segments)
+        FAIL("Can't allocate template segments!");
+
+    TRY safe_calloc(escaped_length(format, literal_escape) + 1, &label->literals)
+        CATCH({
+            free(label->segments); label->segments = NULL;
+            return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate literals!");
+        });
+
+    char* literals_end = label->literals;
+    label_segment current = { .literal_begin = 0, .literal_length = 0,
+                              .slot = SLOT_NONE, .width = 0, .zero_pad = false };
+
+    for (const char* symbol = format; *symbol != '\0'; ++ symbol) {
+        if (*symbol != '%' || symbol[1] == '%') {
+            literals_end = write_escaped(literals_end, symbol, 1, literal_escape);
+            symbol += *symbol == '%'; // Skip second percent
+
+            continue;
+        }
+
+        ++ symbol; // Skip percent
+
+        if (*symbol == '0')
+            current.zero_pad = true, ++ symbol;
+
+        for (; *symbol >= '0' && *symbol <= '9'; ++ symbol)
+            current.width = current.width * 10 + (*symbol - '0');
+
+        if (*symbol == 'd')
+            current.slot = SLOT_INT;
+        else if (*symbol == 's' && current.width == 0 && !current.zero_pad)
+            current.slot = SLOT_STRING;
+        else {
+            label_template_destroy(label);
+            return FAILURE(RUNTIME_ERROR, "Unsupported slot at position %zu of \"%s\"!",
+                           (size_t) (symbol - format), format);
+        }
+
+        current.literal_length =
+            (size_t) (literals_end - label->literals) - current.literal_begin;
+
+        label->segments[label->segment_count ++] = current;
+
+        current = { .literal_begin = (size_t) (literals_end - label->literals),
+                    .literal_length = 0, .slot = SLOT_NONE,
+                    .width = 0, .zero_pad = false };
+    }
+
+    // Last literal has no slot after it
+    current.literal_length = (size_t) (literals_end - label->literals) - current.literal_begin;
+    label->segments[label->segment_count ++] = current;
+
+    label->literals_size = (size_t) (literals_end - label->literals);
+
+    return SUCCESS();
+}
+
+void label_template_destroy(label_template* label) {
+    free(label->literals);
+    free(label->segments);
+
+    *label = {};
+}
+
+// Longest decimal number, with sign
+const int MAX_INT_LENGTH = 21;
+
+static char* write_int(char* output, long long number, int width, bool zero_pad) {
+    char digits[MAX_INT_LENGTH];
+
+    unsigned long long magnitude =
+        number < 0 ? 0 - (unsigned long long) number : (unsigned long long) number;
+
+    int begin = MAX_INT_LENGTH;
+    do {
+        digits[-- begin] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    int length = MAX_INT_LENGTH - begin + (number < 0);
+
+    // Like printf, zeros go after the sign and spaces before it
+    if (!zero_pad)
+        for (; length < width; ++ length)
+            *output ++ = ' ';
+
+    if (number < 0)
+        *output ++ = '-';
+
+    if (zero_pad)
+        for (; length < width; ++ length)
+            *output ++ = '0';
+
+    memcpy(output, digits + begin, (size_t) (MAX_INT_LENGTH - begin));
+    return output + MAX_INT_LENGTH - begin;
+}
+
+char* label_template_vfill(const label_template* label, va_list args) {
+    // Integers are bounded, but strings should be measured first
+    va_list measured_args;
+    va_copy(measured_args, args);
+
+    size_t size = label->literals_size + 1 /* For '\0' */;
+    for (size_t i = 0; i < label->segment_count; ++ i) {
+        const label_segment* segment = &label->segments[i];
+
+        if (segment->slot == SLOT_INT) {
+            va_arg(measured_args, int);
+            size += (size_t) (segment->width > MAX_INT_LENGTH ?
+                              segment->width : MAX_INT_LENGTH);
+        } else if (segment->slot == SLOT_STRING)
+            size += escaped_length(va_arg(measured_args, const char*), label->escape);
+    }
+
+    va_end(measured_args);
+
+    char* filled = NULL;
+    TRY safe_calloc(size, &filled)
+        THROW("Can't allocate label of %zu bytes!", size);
+
+    char* end = filled;
+    for (size_t i = 0; i < label->segment_count; ++ i) {
+        const label_segment* segment = &label->segments[i];
+
+        memcpy(end, label->literals + segment->literal_begin, segment->literal_length);
+        end += segment->literal_length;
+
+        if (segment->slot == SLOT_INT)
+            end = write_int(end, va_arg(args, int), segment->width, segment->zero_pad);
+        else if (segment->slot == SLOT_STRING) {
+            const char* value = va_arg(args, const char*);
+            end = write_escaped(end, value, strlen(value), label->escape);
+        }
+    }
+
+    *end = '\0';
+    return filled;
+}
+
+char* label_template_fill(const label_template* label, ...) {
+    va_list args;
+    va_start(args, label);
+
+    char* filled = label_template_vfill(label, args);
+
+    va_end(args);
+
+    return filled;
+}
+
+node_id subgraph_insert_template_node(digraph* graph, subgraph_id subgraph,
+                                      node default_node, const label_template* label, ...) {
+    va_list args;
+    va_start(args, label);
+
+    // Default node is copied
+    default_node.label = label_template_vfill(label, args);
+
+    va_end(args);
+
+    return subgraph_insert_node(graph, subgraph, default_node);
+}
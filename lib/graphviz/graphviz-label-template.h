@@ -0,0 +1,65 @@
+#pragma once
+
+#include "graphviz.h"
+#include "trace.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/** How values are escaped before they get into a label */
+enum label_escape {
+    LABEL_ESCAPE_NONE,   // Copied as is, like labels of NODE
+    LABEL_ESCAPE_QUOTED, // Quotes and backslashes are escaped, label is a quoted string
+    LABEL_ESCAPE_HTML    // Template is HTML markup, values become entities
+};
+
+enum label_slot_type { SLOT_NONE, SLOT_INT, SLOT_STRING };
+
+/** Literal text, followed by a slot, that is filled with a value */
+struct label_segment {
+    size_t literal_begin, literal_length;
+
+    label_slot_type slot;
+    int width;    // Minimal width of integer, 0 if not set
+    bool zero_pad;
+};
+
+/**
+ * Label format, that is parsed once and then filled for many nodes.
+ * Supports %d and %s slots (with optional zero padding and width for
+ * integers) and %% for percent sign. Literals are already escaped, only
+ * slot values are escaped when template is filled.
+ */
+struct label_template {
+    char* literals;
+    size_t literals_size;
+
+    label_segment* segments;
+    size_t segment_count;
+
+    label_escape escape;
+};
+
+stack_trace* label_template_create(label_template* label, const char* format,
+                                   label_escape escape = LABEL_ESCAPE_NONE);
+
+void label_template_destroy(label_template* label);
+
+/**
+ * Fill template's slots with arguments, int for %d and const char* for %s
+ *
+ * @return new label, which should be freed by caller
+ */
+char* label_template_vfill(const label_template* label, va_list args);
+char* label_template_fill (const label_template* label, ...);
+
+/**
+ * Insert new node with style inherited from default node, and label
+ * filled from @arg label with the rest of arguments
+ */
+node_id subgraph_insert_template_node(digraph* graph, subgraph_id subgraph,
+                                      node default_node, const label_template* label, ...);
+
+#define TEMPLATE_NODE(label, ...)                                                       \
+    subgraph_insert_template_node(&__current_graph, __current_subgraph,                 \
+                                  __default_node, label, ##__VA_ARGS__)
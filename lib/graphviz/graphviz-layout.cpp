@@ -0,0 +1,434 @@
+#include "graphviz-layout.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+template <typename T>
+static stack_trace* grow_array(T** array, size_t* capacity, size_t needed) {
+    if (needed <= *capacity)
+        return SUCCESS();
+
+    size_t new_capacity = *capacity > 0 ? *capacity : 16;
+    while (new_capacity < needed)
+        new_capacity *= 2;
+
+    T* grown = (T*) realloc(*array, new_capacity * sizeof(T));
+    if (grown == NULL)
+        return FAILURE(RUNTIME_ERROR, "Can't grow array to %zu elements!", new_capacity);
+
+    *array = grown, *capacity = new_capacity;
+    return SUCCESS();
+}
+
+graph_layout graph_layout_create() {
+    graph_layout layout = {};
+    return layout;
+}
+
+void graph_layout_destroy(graph_layout* layout) {
+    free(layout->nodes);
+    free(layout->slots);
+    free(layout->edges);
+    free(layout->points);
+
+    *layout = {};
+}
+
+stack_trace* graph_layout_place_node(graph_layout* layout, node_id node, layout_box box) {
+    if (node <= linked_list_end_index)
+        return FAILURE(RUNTIME_ERROR, "Node id %d is not valid!", node);
+
+    size_t old_capacity = layout->slot_capacity;
+    TRY grow_array(&layout->slots, &layout->slot_capacity, (size_t) node + 1)
+        FAIL("Can't index node %d!", node);
+
+    for (size_t i = old_capacity; i < layout->slot_capacity; ++ i)
+        layout->slots[i] = LAYOUT_NOT_PLACED;
+
+    size_t slot = layout->slots[node];
+    if (slot != LAYOUT_NOT_PLACED) {
+        layout->nodes[slot].box = box;
+        return SUCCESS();
+    }
+
+    TRY grow_array(&layout->nodes, &layout->node_capacity, layout->node_count + 1)
+        FAIL("Can't place node %d!", node);
+
+    layout->slots[node] = layout->node_count;
+    layout->nodes[layout->node_count ++] = { .node = node, .box = box };
+
+    return SUCCESS();
+}
+
+const layout_box* graph_layout_node_box(const graph_layout* layout, node_id node) {
+    if (node <= linked_list_end_index || (size_t) node >= layout->slot_capacity)
+        return NULL;
+
+    size_t slot = layout->slots[node];
+    return slot != LAYOUT_NOT_PLACED ? &layout->nodes[slot].box : NULL;
+}
+
+stack_trace* graph_layout_add_edges(graph_layout* layout, digraph* graph) {
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current_subgraph) {
+        subgraph* current = &current_subgraph->element;
+        subgraph_id id = linked_list_get_index(&graph->subgraphs, current_subgraph);
+
+        LINKED_LIST_TRAVERSE(&current->edges, edge, current_edge) {
+            node_id from = current_edge->element.from, to = current_edge->element.to;
+
+            if (graph_layout_node_box(layout, from) == NULL ||
+                graph_layout_node_box(layout, to)   == NULL)
+                continue;
+
+            TRY grow_array(&layout->edges, &layout->edge_capacity, layout->edge_count + 1)
+                FAIL("Can't add edge %d -> %d to layout!", from, to);
+
+            layout->edges[layout->edge_count ++] = {
+                .subgraph = id, .edge = linked_list_get_index(&current->edges, current_edge),
+                .from = from, .to = to, .first_point = 0, .point_count = 0
+            };
+        }
+    }
+
+    return SUCCESS();
+}
+
+// ------------------------------- PLAIN INPUT --------------------------------
+
+/** Words of one line of dot's plain output */
+struct plain_cursor {
+    const char *current, *end;
+    size_t line;
+};
+
+static bool is_blank(char symbol) {
+    return symbol == ' ' || symbol == '\t' || symbol == '\r';
+}
+
+// Read next word of the line, quoted words are read with their quotes
+static bool plain_next_word(plain_cursor* cursor, const char** word, size_t* length) {
+    while (cursor->current < cursor->end && is_blank(*cursor->current))
+        ++ cursor->current;
+
+    if (cursor->current == cursor->end || *cursor->current == '\n')
+        return false;
+
+    const char* start = cursor->current;
+
+    if (*cursor->current == '"') {
+        for (++ cursor->current; cursor->current < cursor->end && *cursor->current != '"';
+             ++ cursor->current)
+            if (*cursor->current == '\\' && cursor->current + 1 < cursor->end)
+                ++ cursor->current;
+
+        if (cursor->current < cursor->end)
+            ++ cursor->current;
+    } else
+        while (cursor->current < cursor->end && !is_blank(*cursor->current) &&
+               *cursor->current != '\n')
+            ++ cursor->current;
+
+    *word = start, *length = (size_t) (cursor->current - start);
+    return true;
+}
+
+static void plain_skip_line(plain_cursor* cursor) {
+    while (cursor->current < cursor->end && *cursor->current != '\n')
+        ++ cursor->current;
+
+    if (cursor->current < cursor->end)
+        ++ cursor->current;
+
+    ++ cursor->line;
+}
+
+static bool word_is(const char* word, size_t length, const char* expected) {
+    return length == strlen(expected) && memcmp(word, expected, length) == 0;
+}
+
+static stack_trace* plain_read_number(plain_cursor* cursor, double* number) {
+    const char* word = NULL;
+    size_t length = 0;
+
+    char buffer[64] = {};
+
+    if (!plain_next_word(cursor, &word, &length) || length >= sizeof(buffer))
+        return FAILURE(RUNTIME_ERROR, "Line %zu: number expected!", cursor->line);
+
+    memcpy(buffer, word, length);
+
+    char* parsed_end = NULL;
+    *number = strtod(buffer, &parsed_end);
+
+    if (parsed_end != buffer + length)
+        return FAILURE(RUNTIME_ERROR, "Line %zu: \"%s\" is not a number!", cursor->line, buffer);
+
+    return SUCCESS();
+}
+
+// Nodes are named node_<id> by digraph_write, name may be quoted
+static stack_trace* plain_read_node_name(plain_cursor* cursor, node_id* node) {
+    const char* word = NULL;
+    size_t length = 0;
+
+    if (!plain_next_word(cursor, &word, &length))
+        return FAILURE(RUNTIME_ERROR, "Line %zu: node name expected!", cursor->line);
+
+    if (length >= 2 && word[0] == '"')
+        ++ word, length -= 2;
+
+    const char prefix[] = "node_";
+    const size_t prefix_length = sizeof(prefix) - 1;
+
+    char buffer[32] = {};
+    if (length <= prefix_length || length - prefix_length >= sizeof(buffer) ||
+        memcmp(word, prefix, prefix_length) != 0)
+        return FAILURE(RUNTIME_ERROR, "Line %zu: unknown node name!", cursor->line);
+
+    memcpy(buffer, word + prefix_length, length - prefix_length);
+
+    char* parsed_end = NULL;
+    long id = strtol(buffer, &parsed_end, 10);
+
+    if (*parsed_end != '\0' || id <= linked_list_end_index || id > INT32_MAX)
+        return FAILURE(RUNTIME_ERROR, "Line %zu: bad node id \"%s\"!", cursor->line, buffer);
+
+    *node = (node_id) id;
+    return SUCCESS();
+}
+
+static stack_trace* plain_read_node(graph_layout* layout, plain_cursor* cursor) {
+    node_id node = linked_list_end_index;
+    TRY plain_read_node_name(cursor, &node) FAIL("Failed to read node's name!");
+
+    layout_point center = {};
+    double width = 0, height = 0;
+
+    TRY plain_read_number(cursor, &center.x) FAIL("Failed to read x of node %d!", node);
+    TRY plain_read_number(cursor, &center.y) FAIL("Failed to read y of node %d!", node);
+    TRY plain_read_number(cursor, &width)    FAIL("Failed to read width of node %d!",  node);
+    TRY plain_read_number(cursor, &height)   FAIL("Failed to read height of node %d!", node);
+
+    center.x *= LAYOUT_POINTS_PER_INCH, center.y *= LAYOUT_POINTS_PER_INCH;
+
+    TRY graph_layout_place_node(layout, node,
+                                layout_box_around(center, width  * LAYOUT_POINTS_PER_INCH,
+                                                          height * LAYOUT_POINTS_PER_INCH))
+        FAIL("Failed to place node %d!", node);
+
+    return SUCCESS();
+}
+
+stack_trace* graph_layout_read_plain(graph_layout* layout, const char* text, size_t size) {
+    plain_cursor cursor = { .current = text, .end = text + size, .line = 1 };
+
+    while (cursor.current < cursor.end) {
+        const char* word = NULL;
+        size_t length = 0;
+
+        if (!plain_next_word(&cursor, &word, &length)) {
+            plain_skip_line(&cursor);
+            continue;
+        }
+
+        if (word_is(word, length, "stop"))
+            break;
+
+        // Graph's size is derived from boxes, edges are routed natively
+        if (word_is(word, length, "node")) {
+            TRY plain_read_node(layout, &cursor)
+                FAIL("Failed to read node at line %zu!", cursor.line);
+        } else if (!word_is(word, length, "graph") && !word_is(word, length, "edge"))
+            return FAILURE(RUNTIME_ERROR, "Line %zu: unknown statement!", cursor.line);
+
+        plain_skip_line(&cursor);
+    }
+
+    return SUCCESS();
+}
+
+// ---------------------------------- BOUNDS ----------------------------------
+
+static void extend_box(layout_box* box, layout_point point) {
+    if (point.x < box->left)   box->left   = point.x;
+    if (point.x > box->right)  box->right  = point.x;
+    if (point.y < box->bottom) box->bottom = point.y;
+    if (point.y > box->top)    box->top    = point.y;
+}
+
+layout_box graph_layout_bounds(const graph_layout* layout) {
+    if (layout->node_count == 0 && layout->point_count == 0)
+        return {};
+
+    layout_box bounds = layout->node_count > 0 ? layout->nodes[0].box :
+        layout_box { layout->points[0].x, layout->points[0].y,
+                     layout->points[0].x, layout->points[0].y };
+
+    for (size_t i = 0; i < layout->node_count; ++ i) {
+        extend_box(&bounds, { layout->nodes[i].box.left,  layout->nodes[i].box.bottom });
+        extend_box(&bounds, { layout->nodes[i].box.right, layout->nodes[i].box.top    });
+    }
+
+    for (size_t i = 0; i < layout->point_count; ++ i)
+        extend_box(&bounds, layout->points[i]);
+
+    return bounds;
+}
+
+// ----------------------------------- SVG ------------------------------------
+
+// Picture's margin around the graph, in points
+static const double SVG_PADDING = 8;
+
+static void write_svg_text(buffered_writer* writer, const char* string) {
+    for (const char* current = string; *current != '\0'; ++ current)
+        switch (*current) {
+        case '&': buffered_writer_puts(writer, "&amp;");  break;
+        case '<': buffered_writer_puts(writer, "&lt;");   break;
+        case '>': buffered_writer_puts(writer, "&gt;");   break;
+        case '"': buffered_writer_puts(writer, "&quot;"); break;
+        default:  buffered_writer_putc(writer, *current); break;
+        }
+}
+
+static const char* svg_dashes(graphviz_style style) {
+    switch (style) {
+    case STYLE_DASHED: return " stroke-dasharray=\"5,2\"";
+    case STYLE_DOTTED: return " stroke-dasharray=\"1,3\"";
+    default:           return "";
+    }
+}
+
+static const char* svg_color(graphviz_color color) {
+    const char** name = hash_table_lookup(&graphviz_colors, (int) color);
+    return name != NULL ? *name : "black";
+}
+
+/** Maps layout coordinates to picture's, where y grows down */
+struct svg_frame {
+    double left, top;
+};
+
+static double svg_x(const svg_frame* frame, double x) { return x - frame->left + SVG_PADDING; }
+static double svg_y(const svg_frame* frame, double y) { return frame->top - y + SVG_PADDING; }
+
+static void write_svg_node(buffered_writer* writer, const svg_frame* frame,
+                           const layout_box* box, const node* drawn) {
+    if (drawn->style == STYLE_INVIS)
+        return;
+
+    const double width = box->right - box->left, height = box->top - box->bottom;
+    const layout_point center = layout_box_center(box);
+
+    const char* color = svg_color(drawn->color);
+    const char* fill  = drawn->style == STYLE_FILLED ? color : "none";
+
+    switch (drawn->shape) {
+    case SHAPE_ELLIPSE: case SHAPE_OVAL: case SHAPE_CIRCLE:
+    case SHAPE_DOUBLECIRCLE: case SHAPE_EGG: case SHAPE_POINT:
+        buffered_writer_printf(writer, "<ellipse cx=\"%.2f\" cy=\"%.2f\" rx=\"%.2f\" ry=\"%.2f\"",
+                               svg_x(frame, center.x), svg_y(frame, center.y),
+                               width / 2, height / 2);
+        break;
+
+    case SHAPE_PLAINTEXT: case SHAPE_PLAIN:
+        buffered_writer_puts(writer, "<g");
+        break;
+
+    default:
+        buffered_writer_printf(writer, "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" "
+                               "height=\"%.2f\"%s", svg_x(frame, box->left),
+                               svg_y(frame, box->top), width, height,
+                               drawn->style == STYLE_ROUNDED ? " rx=\"4\"" : "");
+        break;
+    }
+
+    if (drawn->shape == SHAPE_PLAINTEXT || drawn->shape == SHAPE_PLAIN)
+        buffered_writer_puts(writer, "></g>" "\n");
+    else
+        buffered_writer_printf(writer, " fill=\"%s\" stroke=\"%s\"%s/>" "\n", fill, color,
+                               svg_dashes(drawn->style));
+
+    if (drawn->label == NULL || drawn->label[0] == '\0')
+        return;
+
+    buffered_writer_printf(writer, "<text x=\"%.2f\" y=\"%.2f\">",
+                           svg_x(frame, center.x), svg_y(frame, center.y));
+    write_svg_text(writer, drawn->label);
+    buffered_writer_puts(writer, "</text>" "\n");
+}
+
+static void write_svg_edge(buffered_writer* writer, const svg_frame* frame,
+                           const graph_layout* layout, const layout_edge* drawn,
+                           const edge* attributes) {
+    if (drawn->point_count < 2 || (attributes != NULL && attributes->style == STYLE_INVIS))
+        return;
+
+    const layout_point* points = &layout->points[drawn->first_point];
+
+    buffered_writer_printf(writer, "<path d=\"M%.2f %.2f",
+                           svg_x(frame, points[0].x), svg_y(frame, points[0].y));
+
+    for (size_t i = 1; i < drawn->point_count; ++ i)
+        buffered_writer_printf(writer, " L%.2f %.2f",
+                               svg_x(frame, points[i].x), svg_y(frame, points[i].y));
+
+    buffered_writer_printf(writer, "\" stroke=\"%s\"%s/>" "\n",
+                           attributes != NULL ? svg_color(attributes->color) : "black",
+                           attributes != NULL ? svg_dashes(attributes->style) : "");
+}
+
+void graph_layout_write_svg(buffered_writer* writer, const graph_layout* layout, digraph* graph) {
+    const layout_box bounds = graph_layout_bounds(layout);
+    const svg_frame frame = { .left = bounds.left, .top = bounds.top };
+
+    const double width  = bounds.right - bounds.left + 2 * SVG_PADDING,
+                 height = bounds.top - bounds.bottom + 2 * SVG_PADDING;
+
+    buffered_writer_printf(writer,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"                                      "\n"
+        "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%.0f\" height=\"%.0f\" "
+        "viewBox=\"0 0 %.2f %.2f\">"                                                     "\n"
+        "<defs><marker id=\"arrow\" viewBox=\"0 0 10 10\" refX=\"10\" refY=\"5\" "
+        "markerWidth=\"8\" markerHeight=\"8\" orient=\"auto\">"
+        "<path d=\"M0 0 L10 5 L0 10 z\" fill=\"context-stroke\"/></marker></defs>"        "\n"
+        "<g fill=\"none\" marker-end=\"url(#arrow)\">"                                    "\n",
+        width, height, width, height);
+
+    for (size_t i = 0; i < layout->edge_count; ++ i) {
+        const layout_edge* drawn = &layout->edges[i];
+
+        // Edge, removed after layout was made, is drawn plain
+        const edge* attributes = graph != NULL ?
+            subgraph_find_edge(graph, drawn->subgraph, drawn->edge) : NULL;
+
+        write_svg_edge(writer, &frame, layout, drawn, attributes);
+    }
+
+    buffered_writer_puts(writer, "</g>" "\n" "<g font-family=\"sans-serif\" font-size=\"14\" "
+                                 "text-anchor=\"middle\" dominant-baseline=\"central\">" "\n");
+
+    // Nodes without graph are drawn as plain boxes
+    if (graph == NULL)
+        for (size_t i = 0; i < layout->node_count; ++ i) {
+            node plain = { .style = STYLE_SOLID, .color = GRAPHVIZ_BLACK, .shape = SHAPE_BOX };
+            write_svg_node(writer, &frame, &layout->nodes[i].box, &plain);
+        }
+    else
+        LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current_subgraph) {
+            subgraph* current = &current_subgraph->element;
+
+            LINKED_LIST_TRAVERSE(&current->nodes, node, current_node) {
+                const layout_box* box = graph_layout_node_box(
+                    layout, linked_list_get_index(&current->nodes, current_node));
+
+                if (box != NULL)
+                    write_svg_node(writer, &frame, box, &current_node->element);
+            }
+        }
+
+    buffered_writer_puts(writer, "</g>" "\n" "</svg>" "\n");
+}
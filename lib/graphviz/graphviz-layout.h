@@ -0,0 +1,130 @@
+#pragma once
+
+#include "graphviz.h"
+#include "graphviz-writer.h"
+#include "trace.h"
+
+#include <stddef.h>
+
+// Layout coordinates are in points, dot's plain output is in inches
+const double LAYOUT_POINTS_PER_INCH = 72.0;
+
+struct layout_point {
+    double x, y;
+};
+
+/** Axis aligned box, y grows up like in dot's coordinates */
+struct layout_box {
+    double left, bottom, right, top;
+};
+
+inline layout_box layout_box_around(layout_point center, double width, double height) {
+    layout_box box = {
+        .left  = center.x - width  / 2, .bottom = center.y - height / 2,
+        .right = center.x + width  / 2, .top    = center.y + height / 2
+    };
+
+    return box;
+}
+
+inline layout_point layout_box_center(const layout_box* box) {
+    layout_point center = { .x = (box->left + box->right) / 2, .y = (box->bottom + box->top) / 2 };
+    return center;
+}
+
+inline layout_box layout_box_inflate(const layout_box* box, double margin) {
+    layout_box inflated = {
+        .left  = box->left  - margin, .bottom = box->bottom - margin,
+        .right = box->right + margin, .top    = box->top    + margin
+    };
+
+    return inflated;
+}
+
+inline bool layout_box_contains(const layout_box* box, layout_point point) {
+    return point.x > box->left && point.x < box->right &&
+           point.y > box->bottom && point.y < box->top;
+}
+
+inline bool layout_box_overlaps(const layout_box* first, const layout_box* second) {
+    return first->left <= second->right && second->left <= first->right &&
+           first->bottom <= second->top && second->bottom <= first->top;
+}
+
+/** Placed node, box is it's outline */
+struct layout_node {
+    node_id node;
+    layout_box box;
+};
+
+/** Edge between two placed nodes and it's route */
+struct layout_edge {
+    subgraph_id subgraph;
+    edge_id edge;
+
+    node_id from, to;
+
+    // Route is points [first_point, first_point + point_count) of layout,
+    // it goes from border of source to border of target. Empty if not routed
+    size_t first_point, point_count;
+};
+
+/**
+ * Geometry of a drawn graph: boxes of nodes and routes of edges. Nodes
+ * are placed by dot (see graph_layout_read_plain) or by hand, edges are
+ * routed natively by graph_layout_route_edges
+ */
+struct graph_layout {
+    layout_node* nodes;
+    size_t node_count, node_capacity;
+
+    // Position of node in nodes by it's id, LAYOUT_NOT_PLACED if absent
+    size_t* slots;
+    size_t slot_capacity;
+
+    layout_edge* edges;
+    size_t edge_count, edge_capacity;
+
+    layout_point* points;
+    size_t point_count;
+};
+
+const size_t LAYOUT_NOT_PLACED = (size_t) -1;
+
+graph_layout graph_layout_create();
+
+void graph_layout_destroy(graph_layout* layout);
+
+/**
+ * Place node @arg node in @arg box, node that is already placed is moved
+ */
+stack_trace* graph_layout_place_node(graph_layout* layout, node_id node, layout_box box);
+
+/**
+ * @return box of the node, or NULL if it isn't placed
+ */
+const layout_box* graph_layout_node_box(const graph_layout* layout, node_id node);
+
+/**
+ * Add every edge of @arg graph, which connects placed nodes, without
+ * routes. Edges added before are kept
+ */
+stack_trace* graph_layout_add_edges(graph_layout* layout, digraph* graph);
+
+/**
+ * Place nodes as dot placed them in it's plain output (dot -Tplain) of
+ * graph written by digraph_write. Edge lines are skipped, edges are
+ * routed natively
+ */
+stack_trace* graph_layout_read_plain(graph_layout* layout, const char* text, size_t size);
+
+/**
+ * @return box around every node and route of layout
+ */
+layout_box graph_layout_bounds(const graph_layout* layout);
+
+/**
+ * Write layout as SVG picture. If @arg graph is not NULL, labels, colors
+ * and styles of nodes and edges are taken from it
+ */
+void graph_layout_write_svg(buffered_writer* writer, const graph_layout* layout, digraph* graph);
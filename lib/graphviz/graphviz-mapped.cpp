@@ -0,0 +1,225 @@
+#include "graphviz-mapped.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "hash-table.h"
+#include "mapped-array.h"
+#include "trace.h"
+
+// Names of graph's files inside of it's directory
+static const char*  NODES_FILE_NAME = "nodes";
+static const char*  EDGES_FILE_NAME = "edges";
+static const char* LABELS_FILE_NAME = "labels";
+
+static void file_path(char* path, const char* directory, const char* name) {
+    snprintf(path, PATH_MAX, "%s/%s", directory, name);
+}
+
+// Arrays that weren't mapped yet, so graph can be closed at any moment
+static void mapped_digraph_init(mapped_digraph* graph) {
+    graph->nodes  = { .elements = NULL, .capacity = 0, .used = 0, .fd = -1 };
+    graph->edges  = { .elements = NULL, .capacity = 0, .used = 0, .fd = -1 };
+    graph->labels = { .elements = NULL, .capacity = 0, .used = 0, .fd = -1 };
+}
+
+stack_trace* mapped_digraph_create(mapped_digraph* graph, const char* directory) {
+    mapped_digraph_init(graph);
+
+    if (mkdir(directory, 0755) == -1 && errno != EEXIST)
+        return FAILURE(RUNTIME_ERROR, "Can't create %s: %s", directory, strerror(errno));
+
+    char path[PATH_MAX] = {};
+
+    file_path(path, directory, NODES_FILE_NAME);
+    TRY mapped_array_create(&graph->nodes, path)
+        FAIL("Failed to create nodes file!");
+
+    FINALIZER(close_graph, { mapped_digraph_close(graph); });
+
+    file_path(path, directory, EDGES_FILE_NAME);
+    TRY mapped_array_create(&graph->edges, path)
+        FINALIZE_AND_FAIL(close_graph, "Failed to create edges file!");
+
+    file_path(path, directory, LABELS_FILE_NAME);
+    TRY mapped_array_create(&graph->labels, path)
+        FINALIZE_AND_FAIL(close_graph, "Failed to create labels file!");
+
+    return SUCCESS();
+}
+
+stack_trace* mapped_digraph_open(mapped_digraph* graph, const char* directory) {
+    mapped_digraph_init(graph);
+
+    char path[PATH_MAX] = {};
+
+    file_path(path, directory, NODES_FILE_NAME);
+    TRY mapped_array_open(&graph->nodes, path)
+        FAIL("Failed to open nodes file!");
+
+    FINALIZER(close_graph, { mapped_digraph_close(graph); });
+
+    file_path(path, directory, EDGES_FILE_NAME);
+    TRY mapped_array_open(&graph->edges, path)
+        FINALIZE_AND_FAIL(close_graph, "Failed to open edges file!");
+
+    file_path(path, directory, LABELS_FILE_NAME);
+    TRY mapped_array_open(&graph->labels, path)
+        FINALIZE_AND_FAIL(close_graph, "Failed to open labels file!");
+
+    return SUCCESS();
+}
+
+stack_trace* mapped_digraph_close(mapped_digraph* graph) {
+    // Every array should be closed, even if one of them fails
+    stack_trace*  nodes_trace = mapped_array_close(&graph->nodes);
+    stack_trace*  edges_trace = mapped_array_close(&graph->edges);
+    stack_trace* labels_trace = mapped_array_close(&graph->labels);
+
+    TRY  nodes_trace FAIL("Failed to close nodes file!");
+    TRY  edges_trace FAIL("Failed to close edges file!");
+    TRY labels_trace FAIL("Failed to close labels file!");
+
+    return SUCCESS();
+}
+
+// Format label right into the labels file, without intermediate buffer.
+// Without format label of default element is kept, like in vedge_from_default
+static size_t vappend_label(mapped_digraph* graph, const char* default_label,
+                            const char* format, va_list args) {
+    const size_t label_size = vlabel_size(default_label, format, args);
+
+    TRY mapped_array_reserve(&graph->labels, label_size)
+        THROW("Failed to reserve space for label of size %zu!", label_size);
+
+    size_t label = graph->labels.used;
+    vformat_label(graph->labels.elements + label, label_size, default_label, format, args);
+
+    graph->labels.used += label_size;
+    return label;
+}
+
+node_id mapped_digraph_insert_default_node(mapped_digraph* graph, node default_node,
+                                           const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    mapped_node new_node = {
+        .style = default_node.style,
+        .color = default_node.color,
+        .shape = default_node.shape,
+        .label = vappend_label(graph, default_node.label, format, args)
+    };
+
+    va_end(args);
+
+    size_t index = 0;
+    TRY mapped_array_push_back(&graph->nodes, new_node, &index)
+        THROW("Failed to insert new node!");
+
+    return (node_id) index;
+}
+
+void mapped_digraph_insert_default_edge(mapped_digraph* graph, edge default_edge,
+                                        node_id from, node_id to,
+                                        const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    mapped_edge new_edge = {
+        .from  = from, .to = to,
+        .color = default_edge.color,
+        .style = default_edge.style,
+        .weight = default_edge.weight,
+        .label = vappend_label(graph, default_edge.label, format, args)
+    };
+
+    va_end(args);
+
+    TRY mapped_array_push_back(&graph->edges, new_edge)
+        THROW("Failed to insert new edge!");
+}
+
+size_t mapped_digraph_shortest_paths(mapped_digraph* graph, node_id source, double* distances) {
+    mapped_array_advise_sequential(&graph->edges);
+
+    const size_t node_count = graph->nodes.used;
+    for (size_t i = 0; i < node_count; ++ i)
+        distances[i] = INFINITY;
+
+    distances[source] = 0;
+
+    // Every shortest path has less than node_count edges, so
+    // each of them is found after that many passes at most
+    size_t passes = 0;
+    for (bool is_changed = true; is_changed && passes <= node_count; ++ passes) {
+        is_changed = false;
+
+        MAPPED_ARRAY_TRAVERSE(&graph->edges, mapped_edge, current_edge) {
+            if ((size_t) current_edge->from >= node_count ||
+                (size_t) current_edge->to   >= node_count)
+                continue;
+
+            const double weight = current_edge->weight != 0 ? current_edge->weight : 1.0;
+            const double distance = distances[current_edge->from] + weight;
+
+            if (distance < distances[current_edge->to])
+                distances[current_edge->to] = distance, is_changed = true;
+        }
+    }
+
+    return passes;
+}
+
+void mapped_digraph_write_to_file(FILE* file, mapped_digraph* graph) {
+    // Every file is read exactly once from start to end
+    mapped_array_advise_sequential(&graph->nodes);
+    mapped_array_advise_sequential(&graph->edges);
+    mapped_array_advise_sequential(&graph->labels);
+
+    fprintf(file, "digraph {" "\n");
+    fprintf(file, "\t" "subgraph {" "\n");
+
+    node_id node_identity = 0;
+    MAPPED_ARRAY_TRAVERSE(&graph->nodes, mapped_node, current_node) {
+        const char* shape =
+            *hash_table_lookup(&graphviz_node_shapes, (int) current_node->shape);
+
+        const char* color =
+            *hash_table_lookup(&graphviz_colors,      (int) current_node->color);
+
+        const char* style =
+            *hash_table_lookup(&graphviz_styles,      (int) current_node->style);
+
+        fprintf(file, "\t\t" "node_%d [" "label = \"%s\","
+                "shape = \"%s\", color = \"%s\", style = \"%s\"];" "\n",
+                node_identity ++, mapped_digraph_label(graph, current_node->label),
+                shape, color, style);
+    }
+
+    MAPPED_ARRAY_TRAVERSE(&graph->edges, mapped_edge, current_edge) {
+        const char* color =
+            *hash_table_lookup(&graphviz_colors, (int) current_edge->color);
+
+        const char* style =
+            *hash_table_lookup(&graphviz_styles, (int) current_edge->style);
+
+        fprintf(file, "\t\t" "node_%d -> node_%d [label = \" %s \","
+                "color = %s, style = %s, margin = \"1.5\"",
+                current_edge->from, current_edge->to,
+                mapped_digraph_label(graph, current_edge->label), color, style);
+
+        if (current_edge->weight != 0)
+            fprintf(file, ", weight = %d", edge_dot_weight(current_edge->weight));
+
+        fprintf(file, "];" "\n");
+    }
+
+    fprintf(file, "\t" "}" "\n");
+    fprintf(file, "}"  "\n");
+}
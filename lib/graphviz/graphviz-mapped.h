@@ -0,0 +1,93 @@
+#pragma once
+
+#include "graphviz.h"
+#include "mapped-array.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+struct mapped_node {
+    graphviz_style style;
+    graphviz_color color;
+    graphviz_node_shape shape;
+
+    size_t label; // Offset of null terminated label in labels
+};
+
+struct mapped_edge {
+    node_id from, to;
+
+    graphviz_color color;
+    graphviz_style style;
+
+    double weight; // The same as weight of edge, 0 is the default one
+    size_t label;
+};
+
+/**
+ * Append-only graph, that keeps nodes, edges and labels in memory mapped
+ * files in a directory, so graph's size is bounded by disk, not memory.
+ * Node ids are positions of nodes in the nodes file.
+ *
+ * Graph is flat, it has no subgraphs.
+ */
+struct mapped_digraph {
+    mapped_array<mapped_node> nodes;
+    mapped_array<mapped_edge> edges;
+    mapped_array<char> labels;
+};
+
+/**
+ * Create empty graph in @arg directory, it's created if it doesn't exist
+ */
+stack_trace* mapped_digraph_create(mapped_digraph* graph, const char* directory);
+
+/**
+ * Open graph, previously built in @arg directory, to export or extend it
+ */
+stack_trace* mapped_digraph_open(mapped_digraph* graph, const char* directory);
+
+/**
+ * Unmap graph, it's files stay in the directory
+ */
+stack_trace* mapped_digraph_close(mapped_digraph* graph);
+
+/**
+ * Insert new node with style inherited from default node, it's
+ * label is formatted directly into the labels file
+ *
+ * @return value that identifies node and can be used to create edges
+ */
+node_id mapped_digraph_insert_default_node(mapped_digraph* graph, node default_node,
+                                           const char* format, ...);
+
+/**
+ * Insert new edge that connects two nodes, identified by their id's
+ */
+void    mapped_digraph_insert_default_edge(mapped_digraph* graph, edge default_edge,
+                                           node_id from, node_id to,
+                                           const char* format, ...);
+
+inline const char* mapped_digraph_label(mapped_digraph* graph, size_t label) {
+    return graph->labels.elements + label;
+}
+
+/**
+ * Find weighted distances from @arg source, without building any index:
+ * edges file is read sequentially in passes, that relax every edge, until
+ * a pass changes nothing. Graphs, that are built mostly in the order of
+ * their paths, settle in a few passes. Weights should be non negative.
+ *
+ * @arg distances has a place for every node, it's set to INFINITY for
+ * unreachable ones
+ *
+ * @return number of passes over edges
+ */
+size_t mapped_digraph_shortest_paths(mapped_digraph* graph, node_id source, double* distances);
+
+/**
+ * Write to @arg file description of the @arg graph in graphviz dot's
+ * lang, files are read sequentially, once
+ */
+void mapped_digraph_write_to_file(FILE* file, mapped_digraph* graph);
@@ -0,0 +1,349 @@
+#include "graphviz-parallel-writer.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "safe-alloc.h"
+#include "thread-pool.h"
+#include "trace.h"
+
+/** Consecutive nodes or edges of one subgraph */
+struct write_piece {
+    subgraph* graph;
+
+    bool is_edges;
+    element_index_t first;
+    size_t count;
+
+    bool opens, closes; // Piece starts or ends it's subgraph
+};
+
+/** Consecutive pieces, that are formatted into one buffer */
+struct write_task {
+    write_piece* pieces;
+    size_t piece_count;
+
+    iovec* output;
+};
+
+/**
+ * Output of the graph in order, first and last buffers are graph's own
+ * braces, others are formatted by tasks
+ */
+struct write_plan {
+    write_piece* pieces;
+    size_t piece_count;
+
+    write_task* tasks;
+    size_t task_count;
+
+    iovec* outputs;
+};
+
+static const char GRAPH_BEGIN[] = "digraph {" "\n";
+static const char GRAPH_END  [] = "}"         "\n";
+
+// ------------------------------- PLANNING ----------------------------------
+
+static size_t count_elements(digraph* graph, size_t* max_pieces) {
+    size_t elements = 0;
+    *max_pieces = 0;
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current) {
+        size_t nodes = current->element.nodes.used, edges = current->element.edges.used;
+
+        elements += nodes + edges;
+
+        // Each list gives one partial piece at most, empty subgraph gets one
+        *max_pieces += nodes / PARALLEL_WRITE_TASK_ELEMENTS +
+                       edges / PARALLEL_WRITE_TASK_ELEMENTS + 2;
+    }
+
+    return elements;
+}
+
+template <typename E>
+static void split_in_pieces(write_plan* plan, subgraph* graph,
+                            linked_list<E>* list, bool is_edges) {
+    size_t in_piece = 0;
+
+    LINKED_LIST_TRAVERSE(list, E, current) {
+        if (in_piece == 0)
+            plan->pieces[plan->piece_count ++] = {
+                .graph = graph, .is_edges = is_edges,
+                .first = linked_list_get_index(list, current), .count = 0,
+                .opens = false, .closes = false
+            };
+
+        ++ plan->pieces[plan->piece_count - 1].count;
+
+        if (++ in_piece == PARALLEL_WRITE_TASK_ELEMENTS)
+            in_piece = 0;
+    }
+}
+
+static void plan_subgraph(write_plan* plan, subgraph* graph) {
+    size_t first_piece = plan->piece_count;
+
+    split_in_pieces(plan, graph, &graph->nodes, false);
+    split_in_pieces(plan, graph, &graph->edges, true);
+
+    // Empty subgraph is still written, so it gets piece of it's own
+    if (plan->piece_count == first_piece)
+        plan->pieces[plan->piece_count ++] = {
+            .graph = graph, .is_edges = false, .first = 0, .count = 0,
+            .opens = false, .closes = false
+        };
+
+    plan->pieces[first_piece].opens = true;
+    plan->pieces[plan->piece_count - 1].closes = true;
+}
+
+// Small neighbouring pieces are joined, so every task is worth spawning
+static void group_in_tasks(write_plan* plan) {
+    size_t weight = 0;
+
+    for (size_t i = 0; i < plan->piece_count; ++ i) {
+        if (weight == 0) {
+            plan->tasks[plan->task_count] = {
+                .pieces = &plan->pieces[i], .piece_count = 0,
+                .output = &plan->outputs[plan->task_count + 1]
+            };
+
+            ++ plan->task_count;
+        }
+
+        ++ plan->tasks[plan->task_count - 1].piece_count;
+
+        weight += plan->pieces[i].count + 1;
+        if (weight >= PARALLEL_WRITE_TASK_ELEMENTS)
+            weight = 0;
+    }
+}
+
+static void write_plan_destroy(write_plan* plan) {
+    for (size_t i = 0; i < plan->task_count; ++ i)
+        free(plan->tasks[i].output->iov_base);
+
+    free(plan->pieces);
+    free(plan->tasks);
+    free(plan->outputs);
+
+    *plan = {};
+}
+
+static stack_trace* write_plan_create(write_plan* plan, digraph* graph, size_t max_pieces) {
+    *plan = {};
+
+    TRY safe_calloc(max_pieces, &plan->pieces)
+        FAIL("Failed to allocate %zu pieces!", max_pieces);
+
+    TRY safe_calloc(max_pieces, &plan->tasks) CATCH({
+        write_plan_destroy(plan);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate tasks!");
+    });
+
+    TRY safe_calloc(max_pieces + 2, &plan->outputs) CATCH({
+        write_plan_destroy(plan);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate outputs!");
+    });
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        plan_subgraph(plan, &current->element);
+
+    group_in_tasks(plan);
+
+    plan->outputs[0] = { .iov_base = (void*) GRAPH_BEGIN, .iov_len = strlen(GRAPH_BEGIN) };
+    plan->outputs[plan->task_count + 1] =
+        { .iov_base = (void*) GRAPH_END, .iov_len = strlen(GRAPH_END) };
+
+    return SUCCESS();
+}
+
+// ------------------------------ FORMATTING ---------------------------------
+
+static void format_piece(buffered_writer* writer, write_piece* piece) {
+    subgraph* graph = piece->graph;
+
+    if (piece->opens)
+        subgraph_write_begin(writer, graph);
+
+    if (piece->is_edges) {
+        element<edge>* current = linked_list_get_pointer(&graph->edges, piece->first);
+
+        for (size_t i = 0; i < piece->count; ++ i) {
+            subgraph_write_edge(writer, graph, linked_list_get_index(&graph->edges, current));
+            current = linked_list_next(&graph->edges, current);
+        }
+    } else if (piece->count > 0) {
+        element<node>* current = linked_list_get_pointer(&graph->nodes, piece->first);
+
+        for (size_t i = 0; i < piece->count; ++ i) {
+            subgraph_write_node(writer, graph, linked_list_get_index(&graph->nodes, current));
+            current = linked_list_next(&graph->nodes, current);
+        }
+    }
+
+    if (piece->closes)
+        subgraph_write_end(writer);
+}
+
+static stack_trace* format_task(void* task_pointer) {
+    write_task* task = (write_task*) task_pointer;
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        FAIL("Failed to create writer for %zu pieces!", task->piece_count);
+
+    for (size_t i = 0; i < task->piece_count; ++ i)
+        format_piece(&writer, &task->pieces[i]);
+
+    if (writer.failed) {
+        trace_destruct(buffered_writer_destroy(&writer));
+        return FAILURE(RUNTIME_ERROR, "Failed to format %zu pieces!", task->piece_count);
+    }
+
+    task->output->iov_base = buffered_writer_take(&writer, &task->output->iov_len);
+
+    trace_destruct(buffered_writer_destroy(&writer));
+    return SUCCESS();
+}
+
+static stack_trace* format_in_parallel(write_plan* plan) {
+    thread_pool* pool = thread_pool_default();
+
+    thread_pool_future* futures = NULL;
+    TRY safe_calloc(plan->task_count, &futures)
+        FAIL("Failed to allocate %zu futures!", plan->task_count);
+
+    // Task that can't be spawned is formatted in place
+    for (size_t i = 0; i < plan->task_count; ++ i) {
+        stack_trace* spawned = thread_pool_spawn(pool, format_task, &plan->tasks[i], &futures[i]);
+
+        if (!trace_is_success(spawned))
+            futures[i] = { .result = format_task(&plan->tasks[i]), .is_done = true };
+
+        trace_destruct(spawned);
+    }
+
+    stack_trace* result = thread_pool_wait_all(pool, futures, plan->task_count);
+    free(futures);
+
+    TRY result FAIL("Failed to format graph in %zu tasks!", plan->task_count);
+    return SUCCESS();
+}
+
+// -------------------------------- OUTPUT -----------------------------------
+
+static stack_trace* write_outputs_to_fd(int fd, iovec* outputs, size_t count) {
+    iovec vectors[IOV_MAX];
+
+    size_t current = 0, offset = 0; // Offset in current output, that is written partially
+    while (current < count) {
+        int vector_count = 0;
+
+        for (size_t i = current; i < count && vector_count < IOV_MAX; ++ i) {
+            size_t skip = i == current ? offset : 0;
+
+            vectors[vector_count ++] = {
+                .iov_base = (char*) outputs[i].iov_base + skip,
+                .iov_len  = outputs[i].iov_len - skip
+            };
+        }
+
+        ssize_t written = writev(fd, vectors, vector_count);
+
+        if (written == -1 && errno == EINTR)
+            continue;
+
+        if (written == -1)
+            return FAILURE(RUNTIME_ERROR, "Failed to write graph: %s", strerror(errno));
+
+        // Skip outputs, that are written completely
+        size_t left = (size_t) written;
+        while (current < count && left >= outputs[current].iov_len - offset) {
+            left -= outputs[current].iov_len - offset;
+            ++ current, offset = 0;
+        }
+
+        offset += left;
+    }
+
+    return SUCCESS();
+}
+
+stack_trace* digraph_write_parallel(buffered_writer* writer, digraph* graph) {
+    size_t max_pieces = 0;
+
+    // Spawning tasks doesn't pay off for small graphs
+    if (count_elements(graph, &max_pieces) < PARALLEL_WRITE_MIN_ELEMENTS) {
+        digraph_write(writer, graph);
+        return SUCCESS();
+    }
+
+    write_plan plan = {};
+    TRY write_plan_create(&plan, graph, max_pieces)
+        FAIL("Failed to plan writing of graph!");
+
+    TRY format_in_parallel(&plan) CATCH({
+        write_plan_destroy(&plan);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to format graph!");
+    });
+
+    size_t output_count = plan.task_count + 2;
+
+    if (writer->sink == WRITER_FD) {
+        // Buffered output goes first, then formatted buffers as they are
+        TRY buffered_writer_flush(writer) CATCH({
+            write_plan_destroy(&plan);
+            return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to flush writer!");
+        });
+
+        TRY write_outputs_to_fd(writer->fd, plan.outputs, output_count) CATCH({
+            write_plan_destroy(&plan);
+            return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to write graph!");
+        });
+    } else {
+        for (size_t i = 0; i < output_count; ++ i)
+            buffered_writer_write(writer, plan.outputs[i].iov_base, plan.outputs[i].iov_len);
+    }
+
+    write_plan_destroy(&plan);
+    return SUCCESS();
+}
+
+stack_trace* digraph_write_parallel_to_fd(int fd, digraph* graph) {
+    buffered_writer writer = {};
+    TRY buffered_writer_create_for_fd(&writer, fd)
+        FAIL("Failed to create writer for descriptor %d!", fd);
+
+    TRY digraph_write_parallel(&writer, graph) CATCH({
+        trace_destruct(buffered_writer_destroy(&writer));
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to write graph!");
+    });
+
+    TRY buffered_writer_destroy(&writer)
+        FAIL("Failed to write graph to descriptor %d!", fd);
+
+    return SUCCESS();
+}
+
+stack_trace* digraph_write_parallel_to_file(FILE* file, digraph* graph) {
+    buffered_writer writer = {};
+    TRY buffered_writer_create_for_file(&writer, file)
+        FAIL("Failed to create writer for file!");
+
+    TRY digraph_write_parallel(&writer, graph) CATCH({
+        trace_destruct(buffered_writer_destroy(&writer));
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to write graph!");
+    });
+
+    TRY buffered_writer_destroy(&writer)
+        FAIL("Failed to write graph to file!");
+
+    return SUCCESS();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "graphviz.h"
+#include "graphviz-writer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Graphs with fewer nodes and edges are written on the calling thread
+const size_t PARALLEL_WRITE_MIN_ELEMENTS = 16 * 1024;
+
+// Nodes and edges, that one task formats, big subgraphs are split by them
+const size_t PARALLEL_WRITE_TASK_ELEMENTS = 2 * 1024;
+
+/**
+ * Same output as digraph_write, byte for byte, but subgraphs and big
+ * ranges of their nodes and edges are formatted concurrently into
+ * separate buffers, which are then passed to @arg writer in order.
+ * Writers, that write to a descriptor, get buffers with writev, without
+ * copying them.
+ */
+stack_trace* digraph_write_parallel(buffered_writer* writer, digraph* graph);
+
+/**
+ * Same as digraph_write_parallel, but output goes right to @arg fd
+ */
+stack_trace* digraph_write_parallel_to_fd(int fd, digraph* graph);
+
+/**
+ * Same as digraph_write_parallel, but output goes to @arg file, failures
+ * to write it are returned, unlike in digraph_write_to_file
+ */
+stack_trace* digraph_write_parallel_to_file(FILE* file, digraph* graph);
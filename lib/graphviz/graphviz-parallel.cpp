@@ -0,0 +1,18 @@
+#include "graphviz-parallel.h"
+
+#include <stdlib.h>
+
+#include "thread-pool.h"
+#include "trace.h"
+
+size_t graphviz_parallel_thread_count() {
+    return thread_pool_thread_count(thread_pool_default());
+}
+
+void graphviz_parallel_for(size_t count,
+                           void (*body)(size_t begin, size_t end, void* argument),
+                           void* argument) {
+    // Bodies can't fail, so failure here means pool itself is broken
+    TRY thread_pool_parallel_for(thread_pool_default(), count, body, argument)
+        THROW("Parallel for failed!");
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Split range [0, @arg count) in contiguous chunks, one per thread of the
+ * default thread pool, and call @arg body for each of them concurrently.
+ * Returns when every chunk is processed, @arg body is also run on the
+ * calling thread.
+ */
+void graphviz_parallel_for(size_t count,
+                           void (*body)(size_t begin, size_t end, void* argument),
+                           void* argument);
+
+// Number of threads graphviz_parallel_for will use at most
+size_t graphviz_parallel_thread_count();
@@ -0,0 +1,265 @@
+#include "graphviz-png.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "safe-alloc.h"
+#include "trace.h"
+
+static uint32_t crc_table[256] = {};
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void fill_crc_table() {
+    for (uint32_t byte = 0; byte < 256; ++ byte) {
+        uint32_t crc = byte;
+
+        for (int bit = 0; bit < 8; ++ bit)
+            crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+
+        crc_table[byte] = crc;
+    }
+}
+
+uint32_t png_crc32(uint32_t crc, const void* data, size_t size) {
+    pthread_once(&crc_table_once, fill_crc_table);
+
+    const uint8_t* bytes = (const uint8_t*) data;
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++ i)
+        crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+uint32_t png_adler32(uint32_t adler, const void* data, size_t size) {
+    // Sums don't overflow 32 bits in so many bytes, so modulo is taken rarely
+    const size_t ADLER_RUN = 5552;
+    const uint32_t ADLER_MODULO = 65521;
+
+    const uint8_t* bytes = (const uint8_t*) data;
+    uint32_t low = adler & 0xffff, high = adler >> 16;
+
+    while (size > 0) {
+        size_t run = size < ADLER_RUN ? size : ADLER_RUN;
+
+        for (size_t i = 0; i < run; ++ i)
+            low += bytes[i], high += low;
+
+        low %= ADLER_MODULO, high %= ADLER_MODULO;
+        bytes += run, size -= run;
+    }
+
+    return high << 16 | low;
+}
+
+/** Chunk, that is written piece by piece, it's CRC is kept up to date */
+struct png_chunk {
+    buffered_writer* writer;
+    uint32_t crc;
+};
+
+static void write_big_endian(uint8_t* bytes, uint32_t value) {
+    bytes[0] = (uint8_t) (value >> 24), bytes[1] = (uint8_t) (value >> 16);
+    bytes[2] = (uint8_t) (value >>  8), bytes[3] = (uint8_t) value;
+}
+
+static png_chunk chunk_begin(buffered_writer* writer, const char type[4], uint32_t length) {
+    uint8_t header[8] = {};
+    write_big_endian(header, length);
+    memcpy(header + 4, type, 4);
+
+    buffered_writer_write(writer, header, sizeof(header));
+
+    // Length isn't covered by CRC, type is
+    png_chunk chunk = { .writer = writer, .crc = png_crc32(0, type, 4) };
+    return chunk;
+}
+
+static void chunk_write(png_chunk* chunk, const void* data, size_t size) {
+    buffered_writer_write(chunk->writer, data, size);
+    chunk->crc = png_crc32(chunk->crc, data, size);
+}
+
+static void chunk_end(png_chunk* chunk) {
+    uint8_t crc[4] = {};
+    write_big_endian(crc, chunk->crc);
+
+    buffered_writer_write(chunk->writer, crc, sizeof(crc));
+}
+
+// ------------------------------- DEFLATE ------------------------------------
+
+/** Output of deflate, bits are packed starting from the lowest one */
+struct bit_writer {
+    uint8_t* bytes;
+    size_t size;
+
+    uint64_t bits;
+    unsigned count;
+};
+
+static void put_bits(bit_writer* output, uint32_t value, unsigned count) {
+    output->bits |= (uint64_t) value << output->count;
+    output->count += count;
+
+    while (output->count >= 8) {
+        output->bytes[output->size ++] = (uint8_t) output->bits;
+        output->bits >>= 8, output->count -= 8;
+    }
+}
+
+// Huffman codes are packed starting from their highest bit
+static void put_code(bit_writer* output, uint32_t code, unsigned length) {
+    uint32_t reversed = 0;
+    for (unsigned i = 0; i < length; ++ i)
+        reversed |= (code >> i & 1) << (length - 1 - i);
+
+    put_bits(output, reversed, length);
+}
+
+// Literal or length symbol in fixed Huffman code
+static void put_symbol(bit_writer* output, unsigned symbol) {
+    if (symbol < 144)
+        put_code(output, 0x30 + symbol, 8);
+    else if (symbol < 256)
+        put_code(output, 0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        put_code(output, symbol - 256, 7);
+    else
+        put_code(output, 0xc0 + symbol - 280, 8);
+}
+
+static const uint16_t LENGTH_BASES[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t LENGTH_EXTRA[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t DISTANCE_BASES[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t DISTANCE_EXTRA[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static void put_match(bit_writer* output, size_t length, size_t distance) {
+    unsigned code = 28;
+    while (LENGTH_BASES[code] > length)
+        -- code;
+
+    put_symbol(output, 257 + code);
+    put_bits(output, (uint32_t) (length - LENGTH_BASES[code]), LENGTH_EXTRA[code]);
+
+    code = 29;
+    while (DISTANCE_BASES[code] > distance)
+        -- code;
+
+    put_code(output, code, 5);
+    put_bits(output, (uint32_t) (distance - DISTANCE_BASES[code]), DISTANCE_EXTRA[code]);
+}
+
+const size_t MIN_MATCH = 3, MAX_MATCH = 258, MAX_DISTANCE = 32768;
+
+static size_t match_length(const uint8_t* data, size_t size, size_t position, size_t distance) {
+    if (distance == 0 || distance > position || distance > MAX_DISTANCE)
+        return 0;
+
+    size_t length = 0;
+    while (length < MAX_MATCH && position + length < size &&
+           data[position + length] == data[position + length - distance])
+        ++ length;
+
+    return length;
+}
+
+// One block with fixed codes, matches are the previous pixel or the row above
+static void deflate_fixed(bit_writer* output, const uint8_t* data, size_t size, size_t row_size) {
+    put_bits(output, 1, 1); // Final block
+    put_bits(output, 1, 2); // Fixed Huffman codes
+
+    for (size_t position = 0; position < size; ) {
+        size_t pixel = match_length(data, size, position, 3),
+               row   = match_length(data, size, position, row_size);
+
+        size_t length = pixel >= row ? pixel : row, distance = pixel >= row ? 3 : row_size;
+
+        if (length < MIN_MATCH) {
+            put_symbol(output, data[position ++]);
+            continue;
+        }
+
+        put_match(output, length, distance);
+        position += length;
+    }
+
+    put_symbol(output, 256); // End of block
+
+    if (output->count > 0)
+        put_bits(output, 0, 8 - output->count);
+}
+
+// --------------------------------- PNG --------------------------------------
+
+stack_trace* png_write_rgb(buffered_writer* writer, const uint8_t* pixels,
+                           size_t width, size_t height) {
+    // Every row starts with filter type, which is always none
+    const size_t row_size = 3 * width + 1, raw_size = height * row_size;
+
+    uint8_t* raw = NULL;
+    TRY safe_calloc(raw_size + 1, &raw)
+        FAIL("Can't allocate %zu x %zu picture!", width, height);
+
+    for (size_t row = 0; row < height; ++ row)
+        memcpy(&raw[row * row_size + 1], &pixels[row * (row_size - 1)], row_size - 1);
+
+    // Literals take at most 9 bits, matches are shorter than what they replace
+    bit_writer deflated = {};
+    TRY safe_calloc(raw_size + raw_size / 8 + 64, &deflated.bytes) CATCH({
+        free(raw);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate deflated picture!");
+    });
+
+    // Deflate with 32K window, no dictionary, header is multiple of 31
+    put_bits(&deflated, 0x78, 8);
+    put_bits(&deflated, 0x01, 8);
+
+    deflate_fixed(&deflated, raw, raw_size, row_size);
+
+    uint32_t adler = png_adler32(1, raw, raw_size);
+    for (int shift = 24; shift >= 0; shift -= 8)
+        put_bits(&deflated, adler >> shift & 0xff, 8);
+
+    free(raw);
+
+    static const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    buffered_writer_write(writer, SIGNATURE, sizeof(SIGNATURE));
+
+    // Width, height, 8 bits per channel, RGB, default compression, filter, no interlace
+    uint8_t header[13] = { 0, 0, 0, 0, 0, 0, 0, 0, 8, 2, 0, 0, 0 };
+    write_big_endian(header,     (uint32_t) width);
+    write_big_endian(header + 4, (uint32_t) height);
+
+    png_chunk chunk = chunk_begin(writer, "IHDR", sizeof(header));
+    chunk_write(&chunk, header, sizeof(header));
+    chunk_end(&chunk);
+
+    chunk = chunk_begin(writer, "IDAT", (uint32_t) deflated.size);
+    chunk_write(&chunk, deflated.bytes, deflated.size);
+    chunk_end(&chunk);
+
+    free(deflated.bytes);
+
+    chunk = chunk_begin(writer, "IEND", 0);
+    chunk_end(&chunk);
+
+    return SUCCESS();
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "graphviz-writer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * CRC-32 of PNG chunks, continue @arg crc of previous data, start with 0
+ */
+uint32_t png_crc32(uint32_t crc, const void* data, size_t size);
+
+/**
+ * Adler-32 of zlib stream, continue @arg adler of previous data, start with 1
+ */
+uint32_t png_adler32(uint32_t adler, const void* data, size_t size);
+
+/**
+ * Write 8 bit RGB picture as PNG. Rows of @arg pixels go from top to
+ * bottom, three bytes per pixel. Data is deflated with fixed Huffman
+ * codes, only repeats of the previous pixel and of the row above are
+ * matched, which is what flat drawings mostly consist of
+ */
+stack_trace* png_write_rgb(buffered_writer* writer, const uint8_t* pixels,
+                           size_t width, size_t height);
@@ -0,0 +1,240 @@
+#include "graphviz-reduce.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphviz-adjacency.h"
+#include "graphviz-parallel.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+const size_t BITSET_WORD_BITS = 64;
+
+static inline bool bitset_test(const uint64_t* bitset, size_t bit) {
+    return (bitset[bit / BITSET_WORD_BITS] >> (bit % BITSET_WORD_BITS)) & 1;
+}
+
+static inline void bitset_set(uint64_t* bitset, size_t bit) {
+    bitset[bit / BITSET_WORD_BITS] |= (uint64_t) 1 << (bit % BITSET_WORD_BITS);
+}
+
+struct reduction {
+    digraph_adjacency adjacency;
+
+    size_t node_count;
+    size_t* dense;     // Dense index of node id, nodes are numbered from zero
+    node_id* ids;      // Node id of dense index
+
+    size_t* order;     // Dense indexes, sorted by height
+    size_t* heights;   // Longest path from node to a sink
+    size_t* level_offsets, level_count;
+
+    size_t words;      // Words in a bitset of a node
+    uint64_t* reachable;
+
+    bool* is_redundant; // For every out edge of adjacency
+};
+
+static void reduction_destroy(reduction* state) {
+    digraph_adjacency_destroy(&state->adjacency);
+
+    free(state->dense);
+    free(state->ids);
+    free(state->order);
+    free(state->heights);
+    free(state->level_offsets);
+    free(state->reachable);
+    free(state->is_redundant);
+
+    *state = {};
+}
+
+static stack_trace* reduction_allocate(reduction* state) {
+    const size_t capacity = state->adjacency.node_capacity;
+    const size_t edge_count = state->adjacency.out_offsets[capacity];
+
+    TRY safe_calloc(capacity, &state->dense)   FAIL("Can't allocate dense indexes!");
+    TRY safe_calloc(capacity, &state->ids)     FAIL("Can't allocate node ids!");
+    TRY safe_calloc(capacity, &state->order)   FAIL("Can't allocate node order!");
+    TRY safe_calloc(capacity, &state->heights) FAIL("Can't allocate node heights!");
+
+    TRY safe_calloc(capacity + 1, &state->level_offsets)
+        FAIL("Can't allocate level offsets!");
+
+    TRY safe_calloc(edge_count + 1, &state->is_redundant)
+        FAIL("Can't allocate edge marks!");
+
+    for (node_id id = 0; (size_t) id < capacity; ++ id)
+        if (digraph_adjacency_has_node(&state->adjacency, id)) {
+            state->ids[state->node_count] = id;
+            state->dense[id] = state->node_count ++;
+        }
+
+    state->words = (state->node_count + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+
+    TRY safe_calloc(state->node_count * state->words + 1, &state->reachable)
+        FAIL("Can't allocate reachability of %zu nodes!", state->node_count);
+
+    return SUCCESS();
+}
+
+/**
+ * Find heights with Kahn's algorithm on reversed edges, going from sinks
+ * up. Then sort nodes by height, nodes of the same height don't depend
+ * on each other.
+ */
+static stack_trace* order_by_height(reduction* state) {
+    digraph_adjacency* adjacency = &state->adjacency;
+
+    // Out degrees are counted down, and sinks go first
+    size_t* queue = state->order;
+    size_t queue_begin = 0, queue_end = 0;
+
+    size_t* pending = state->level_offsets; // Reused before levels are counted
+    for (size_t i = 0; i < state->node_count; ++ i) {
+        const node_id id = state->ids[i];
+        pending[i] = adjacency->out_offsets[id + 1] - adjacency->out_offsets[id];
+
+        if (pending[i] == 0)
+            queue[queue_end ++] = i;
+    }
+
+    while (queue_begin < queue_end) {
+        const size_t current = queue[queue_begin ++];
+        const node_id id = state->ids[current];
+
+        for (size_t i = adjacency->in_offsets[id]; i < adjacency->in_offsets[id + 1]; ++ i) {
+            const size_t parent = state->dense[adjacency->in_edges[i].neighbour];
+
+            if (state->heights[parent] < state->heights[current] + 1)
+                state->heights[parent] = state->heights[current] + 1;
+
+            if (-- pending[parent] == 0)
+                queue[queue_end ++] = parent;
+        }
+    }
+
+    if (queue_end != state->node_count)
+        return FAILURE(RUNTIME_ERROR, "Graph has a cycle, it can't be reduced!");
+
+    // Counting sort by height, it's stable so order stays topological
+    memset(state->level_offsets, 0, (state->node_count + 1) * sizeof(size_t));
+
+    for (size_t i = 0; i < state->node_count; ++ i) {
+        ++ state->level_offsets[state->heights[i] + 1];
+
+        if (state->heights[i] + 1 > state->level_count)
+            state->level_count = state->heights[i] + 1;
+    }
+
+    for (size_t level = 1; level <= state->level_count; ++ level)
+        state->level_offsets[level] += state->level_offsets[level - 1];
+
+    // Queue is topological order from sinks, so it's sorted in place
+    size_t* cursors = NULL;
+    TRY safe_calloc(state->level_count + 1, &cursors)
+        FAIL("Can't allocate level cursors!");
+
+    memcpy(cursors, state->level_offsets, (state->level_count + 1) * sizeof(size_t));
+
+    size_t* sorted = NULL;
+    TRY safe_calloc(state->node_count + 1, &sorted) CATCH({
+        free(cursors);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate sorted nodes!");
+    });
+
+    for (size_t i = 0; i < state->node_count; ++ i)
+        sorted[cursors[state->heights[queue[i]]] ++] = queue[i];
+
+    free(cursors);
+    free(state->order), state->order = sorted;
+
+    return SUCCESS();
+}
+
+struct level_task {
+    reduction* state;
+    size_t level_begin;
+};
+
+/**
+ * Everything reachable from successors of a node is reachable indirectly,
+ * so direct edges to these nodes are redundant
+ */
+static void reduce_nodes(size_t begin, size_t end, void* argument) {
+    level_task* task = (level_task*) argument;
+    reduction* state = task->state;
+    digraph_adjacency* adjacency = &state->adjacency;
+
+    for (size_t i = task->level_begin + begin; i < task->level_begin + end; ++ i) {
+        const size_t current = state->order[i];
+        const node_id id = state->ids[current];
+
+        uint64_t* reachable = state->reachable + current * state->words;
+
+        const size_t first = adjacency->out_offsets[id], last = adjacency->out_offsets[id + 1];
+        for (size_t edge = first; edge < last; ++ edge) {
+            const uint64_t* child = state->reachable +
+                state->dense[adjacency->out_edges[edge].neighbour] * state->words;
+
+            for (size_t word = 0; word < state->words; ++ word)
+                reachable[word] |= child[word];
+        }
+
+        for (size_t edge = first; edge < last; ++ edge)
+            state->is_redundant[edge] = bitset_test(reachable,
+                state->dense[adjacency->out_edges[edge].neighbour]);
+
+        for (size_t edge = first; edge < last; ++ edge)
+            bitset_set(reachable, state->dense[adjacency->out_edges[edge].neighbour]);
+    }
+}
+
+static size_t delete_redundant_edges(digraph* graph, reduction* state) {
+    digraph_adjacency* adjacency = &state->adjacency;
+    size_t removed = 0;
+
+    for (size_t edge = 0; edge < adjacency->out_offsets[adjacency->node_capacity]; ++ edge) {
+        if (!state->is_redundant[edge])
+            continue;
+
+        // Keeps incidence index and extra attributes in sync with edges
+        adjacency_entry* entry = &adjacency->out_edges[edge];
+        subgraph_remove_edge(graph, entry->subgraph, entry->edge);
+
+        ++ removed;
+    }
+
+    return removed;
+}
+
+stack_trace* digraph_transitive_reduce(digraph* graph, size_t* removed) {
+    reduction state = {};
+
+    TRY digraph_adjacency_create(&state.adjacency, graph)
+        FAIL("Can't index edges of the graph!");
+
+    FINALIZER(reduction_destroy, { reduction_destroy(&state); });
+
+    TRY reduction_allocate(&state)
+        FINALIZE_AND_FAIL(reduction_destroy, "Can't allocate reduction state!");
+
+    TRY order_by_height(&state)
+        FINALIZE_AND_FAIL(reduction_destroy, "Can't order nodes!");
+
+    // Levels go from sinks up, each one depends only on the lower ones
+    for (size_t level = 0; level < state.level_count; ++ level) {
+        level_task task = { .state = &state, .level_begin = state.level_offsets[level] };
+
+        graphviz_parallel_for(state.level_offsets[level + 1] - state.level_offsets[level],
+                              reduce_nodes, &task);
+    }
+
+    size_t removed_edges = delete_redundant_edges(graph, &state);
+    if (removed != NULL)
+        *removed = removed_edges;
+
+    CALL_FINALIZER(reduction_destroy);
+    return SUCCESS();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "graphviz.h"
+#include "trace.h"
+
+#include <stddef.h>
+
+/**
+ * Delete every edge a -> c of @arg graph, if c is reachable from a by
+ * some other path, reachability between nodes doesn't change. Graph
+ * should be acyclic, otherwise it's left as is and failure is returned.
+ *
+ * Reachability is kept as a bitset per node, so memory grows with the
+ * square of node count. Nodes, that are equally far from sinks, are
+ * processed concurrently.
+ *
+ * @arg removed is set to the number of deleted edges, if not NULL
+ */
+stack_trace* digraph_transitive_reduce(digraph* graph, size_t* removed = NULL);
@@ -0,0 +1,603 @@
+#include "graphviz-routing.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphviz-parallel.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+// --------------------------------- GRID -------------------------------------
+
+// Grid has at most so many cells per box, so few big boxes don't blow it up
+const size_t GRID_CELLS_PER_BOX = 4;
+
+static size_t grid_column(const spatial_grid* grid, double x) {
+    double column = floor((x - grid->bounds.left) / grid->cell_size);
+
+    if (column < 0) return 0;
+    return column >= (double) grid->columns ? grid->columns - 1 : (size_t) column;
+}
+
+static size_t grid_row(const spatial_grid* grid, double y) {
+    double row = floor((y - grid->bounds.bottom) / grid->cell_size);
+
+    if (row < 0) return 0;
+    return row >= (double) grid->rows ? grid->rows - 1 : (size_t) row;
+}
+
+static void choose_cells(spatial_grid* grid) {
+    double width  = grid->bounds.right - grid->bounds.left,
+           height = grid->bounds.top   - grid->bounds.bottom;
+
+    double average = 0;
+    for (size_t i = 0; i < grid->box_count; ++ i) {
+        const layout_box* box = &grid->boxes[i];
+        average += fmax(box->right - box->left, box->top - box->bottom);
+    }
+
+    average /= (double) grid->box_count;
+
+    double cell_size = 2 * average;
+
+    // Sparse layouts with small boxes would get too many empty cells
+    double min_size = sqrt(width * height / (double) (GRID_CELLS_PER_BOX * grid->box_count));
+    if (cell_size < min_size)
+        cell_size = min_size;
+
+    if (!(cell_size > 0))
+        cell_size = fmax(fmax(width, height), 1.0);
+
+    grid->cell_size = cell_size;
+    grid->columns   = (size_t) (width  / cell_size) + 1;
+    grid->rows      = (size_t) (height / cell_size) + 1;
+}
+
+stack_trace* spatial_grid_create(spatial_grid* grid, const layout_box* boxes, size_t count) {
+    *grid = { .boxes = boxes, .box_count = count };
+
+    if (count > UINT32_MAX)
+        return FAILURE(RUNTIME_ERROR, "Can't index %zu boxes!", count);
+
+    if (count > 0) {
+        grid->bounds = boxes[0];
+
+        for (size_t i = 1; i < count; ++ i) {
+            grid->bounds.left   = fmin(grid->bounds.left,   boxes[i].left);
+            grid->bounds.bottom = fmin(grid->bounds.bottom, boxes[i].bottom);
+            grid->bounds.right  = fmax(grid->bounds.right,  boxes[i].right);
+            grid->bounds.top    = fmax(grid->bounds.top,    boxes[i].top);
+        }
+
+        choose_cells(grid);
+    } else
+        grid->cell_size = 1, grid->columns = grid->rows = 1;
+
+    const size_t cell_count = grid->columns * grid->rows;
+
+    TRY safe_calloc(cell_count + 1, &grid->cell_starts)
+        FAIL("Can't allocate %zu cells!", cell_count);
+
+    // Count boxes of every cell, then turn counts into starts
+    for (size_t i = 0; i < count; ++ i)
+        for (size_t row = grid_row(grid, boxes[i].bottom); row <= grid_row(grid, boxes[i].top); ++ row)
+            for (size_t column = grid_column(grid, boxes[i].left);
+                 column <= grid_column(grid, boxes[i].right); ++ column)
+                ++ grid->cell_starts[row * grid->columns + column + 1];
+
+    for (size_t i = 0; i < cell_count; ++ i)
+        grid->cell_starts[i + 1] += grid->cell_starts[i];
+
+    size_t* filled = NULL;
+    TRY safe_calloc(cell_count, &filled) CATCH({
+        spatial_grid_destroy(grid);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate %zu cells!", cell_count);
+    });
+
+    TRY safe_calloc(grid->cell_starts[cell_count] + 1, &grid->items) CATCH({
+        free(filled);
+        spatial_grid_destroy(grid);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate grid's items!");
+    });
+
+    for (size_t i = 0; i < count; ++ i)
+        for (size_t row = grid_row(grid, boxes[i].bottom); row <= grid_row(grid, boxes[i].top); ++ row)
+            for (size_t column = grid_column(grid, boxes[i].left);
+                 column <= grid_column(grid, boxes[i].right); ++ column) {
+                size_t cell = row * grid->columns + column;
+                grid->items[grid->cell_starts[cell] + filled[cell] ++] = (uint32_t) i;
+            }
+
+    free(filled);
+    return SUCCESS();
+}
+
+void spatial_grid_destroy(spatial_grid* grid) {
+    free(grid->cell_starts);
+    free(grid->items);
+
+    *grid = {};
+}
+
+void spatial_grid_query(const spatial_grid* grid, layout_box area,
+                        bool (*visit)(size_t box, void* argument), void* argument) {
+    if (grid->box_count == 0 || !layout_box_overlaps(&grid->bounds, &area))
+        return;
+
+    const size_t first_column = grid_column(grid, area.left),
+                 first_row    = grid_row   (grid, area.bottom);
+
+    for (size_t row = first_row; row <= grid_row(grid, area.top); ++ row)
+        for (size_t column = first_column; column <= grid_column(grid, area.right); ++ column) {
+            size_t cell = row * grid->columns + column;
+
+            for (size_t i = grid->cell_starts[cell]; i < grid->cell_starts[cell + 1]; ++ i) {
+                const layout_box* box = &grid->boxes[grid->items[i]];
+                if (!layout_box_overlaps(box, &area))
+                    continue;
+
+                // Box is reported only from the cell, where it's overlap with area starts
+                size_t box_column = grid_column(grid, box->left), box_row = grid_row(grid, box->bottom);
+                if (column != (box_column > first_column ? box_column : first_column) ||
+                    row    != (box_row    > first_row    ? box_row    : first_row))
+                    continue;
+
+                if (!visit(grid->items[i], argument))
+                    return;
+            }
+        }
+}
+
+// -------------------------------- ROUTING -----------------------------------
+
+// Edges, that are routed by one task into one buffer
+const size_t ROUTE_BLOCK_EDGES = 1024;
+
+/** Routes of one block of edges, in order */
+struct route_block {
+    layout_point* points;
+    size_t point_count, point_capacity;
+
+    bool failed;
+};
+
+struct router {
+    graph_layout* layout;
+    routing_options options;
+
+    // Node boxes inflated by half of margin, route shouldn't cross them
+    layout_box* obstacles;
+    spatial_grid grid;
+
+    route_block* blocks;
+    size_t block_count;
+};
+
+static layout_point point_between(layout_point from, layout_point to, double t) {
+    return { .x = from.x + (to.x - from.x) * t, .y = from.y + (to.y - from.y) * t };
+}
+
+static double distance(layout_point first, layout_point second) {
+    return hypot(second.x - first.x, second.y - first.y);
+}
+
+// Clip parameter range of segment to slab [low, high] of one axis
+static bool clip_to_slab(double start, double delta, double low, double high,
+                         double* enter, double* exit) {
+    if (delta == 0)
+        return start > low && start < high;
+
+    double t_low = (low - start) / delta, t_high = (high - start) / delta;
+    if (t_low > t_high) {
+        double swapped = t_low;
+        t_low = t_high, t_high = swapped;
+    }
+
+    *enter = fmax(*enter, t_low);
+    *exit  = fmin(*exit,  t_high);
+
+    return *enter < *exit;
+}
+
+// Clip segment to the box, @return false if it passes by
+static bool clip_segment(layout_point from, layout_point to, const layout_box* box,
+                         double* enter, double* exit) {
+    return clip_to_slab(from.x, to.x - from.x, box->left,   box->right, enter, exit) &&
+           clip_to_slab(from.y, to.y - from.y, box->bottom, box->top,   enter, exit);
+}
+
+/** Closest obstacle, that blocks a segment */
+struct segment_hit {
+    size_t obstacle;
+    double distance; // Fraction of segment before obstacle
+};
+
+// Obstacles, that contain one of segment's ends, can't be avoided and are skipped
+static void hit_obstacles_of_cell(router* routing, size_t cell, layout_point from, layout_point to,
+                                  size_t source, size_t target, segment_hit* hit) {
+    const spatial_grid* grid = &routing->grid;
+
+    for (size_t i = grid->cell_starts[cell]; i < grid->cell_starts[cell + 1]; ++ i) {
+        size_t obstacle = grid->items[i];
+        if (obstacle == source || obstacle == target)
+            continue;
+
+        const layout_box* box = &routing->obstacles[obstacle];
+
+        double enter = 0, exit = 1;
+        if (!clip_segment(from, to, box, &enter, &exit) || enter <= 0 ||
+            layout_box_contains(box, to))
+            continue;
+
+        if (enter < hit->distance)
+            *hit = { .obstacle = obstacle, .distance = enter };
+    }
+}
+
+/**
+ * Walk cells, that segment crosses, in order, until obstacle is found
+ * in a cell, which ends before next cell begins
+ */
+static bool find_obstacle(router* routing, layout_point from, layout_point to,
+                          size_t source, size_t target, size_t* obstacle) {
+    const spatial_grid* grid = &routing->grid;
+
+    double start = 0, end = 1;
+    if (grid->box_count == 0 || !clip_segment(from, to, &grid->bounds, &start, &end))
+        return false;
+
+    const double delta_x = to.x - from.x, delta_y = to.y - from.y;
+    layout_point entry = point_between(from, to, start);
+
+    size_t column = grid_column(grid, entry.x), row = grid_row(grid, entry.y);
+
+    // Segment's parameter at the next cell border and per whole cell
+    double next_x = INFINITY, step_x = INFINITY, next_y = INFINITY, step_y = INFINITY;
+
+    if (delta_x != 0) {
+        double border = grid->bounds.left + (double) (column + (delta_x > 0)) * grid->cell_size;
+        next_x = (border - from.x) / delta_x, step_x = grid->cell_size / fabs(delta_x);
+    }
+
+    if (delta_y != 0) {
+        double border = grid->bounds.bottom + (double) (row + (delta_y > 0)) * grid->cell_size;
+        next_y = (border - from.y) / delta_y, step_y = grid->cell_size / fabs(delta_y);
+    }
+
+    segment_hit hit = { .obstacle = 0, .distance = INFINITY };
+
+    while (true) {
+        hit_obstacles_of_cell(routing, row * grid->columns + column, from, to,
+                              source, target, &hit);
+
+        double cell_exit = fmin(next_x, next_y);
+        if (hit.distance <= cell_exit || cell_exit >= end)
+            break;
+
+        if (next_x < next_y) {
+            if (delta_x > 0 ? column + 1 == grid->columns : column == 0)
+                break;
+
+            column += delta_x > 0 ? 1 : -1, next_x += step_x;
+        } else {
+            if (delta_y > 0 ? row + 1 == grid->rows : row == 0)
+                break;
+
+            row += delta_y > 0 ? 1 : -1, next_y += step_y;
+        }
+    }
+
+    *obstacle = hit.obstacle;
+    return hit.distance != INFINITY;
+}
+
+static double cross(layout_point origin, layout_point first, layout_point second) {
+    return (first.x - origin.x) * (second.y - origin.y) -
+           (first.y - origin.y) * (second.x - origin.x);
+}
+
+/**
+ * Corners of box, that lie on one side of the segment, in order they
+ * are passed going from it's start to it's end
+ *
+ * @return number of corners, zero if there are none
+ */
+static size_t side_corners(const layout_point corners[4], layout_point from, layout_point to,
+                           bool left_side, layout_point* chain) {
+    bool on_side[4] = {};
+    for (size_t i = 0; i < 4; ++ i)
+        on_side[i] = (cross(from, to, corners[i]) > 0) == left_side;
+
+    // Corners of convex box on one side of a line are neighbours
+    size_t first = 4;
+    for (size_t i = 0; i < 4; ++ i)
+        if (on_side[i] && !on_side[(i + 3) % 4])
+            first = i;
+
+    if (first == 4)
+        return 0;
+
+    size_t count = 0;
+    for (size_t i = first; on_side[i % 4] && count < 4; ++ i)
+        chain[count ++] = corners[i % 4];
+
+    const double delta_x = to.x - from.x, delta_y = to.y - from.y;
+
+    double first_projection = (chain[0].x - from.x) * delta_x + (chain[0].y - from.y) * delta_y,
+           last_projection  = (chain[count - 1].x - from.x) * delta_x +
+                              (chain[count - 1].y - from.y) * delta_y;
+
+    if (first_projection > last_projection)
+        for (size_t i = 0; i < count / 2; ++ i) {
+            layout_point swapped = chain[i];
+            chain[i] = chain[count - 1 - i], chain[count - 1 - i] = swapped;
+        }
+
+    return count;
+}
+
+static double chain_length(layout_point from, const layout_point* chain, size_t count,
+                           layout_point to) {
+    double length = distance(from, chain[0]) + distance(chain[count - 1], to);
+
+    for (size_t i = 0; i + 1 < count; ++ i)
+        length += distance(chain[i], chain[i + 1]);
+
+    return length;
+}
+
+/**
+ * Choose corners, that lead around node's box on the shorter side
+ *
+ * @return number of corners, zero if box can't be passed
+ */
+static size_t detour(router* routing, size_t obstacle, layout_point from, layout_point to,
+                     layout_point* chain) {
+    const layout_box box = layout_box_inflate(&routing->layout->nodes[obstacle].box,
+                                              routing->options.margin);
+
+    const layout_point corners[4] = {
+        { box.left, box.bottom }, { box.right, box.bottom },
+        { box.right, box.top   }, { box.left,  box.top    }
+    };
+
+    layout_point left[4] = {}, right[4] = {};
+
+    size_t left_count  = side_corners(corners, from, to, true,  left);
+    size_t right_count = side_corners(corners, from, to, false, right);
+
+    if (left_count == 0 || right_count == 0)
+        return 0;
+
+    const bool is_left_shorter = chain_length(from, left,  left_count,  to) <=
+                                 chain_length(from, right, right_count, to);
+
+    memcpy(chain, is_left_shorter ? left : right,
+           (is_left_shorter ? left_count : right_count) * sizeof(*chain));
+
+    return is_left_shorter ? left_count : right_count;
+}
+
+// Move route's end from inside of the box to it's border
+static layout_point clip_to_border(const layout_box* box, layout_point inside, layout_point outside) {
+    double enter = 0, exit = 1;
+    clip_segment(inside, outside, box, &enter, &exit);
+
+    return point_between(inside, outside, exit);
+}
+
+static size_t route_loop(router* routing, const layout_box* box, layout_point* route) {
+    const double height = box->top - box->bottom,
+                 size   = fmax(2 * routing->options.margin, height / 2);
+
+    const double upper = box->top - height / 4, lower = box->bottom + height / 4;
+
+    route[0] = { box->right,        upper };
+    route[1] = { box->right + size, upper };
+    route[2] = { box->right + size, lower };
+    route[3] = { box->right,        lower };
+
+    return 4;
+}
+
+/**
+ * Route edge between nodes in slots @arg source and @arg target
+ *
+ * @return number of points in @arg route
+ */
+static size_t route_edge(router* routing, size_t source, size_t target, layout_point* route) {
+    const layout_box *source_box = &routing->layout->nodes[source].box,
+                     *target_box = &routing->layout->nodes[target].box;
+
+    if (source == target)
+        return route_loop(routing, source_box, route);
+
+    size_t count = 2, detours = 0;
+    route[0] = layout_box_center(source_box), route[1] = layout_box_center(target_box);
+
+    for (size_t i = 0; i + 1 < count; ) {
+        size_t obstacle = 0;
+
+        if (detours == routing->options.max_detours ||
+            !find_obstacle(routing, route[i], route[i + 1], source, target, &obstacle)) {
+            ++ i;
+            continue;
+        }
+
+        layout_point chain[4] = {};
+        size_t corners = detour(routing, obstacle, route[i], route[i + 1], chain);
+
+        if (corners == 0) {
+            ++ i;
+            continue;
+        }
+
+        // New segments are checked again, starting from this one
+        memmove(&route[i + 1 + corners], &route[i + 1], (count - i - 1) * sizeof(*route));
+        memcpy(&route[i + 1], chain, corners * sizeof(*route));
+
+        count += corners, ++ detours;
+    }
+
+    if (!layout_box_contains(source_box, route[1]))
+        route[0] = clip_to_border(source_box, route[0], route[1]);
+
+    if (!layout_box_contains(target_box, route[count - 2]))
+        route[count - 1] = clip_to_border(target_box, route[count - 1], route[count - 2]);
+
+    return count;
+}
+
+// Every detour adds at most three corners
+static size_t max_route_points(const routing_options* options) {
+    return 2 + 3 * options->max_detours + 2;
+}
+
+static stack_trace* route_block_edges(router* routing, size_t block) {
+    graph_layout* layout = routing->layout;
+    route_block* output = &routing->blocks[block];
+
+    const size_t first = block * ROUTE_BLOCK_EDGES,
+                 last  = first + ROUTE_BLOCK_EDGES < layout->edge_count ?
+                         first + ROUTE_BLOCK_EDGES : layout->edge_count;
+
+    const size_t max_points = max_route_points(&routing->options);
+
+    for (size_t i = first; i < last; ++ i) {
+        layout_edge* current = &layout->edges[i];
+        current->first_point = output->point_count, current->point_count = 0;
+
+        const size_t source = layout->slots[current->from], target = layout->slots[current->to];
+
+        if (output->point_count + max_points > output->point_capacity) {
+            size_t new_capacity = 2 * output->point_capacity + max_points;
+
+            layout_point* grown = (layout_point*)
+                realloc(output->points, new_capacity * sizeof(layout_point));
+
+            if (grown == NULL)
+                return FAILURE(RUNTIME_ERROR, "Can't grow routes to %zu points!", new_capacity);
+
+            output->points = grown, output->point_capacity = new_capacity;
+        }
+
+        current->point_count = route_edge(routing, source, target,
+                                          &output->points[output->point_count]);
+
+        output->point_count += current->point_count;
+    }
+
+    return SUCCESS();
+}
+
+static void route_blocks(size_t begin, size_t end, void* argument) {
+    router* routing = (router*) argument;
+
+    for (size_t block = begin; block < end; ++ block) {
+        stack_trace* result = route_block_edges(routing, block);
+
+        routing->blocks[block].failed = !trace_is_success(result);
+        trace_destruct(result);
+    }
+}
+
+static void router_destroy(router* routing) {
+    spatial_grid_destroy(&routing->grid);
+    free(routing->obstacles);
+
+    for (size_t i = 0; i < routing->block_count; ++ i)
+        free(routing->blocks[i].points);
+
+    free(routing->blocks);
+
+    *routing = {};
+}
+
+static stack_trace* router_create(router* routing, graph_layout* layout, routing_options options) {
+    *routing = { .layout = layout, .options = options };
+
+    const size_t node_count = layout->node_count;
+
+    TRY safe_calloc(node_count + 1, &routing->obstacles)
+        FAIL("Can't allocate %zu obstacles!", node_count);
+
+    for (size_t i = 0; i < node_count; ++ i)
+        routing->obstacles[i] = layout_box_inflate(&layout->nodes[i].box, options.margin / 2);
+
+    TRY spatial_grid_create(&routing->grid, routing->obstacles, node_count) CATCH({
+        router_destroy(routing);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to index %zu nodes!", node_count);
+    });
+
+    routing->block_count = (layout->edge_count + ROUTE_BLOCK_EDGES - 1) / ROUTE_BLOCK_EDGES;
+
+    TRY safe_calloc(routing->block_count + 1, &routing->blocks) CATCH({
+        router_destroy(routing);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate %zu blocks!",
+                            routing->block_count);
+    });
+
+    return SUCCESS();
+}
+
+// Gather routes of blocks in one array, so they follow edges' order
+static stack_trace* gather_routes(router* routing) {
+    graph_layout* layout = routing->layout;
+
+    size_t total = 0;
+    for (size_t i = 0; i < routing->block_count; ++ i) {
+        if (routing->blocks[i].failed)
+            return FAILURE(RUNTIME_ERROR, "Failed to route block %zu!", i);
+
+        total += routing->blocks[i].point_count;
+    }
+
+    layout_point* points = NULL;
+    TRY safe_calloc(total + 1, &points)
+        FAIL("Can't allocate %zu route points!", total);
+
+    size_t offset = 0;
+    for (size_t block = 0; block < routing->block_count; ++ block) {
+        route_block* current = &routing->blocks[block];
+
+        size_t first = block * ROUTE_BLOCK_EDGES,
+               last  = first + ROUTE_BLOCK_EDGES < layout->edge_count ?
+                       first + ROUTE_BLOCK_EDGES : layout->edge_count;
+
+        for (size_t i = first; i < last; ++ i)
+            layout->edges[i].first_point += offset;
+
+        memcpy(&points[offset], current->points, current->point_count * sizeof(*points));
+        offset += current->point_count;
+    }
+
+    free(layout->points);
+    layout->points = points, layout->point_count = total;
+
+    return SUCCESS();
+}
+
+stack_trace* graph_layout_route_edges(graph_layout* layout, routing_options options) {
+    if (!(options.margin >= 0))
+        return FAILURE(RUNTIME_ERROR, "Margin %g is not valid!", options.margin);
+
+    router routing = {};
+    TRY router_create(&routing, layout, options)
+        FAIL("Failed to prepare routing of %zu edges!", layout->edge_count);
+
+    graphviz_parallel_for(routing.block_count, route_blocks, &routing);
+
+    TRY gather_routes(&routing) CATCH({
+        // Routes of blocks are lost, so edges are left unrouted
+        for (size_t i = 0; i < layout->edge_count; ++ i)
+            layout->edges[i].first_point = layout->edges[i].point_count = 0;
+
+        router_destroy(&routing);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to route %zu edges!",
+                            layout->edge_count);
+    });
+
+    router_destroy(&routing);
+    return SUCCESS();
+}
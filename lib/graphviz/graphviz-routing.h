@@ -0,0 +1,54 @@
+#pragma once
+
+#include "graphviz-layout.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Uniform grid over boxes, every cell lists boxes, that overlap it.
+ * Boxes are borrowed, they should outlive the grid and stay in place
+ */
+struct spatial_grid {
+    const layout_box* boxes;
+    size_t box_count;
+
+    layout_box bounds; // Box around every indexed box
+    double cell_size;
+    size_t columns, rows;
+
+    size_t* cell_starts; // Boxes of cell i are items [starts[i], starts[i + 1])
+    uint32_t* items;
+};
+
+/**
+ * Index @arg count boxes, cells are about twice the size of average box
+ */
+stack_trace* spatial_grid_create(spatial_grid* grid, const layout_box* boxes, size_t count);
+
+void spatial_grid_destroy(spatial_grid* grid);
+
+/**
+ * Call @arg visit once for every box, that overlaps @arg area, with it's
+ * index. Search stops, when @arg visit returns false
+ */
+void spatial_grid_query(const spatial_grid* grid, layout_box area,
+                        bool (*visit)(size_t box, void* argument), void* argument);
+
+struct routing_options {
+    double margin; // Routes keep this far from boxes of other nodes
+
+    size_t max_detours; // Per edge, routes stay straight after them
+};
+
+const routing_options ROUTING_DEFAULT = { .margin = 6, .max_detours = 16 };
+
+/**
+ * Route every edge of @arg layout as a polyline, that goes around boxes
+ * of other nodes, old routes are replaced. Blocking box is passed by
+ * it's corners on the shorter side, then new segments are checked again.
+ * Edges are routed concurrently, in blocks, routes keep edges' order
+ */
+stack_trace* graph_layout_route_edges(graph_layout* layout,
+                                      routing_options options = ROUTING_DEFAULT);
@@ -0,0 +1,513 @@
+#include "graphviz-shared.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hash-table.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+// How much region grows when it runs out of space
+const double SHARED_REGION_GROW = 2.0;
+
+// Every record and label starts at this alignment
+const size_t SHARED_ALIGNMENT = 8;
+
+static shared_digraph_header* header(shared_digraph* graph) {
+    return (shared_digraph_header*) graph->region;
+}
+
+static stack_trace* map_region(shared_digraph* graph, size_t capacity) {
+    if (ftruncate(graph->fd, (off_t) capacity) == -1)
+        return FAILURE(RUNTIME_ERROR, "Failed to resize region to %zu bytes: %s",
+                       capacity, strerror(errno));
+
+    void* new_region = graph->region == NULL ?
+        mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, graph->fd, 0) :
+        mremap(graph->region, graph->capacity, capacity, MREMAP_MAYMOVE);
+
+    if (new_region == MAP_FAILED)
+        return FAILURE(RUNTIME_ERROR, "Failed to map %zu bytes: %s",
+                       capacity, strerror(errno));
+
+    graph->region   = (char*) new_region;
+    graph->capacity = capacity;
+
+    return SUCCESS();
+}
+
+stack_trace* shared_digraph_create(shared_digraph* graph, const char* name, size_t capacity) {
+    *graph = { .fd = -1 };
+
+    if (capacity < sizeof(shared_digraph_header))
+        capacity = sizeof(shared_digraph_header);
+
+    graph->fd = memfd_create(name, MFD_CLOEXEC);
+    if (graph->fd == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't create shared region: %s", strerror(errno));
+
+    TRY map_region(graph, capacity) CATCH({
+        close(graph->fd); graph->fd = -1;
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't map shared region!");
+    });
+
+    // Region is zero filled, so only magic and size are set
+    memcpy(header(graph)->magic, SHARED_DIGRAPH_MAGIC, sizeof(SHARED_DIGRAPH_MAGIC));
+
+    graph->used = sizeof(shared_digraph_header);
+    shared_digraph_publish(graph);
+
+    return SUCCESS();
+}
+
+stack_trace* shared_digraph_destroy(shared_digraph* graph) {
+    bool is_unmapped = graph->region == NULL || munmap(graph->region, graph->capacity) == 0;
+    bool is_closed   = graph->fd == -1       || close(graph->fd) == 0;
+
+    *graph = { .fd = -1 };
+
+    if (!is_unmapped || !is_closed)
+        return FAILURE(RUNTIME_ERROR, "Failed to release shared region: %s", strerror(errno));
+
+    return SUCCESS();
+}
+
+// @return offset of @arg size new bytes in region
+static uint64_t allocate(shared_digraph* graph, size_t size) {
+    const size_t start = (graph->used + SHARED_ALIGNMENT - 1) & ~(SHARED_ALIGNMENT - 1);
+
+    if (start + size > graph->capacity) {
+        size_t new_capacity = graph->capacity;
+        while (new_capacity < start + size)
+            new_capacity = (size_t) ((double) new_capacity * SHARED_REGION_GROW);
+
+        TRY map_region(graph, new_capacity)
+            THROW("Failed to grow shared region to %zu bytes!", new_capacity);
+    }
+
+    graph->used = start + size;
+    return start;
+}
+
+// @return offset of record @arg index, new block is allocated if it's first in block
+static uint64_t allocate_record(shared_digraph* graph, uint64_t* blocks,
+                                uint64_t index, size_t record_size) {
+    const uint64_t block = 63 - (uint64_t) __builtin_clzll(index / SHARED_FIRST_BLOCK + 1);
+
+    // Blocks are passed as offset in header, because allocation can move region
+    const size_t blocks_offset = (size_t) ((char*) blocks - graph->region);
+
+    if (index == SHARED_FIRST_BLOCK * ((1ull << block) - 1)) {
+        uint64_t new_block = allocate(graph, record_size * (SHARED_FIRST_BLOCK << block));
+
+        blocks = (uint64_t*) (graph->region + blocks_offset);
+        __atomic_store_n(&blocks[block], new_block, __ATOMIC_RELAXED);
+    }
+
+    blocks = (uint64_t*) (graph->region + blocks_offset);
+    return __shared_record_offset(blocks, index, record_size);
+}
+
+uint32_t shared_digraph_create_subgraph(shared_digraph* graph, graphviz_rank_type rank) {
+    const uint64_t offset = allocate_record(graph, header(graph)->subgraph_blocks,
+                                            graph->subgraph_count, sizeof(shared_subgraph));
+
+    *(shared_subgraph*) (graph->region + offset) = { .rank = (uint32_t) rank };
+    return (uint32_t) graph->subgraph_count ++;
+}
+
+// Format label right into the region, without intermediate buffer. Without
+// format label of default element is kept, like in vedge_from_default
+static uint64_t vappend_label(shared_digraph* graph, const char* default_label,
+                              const char* format, va_list args) {
+    const size_t label_size = vlabel_size(default_label, format, args);
+
+    uint64_t label = allocate(graph, label_size);
+    vformat_label(graph->region + label, label_size, default_label, format, args);
+
+    return label;
+}
+
+node_id shared_digraph_insert_default_node(shared_digraph* graph, uint32_t subgraph,
+                                           node default_node, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    shared_node new_node = {
+        .subgraph = subgraph,
+        .style = (uint8_t) default_node.style,
+        .color = (uint8_t) default_node.color,
+        .shape = (uint8_t) default_node.shape,
+        .label = vappend_label(graph, default_node.label, format, args)
+    };
+
+    va_end(args);
+
+    const uint64_t offset = allocate_record(graph, header(graph)->node_blocks,
+                                            graph->node_count, sizeof(shared_node));
+
+    *(shared_node*) (graph->region + offset) = new_node;
+    return (node_id) graph->node_count ++;
+}
+
+void shared_digraph_insert_default_edge(shared_digraph* graph, uint32_t subgraph,
+                                        edge default_edge, node_id from, node_id to,
+                                        const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    shared_edge new_edge = {
+        .from = (uint32_t) from, .to = (uint32_t) to,
+        .subgraph = subgraph,
+        .color = (uint8_t) default_edge.color,
+        .style = (uint8_t) default_edge.style,
+        .weight = default_edge.weight,
+        .label = vappend_label(graph, default_edge.label, format, args)
+    };
+
+    va_end(args);
+
+    const uint64_t offset = allocate_record(graph, header(graph)->edge_blocks,
+                                            graph->edge_count, sizeof(shared_edge));
+
+    *(shared_edge*) (graph->region + offset) = new_edge;
+    ++ graph->edge_count;
+}
+
+void shared_digraph_publish(shared_digraph* graph, bool is_complete) {
+    shared_digraph_header* shared = header(graph);
+
+    const uint64_t sequence = __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED);
+
+    // Odd sequence tells consumers that counts are being written
+    __atomic_store_n(&shared->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&shared->size,           (uint64_t) graph->used,  __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->subgraph_count, graph->subgraph_count,   __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->node_count,     graph->node_count,       __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->edge_count,     graph->edge_count,       __ATOMIC_RELAXED);
+    __atomic_store_n(&shared->is_complete,    (uint64_t) is_complete,  __ATOMIC_RELAXED);
+
+    // Records and counts become visible together with even sequence
+    __atomic_store_n(&shared->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+stack_trace* shared_digraph_send(int socket, shared_digraph* graph) {
+    char byte = 0;
+    iovec payload = { .iov_base = &byte, .iov_len = sizeof(byte) };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+    msghdr message = {
+        .msg_iov = &payload, .msg_iovlen = 1,
+        .msg_control = control, .msg_controllen = sizeof(control)
+    };
+
+    cmsghdr* rights = CMSG_FIRSTHDR(&message);
+    rights->cmsg_level = SOL_SOCKET;
+    rights->cmsg_type  = SCM_RIGHTS;
+    rights->cmsg_len   = CMSG_LEN(sizeof(int));
+
+    memcpy(CMSG_DATA(rights), &graph->fd, sizeof(int));
+
+    if (sendmsg(socket, &message, MSG_NOSIGNAL) == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't send shared region: %s", strerror(errno));
+
+    return SUCCESS();
+}
+
+stack_trace* shared_digraph_receive(int socket, int* fd) {
+    char byte = 0;
+    iovec payload = { .iov_base = &byte, .iov_len = sizeof(byte) };
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+    msghdr message = {
+        .msg_iov = &payload, .msg_iovlen = 1,
+        .msg_control = control, .msg_controllen = sizeof(control)
+    };
+
+    if (recvmsg(socket, &message, MSG_CMSG_CLOEXEC) <= 0)
+        return FAILURE(RUNTIME_ERROR, "Can't receive shared region: %s", strerror(errno));
+
+    cmsghdr* rights = CMSG_FIRSTHDR(&message);
+    if (rights == NULL || rights->cmsg_type != SCM_RIGHTS)
+        return FAILURE(RUNTIME_ERROR, "Message doesn't carry a descriptor!");
+
+    memcpy(fd, CMSG_DATA(rights), sizeof(int));
+    return SUCCESS();
+}
+
+// ---------------------------------- VIEW -----------------------------------
+
+stack_trace* shared_digraph_view_open(shared_digraph_view* view, int fd) {
+    *view = { .fd = fd };
+
+    struct stat region_stats;
+    if (fstat(fd, &region_stats) == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't get size of shared region: %s", strerror(errno));
+
+    const size_t size = (size_t) region_stats.st_size;
+    if (size < sizeof(shared_digraph_header))
+        return FAILURE(RUNTIME_ERROR, "Shared region is too small for a graph!");
+
+    void* region = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (region == MAP_FAILED)
+        return FAILURE(RUNTIME_ERROR, "Can't map shared region: %s", strerror(errno));
+
+    view->region = (const char*) region, view->mapped = size;
+
+    if (memcmp(shared_digraph_view_header(view)->magic, SHARED_DIGRAPH_MAGIC,
+               sizeof(SHARED_DIGRAPH_MAGIC)) != 0) {
+        trace_destruct(shared_digraph_view_close(view));
+        return FAILURE(RUNTIME_ERROR, "Region doesn't hold a shared graph!");
+    }
+
+    TRY shared_digraph_view_refresh(view) CATCH({
+        trace_destruct(shared_digraph_view_close(view));
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't read shared graph!");
+    });
+
+    return SUCCESS();
+}
+
+// Records below @arg count are aligned, and lie in the first @arg size bytes of region
+static bool are_blocks_valid(const uint64_t* blocks, uint64_t count,
+                             size_t record_size, uint64_t size) {
+    uint64_t first = 0;
+    for (size_t block = 0; block < SHARED_BLOCK_COUNT && first < count; ++ block) {
+        const uint64_t records = SHARED_FIRST_BLOCK << block;
+        const uint64_t used = count - first < records ? count - first : records;
+
+        if (blocks[block] % SHARED_ALIGNMENT != 0 || blocks[block] < sizeof(shared_digraph_header) ||
+            blocks[block] > size || used > (size - blocks[block]) / record_size)
+            return false;
+
+        first += records;
+    }
+
+    return first >= count;
+}
+
+// Label starts after header and is null terminated before @arg size
+static bool is_label_valid(shared_digraph_view* view, uint64_t label, uint64_t size) {
+    return label >= sizeof(shared_digraph_header) && label < size &&
+           memchr(view->region + label, '\0', size - label) != NULL;
+}
+
+// Records, that became published since last snapshot, refer only to published
+// records, to existing styles and to labels inside @arg size bytes. Published
+// records never change, so older records aren't checked again
+static bool are_new_records_valid(shared_digraph_view* view, uint64_t size,
+                                  uint64_t subgraph_count, uint64_t node_count,
+                                  uint64_t edge_count) {
+    const shared_digraph_header* shared = shared_digraph_view_header(view);
+
+    if (!are_blocks_valid(shared->subgraph_blocks, subgraph_count, sizeof(shared_subgraph), size) ||
+        !are_blocks_valid(shared->node_blocks,     node_count,     sizeof(shared_node),     size) ||
+        !are_blocks_valid(shared->edge_blocks,     edge_count,     sizeof(shared_edge),     size))
+        return false;
+
+    // Subgraphs are addressed by 32-bit ids, and node ids are printed as ints
+    if (subgraph_count > UINT32_MAX || node_count > (uint64_t) INT_MAX + 1)
+        return false;
+
+    for (uint64_t i = view->node_count; i < node_count; ++ i) {
+        const shared_node* current_node = shared_digraph_view_node(view, (node_id) i);
+
+        if (current_node->subgraph >= subgraph_count ||
+            hash_table_lookup(&graphviz_node_shapes, (int) current_node->shape) == NULL ||
+            hash_table_lookup(&graphviz_colors,      (int) current_node->color) == NULL ||
+            hash_table_lookup(&graphviz_styles,      (int) current_node->style) == NULL ||
+            !is_label_valid(view, current_node->label, size))
+            return false;
+    }
+
+    for (uint64_t i = view->edge_count; i < edge_count; ++ i) {
+        const shared_edge* current_edge = shared_digraph_view_edge(view, i);
+
+        if (current_edge->subgraph >= subgraph_count ||
+            current_edge->from >= node_count || current_edge->to >= node_count ||
+            hash_table_lookup(&graphviz_colors, (int) current_edge->color) == NULL ||
+            hash_table_lookup(&graphviz_styles, (int) current_edge->style) == NULL ||
+            !is_label_valid(view, current_edge->label, size))
+            return false;
+    }
+
+    return true;
+}
+
+stack_trace* shared_digraph_view_refresh(shared_digraph_view* view) {
+    shared_digraph_header* shared = (shared_digraph_header*) view->region;
+
+    uint64_t before = 0, after = 0, size = 0;
+    uint64_t subgraph_count = 0, node_count = 0, edge_count = 0, is_complete = 0;
+
+    do {
+        before = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if (before % 2 == 1)
+            continue; // Producer is publishing right now
+
+        size           = __atomic_load_n(&shared->size,           __ATOMIC_RELAXED);
+        subgraph_count = __atomic_load_n(&shared->subgraph_count, __ATOMIC_RELAXED);
+        node_count     = __atomic_load_n(&shared->node_count,     __ATOMIC_RELAXED);
+        edge_count     = __atomic_load_n(&shared->edge_count,     __ATOMIC_RELAXED);
+        is_complete    = __atomic_load_n(&shared->is_complete,    __ATOMIC_RELAXED);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&shared->sequence, __ATOMIC_RELAXED);
+    } while (before % 2 == 1 || before != after);
+
+    if (size < sizeof(shared_digraph_header))
+        return FAILURE(RUNTIME_ERROR, "Shared graph claims %zu bytes, less than it's header!",
+                       (size_t) size);
+
+    if (size > view->mapped) {
+        // Pages past the end of file can't be read, so region should really hold them
+        struct stat region_stats;
+        if (fstat(view->fd, &region_stats) == -1)
+            return FAILURE(RUNTIME_ERROR, "Can't get size of shared region: %s", strerror(errno));
+
+        if (size > (uint64_t) region_stats.st_size)
+            return FAILURE(RUNTIME_ERROR, "Shared graph claims %zu bytes, but region has %zu!",
+                           (size_t) size, (size_t) region_stats.st_size);
+
+        void* region = mremap((void*) view->region, view->mapped, size, MREMAP_MAYMOVE);
+        if (region == MAP_FAILED)
+            return FAILURE(RUNTIME_ERROR, "Can't remap shared region to %zu bytes: %s",
+                           (size_t) size, strerror(errno));
+
+        view->region = (const char*) region, view->mapped = size;
+    }
+
+    if (!are_new_records_valid(view, size, subgraph_count, node_count, edge_count))
+        return FAILURE(RUNTIME_ERROR, "Shared graph has records out of it's bounds!");
+
+    view->subgraph_count = subgraph_count;
+    view->node_count     = node_count;
+    view->edge_count     = edge_count;
+    view->is_complete    = is_complete != 0;
+
+    return SUCCESS();
+}
+
+stack_trace* shared_digraph_view_close(shared_digraph_view* view) {
+    bool is_unmapped = view->region == NULL || munmap((void*) view->region, view->mapped) == 0;
+    bool is_closed   = view->fd == -1       || close(view->fd) == 0;
+
+    *view = { .fd = -1 };
+
+    if (!is_unmapped || !is_closed)
+        return FAILURE(RUNTIME_ERROR, "Failed to release shared region: %s", strerror(errno));
+
+    return SUCCESS();
+}
+
+// Sort @arg count records by their subgraphs, @arg starts gets subgraph_count + 1 bounds
+template <typename R>
+static stack_trace* group_by_subgraph(shared_digraph_view* view, uint64_t count,
+                                      const R* (*get)(shared_digraph_view*, uint64_t),
+                                      uint64_t* starts, uint64_t** order) {
+    TRY safe_calloc(count + 1, order)
+        FAIL("Can't allocate order of %zu records!", (size_t) count);
+
+    for (uint64_t i = 0; i < count; ++ i)
+        ++ starts[get(view, i)->subgraph + 1];
+
+    for (uint64_t i = 0; i < view->subgraph_count; ++ i)
+        starts[i + 1] += starts[i];
+
+    uint64_t* next = NULL;
+    TRY safe_calloc(view->subgraph_count + 1, &next) CATCH({
+        free(*order); *order = NULL;
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate subgraph cursors!");
+    });
+
+    memcpy(next, starts, view->subgraph_count * sizeof(uint64_t));
+
+    for (uint64_t i = 0; i < count; ++ i)
+        (*order)[next[get(view, i)->subgraph] ++] = i;
+
+    free(next);
+    return SUCCESS();
+}
+
+static const shared_node* node_at(shared_digraph_view* view, uint64_t index) {
+    return shared_digraph_view_node(view, (node_id) index);
+}
+
+stack_trace* shared_digraph_view_write(buffered_writer* writer, shared_digraph_view* view) {
+    const uint64_t subgraph_count = view->subgraph_count;
+
+    uint64_t *node_starts = NULL, *edge_starts = NULL, *nodes = NULL, *edges = NULL;
+
+    TRY safe_calloc(subgraph_count + 1, &node_starts)
+        FAIL("Can't allocate subgraph bounds!");
+
+    FINALIZER(free_order, { free(node_starts); free(edge_starts); free(nodes); free(edges); });
+
+    TRY safe_calloc(subgraph_count + 1, &edge_starts)
+        FINALIZE_AND_FAIL(free_order, "Can't allocate subgraph bounds!");
+
+    TRY group_by_subgraph(view, view->node_count, node_at, node_starts, &nodes)
+        FINALIZE_AND_FAIL(free_order, "Can't group nodes by subgraph!");
+
+    TRY group_by_subgraph(view, view->edge_count, shared_digraph_view_edge, edge_starts, &edges)
+        FINALIZE_AND_FAIL(free_order, "Can't group edges by subgraph!");
+
+    buffered_writer_puts(writer, "digraph {" "\n");
+
+    for (uint32_t subgraph = 0; subgraph < subgraph_count; ++ subgraph) {
+        buffered_writer_puts(writer, "\t" "subgraph {" "\n");
+
+        const char** rank = hash_table_lookup(&graphviz_rank_names,
+            (int) shared_digraph_view_subgraph(view, subgraph)->rank);
+
+        if (rank != NULL)
+            buffered_writer_printf(writer, "\t\t" "rank = %s;" "\n", *rank);
+
+        for (uint64_t i = node_starts[subgraph]; i < node_starts[subgraph + 1]; ++ i) {
+            const shared_node* current_node = node_at(view, nodes[i]);
+
+            buffered_writer_printf(writer, "\t\t" "node_%d [" "label = \"%s\","
+                                   "shape = \"%s\", color = \"%s\", style = \"%s\"];" "\n",
+                                   (int) nodes[i],
+                                   shared_digraph_view_label(view, current_node->label),
+                                   *hash_table_lookup(&graphviz_node_shapes, (int) current_node->shape),
+                                   *hash_table_lookup(&graphviz_colors,      (int) current_node->color),
+                                   *hash_table_lookup(&graphviz_styles,      (int) current_node->style));
+        }
+
+        for (uint64_t i = edge_starts[subgraph]; i < edge_starts[subgraph + 1]; ++ i) {
+            const shared_edge* current_edge = shared_digraph_view_edge(view, edges[i]);
+
+            buffered_writer_printf(writer, "\t\t" "node_%d -> node_%d [label = \" %s \","
+                                   "color = %s, style = %s, margin = \"1.5\"",
+                                   (int) current_edge->from, (int) current_edge->to,
+                                   shared_digraph_view_label(view, current_edge->label),
+                                   *hash_table_lookup(&graphviz_colors, (int) current_edge->color),
+                                   *hash_table_lookup(&graphviz_styles, (int) current_edge->style));
+
+            if (current_edge->weight != 0)
+                buffered_writer_printf(writer, ", weight = %d",
+                                       edge_dot_weight(current_edge->weight));
+
+            buffered_writer_puts(writer, "];" "\n");
+        }
+
+        buffered_writer_puts(writer, "\t" "}" "\n");
+    }
+
+    buffered_writer_puts(writer, "}" "\n");
+
+    CALL_FINALIZER(free_order);
+    return SUCCESS();
+}
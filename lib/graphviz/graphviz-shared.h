@@ -0,0 +1,185 @@
+#pragma once
+
+#include "graphviz.h"
+#include "graphviz-writer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+const char SHARED_DIGRAPH_MAGIC[8] = "GVSHM01";
+
+// Records are kept in blocks, block i has SHARED_FIRST_BLOCK << i records,
+// so records never move when graph grows and block of record is computed.
+// Blocks hold more records, than 32-bit node ids can address
+const uint64_t SHARED_FIRST_BLOCK = 64;
+const size_t   SHARED_BLOCK_COUNT = 40;
+
+struct shared_subgraph {
+    uint32_t rank; // graphviz_rank_type
+};
+
+struct shared_node {
+    uint32_t subgraph;
+    uint8_t style, color, shape;
+
+    uint64_t label; // Offset of null terminated label from start of region
+};
+
+struct shared_edge {
+    uint32_t from, to;
+    uint32_t subgraph;
+    uint8_t color, style;
+
+    double weight;
+    uint64_t label;
+};
+
+/**
+ * Start of the shared region. Everything in region is addressed by offsets
+ * from it's start, so processes can map it at different addresses.
+ *
+ * Region is append-only: records, that are counted in published header,
+ * never change. Producer publishes new counts under sequence lock, which
+ * is odd while counts are written, consumer retries until it reads the
+ * same even sequence before and after counts.
+ */
+struct shared_digraph_header {
+    char magic[8];
+
+    uint64_t sequence;
+
+    // Published state, protected by sequence
+    uint64_t size; // Bytes in use, region can be mapped up to them
+    uint64_t subgraph_count, node_count, edge_count;
+    uint64_t is_complete;
+
+    // Offsets of record blocks, set once before they are published
+    uint64_t subgraph_blocks[SHARED_BLOCK_COUNT];
+    uint64_t     node_blocks[SHARED_BLOCK_COUNT];
+    uint64_t     edge_blocks[SHARED_BLOCK_COUNT];
+};
+
+/**
+ * Producer's side of the shared graph, it's built right in a memfd
+ * region, that consumer can map without copying or parsing.
+ *
+ * Node ids are positions of nodes in insertion order, they are shared
+ * by all subgraphs.
+ */
+struct shared_digraph {
+    int fd;
+
+    char* region;
+    size_t used, capacity; // Used bytes may be not published yet
+
+    uint64_t subgraph_count, node_count, edge_count;
+};
+
+stack_trace* shared_digraph_create(shared_digraph* graph, const char* name = "graphviz",
+                                   size_t capacity = 1024 * 1024);
+
+/**
+ * Unmap and close producer's descriptor, region lives while
+ * consumers keep it mapped
+ */
+stack_trace* shared_digraph_destroy(shared_digraph* graph);
+
+uint32_t shared_digraph_create_subgraph(shared_digraph* graph, graphviz_rank_type rank);
+
+/**
+ * Insert new node with style inherited from default node, it's
+ * label is formatted directly into the region
+ *
+ * @return value that identifies node and can be used to create edges
+ */
+node_id shared_digraph_insert_default_node(shared_digraph* graph, uint32_t subgraph,
+                                           node default_node, const char* format, ...);
+
+/**
+ * Insert new edge that connects two nodes, identified by their id's
+ */
+void    shared_digraph_insert_default_edge(shared_digraph* graph, uint32_t subgraph,
+                                           edge default_edge, node_id from, node_id to,
+                                           const char* format, ...);
+
+/**
+ * Make everything inserted so far visible to consumers, @arg is_complete
+ * tells them that nothing else will be inserted
+ */
+void shared_digraph_publish(shared_digraph* graph, bool is_complete = false);
+
+/**
+ * Pass region's descriptor to other process over Unix @arg socket
+ */
+stack_trace* shared_digraph_send(int socket, shared_digraph* graph);
+
+/**
+ * Receive descriptor of region sent with shared_digraph_send
+ */
+stack_trace* shared_digraph_receive(int socket, int* fd);
+
+/** Consumer's read only mapping of the shared graph */
+struct shared_digraph_view {
+    int fd;
+
+    const char* region;
+    size_t mapped;
+
+    // Snapshot of published state, taken by shared_digraph_view_refresh
+    uint64_t subgraph_count, node_count, edge_count;
+    bool is_complete;
+};
+
+/**
+ * Map region from @arg fd and take first snapshot, view owns descriptor.
+ * Region comes from other process, so snapshot is checked to stay inside it
+ */
+stack_trace* shared_digraph_view_open(shared_digraph_view* view, int fd);
+
+/**
+ * Take new snapshot of published state, region is remapped if it grew.
+ * Newly published records are checked to refer to published records,
+ * known styles and null terminated labels inside the region
+ */
+stack_trace* shared_digraph_view_refresh(shared_digraph_view* view);
+
+stack_trace* shared_digraph_view_close(shared_digraph_view* view);
+
+inline uint64_t __shared_record_offset(const uint64_t* blocks, uint64_t index,
+                                       size_t record_size) {
+    const uint64_t block = 63 - (uint64_t) __builtin_clzll(index / SHARED_FIRST_BLOCK + 1);
+    const uint64_t first = SHARED_FIRST_BLOCK * ((1ull << block) - 1);
+
+    return blocks[block] + (index - first) * record_size;
+}
+
+inline const shared_digraph_header* shared_digraph_view_header(shared_digraph_view* view) {
+    return (const shared_digraph_header*) view->region;
+}
+
+inline const shared_subgraph* shared_digraph_view_subgraph(shared_digraph_view* view,
+                                                          uint32_t subgraph) {
+    return (const shared_subgraph*) (view->region + __shared_record_offset(
+        shared_digraph_view_header(view)->subgraph_blocks, subgraph, sizeof(shared_subgraph)));
+}
+
+inline const shared_node* shared_digraph_view_node(shared_digraph_view* view, node_id id) {
+    return (const shared_node*) (view->region + __shared_record_offset(
+        shared_digraph_view_header(view)->node_blocks, (uint64_t) id, sizeof(shared_node)));
+}
+
+inline const shared_edge* shared_digraph_view_edge(shared_digraph_view* view, uint64_t index) {
+    return (const shared_edge*) (view->region + __shared_record_offset(
+        shared_digraph_view_header(view)->edge_blocks, index, sizeof(shared_edge)));
+}
+
+inline const char* shared_digraph_view_label(shared_digraph_view* view, uint64_t label) {
+    return view->region + label;
+}
+
+/**
+ * Write snapshot of the graph in graphviz dot's lang, straight from
+ * the mapping, nodes are grouped by their subgraphs
+ */
+stack_trace* shared_digraph_view_write(buffered_writer* writer, shared_digraph_view* view);
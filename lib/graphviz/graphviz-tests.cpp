@@ -1,5 +1,28 @@
 #include "graphviz.h"
+#include "graphviz-adjacency.h"
+#include "graphviz-label-index.h"
+#include "graphviz-compressed.h"
+#include "graphviz-mapped.h"
+#include "graphviz-export.h"
+#include "graphviz-label-template.h"
+#include "graphviz-diff.h"
+#include "graphviz-reduce.h"
+#include "graphviz-analytics.h"
+#include "graphviz-shared.h"
+#include "graphviz-parallel-writer.h"
+#include "graphviz-generators.h"
+#include "graphviz-layout.h"
+#include "graphviz-routing.h"
+#include "graphviz-viewport.h"
+#include "graphviz-png.h"
+#include "graphviz-tiles.h"
 #include "test-framework.h"
+#include "textlib.h"
+
+#include <limits.h>
+#include <math.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 void create_tree(SUBGRAPH_CONTEXT, node_id current, int depth,
                  int max_depth, int branch_factor) {
@@ -49,6 +72,1827 @@ TEST(graphviz_test) {
     digraph_destroy(&my_graph);
 }
 
+TEST(get_or_insert_node_by_name) {
+    digraph graph = digraph_create();
+    subgraph_id current = digraph_create_subgraph(&graph, RANK_NONE);
+
+    node_id first  = subgraph_get_or_insert_node(&graph, current, "first");
+    node_id second = subgraph_get_or_insert_node(&graph, current, "second");
+
+    ASSERT_EQUAL(first != second, true);
+    ASSERT_EQUAL(subgraph_get_or_insert_node(&graph, current, "first"), first);
+    ASSERT_EQUAL(subgraph_get_or_insert_node(&graph, current, "second"), second);
+
+    // Nodes inserted the usual way are indexed too
+    node_id third = subgraph_insert_default_node(&graph, current, {}, "%s", "third");
+    ASSERT_EQUAL(subgraph_get_or_insert_node(&graph, current, "third"), third);
+
+    ASSERT_EQUAL((int) digraph_get_subgraph(&graph, current)->nodes.used, 3);
+
+    digraph_destroy(&graph);
+}
+
+TEST(extract_neighborhood_of_a_tree_node) {
+    node_id root = linked_list_end_index;
+
+    digraph tree = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            root = NODE("root");
+
+            const int branch_factor = 2,
+                      max_depth     = 3;
+
+            create_tree(CURRENT_SUBGRAPH_CONTEXT, root, 0,
+                        max_depth, branch_factor);
+        });
+    });
+
+    digraph_adjacency adjacency = {};
+    TRY digraph_adjacency_create(&adjacency, &tree)
+        ASSERT_SUCCESS();
+
+    // Root, two children and four grandchildren
+    digraph two_hops = digraph_extract_neighborhood(&tree, &adjacency, &root, 1,
+                                                    2, DIRECTION_OUT, 100);
+
+    subgraph* extracted = digraph_get_subgraph(&two_hops,
+        linked_list_head_index(&two_hops.subgraphs));
+
+    ASSERT_EQUAL((int) extracted->nodes.used, 7);
+    ASSERT_EQUAL((int) extracted->edges.used, 6);
+
+    // Budget keeps only the closest nodes
+    digraph limited = digraph_extract_neighborhood(&tree, &adjacency, &root, 1,
+                                                   2, DIRECTION_BOTH, 3);
+
+    extracted = digraph_get_subgraph(&limited,
+        linked_list_head_index(&limited.subgraphs));
+
+    ASSERT_EQUAL((int) extracted->nodes.used, 3);
+    ASSERT_EQUAL((int) extracted->edges.used, 2);
+
+    digraph_destroy(&limited);
+    digraph_destroy(&two_hops);
+
+    digraph_adjacency_destroy(&adjacency);
+    digraph_destroy(&tree);
+}
+
+TEST(search_labels_by_prefix_and_substring) {
+    digraph graph = digraph_create();
+    subgraph_id current = digraph_create_subgraph(&graph, RANK_NONE);
+
+    const int node_count = 1000;
+    for (int i = 0; i < node_count; ++ i)
+        subgraph_insert_default_node(&graph, current, {}, "node-%04d", i);
+
+    label_index index = {};
+    TRY label_index_create(&index, &graph)
+        ASSERT_SUCCESS();
+
+    node_id found[node_count];
+
+    // node-0100 ... node-0199
+    ASSERT_EQUAL((int) label_index_find_prefix(&index, "node-01", found, node_count), 100);
+    ASSERT_EQUAL((int) label_index_find_prefix(&index, "edge",    found, node_count), 0);
+
+    // node-0042, node-0420 ... node-0429, node-1420 doesn't exist
+    ASSERT_EQUAL((int) label_index_find_substring(&index, "042", found, node_count), 11);
+    ASSERT_EQUAL((int) label_index_find_substring(&index, "-09", found, 5), 5);
+
+    // Short patterns still work, just without trigrams
+    ASSERT_EQUAL((int) label_index_find_substring(&index, "99", found, node_count), 19);
+
+    label_index_destroy(&index);
+    digraph_destroy(&graph);
+}
+
+TEST(compress_and_decode_tree) {
+    node_id root = linked_list_end_index;
+
+    digraph tree = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            root = NODE("root");
+            create_tree(CURRENT_SUBGRAPH_CONTEXT, root, 0, 3, 3);
+
+            LABELED_EDGE(root, root, "loop");
+        });
+    });
+
+    subgraph_id current = linked_list_head_index(&tree.subgraphs);
+    edge_id weighted = linked_list_head_index(&digraph_get_subgraph(&tree, current)->edges);
+    subgraph_set_edge_weight(&tree, current, weighted, 2.5);
+
+    compressed_digraph compressed = {};
+    TRY compressed_digraph_create(&compressed, &tree)
+        ASSERT_SUCCESS();
+
+    // 3 + 9 + 27 + 81 tree edges, and a loop
+    ASSERT_EQUAL((int) compressed.edge_count, 121);
+    ASSERT_EQUAL((int) compressed.node_count, 121);
+
+    // Only the loop and the weighted edge differ from default edges
+    ASSERT_EQUAL((int) compressed.edge_attribute_count, 2);
+
+    node_id targets[4] = {};
+    ASSERT_EQUAL((int) compressed_digraph_out_degree(&compressed, root), 4);
+    ASSERT_EQUAL((int) compressed_digraph_decode_neighbours(&compressed, root, targets), 4);
+    ASSERT_EQUAL(targets[0], root);
+
+    compressed_edge_cursor cursor = {};
+    edge decoded = {};
+
+    int decoded_edges = 0, loops = 0, weighted_edges = 0;
+    while (compressed_digraph_next_edge(&compressed, &cursor, &decoded)) {
+        loops += decoded.from == decoded.to && strcmp(decoded.label, "loop") == 0;
+        weighted_edges += decoded.weight == 2.5;
+        ++ decoded_edges;
+    }
+
+    ASSERT_EQUAL(decoded_edges, 121);
+    ASSERT_EQUAL(loops, 1);
+    ASSERT_EQUAL(weighted_edges, 1);
+
+    // Neighbours are mostly close to each other, byte per edge is enough
+    ASSERT_EQUAL(compressed.neighbour_offsets[compressed.node_capacity] <= 121 * 2, true);
+
+    compressed_digraph_destroy(&compressed);
+    digraph_destroy(&tree);
+}
+
+static char* read_whole_file(FILE* file, size_t size, size_t* read) {
+    char* content = (char*) calloc(size + 1, sizeof(char));
+
+    rewind(file);
+    *read = fread(content, sizeof(char), size + 1, file);
+
+    return content;
+}
+
+TEST(build_mapped_graph_and_export_it) {
+    char directory[256] = { 0 };
+    ASSERT_EQUAL((tmpnam(directory) != 0), true);
+
+    mapped_digraph graph = {};
+    TRY mapped_digraph_create(&graph, directory)
+        ASSERT_SUCCESS();
+
+    node default_node = { .style = STYLE_ROUNDED, .color = GRAPHVIZ_RED, .shape = SHAPE_BOX };
+    edge default_edge = { .color = GRAPHVIZ_ORANGE, .style = STYLE_SOLID, .weight = 2 };
+
+    const int node_count = 10000;
+
+    node_id previous = mapped_digraph_insert_default_node(&graph, default_node, "%d", 0);
+    for (int i = 1; i < node_count - 1; ++ i) {
+        node_id current = mapped_digraph_insert_default_node(&graph, default_node, "%d", i);
+        mapped_digraph_insert_default_edge(&graph, default_edge, previous, current, "");
+
+        previous = current;
+    }
+
+    // Elements without format keep label of default one, or get an empty one
+    node_id unlabeled = mapped_digraph_insert_default_node(&graph, default_node, NULL);
+
+    char default_label[] = "default";
+    mapped_digraph_insert_default_edge(&graph, { .label = default_label },
+                                       previous, unlabeled, NULL);
+
+    TRY mapped_digraph_close(&graph)
+        ASSERT_SUCCESS();
+
+    TRY mapped_digraph_open(&graph, directory)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL((int) graph.nodes.used, node_count);
+    ASSERT_EQUAL((int) graph.edges.used, node_count - 1);
+
+    ASSERT_EQUAL(strcmp(mapped_digraph_label(&graph, graph.nodes.elements[42].label),
+                        "42"), 0);
+
+    ASSERT_EQUAL(strcmp(mapped_digraph_label(&graph, graph.nodes.elements[unlabeled].label),
+                        ""), 0);
+
+    ASSERT_EQUAL(strcmp(mapped_digraph_label(&graph, graph.edges.elements[node_count - 2].label),
+                        "default"), 0);
+
+    ASSERT_EQUAL(graph.edges.elements[0].weight, 2.0);
+
+    // Chain is built in order of it's path, so distances settle in one pass,
+    // and the second one only finds that nothing changes
+    double* distances = (double*) calloc((size_t) node_count, sizeof(double));
+
+    size_t passes = mapped_digraph_shortest_paths(&graph, 0, distances);
+    ASSERT_EQUAL((int) passes, 2);
+
+    ASSERT_EQUAL(distances[42], 84.0);
+    ASSERT_EQUAL(distances[unlabeled], 2.0 * (node_count - 2) + 1);
+
+    // Nothing leads back to the start of chain
+    mapped_digraph_shortest_paths(&graph, unlabeled, distances);
+    ASSERT_EQUAL(distances[0] == INFINITY, true);
+
+    free(distances);
+
+    FILE* output = tmpfile();
+    mapped_digraph_write_to_file(output, &graph);
+
+    // Two lines for each graph and subgraph braces, and a line per element
+    rewind(output);
+
+    int lines = 0;
+    for (int symbol = 0; (symbol = fgetc(output)) != EOF; )
+        lines += symbol == '\n';
+
+    ASSERT_EQUAL(lines, 4 + node_count + node_count - 1);
+
+    // Weight gets to dot too
+    size_t size = (size_t) ftell(output), read = 0;
+    char* dot = read_whole_file(output, size, &read);
+
+    ASSERT_EQUAL(strstr(dot, "weight = 2") != NULL, true);
+
+    free(dot);
+    fclose(output);
+
+    TRY mapped_digraph_close(&graph)
+        ASSERT_SUCCESS();
+
+    char command[512] = {};
+    snprintf(command, sizeof(command), "rm -r %s", directory);
+    system(command);
+}
+
+TEST(export_json_and_columnar) {
+    node_id root = linked_list_end_index;
+
+    digraph tree = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            root = NODE("\"root\"");
+            create_tree(CURRENT_SUBGRAPH_CONTEXT, root, 0, 2, 3);
+        });
+    });
+
+    subgraph_id current = linked_list_head_index(&tree.subgraphs);
+    edge_id weighted = linked_list_head_index(&digraph_get_subgraph(&tree, current)->edges);
+    subgraph_set_edge_weight(&tree, current, weighted, 2.5);
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_write_json(&writer, &tree);
+
+    size_t size = 0;
+    char* json = buffered_writer_take(&writer, &size);
+
+    ASSERT_EQUAL(strstr(json, "\"label\": \"\\\"root\\\"\"") != NULL, true);
+    free(json);
+
+    TRY digraph_write_columnar(&writer, &tree)
+        ASSERT_SUCCESS();
+
+    char* columnar = buffered_writer_take(&writer, &size);
+
+    columnar_view view = {};
+    TRY columnar_view_open(&view, columnar, size)
+        ASSERT_SUCCESS();
+
+    // Root and 3 + 9 + 27 tree nodes, their labels repeat
+    ASSERT_EQUAL((int) view.header->node_count, 40);
+    ASSERT_EQUAL((int) view.header->edge_count, 39);
+    ASSERT_EQUAL((int) view.header->string_count, 5);
+
+    ASSERT_EQUAL(view.node_ids[0], root);
+    ASSERT_EQUAL(strcmp(columnar_view_string(&view, view.node_labels[0]), "\"root\""), 0);
+    ASSERT_EQUAL(view.edge_froms[0], root);
+    ASSERT_EQUAL(view.edge_weights[0], 2.5);
+    ASSERT_EQUAL(view.edge_weights[1], 0.0);
+
+    // Every corruption is found before anything is read through it
+    columnar_header* header = (columnar_header*) columnar;
+    uint64_t* const fields[] = {
+        &header->node_count, &header->string_count, &header->edge_labels, &header->string_offsets
+    };
+
+    for (uint64_t* field : fields) {
+        const uint64_t original = *field;
+        const uint64_t corruptions[] = { original * 4096 + 4096, UINT64_MAX - 7, original + 4 };
+
+        // Counts can be off by a few, while columns still fit in padding
+        const size_t corruption_count = field == &header->edge_labels ||
+                                        field == &header->string_offsets ? 3 : 2;
+
+        for (size_t i = 0; i < corruption_count; ++ i) {
+            *field = corruptions[i];
+
+            stack_trace* opened = columnar_view_open(&view, columnar, size);
+            ASSERT_EQUAL(trace_is_success(opened), false);
+            trace_destruct(opened);
+        }
+
+        *field = original;
+    }
+
+    uint32_t* labels = (uint32_t*) (columnar + header->node_labels);
+    uint64_t* offsets = (uint64_t*) (columnar + header->string_offsets);
+
+    uint32_t first_label = labels[0];
+    labels[0] = (uint32_t) header->string_count;
+
+    stack_trace* opened = columnar_view_open(&view, columnar, size);
+    ASSERT_EQUAL(trace_is_success(opened), false);
+    trace_destruct(opened);
+
+    labels[0] = first_label;
+    offsets[1] = UINT64_MAX / 2;
+
+    opened = columnar_view_open(&view, columnar, size);
+    ASSERT_EQUAL(trace_is_success(opened), false);
+    trace_destruct(opened);
+
+    free(columnar);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_destroy(&tree);
+}
+
+TEST(keep_exact_weight_in_json_and_graphml) {
+    const double weight = 0.1234567891;
+
+    digraph graph = digraph_create();
+    subgraph_id current = digraph_create_subgraph(&graph, RANK_NONE);
+
+    node_id from = subgraph_insert_default_node(&graph, current, {}, "from");
+    node_id to   = subgraph_insert_default_node(&graph, current, {}, "to");
+    subgraph_insert_default_edge(&graph, current, { .weight = weight }, from, to, "");
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    size_t size = 0;
+
+    digraph_write_json(&writer, &graph);
+    char* json = buffered_writer_take(&writer, &size);
+
+    const char* json_weight = strstr(json, "\"weight\": ");
+    ASSERT_EQUAL(json_weight != NULL, true);
+    ASSERT_EQUAL(strtod(json_weight + strlen("\"weight\": "), NULL) == weight, true);
+
+    free(json);
+
+    digraph_write_graphml(&writer, &graph);
+    char* graphml = buffered_writer_take(&writer, &size);
+
+    const char* graphml_weight = strstr(graphml, "<data key=\"weight\">");
+    ASSERT_EQUAL(graphml_weight != NULL, true);
+    ASSERT_EQUAL(strtod(graphml_weight + strlen("<data key=\"weight\">"), NULL) == weight, true);
+
+    free(graphml);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_destroy(&graph);
+}
+
+TEST(fill_label_templates) {
+    label_template record = {};
+    TRY label_template_create(&record, "<td>%03d</td><td>%s</td> 100%%",
+                              LABEL_ESCAPE_HTML)
+        ASSERT_SUCCESS();
+
+    char* label = label_template_fill(&record, 7, "a < b");
+    ASSERT_EQUAL(strcmp(label, "<td>007</td><td>a &lt; b</td> 100%"), 0);
+    free(label);
+
+    char expected[64] = {};
+    snprintf(expected, sizeof(expected), "<td>%03d</td><td>%s</td> 100%%", -5, "");
+
+    label = label_template_fill(&record, -5, "");
+    ASSERT_EQUAL(strcmp(label, expected), 0);
+    free(label);
+
+    label_template_destroy(&record);
+
+    label_template quoted = {};
+    TRY label_template_create(&quoted, "\"%s\" = %4d", LABEL_ESCAPE_QUOTED)
+        ASSERT_SUCCESS();
+
+    digraph graph = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id answer = TEMPLATE_NODE(&quoted, "x\"y", 42);
+
+            ASSERT_EQUAL(strcmp(digraph_get_subgraph(&__current_graph, __current_subgraph)
+                                ->nodes.elements[answer].element.label,
+                                "\\\"x\\\"y\\\" =   42"), 0);
+
+            // Backslash can't escape closing quote of label
+            node_id path = TEMPLATE_NODE(&quoted, "C:\\", 1);
+
+            ASSERT_EQUAL(strcmp(digraph_get_subgraph(&__current_graph, __current_subgraph)
+                                ->nodes.elements[path].element.label,
+                                "\\\"C:\\\\\\\" =    1"), 0);
+        });
+    });
+
+    label_template_destroy(&quoted);
+
+    stack_trace* unsupported = label_template_create(&quoted, "%f");
+    ASSERT_EQUAL(trace_is_success(unsupported), false);
+    trace_destruct(unsupported);
+
+    digraph_destroy(&graph);
+}
+
+TEST(diff_two_versions_of_graph) {
+    digraph before = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id a = NODE("a"), b = NODE("b"), c = NODE("c");
+
+            EDGE(a, b);
+            EDGE(b, c);
+        });
+    });
+
+    // Ids shift, since nodes are inserted in other order
+    digraph after = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id d = NODE("d"), b = NODE("b"), a = NODE("a");
+
+            DEFAULT_EDGE.color = GRAPHVIZ_BLUE;
+            EDGE(a, b);
+
+            DEFAULT_EDGE.color = GRAPHVIZ_BLACK;
+            EDGE(b, d);
+        });
+    });
+
+    digraph_diff_stats stats = {};
+    digraph diff = digraph_diff(&before, &after, &stats);
+
+    ASSERT_EQUAL((int) stats.added_nodes,   1);
+    ASSERT_EQUAL((int) stats.removed_nodes, 1);
+    ASSERT_EQUAL((int) stats.changed_nodes, 0);
+
+    ASSERT_EQUAL((int) stats.added_edges,   1);
+    ASSERT_EQUAL((int) stats.removed_edges, 1);
+    ASSERT_EQUAL((int) stats.changed_edges, 1);
+
+    subgraph_id changes_id = linked_list_head_index(&diff.subgraphs);
+    subgraph* changes = digraph_get_subgraph(&diff, changes_id);
+
+    ASSERT_EQUAL((int) changes->nodes.used, 4);
+    ASSERT_EQUAL((int) changes->edges.used, 3);
+
+    node_id removed = subgraph_get_or_insert_node(&diff, changes_id, "c");
+    ASSERT_EQUAL((int) changes->nodes.elements[removed].element.color, (int) GRAPHVIZ_RED);
+
+    digraph_destroy(&diff);
+    digraph_destroy(&after);
+    digraph_destroy(&before);
+}
+
+TEST(diff_parallel_edges_and_weights) {
+    digraph before = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id a = NODE("a"), b = NODE("b");
+
+            EDGE(a, b);
+            EDGE(a, b);
+            EDGE(b, a);
+        });
+    });
+
+    // One of parallel edges is gone and weight of the other one changed
+    digraph after = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id a = NODE("a"), b = NODE("b");
+
+            EDGE(a, b);
+
+            DEFAULT_EDGE.weight = 3;
+            EDGE(b, a);
+            EDGE(b, a);
+        });
+    });
+
+    digraph_diff_stats stats = {};
+    digraph diff = digraph_diff(&before, &after, &stats);
+
+    ASSERT_EQUAL((int) stats.added_edges,   1);
+    ASSERT_EQUAL((int) stats.removed_edges, 1);
+    ASSERT_EQUAL((int) stats.changed_edges, 1);
+
+    digraph_destroy(&diff);
+    digraph_destroy(&after);
+    digraph_destroy(&before);
+}
+
+TEST(transitive_reduction_of_chain_with_shortcuts) {
+    const int length = 100;
+
+    // Every node is connected to every later node
+    digraph chain = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id nodes[length];
+            for (int i = 0; i < length; ++ i)
+                nodes[i] = NODE("%d", i);
+
+            for (int i = 0; i < length; ++ i)
+                for (int j = i + 1; j < length; ++ j)
+                    EDGE(nodes[i], nodes[j]);
+        });
+    });
+
+    size_t removed = 0;
+    TRY digraph_transitive_reduce(&chain, &removed)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL((int) removed, length * (length - 1) / 2 - (length - 1));
+
+    subgraph* reduced = &linked_list_head(&chain.subgraphs)->element;
+    ASSERT_EQUAL((int) reduced->edges.used, length - 1);
+
+    LINKED_LIST_TRAVERSE(&reduced->edges, edge, current) {
+        int from = atoi(reduced->nodes.elements[current->element.from].element.label),
+            to   = atoi(reduced->nodes.elements[current->element.to  ].element.label);
+
+        ASSERT_EQUAL(to, from + 1);
+    }
+
+    digraph_destroy(&chain);
+
+    digraph cycle = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id a = NODE("a"), b = NODE("b");
+
+            EDGE(a, b);
+            EDGE(b, a);
+        });
+    });
+
+    stack_trace* failure = digraph_transitive_reduce(&cycle);
+    ASSERT_EQUAL(trace_is_success(failure), false);
+    trace_destruct(failure);
+
+    digraph_destroy(&cycle);
+
+    // Removed edges leave nothing behind in incidence index and attributes
+    digraph indexed = digraph_create();
+    subgraph_id current = digraph_create_subgraph(&indexed, RANK_NONE);
+    digraph_create_incidence_index(&indexed);
+
+    node_id a = subgraph_insert_default_node(&indexed, current, {}, "a"),
+            b = subgraph_insert_default_node(&indexed, current, {}, "b"),
+            c = subgraph_insert_default_node(&indexed, current, {}, "c");
+
+    subgraph_insert_default_edge(&indexed, current, {}, a, b, "");
+    subgraph_insert_default_edge(&indexed, current, {}, b, c, "");
+
+    edge_id shortcut = subgraph_insert_default_edge(&indexed, current, {}, a, c, "");
+    subgraph_set_edge_attribute(&indexed, current, shortcut,
+                                attribute_number(ATTRIBUTE_PENWIDTH, 2));
+
+    TRY digraph_transitive_reduce(&indexed)
+        ASSERT_SUCCESS();
+
+    node_id d = subgraph_insert_default_node(&indexed, current, {}, "d");
+    edge_id loop = subgraph_insert_default_edge(&indexed, current, {}, d, d, "");
+
+    ASSERT_EQUAL(loop, shortcut);
+    ASSERT_EQUAL(subgraph_get_edge_attribute(&indexed, current, loop, ATTRIBUTE_PENWIDTH) == NULL,
+                 true);
+
+    subgraph_remove_node(&indexed, current, a);
+
+    subgraph* remaining = digraph_get_subgraph(&indexed, current);
+    ASSERT_EQUAL((int) remaining->edges.used, 2);
+
+    digraph_destroy(&indexed);
+}
+
+TEST(weighted_analytics) {
+    node_id a = 0, b = 0, c = 0, d = 0;
+
+    digraph graph = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            a = NODE("a"), b = NODE("b"), c = NODE("c"), d = NODE("d");
+
+            subgraph_insert_edge(&__current_graph, __current_subgraph,
+                                 { .from = a, .to = b, .weight = 1 });
+            subgraph_insert_edge(&__current_graph, __current_subgraph,
+                                 { .from = b, .to = c, .weight = 1 });
+            subgraph_insert_edge(&__current_graph, __current_subgraph,
+                                 { .from = a, .to = c, .weight = 5 });
+            subgraph_insert_edge(&__current_graph, __current_subgraph,
+                                 { .from = c, .to = d, .weight = 0.5 });
+        });
+    });
+
+    digraph_analytics analytics = {};
+    TRY digraph_analytics_create(&analytics, &graph)
+        ASSERT_SUCCESS();
+
+    const size_t capacity = analytics.adjacency.node_capacity;
+    double scores[capacity];
+
+    TRY digraph_shortest_paths(&analytics, a, 1.0, scores)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(scores[b], 1.0);
+    ASSERT_EQUAL(scores[c], 2.0);
+    ASSERT_EQUAL(scores[d], 2.5);
+
+    TRY digraph_shortest_paths(&analytics, d, 1.0, scores)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(isinf(scores[a]), true);
+
+    TRY digraph_page_rank(&analytics, scores)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(fabs(scores[a] + scores[b] + scores[c] + scores[d] - 1) < 1e-6, true);
+    ASSERT_EQUAL(scores[d] > scores[a], true);
+
+    // Every node is a source, so estimate is exact. Paths are counted
+    // in hops, so a -> c is direct, while a -> d and b -> d go through c
+    TRY digraph_betweenness(&analytics, scores, 4)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(scores[b], 0.0);
+    ASSERT_EQUAL(scores[c], 2.0);
+    ASSERT_EQUAL(scores[a], 0.0);
+
+    digraph_color_by_score(&graph, scores, capacity);
+
+    subgraph* nodes = &linked_list_head(&graph.subgraphs)->element;
+    ASSERT_EQUAL((int) nodes->nodes.elements[c].element.color, (int) GRAPHVIZ_RED);
+    ASSERT_EQUAL((int) nodes->nodes.elements[a].element.color, (int) GRAPHVIZ_BLACK);
+
+    // Dot accepts only integer weights
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_write(&writer, &graph);
+
+    size_t size = 0;
+    char* dot = buffered_writer_take(&writer, &size);
+
+    ASSERT_EQUAL(strstr(dot, "weight = 5") != NULL, true);
+    ASSERT_EQUAL(strstr(dot, "weight = 0.5") == NULL, true);
+    free(dot);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(edge_dot_weight(0.5), 1);
+    ASSERT_EQUAL(edge_dot_weight(0.4), 0);
+    ASSERT_EQUAL(edge_dot_weight(-3), 0);
+    ASSERT_EQUAL(edge_dot_weight(1e300), INT_MAX);
+
+    digraph_analytics_destroy(&analytics);
+    digraph_destroy(&graph);
+}
+
+TEST(hand_off_shared_graph) {
+    // Small region, so it grows while graph is built
+    shared_digraph producer = {};
+    TRY shared_digraph_create(&producer, "graphviz-tests", 4096)
+        ASSERT_SUCCESS();
+
+    uint32_t subgraph = shared_digraph_create_subgraph(&producer, RANK_SAME);
+
+    node_id root = shared_digraph_insert_default_node(&producer, subgraph, {}, "root");
+    shared_digraph_publish(&producer);
+
+    int sockets[2] = {};
+    ASSERT_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), 0);
+
+    TRY shared_digraph_send(sockets[0], &producer)
+        ASSERT_SUCCESS();
+
+    int fd = -1;
+    TRY shared_digraph_receive(sockets[1], &fd)
+        ASSERT_SUCCESS();
+
+    close(sockets[0]), close(sockets[1]);
+
+    shared_digraph_view view = {};
+    TRY shared_digraph_view_open(&view, fd)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(view.node_count, (uint64_t) 1);
+    ASSERT_EQUAL(view.is_complete, false);
+
+    // Nodes inserted after publish aren't visible until next one
+    for (int i = 0; i < 1000; ++ i) {
+        node_id child = shared_digraph_insert_default_node(&producer, subgraph,
+                                                           { .color = GRAPHVIZ_RED }, "child %d", i);
+
+        shared_digraph_insert_default_edge(&producer, subgraph, { .weight = 2 },
+                                           root, child, "%d", i);
+    }
+
+    // Elements without format keep label of default one, or get an empty one
+    node_id unlabeled = shared_digraph_insert_default_node(&producer, subgraph, {}, NULL);
+
+    char default_label[] = "default";
+    shared_digraph_insert_default_edge(&producer, subgraph, { .label = default_label },
+                                       root, unlabeled, NULL);
+
+    TRY shared_digraph_view_refresh(&view)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(view.node_count, (uint64_t) 1);
+
+    shared_digraph_publish(&producer, true);
+
+    TRY shared_digraph_view_refresh(&view)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(view.is_complete, true);
+    ASSERT_EQUAL(view.node_count, (uint64_t) 1002);
+    ASSERT_EQUAL(view.edge_count, (uint64_t) 1001);
+
+    const shared_node* empty = shared_digraph_view_node(&view, unlabeled);
+    ASSERT_EQUAL(strcmp(shared_digraph_view_label(&view, empty->label), ""), 0);
+
+    const shared_edge* defaulted = shared_digraph_view_edge(&view, 1000);
+    ASSERT_EQUAL(strcmp(shared_digraph_view_label(&view, defaulted->label), "default"), 0);
+
+    const shared_node* last = shared_digraph_view_node(&view, 1000);
+    ASSERT_EQUAL(strcmp(shared_digraph_view_label(&view, last->label), "child 999"), 0);
+    ASSERT_EQUAL((int) last->color, (int) GRAPHVIZ_RED);
+
+    const shared_edge* first_edge = shared_digraph_view_edge(&view, 0);
+    ASSERT_EQUAL((int) first_edge->from, root);
+    ASSERT_EQUAL(first_edge->weight, 2.0);
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    TRY shared_digraph_view_write(&writer, &view)
+        ASSERT_SUCCESS();
+
+    size_t size = 0;
+    char* dot = buffered_writer_take(&writer, &size);
+
+    ASSERT_EQUAL(strstr(dot, "rank = same;") != NULL, true);
+    ASSERT_EQUAL(strstr(dot, "node_1000 [label = \"child 999\"") != NULL, true);
+    ASSERT_EQUAL(strstr(dot, "node_0 -> node_1000 [label = \" 999 \"") != NULL, true);
+
+    free(dot);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    TRY shared_digraph_destroy(&producer)
+        ASSERT_SUCCESS();
+
+    // Consumer's mapping outlives producer
+    ASSERT_EQUAL(strcmp(shared_digraph_view_label(&view, last->label), "child 999"), 0);
+
+    TRY shared_digraph_view_close(&view)
+        ASSERT_SUCCESS();
+}
+
+// Consumer maps @arg producer's region, as if it was received from other process
+static bool is_shared_graph_accepted(shared_digraph* producer) {
+    shared_digraph_view view = {};
+
+    stack_trace* opened = shared_digraph_view_open(&view, dup(producer->fd));
+    bool is_accepted = trace_is_success(opened);
+    trace_destruct(opened);
+
+    if (is_accepted)
+        trace_destruct(shared_digraph_view_close(&view));
+
+    return is_accepted;
+}
+
+TEST(reject_corrupted_shared_graph) {
+    shared_digraph producer = {};
+    TRY shared_digraph_create(&producer, "graphviz-tests", 4096)
+        ASSERT_SUCCESS();
+
+    uint32_t subgraph = shared_digraph_create_subgraph(&producer, RANK_NONE);
+
+    node_id root  = shared_digraph_insert_default_node(&producer, subgraph, {}, "root");
+    node_id child = shared_digraph_insert_default_node(&producer, subgraph, {}, "child");
+    shared_digraph_insert_default_edge(&producer, subgraph, {}, root, child, "edge");
+
+    shared_digraph_publish(&producer, true);
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), true);
+
+    shared_digraph_header* header = (shared_digraph_header*) producer.region;
+
+    shared_node* node = (shared_node*) (producer.region + __shared_record_offset(
+        header->node_blocks, (uint64_t) child, sizeof(shared_node)));
+
+    shared_edge* edge = (shared_edge*) (producer.region + __shared_record_offset(
+        header->edge_blocks, 0, sizeof(shared_edge)));
+
+    const shared_node original_node = *node;
+    const shared_edge original_edge = *edge;
+
+    node->subgraph = 7;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    node->subgraph = original_node.subgraph, node->color = 200;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    node->color = original_node.color, node->label = header->size;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    node->label = sizeof(header->magic);
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    *node = original_node, edge->to = 2;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    edge->to = original_edge.to, edge->style = 200;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    *edge = original_edge;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), true);
+
+    // Blocks and published size are checked against the region too
+    const uint64_t node_block = header->node_blocks[0];
+
+    header->node_blocks[0] = header->size;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    header->node_blocks[0] = node_block, header->node_count = SHARED_FIRST_BLOCK + 1;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    header->node_count = 2, header->size = producer.capacity * 16;
+    ASSERT_EQUAL(is_shared_graph_accepted(&producer), false);
+
+    TRY shared_digraph_destroy(&producer)
+        ASSERT_SUCCESS();
+}
+
+static char* write_sequentially(digraph* graph, size_t* size) {
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        THROW("Failed to create writer!");
+
+    digraph_write(&writer, graph);
+
+    char* output = buffered_writer_take(&writer, size);
+
+    TRY buffered_writer_destroy(&writer)
+        THROW("Failed to destroy writer!");
+
+    return output;
+}
+
+TEST(write_big_graph_in_parallel) {
+    digraph graph = digraph_create();
+
+    // One subgraph is split between tasks, small ones are joined
+    subgraph_id big = digraph_create_subgraph(&graph, RANK_NONE);
+    for (int i = 0; i < 10000; ++ i)
+        subgraph_insert_default_node(&graph, big, { .color = GRAPHVIZ_BLUE }, "node %d", i);
+
+    for (int i = 1; i < 10000; ++ i)
+        subgraph_insert_default_edge(&graph, big, { .weight = i % 3 * 0.5 },
+                                     i / 2, i, "edge %d", i);
+
+    digraph_create_subgraph(&graph, RANK_SAME);
+
+    for (int i = 0; i < 300; ++ i) {
+        subgraph_id small = digraph_create_subgraph(&graph, (graphviz_rank_type) (i % 6));
+
+        node_id first = subgraph_insert_default_node(&graph, small, {}, "small %d", i);
+        subgraph_insert_default_edge(&graph, small, {}, first, first, "loop");
+    }
+
+    size_t expected_size = 0;
+    char* expected = write_sequentially(&graph, &expected_size);
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    TRY digraph_write_parallel(&writer, &graph)
+        ASSERT_SUCCESS();
+
+    size_t size = 0;
+    char* output = buffered_writer_take(&writer, &size);
+
+    ASSERT_EQUAL(size, expected_size);
+    ASSERT_EQUAL(memcmp(output, expected, size), 0);
+
+    free(output);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    // Descriptor gets buffers with writev
+    FILE* file = tmpfile();
+    TRY digraph_write_parallel_to_fd(fileno(file), &graph)
+        ASSERT_SUCCESS();
+
+    output = read_whole_file(file, expected_size, &size);
+    ASSERT_EQUAL(size, expected_size);
+    ASSERT_EQUAL(memcmp(output, expected, expected_size), 0);
+    free(output);
+
+    fclose(file);
+
+    // Writing to FILE takes parallel path for big graphs too
+    file = tmpfile();
+    digraph_write_to_file(file, &graph);
+
+    ASSERT_EQUAL((size_t) ftell(file), expected_size);
+
+    output = read_whole_file(file, expected_size, &size);
+    ASSERT_EQUAL(size, expected_size);
+    ASSERT_EQUAL(memcmp(output, expected, expected_size), 0);
+    free(output);
+
+    fclose(file);
+
+    // Failed write is reported by checked variant, and doesn't abort the other one
+    file = fopen("/dev/full", "w");
+    ASSERT_EQUAL(file != NULL, true);
+
+    stack_trace* written = digraph_write_parallel_to_file(file, &graph);
+    ASSERT_EQUAL(trace_is_success(written), false);
+    trace_destruct(written);
+
+    digraph_write_to_file(file, &graph);
+    fclose(file);
+
+    free(expected);
+    digraph_destroy(&graph);
+}
+
+static size_t count_edges(digraph* graph) {
+    size_t edges = 0;
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        edges += current->element.edges.used;
+
+    return edges;
+}
+
+TEST(remove_nodes_and_edges_in_place) {
+    digraph graph = digraph_create();
+
+    subgraph_id first  = digraph_create_subgraph(&graph, RANK_NONE);
+    subgraph_id second = digraph_create_subgraph(&graph, RANK_SAME);
+
+    node_id hub = subgraph_get_or_insert_node(&graph, first, "hub");
+
+    node_id leaves[10] = {};
+    for (int i = 0; i < 10; ++ i) {
+        leaves[i] = subgraph_insert_default_node(&graph, first, {}, "leaf %d", i);
+        subgraph_insert_default_edge(&graph, first, {}, hub, leaves[i], "out %d", i);
+    }
+
+    // Edges, that end in hub, are stored in other subgraph, one is a loop
+    edge_id back = subgraph_insert_default_edge(&graph, second, {}, leaves[0], hub, "back");
+    subgraph_insert_default_edge(&graph, second, {}, hub, hub, "loop");
+
+    ASSERT_EQUAL(count_edges(&graph), (size_t) 12);
+
+    subgraph_remove_edge(&graph, second, back);
+    ASSERT_EQUAL(count_edges(&graph), (size_t) 11);
+
+    // Index exists now, edges inserted later are indexed on insertion
+    subgraph_remove_node(&graph, first, leaves[9]);
+    ASSERT_EQUAL(count_edges(&graph), (size_t) 10);
+
+    subgraph_insert_default_edge(&graph, second, {}, leaves[1], hub, "late");
+
+    subgraph_remove_node(&graph, first, hub);
+    ASSERT_EQUAL(count_edges(&graph), (size_t) 0);
+    ASSERT_EQUAL(digraph_get_subgraph(&graph, first)->nodes.used, (size_t) 9);
+
+    // Name is free again, so new node is created and gets recycled slot
+    node_id new_hub = subgraph_get_or_insert_node(&graph, first, "hub");
+    ASSERT_EQUAL(new_hub == hub || new_hub == leaves[9], true);
+
+    subgraph_insert_default_edge(&graph, first, {}, new_hub, leaves[2], "new");
+    ASSERT_EQUAL(count_edges(&graph), (size_t) 1);
+
+    subgraph_set_node_label(&graph, first, leaves[2], "renamed");
+    subgraph_set_node_color(&graph, first, leaves[2], GRAPHVIZ_GREEN);
+    ASSERT_EQUAL(subgraph_get_or_insert_node(&graph, first, "renamed"), leaves[2]);
+
+    subgraph_remove_node(&graph, first, leaves[2]);
+    ASSERT_EQUAL(count_edges(&graph), (size_t) 0);
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_write(&writer, &graph);
+
+    size_t size = 0;
+    char* dot = buffered_writer_take(&writer, &size);
+
+    ASSERT_EQUAL(strstr(dot, "->") == NULL, true);
+    ASSERT_EQUAL(strstr(dot, "renamed") == NULL, true);
+    ASSERT_EQUAL(strstr(dot, "leaf 9") == NULL, true);
+    ASSERT_EQUAL(strstr(dot, "leaf 8") != NULL, true);
+
+    free(dot);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_destroy(&graph);
+}
+
+TEST(write_sparse_extra_attributes) {
+    digraph graph = digraph_create();
+    subgraph_id current = digraph_create_subgraph(&graph, RANK_NONE);
+
+    node_id plain  = subgraph_insert_default_node(&graph, current, {}, "plain");
+    node_id styled = subgraph_insert_default_node(&graph, current, {}, "styled");
+    edge_id link   = subgraph_insert_default_edge(&graph, current, {}, plain, styled, "link");
+
+    attribute_key rank_separator = attribute_key_intern("ranksep");
+    ASSERT_EQUAL(attribute_key_intern("ranksep"), rank_separator);
+    ASSERT_EQUAL(attribute_key_intern("penwidth"), (attribute_key) ATTRIBUTE_PENWIDTH);
+
+    subgraph_set_node_attribute(&graph, current, styled,
+                                attribute_string(ATTRIBUTE_TOOLTIP, "say \"hi\" \\"));
+    subgraph_set_node_attribute(&graph, current, styled, attribute_rgb(ATTRIBUTE_FILLCOLOR, 255, 128, 0));
+    subgraph_set_node_attribute(&graph, current, styled, attribute_number(rank_separator, 2));
+
+    // Value with the same key is replaced
+    subgraph_set_edge_attribute(&graph, current, link, attribute_number(ATTRIBUTE_PENWIDTH, 1));
+    subgraph_set_edge_attribute(&graph, current, link, attribute_number(ATTRIBUTE_PENWIDTH, 2.5));
+    subgraph_set_edge_attribute(&graph, current, link, attribute_string(ATTRIBUTE_URL, "a.html"));
+
+    ASSERT_EQUAL(subgraph_get_node_attribute(&graph, current, plain, ATTRIBUTE_TOOLTIP) == NULL, true);
+    ASSERT_EQUAL(subgraph_get_edge_attribute(&graph, current, link, ATTRIBUTE_PENWIDTH)->number, 2.5);
+
+    ASSERT_EQUAL(subgraph_remove_edge_attribute(&graph, current, link, ATTRIBUTE_URL), true);
+    ASSERT_EQUAL(subgraph_remove_edge_attribute(&graph, current, link, ATTRIBUTE_URL), false);
+
+    size_t size = 0;
+    char* dot = write_sequentially(&graph, &size);
+
+    // Keys are written in order of their ids
+    ASSERT_EQUAL(strstr(dot, "node_1 [label = \"plain\",shape = \"box\", color = \"red\", "
+                             "style = \"filled\"];") != NULL, true);
+    ASSERT_EQUAL(strstr(dot, "style = \"filled\", fillcolor = \"#ff8000\", "
+                             "tooltip = \"say \\\"hi\\\" \\\\\", ranksep = 2];") != NULL, true);
+    ASSERT_EQUAL(strstr(dot, "margin = \"1.5\", penwidth = 2.5];") != NULL, true);
+
+    free(dot);
+
+    // Removed node takes it's extras with it, recycled slot starts clean
+    subgraph_remove_node(&graph, current, styled);
+
+    node_id recycled = subgraph_insert_default_node(&graph, current, {}, "recycled");
+    ASSERT_EQUAL(recycled, styled);
+    ASSERT_EQUAL(subgraph_get_node_attribute(&graph, current, recycled, ATTRIBUTE_TOOLTIP) == NULL,
+                 true);
+
+    digraph_destroy(&graph);
+}
+
+TEST(generate_synthetic_graphs) {
+    digraph tree = {};
+    TRY generate_kary_tree(&tree, 1000, 3, { .seed = 0, .has_labels = true })
+        ASSERT_SUCCESS();
+
+    subgraph* tree_subgraph = digraph_get_subgraph(&tree, linked_list_head_index(&tree.subgraphs));
+    ASSERT_EQUAL(tree_subgraph->edges.used, (size_t) 999);
+
+    // Node number i is node id i + 1, it's parent is number (i - 1) / 3
+    edge* last = &linked_list_tail(&tree_subgraph->edges)->element;
+    ASSERT_EQUAL(last->to, 1000);
+    ASSERT_EQUAL(last->from, 998 / 3 + 1);
+    ASSERT_EQUAL(strcmp(subgraph_get_node(&tree, linked_list_head_index(&tree.subgraphs), 1000)
+                            ->label, "999"), 0);
+
+    digraph_destroy(&tree);
+
+    digraph grid = {};
+    TRY generate_grid(&grid, 30, 20)
+        ASSERT_SUCCESS();
+
+    subgraph* grid_subgraph = digraph_get_subgraph(&grid, linked_list_head_index(&grid.subgraphs));
+    ASSERT_EQUAL(grid_subgraph->edges.used, (size_t) (29 * 20 + 30 * 19));
+
+    digraph_destroy(&grid);
+
+    // More than one block, so several streams are used
+    const size_t edge_count = 200000;
+
+    digraph first = {}, second = {};
+    TRY generate_random_dag(&first,  5000, edge_count, { .seed = 42 })
+        ASSERT_SUCCESS();
+
+    TRY generate_random_dag(&second, 5000, edge_count, { .seed = 42 })
+        ASSERT_SUCCESS();
+
+    subgraph* first_subgraph  = digraph_get_subgraph(&first,  linked_list_head_index(&first.subgraphs));
+    subgraph* second_subgraph = digraph_get_subgraph(&second, linked_list_head_index(&second.subgraphs));
+
+    bool is_same = true, is_acyclic = true;
+    for (element_index_t i = 1; i <= (element_index_t) edge_count; ++ i) {
+        edge* first_edge  = &linked_list_get_pointer(&first_subgraph->edges,  i)->element;
+        edge* second_edge = &linked_list_get_pointer(&second_subgraph->edges, i)->element;
+
+        is_same    = is_same    && first_edge->from == second_edge->from &&
+                                   first_edge->to   == second_edge->to;
+        is_acyclic = is_acyclic && first_edge->from <  first_edge->to;
+    }
+
+    ASSERT_EQUAL(is_same,    true);
+    ASSERT_EQUAL(is_acyclic, true);
+
+    digraph_destroy(&first);
+    digraph_destroy(&second);
+
+    digraph rmat = {};
+    TRY generate_rmat(&rmat, 10, 50000, RMAT_GRAPH500, { .seed = 7 })
+        ASSERT_SUCCESS();
+
+    subgraph* rmat_subgraph = digraph_get_subgraph(&rmat, linked_list_head_index(&rmat.subgraphs));
+
+    // Skewed degrees: node 1 gets far more than average of 50 edges
+    size_t from_first = 0;
+    bool is_in_range = true;
+    LINKED_LIST_TRAVERSE(&rmat_subgraph->edges, edge, current) {
+        from_first += current->element.from == 1;
+        is_in_range = is_in_range && current->element.to >= 1 && current->element.to <= 1024;
+    }
+
+    ASSERT_EQUAL(is_in_range, true);
+    ASSERT_EQUAL(from_first > 500, true);
+
+    digraph_destroy(&rmat);
+
+    digraph empty = {};
+    stack_trace* too_few_nodes = generate_random_edges(&empty, 1, 10);
+
+    ASSERT_EQUAL(trace_is_success(too_few_nodes), false);
+    trace_destruct(too_few_nodes);
+
+    // Product of sides wraps around to zero
+    const size_t side = (size_t) 1 << 32;
+    stack_trace* huge_grid = generate_grid(&empty, side, side);
+
+    ASSERT_EQUAL(trace_is_success(huge_grid), false);
+    trace_destruct(huge_grid);
+}
+
+// Number of route's points, sampled along it's segments, that are inside of @arg box
+static size_t count_points_inside(graph_layout* layout, layout_edge* route, const layout_box* box) {
+    size_t inside = 0;
+
+    for (size_t i = 0; i + 1 < route->point_count; ++ i) {
+        layout_point from = layout->points[route->first_point + i],
+                     to   = layout->points[route->first_point + i + 1];
+
+        for (int step = 0; step <= 64; ++ step) {
+            layout_point sample = { from.x + (to.x - from.x) * step / 64,
+                                    from.y + (to.y - from.y) * step / 64 };
+
+            inside += layout_box_contains(box, sample);
+        }
+    }
+
+    return inside;
+}
+
+static bool count_box(size_t, void* count) {
+    ++ *(size_t*) count;
+    return true;
+}
+
+TEST(route_edges_around_nodes) {
+    digraph graph = NEW_GRAPH(
+        NEW_SUBGRAPH(RANK_SAME, {
+            node_id left = NODE("left"), middle = NODE("middle"), right = NODE("right");
+
+            EDGE(left, right);
+            EDGE(left, middle);
+            EDGE(middle, middle);
+        });
+    );
+
+    // Middle node stands right between the other two
+    const char plain[] =
+        "graph 1 3 1"                                                     "\n"
+        "node node_1 0.5 0.5 0.5 0.5 left solid box black lightgrey"      "\n"
+        "node \"node_2\" 1.5 0.5 0.5 0.5 middle solid box black lightgrey" "\n"
+        "node node_3 2.5 0.5 0.5 0.5 right solid box black lightgrey"     "\n"
+        "edge node_1 node_3 4 0.75 0.5 1 0.5 2 0.5 2.25 0.5 solid black"  "\n"
+        "stop"                                                            "\n";
+
+    graph_layout layout = graph_layout_create();
+
+    TRY graph_layout_read_plain(&layout, plain, sizeof(plain) - 1)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(layout.node_count, (size_t) 3);
+    ASSERT_EPSILON_EQUAL(graph_layout_node_box(&layout, 2)->left, 1.25 * 72);
+
+    TRY graph_layout_add_edges(&layout, &graph)
+        ASSERT_SUCCESS();
+
+    TRY graph_layout_route_edges(&layout)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(layout.edge_count, (size_t) 3);
+
+    // Straight line would cross the middle node, so route bends around it
+    layout_edge* long_edge = &layout.edges[0];
+    ASSERT_EQUAL(long_edge->point_count > 2, true);
+    ASSERT_EQUAL(count_points_inside(&layout, long_edge, graph_layout_node_box(&layout, 2)),
+                 (size_t) 0);
+
+    // Ends are on borders of their nodes
+    ASSERT_EPSILON_EQUAL(layout.points[long_edge->first_point].x, 0.75 * 72);
+    ASSERT_EPSILON_EQUAL(layout.points[long_edge->first_point + long_edge->point_count - 1].x,
+                         2.25 * 72);
+
+    ASSERT_EQUAL(layout.edges[1].point_count, (size_t) 2);
+    ASSERT_EQUAL(layout.edges[2].point_count, (size_t) 4);
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    graph_layout_write_svg(&writer, &layout, &graph);
+
+    size_t size = 0;
+    char* svg = buffered_writer_take(&writer, &size);
+
+    ASSERT_EQUAL(strstr(svg, "<path d=\"M") != NULL, true);
+    ASSERT_EQUAL(strstr(svg, ">middle</text>") != NULL, true);
+    ASSERT_EQUAL(strcmp(svg + size - strlen("</svg>\n"), "</svg>\n"), 0);
+
+    free(svg);
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    graph_layout_destroy(&layout);
+    digraph_destroy(&graph);
+
+    // Lattice of nodes with random edges, more of them than in one block
+    digraph random = {};
+    TRY generate_random_edges(&random, 900, 3000, { .seed = 3 })
+        ASSERT_SUCCESS();
+
+    layout = graph_layout_create();
+    for (node_id node = 1; node <= 900; ++ node)
+        TRY graph_layout_place_node(&layout, node,
+                                    layout_box_around({ (double) ((node - 1) % 30) * 60,
+                                                        (double) ((node - 1) / 30) * 60 }, 30, 20))
+            ASSERT_SUCCESS();
+
+    TRY graph_layout_add_edges(&layout, &random)
+        ASSERT_SUCCESS();
+
+    TRY graph_layout_route_edges(&layout, { .margin = 6, .max_detours = 256 })
+        ASSERT_SUCCESS();
+
+    layout_box boxes[900] = {};
+    for (size_t i = 0; i < layout.node_count; ++ i)
+        boxes[i] = layout.nodes[i].box;
+
+    spatial_grid grid = {};
+    TRY spatial_grid_create(&grid, boxes, layout.node_count)
+        ASSERT_SUCCESS();
+
+    size_t found = 0;
+    spatial_grid_query(&grid, layout_box_around({ 60, 60 }, 100, 100), count_box, &found);
+    ASSERT_EQUAL(found, (size_t) 9);
+
+    // Routes don't cross other nodes
+    size_t crossings = 0;
+    for (size_t i = 0; i < layout.edge_count; ++ i)
+        for (size_t j = 0; j < layout.node_count; ++ j)
+            if (layout.nodes[j].node != layout.edges[i].from &&
+                layout.nodes[j].node != layout.edges[i].to)
+                crossings += count_points_inside(&layout, &layout.edges[i], &layout.nodes[j].box);
+
+    ASSERT_EQUAL(crossings, (size_t) 0);
+
+    spatial_grid_destroy(&grid);
+    graph_layout_destroy(&layout);
+    digraph_destroy(&random);
+}
+
+static size_t count_overlapping(graph_layout* layout, layout_box area) {
+    size_t overlapping = 0;
+
+    for (size_t i = 0; i < layout->node_count; ++ i)
+        overlapping += layout_box_overlaps(&layout->nodes[i].box, &area);
+
+    for (size_t i = 0; i < layout->edge_count; ++ i) {
+        layout_edge* current = &layout->edges[i];
+        layout_box box = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+
+        for (size_t j = 0; j < current->point_count; ++ j) {
+            layout_point point = layout->points[current->first_point + j];
+
+            box.left   = fmin(box.left,   point.x), box.bottom = fmin(box.bottom, point.y);
+            box.right  = fmax(box.right,  point.x), box.top    = fmax(box.top,    point.y);
+        }
+
+        overlapping += layout_box_overlaps(&box, &area);
+    }
+
+    return overlapping;
+}
+
+TEST(query_viewport_of_big_layout) {
+    digraph graph = {};
+    TRY generate_random_edges(&graph, 2500, 2000, { .seed = 11 })
+        ASSERT_SUCCESS();
+
+    graph_layout layout = graph_layout_create();
+    for (node_id node = 1; node <= 2500; ++ node)
+        TRY graph_layout_place_node(&layout, node,
+                                    layout_box_around({ (double) ((node - 1) % 50) * 60,
+                                                        (double) ((node - 1) / 50) * 60 }, 30, 20))
+            ASSERT_SUCCESS();
+
+    TRY graph_layout_add_edges(&layout, &graph)
+        ASSERT_SUCCESS();
+
+    TRY graph_layout_route_edges(&layout)
+        ASSERT_SUCCESS();
+
+    viewport_index index = {};
+    TRY viewport_index_create(&index, &layout)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(index.header->item_count, (uint64_t) 4500);
+
+    // Close up every element is found, and every one is big enough for a label
+    const layout_box area = { 500, 700, 900, 1000 };
+
+    viewport_result result = {};
+    TRY query_viewport(&index, area, 2, &result)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(result.count, count_overlapping(&layout, area));
+
+    size_t labeled_nodes = 0;
+    for (size_t i = 0; i < result.count; ++ i)
+        if (result.hits[i].kind == VIEWPORT_NODE) {
+            labeled_nodes += (result.hits[i].detail & DETAIL_LABEL) != 0;
+
+            ASSERT_EQUAL(layout_box_overlaps(&layout.nodes[result.hits[i].element].box, &area),
+                         true);
+        }
+
+    ASSERT_EQUAL(labeled_nodes > 0, true);
+
+    // From afar small subtrees are merged in clusters
+    TRY query_viewport(&index, graph_layout_bounds(&layout), 0.002, &result)
+        ASSERT_SUCCESS();
+
+    // Long edges are still a few pixels long, but nodes are grouped
+    size_t clusters = 0, nodes = 0;
+    for (size_t i = 0; i < result.count; ++ i) {
+        clusters += result.hits[i].kind == VIEWPORT_CLUSTER;
+        nodes    += result.hits[i].kind == VIEWPORT_NODE;
+    }
+
+    ASSERT_EQUAL(clusters > 0, true);
+    ASSERT_EQUAL(clusters + nodes < 2500 / 8, true);
+
+    // Serialized index is used in place and finds the same
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    viewport_index_write(&writer, &index);
+
+    size_t size = 0;
+    char* serialized = buffered_writer_take(&writer, &size);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    viewport_index view = {};
+    TRY viewport_index_open(&view, serialized, size)
+        ASSERT_SUCCESS();
+
+    viewport_result from_view = {};
+    TRY query_viewport(&view, area, 2, &from_view)
+        ASSERT_SUCCESS();
+
+    TRY query_viewport(&index, area, 2, &result)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(from_view.count, result.count);
+    ASSERT_EQUAL(memcmp(from_view.hits, result.hits, result.count * sizeof(viewport_hit)), 0);
+
+    stack_trace* truncated = viewport_index_open(&view, serialized, size / 2);
+    ASSERT_EQUAL(trace_is_success(truncated), false);
+    trace_destruct(truncated);
+
+    // Box count, that wraps offsets of arrays back into a tiny file
+    uint64_t crafted[10] = {};
+    viewport_header* header = (viewport_header*) crafted;
+
+    memcpy(header->magic, VIEWPORT_MAGIC, sizeof(header->magic));
+    header->node_size = VIEWPORT_NODE_SIZE, header->level_count = 1;
+    header->box_count = (uint64_t) 1 << 62;
+    header->level_ends = sizeof(*header), header->boxes = header->indices = header->size = 80;
+
+    stack_trace* wrapped = viewport_index_open(&view, crafted, sizeof(crafted));
+    ASSERT_EQUAL(trace_is_success(wrapped), false);
+    trace_destruct(wrapped);
+
+    // Boxes past the root
+    header->box_count = 1;
+    header->boxes = 80, header->indices = 96, header->size = 104;
+
+    uint64_t padded[13] = {};
+    memcpy(padded, crafted, sizeof(crafted));
+
+    stack_trace* extra = viewport_index_open(&view, padded, sizeof(padded));
+    ASSERT_EQUAL(trace_is_success(extra), false);
+    trace_destruct(extra);
+
+    free(serialized);
+    viewport_result_destroy(&from_view);
+    viewport_result_destroy(&result);
+    viewport_index_destroy(&index);
+    graph_layout_destroy(&layout);
+    digraph_destroy(&graph);
+}
+
+static size_t count_files(const char* directory) {
+    char command[PATH_MAX + 64] = {};
+    snprintf(command, sizeof(command), "find %s -name '*.png' | wc -l", directory);
+
+    FILE* output = popen(command, "r");
+    size_t count = 0;
+
+    if (output != NULL && fscanf(output, "%zu", &count) != 1)
+        count = 0;
+
+    if (output != NULL)
+        pclose(output);
+
+    return count;
+}
+
+/** Bits of deflate stream, they are packed starting from the lowest one */
+struct inflate_input {
+    const uint8_t* bytes;
+    size_t size, bit;
+};
+
+static uint32_t take_bits(inflate_input* input, unsigned count) {
+    uint32_t value = 0;
+
+    for (unsigned i = 0; i < count; ++ i, ++ input->bit)
+        if (input->bit / 8 < input->size)
+            value |= (uint32_t) (input->bytes[input->bit / 8] >> input->bit % 8 & 1) << i;
+
+    return value;
+}
+
+// Huffman codes start from their highest bit
+static uint32_t take_code(inflate_input* input, unsigned count) {
+    uint32_t code = 0;
+
+    for (unsigned i = 0; i < count; ++ i)
+        code = code << 1 | take_bits(input, 1);
+
+    return code;
+}
+
+static unsigned take_fixed_symbol(inflate_input* input) {
+    uint32_t code = take_code(input, 7);
+    if (code <= 0x17)
+        return 256 + code;
+
+    code = code << 1 | take_bits(input, 1);
+    if (code >= 0x30 && code <= 0xbf)
+        return code - 0x30;
+
+    if (code >= 0xc0 && code <= 0xc7)
+        return 280 + code - 0xc0;
+
+    code = code << 1 | take_bits(input, 1);
+    return 144 + code - 0x190;
+}
+
+// Independent of encoder: stored and fixed Huffman blocks, @return false if stream is broken
+static bool inflate_simple(inflate_input* input, uint8_t* output, size_t capacity, size_t* size) {
+    static const uint16_t LENGTHS[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+    };
+
+    static const uint16_t DISTANCES[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385,
+        513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+    };
+
+    *size = 0;
+
+    for (bool is_final = false; !is_final; ) {
+        is_final = take_bits(input, 1);
+        uint32_t type = take_bits(input, 2);
+
+        if (type == 0) {
+            input->bit = (input->bit + 7) / 8 * 8;
+
+            uint32_t length = take_bits(input, 16), complement = take_bits(input, 16);
+            if ((length ^ 0xffff) != complement || *size + length > capacity)
+                return false;
+
+            for (uint32_t i = 0; i < length; ++ i)
+                output[(*size) ++] = (uint8_t) take_bits(input, 8);
+
+            continue;
+        }
+
+        if (type != 1)
+            return false;
+
+        for (unsigned symbol = take_fixed_symbol(input); symbol != 256;
+                      symbol = take_fixed_symbol(input)) {
+            if (input->bit > 8 * input->size)
+                return false;
+
+            if (symbol < 256) {
+                if (*size == capacity)
+                    return false;
+
+                output[(*size) ++] = (uint8_t) symbol;
+                continue;
+            }
+
+            if (symbol > 285)
+                return false;
+
+            unsigned length_code = symbol - 257,
+                     length_extra = length_code < 8 || length_code == 28 ? 0 : (length_code - 4) / 4;
+
+            size_t length = LENGTHS[length_code] + take_bits(input, length_extra);
+
+            unsigned distance_code = take_code(input, 5);
+            if (distance_code >= 30)
+                return false;
+
+            unsigned distance_extra = distance_code < 2 ? 0 : (distance_code - 2) / 2;
+            size_t distance = DISTANCES[distance_code] + take_bits(input, distance_extra);
+
+            if (distance > *size || *size + length > capacity)
+                return false;
+
+            for (size_t i = 0; i < length; ++ i, ++ *size)
+                output[*size] = output[*size - distance];
+        }
+    }
+
+    return input->bit <= 8 * input->size;
+}
+
+static uint32_t read_big_endian(const uint8_t* bytes) {
+    return (uint32_t) bytes[0] << 24 | (uint32_t) bytes[1] << 16 |
+           (uint32_t) bytes[2] << 8  | (uint32_t) bytes[3];
+}
+
+/**
+ * Decode PNG, that png_write_rgb makes: checks chunk CRCs, zlib header,
+ * Adler-32 and filter types. @return RGB pixels or NULL if file is broken
+ */
+static uint8_t* decode_png(const char* path, size_t* width, size_t* height) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+
+    size_t size = 0, read = 0;
+    TRY get_file_size(file, &size) CATCH({
+        trace_destruct(__trace);
+        fclose(file);
+        return NULL;
+    });
+
+    uint8_t* png = (uint8_t*) read_whole_file(file, size, &read);
+    fclose(file);
+
+    uint8_t *deflated = (uint8_t*) calloc(size + 1, 1), *pixels = NULL, *raw = NULL;
+    size_t deflated_size = 0, raw_size = 0, row_size = 0;
+    bool is_valid = png != NULL && read == size && size >= 8 &&
+                    memcmp(png, "\x89PNG\r\n\x1a\n", 8) == 0, has_end = false;
+
+    for (size_t position = 8; is_valid && !has_end; ) {
+        if (position + 12 > size) {
+            is_valid = false;
+            break;
+        }
+
+        uint32_t length = read_big_endian(png + position);
+        const uint8_t* type = png + position + 4;
+
+        if (length > size - position - 12 ||
+            png_crc32(0, type, length + 4) != read_big_endian(type + 4 + length)) {
+            is_valid = false;
+            break;
+        }
+
+        const uint8_t* data = type + 4;
+        if (memcmp(type, "IHDR", 4) == 0) {
+            is_valid = length == 13 && memcmp(data + 8, "\x08\x02\x00\x00\x00", 5) == 0;
+            *width = read_big_endian(data), *height = read_big_endian(data + 4);
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            memcpy(deflated + deflated_size, data, length);
+            deflated_size += length;
+        } else
+            has_end = memcmp(type, "IEND", 4) == 0;
+
+        position += length + 12;
+    }
+
+    if (is_valid && has_end && deflated_size >= 6 && (deflated[0] << 8 | deflated[1]) % 31 == 0) {
+        row_size = 3 * *width + 1;
+        raw = (uint8_t*) calloc(row_size * *height + 1, 1);
+
+        inflate_input input = { .bytes = deflated + 2, .size = deflated_size - 6, .bit = 0 };
+        is_valid = inflate_simple(&input, raw, row_size * *height, &raw_size) &&
+                   raw_size == row_size * *height &&
+                   png_adler32(1, raw, raw_size) == read_big_endian(deflated + deflated_size - 4);
+    } else
+        is_valid = false;
+
+    if (is_valid) {
+        pixels = (uint8_t*) calloc(row_size * *height + 1, 1);
+
+        for (size_t row = 0; row < *height; ++ row) {
+            if (raw[row * row_size] != 0) {
+                free(pixels), pixels = NULL;
+                break;
+            }
+
+            memcpy(&pixels[row * (row_size - 1)], &raw[row * row_size + 1], row_size - 1);
+        }
+    }
+
+    free(raw);
+    free(deflated);
+    free(png);
+
+    return pixels;
+}
+
+TEST(write_deep_zoom_tiles) {
+    ASSERT_EQUAL(png_crc32(0, "123456789", 9), 0xcbf43926u);
+    ASSERT_EQUAL(png_adler32(1, "Wikipedia", 9), 0x11e60398u);
+
+    digraph graph = NEW_GRAPH(
+        NEW_SUBGRAPH(RANK_SAME, {
+            node_id left = NODE("left"), middle = NODE("middle"), right = NODE("right");
+
+            EDGE(left, right);
+            EDGE(left, middle);
+        });
+    );
+
+    // Two nodes are close, the third is far, so most deep tiles are empty
+    graph_layout layout = graph_layout_create();
+
+    TRY graph_layout_place_node(&layout, 1, layout_box_around({ 20,   20 }, 30, 20))
+        ASSERT_SUCCESS();
+    TRY graph_layout_place_node(&layout, 2, layout_box_around({ 100,  20 }, 30, 20))
+        ASSERT_SUCCESS();
+    TRY graph_layout_place_node(&layout, 3, layout_box_around({ 2000, 2000 }, 30, 20))
+        ASSERT_SUCCESS();
+
+    TRY graph_layout_add_edges(&layout, &graph)
+        ASSERT_SUCCESS();
+
+    TRY graph_layout_route_edges(&layout)
+        ASSERT_SUCCESS();
+
+    char directory[] = "/tmp/graphviz-tiles-XXXXXX";
+    ASSERT_EQUAL(mkdtemp(directory) != NULL, true);
+
+    size_t written = 0;
+    TRY graph_layout_write_tiles(&layout, NULL, &graph, directory, "graph",
+                                 { .scale = 1, .tile_size = 256 }, &written)
+        ASSERT_SUCCESS();
+
+    // 2010 x 2000 picture has 12 levels, the deepest one has 8 x 8 tiles
+    ASSERT_EQUAL(written > 12, true);
+    ASSERT_EQUAL(written < 12 + 64, true);
+    ASSERT_EQUAL(count_files(directory), written);
+
+    // Name, that doesn't fit in a path, isn't cut off
+    char long_name[PATH_MAX] = {};
+    memset(long_name, 'g', PATH_MAX - 1);
+
+    stack_trace* too_long = graph_layout_write_tiles(&layout, NULL, &graph, directory, long_name);
+    ASSERT_EQUAL(trace_is_success(too_long), false);
+    trace_destruct(too_long);
+
+    ASSERT_EQUAL(count_files(directory), written);
+
+    char path[PATH_MAX] = {};
+    snprintf(path, PATH_MAX, "%s/graph.dzi", directory);
+
+    FILE* descriptor = fopen(path, "r");
+    ASSERT_EQUAL(descriptor != NULL, true);
+
+    size_t size = 0;
+    TRY get_file_size(descriptor, &size)
+        ASSERT_SUCCESS();
+
+    size_t read = 0;
+    char* text = read_whole_file(descriptor, size, &read);
+    fclose(descriptor);
+
+    ASSERT_EQUAL(strstr(text, "<Size Width=\"2010\" Height=\"2000\"/>") != NULL, true);
+    free(text);
+
+    // Top level is a single pixel, it's PNG is complete
+    snprintf(path, PATH_MAX, "%s/graph_files/0/0_0.png", directory);
+
+    FILE* tile = fopen(path, "rb");
+    ASSERT_EQUAL(tile != NULL, true);
+
+    TRY get_file_size(tile, &size)
+        ASSERT_SUCCESS();
+
+    char* png = read_whole_file(tile, size, &read);
+    fclose(tile);
+
+    ASSERT_EQUAL(read, size);
+    ASSERT_EQUAL(memcmp(png, "\x89PNG\r\n\x1a\n", 8), 0);
+    ASSERT_EQUAL(memcmp(png + size - 8, "IEND\xae\x42\x60\x82", 8), 0);
+    free(png);
+
+    size_t width = 0, height = 0;
+    uint8_t* pixels = decode_png(path, &width, &height);
+
+    ASSERT_EQUAL(pixels != NULL, true);
+    ASSERT_EQUAL(width,  (size_t) 1);
+    ASSERT_EQUAL(height, (size_t) 1);
+    free(pixels);
+
+    // Deepest tile with the close nodes has them in their red on white
+    snprintf(path, PATH_MAX, "%s/graph_files/11/0_7.png", directory);
+    pixels = decode_png(path, &width, &height);
+
+    ASSERT_EQUAL(pixels != NULL, true);
+    ASSERT_EQUAL(width,  (size_t) 256);
+    ASSERT_EQUAL(height, (size_t) 208);
+
+    size_t red = 0, white = 0;
+    for (size_t i = 0; i < 3 * width * height; i += 3) {
+        red   += pixels[i] == 0xff && pixels[i + 1] == 0x00 && pixels[i + 2] == 0x00;
+        white += pixels[i] == 0xff && pixels[i + 1] == 0xff && pixels[i + 2] == 0xff;
+    }
+
+    ASSERT_EQUAL(red > 1000, true);
+    ASSERT_EQUAL(red + white, width * height);
+    free(pixels);
+
+    // Edge is removed after layout was made, and index is of a bigger layout
+    layout_edge* removed = &layout.edges[1];
+    subgraph_remove_edge(&graph, removed->subgraph, removed->edge);
+
+    viewport_index index = {};
+    TRY viewport_index_create(&index, &layout)
+        ASSERT_SUCCESS();
+
+    graph_layout smaller = graph_layout_create();
+    TRY graph_layout_place_node(&smaller, 1, layout_box_around({ 20, 20 }, 30, 20))
+        ASSERT_SUCCESS();
+
+    TRY graph_layout_write_tiles(&layout, &index, &graph, directory, "removed")
+        ASSERT_SUCCESS();
+
+    TRY graph_layout_write_tiles(&smaller, &index, &graph, directory, "smaller")
+        ASSERT_SUCCESS();
+
+    graph_layout_destroy(&smaller);
+    viewport_index_destroy(&index);
+
+    char command[PATH_MAX + 16] = {};
+    snprintf(command, sizeof(command), "rm -rf %s", directory);
+    ASSERT_EQUAL(system(command), 0);
+
+    graph_layout_destroy(&layout);
+    digraph_destroy(&graph);
+}
+
 int main(void) {
     return test_framework_run_all_unit_tests();
 }
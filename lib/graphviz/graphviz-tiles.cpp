@@ -0,0 +1,500 @@
+#include "graphviz-tiles.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graphviz-parallel.h"
+#include "graphviz-png.h"
+#include "graphviz-writer.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+// Clusters of elements, that are too small to be drawn apart
+const uint32_t TILE_CLUSTER = 0xa0a0a0;
+
+/** How element is drawn, taken from the graph before rendering */
+struct element_paint {
+    uint32_t rgb;
+    bool is_filled, is_invisible;
+};
+
+struct tile_job {
+    const graph_layout* layout;
+    const viewport_index* index;
+    tile_pyramid_options options;
+
+    element_paint *node_paints, *edge_paints;
+
+    layout_box bounds;
+    char files[PATH_MAX]; // Directory with levels
+
+    // Level, that is being rendered
+    size_t level, level_width, level_height, columns;
+    double zoom;
+
+    size_t written; // Accessed atomically
+    bool failed;
+};
+
+// -------------------------------- PAINTS ------------------------------------
+
+static uint32_t color_rgb(graphviz_color color) {
+    switch (color) {
+    case GRAPHVIZ_RED:    return 0xff0000;
+    case GRAPHVIZ_BLUE:   return 0x0000ff;
+    case GRAPHVIZ_GREEN:  return 0x008000;
+    case GRAPHVIZ_YELLOW: return 0xffff00;
+    case GRAPHVIZ_ORANGE: return 0xffa500;
+    default:              return 0x000000;
+    }
+}
+
+static element_paint paint_of(graphviz_color color, graphviz_style style) {
+    element_paint paint = {
+        .rgb = color_rgb(color),
+        .is_filled = style == STYLE_FILLED, .is_invisible = style == STYLE_INVIS
+    };
+
+    return paint;
+}
+
+static stack_trace* collect_paints(tile_job* job, digraph* graph) {
+    const graph_layout* layout = job->layout;
+
+    TRY safe_calloc(layout->node_count + 1, &job->node_paints)
+        FAIL("Can't allocate paints of %zu nodes!", layout->node_count);
+
+    TRY safe_calloc(layout->edge_count + 1, &job->edge_paints)
+        FAIL("Can't allocate paints of %zu edges!", layout->edge_count);
+
+    // Without graph everything is black outline, which calloc already gave
+    if (graph == NULL)
+        return SUCCESS();
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current_subgraph) {
+        subgraph* current = &current_subgraph->element;
+
+        LINKED_LIST_TRAVERSE(&current->nodes, node, current_node) {
+            node_id id = linked_list_get_index(&current->nodes, current_node);
+
+            if ((size_t) id < layout->slot_capacity && layout->slots[id] != LAYOUT_NOT_PLACED)
+                job->node_paints[layout->slots[id]] =
+                    paint_of(current_node->element.color, current_node->element.style);
+        }
+    }
+
+    // Edge, removed after layout was made, keeps black outline
+    for (size_t i = 0; i < layout->edge_count; ++ i) {
+        const edge* drawn = subgraph_find_edge(graph, layout->edges[i].subgraph,
+                                               layout->edges[i].edge);
+        if (drawn != NULL)
+            job->edge_paints[i] = paint_of(drawn->color, drawn->style);
+    }
+
+    return SUCCESS();
+}
+
+// -------------------------------- CANVAS ------------------------------------
+
+/** Pixels of one tile, and where tile is on it's level */
+struct tile_canvas {
+    uint8_t* pixels;
+    size_t width, height;
+
+    double left, top; // Level's pixel, that is tile's top left corner
+    bool is_drawn;
+};
+
+static void set_pixel(tile_canvas* canvas, long x, long y, uint32_t rgb) {
+    if (x < 0 || y < 0 || (size_t) x >= canvas->width || (size_t) y >= canvas->height)
+        return;
+
+    uint8_t* pixel = &canvas->pixels[3 * ((size_t) y * canvas->width + (size_t) x)];
+    pixel[0] = (uint8_t) (rgb >> 16), pixel[1] = (uint8_t) (rgb >> 8), pixel[2] = (uint8_t) rgb;
+
+    canvas->is_drawn = true;
+}
+
+static void fill_rectangle(tile_canvas* canvas, double left, double top,
+                           double right, double bottom, uint32_t rgb) {
+    // Rectangle covers every pixel it touches, so small ones are still seen
+    const long first_x = (long) fmax(floor(left), 0),
+               last_x  = (long) fmin(floor(right),  (double) canvas->width  - 1),
+               first_y = (long) fmax(floor(top),  0),
+               last_y  = (long) fmin(floor(bottom), (double) canvas->height - 1);
+
+    for (long y = first_y; y <= last_y; ++ y)
+        for (long x = first_x; x <= last_x; ++ x)
+            set_pixel(canvas, x, y, rgb);
+}
+
+// Clip coordinate range of line to canvas with a pixel around it
+static bool clip_line(const tile_canvas* canvas, layout_point* from, layout_point* to) {
+    double enter = 0, exit = 1;
+
+    const double deltas[2] = { to->x - from->x, to->y - from->y },
+                 starts[2] = { from->x, from->y },
+                 ends  [2] = { (double) canvas->width + 1, (double) canvas->height + 1 };
+
+    for (int axis = 0; axis < 2; ++ axis) {
+        if (deltas[axis] == 0) {
+            if (starts[axis] < -1 || starts[axis] > ends[axis])
+                return false;
+
+            continue;
+        }
+
+        double t_low  = (-1          - starts[axis]) / deltas[axis],
+               t_high = (ends[axis] - starts[axis]) / deltas[axis];
+
+        enter = fmax(enter, fmin(t_low, t_high));
+        exit  = fmin(exit,  fmax(t_low, t_high));
+    }
+
+    if (enter > exit)
+        return false;
+
+    layout_point start = *from;
+    *from = { start.x + deltas[0] * enter, start.y + deltas[1] * enter };
+    *to   = { start.x + deltas[0] * exit,  start.y + deltas[1] * exit  };
+
+    return true;
+}
+
+static void draw_line(tile_canvas* canvas, layout_point from, layout_point to, uint32_t rgb) {
+    if (!clip_line(canvas, &from, &to))
+        return;
+
+    const double steps = ceil(fmax(fabs(to.x - from.x), fabs(to.y - from.y)));
+
+    for (double step = 0; step <= steps; ++ step) {
+        double t = steps > 0 ? step / steps : 0;
+
+        set_pixel(canvas, (long) floor(from.x + (to.x - from.x) * t),
+                          (long) floor(from.y + (to.y - from.y) * t), rgb);
+    }
+}
+
+// ------------------------------- RENDERING ----------------------------------
+
+static layout_point to_canvas(const tile_job* job, const tile_canvas* canvas, layout_point point) {
+    return { .x = (point.x - job->bounds.left) * job->zoom - canvas->left,
+             .y = (job->bounds.top - point.y)  * job->zoom - canvas->top };
+}
+
+static void draw_node(const tile_job* job, tile_canvas* canvas, const viewport_hit* hit) {
+    // Index, that was built for another layout, may point past it
+    if (hit->element >= job->layout->node_count)
+        return;
+
+    const element_paint* paint = &job->node_paints[hit->element];
+    if (paint->is_invisible)
+        return;
+
+    const layout_box* box = &job->layout->nodes[hit->element].box;
+
+    layout_point top_left     = to_canvas(job, canvas, { box->left,  box->top    }),
+                 bottom_right = to_canvas(job, canvas, { box->right, box->bottom });
+
+    if (hit->detail & DETAIL_POINT || paint->is_filled) {
+        fill_rectangle(canvas, top_left.x, top_left.y, bottom_right.x, bottom_right.y, paint->rgb);
+        return;
+    }
+
+    layout_point top_right   = { bottom_right.x, top_left.y },
+                 bottom_left = { top_left.x, bottom_right.y };
+
+    draw_line(canvas, top_left,     top_right,   paint->rgb);
+    draw_line(canvas, top_right,    bottom_right, paint->rgb);
+    draw_line(canvas, bottom_right, bottom_left, paint->rgb);
+    draw_line(canvas, bottom_left,  top_left,    paint->rgb);
+}
+
+static void draw_edge(const tile_job* job, tile_canvas* canvas, const viewport_hit* hit) {
+    if (hit->element >= job->layout->edge_count)
+        return;
+
+    const element_paint* paint = &job->edge_paints[hit->element];
+    if (paint->is_invisible)
+        return;
+
+    const layout_edge* drawn = &job->layout->edges[hit->element];
+
+    if (drawn->point_count == 0) {
+        layout_point from = layout_box_center(graph_layout_node_box(job->layout, drawn->from)),
+                     to   = layout_box_center(graph_layout_node_box(job->layout, drawn->to));
+
+        draw_line(canvas, to_canvas(job, canvas, from), to_canvas(job, canvas, to), paint->rgb);
+        return;
+    }
+
+    const layout_point* points = &job->layout->points[drawn->first_point];
+
+    for (size_t i = 0; i + 1 < drawn->point_count; ++ i)
+        draw_line(canvas, to_canvas(job, canvas, points[i]),
+                          to_canvas(job, canvas, points[i + 1]), paint->rgb);
+}
+
+static void draw_cluster(const tile_job* job, tile_canvas* canvas, const viewport_hit* hit) {
+    layout_point top_left     = to_canvas(job, canvas, { hit->box.left,  hit->box.top    }),
+                 bottom_right = to_canvas(job, canvas, { hit->box.right, hit->box.bottom });
+
+    fill_rectangle(canvas, top_left.x, top_left.y, bottom_right.x, bottom_right.y, TILE_CLUSTER);
+}
+
+static void draw_hits(const tile_job* job, tile_canvas* canvas, const viewport_result* hits) {
+    // Nodes are drawn over edges, which end at their borders
+    for (size_t i = 0; i < hits->count; ++ i)
+        if (hits->hits[i].kind == VIEWPORT_EDGE)
+            draw_edge(job, canvas, &hits->hits[i]);
+        else if (hits->hits[i].kind == VIEWPORT_CLUSTER)
+            draw_cluster(job, canvas, &hits->hits[i]);
+
+    for (size_t i = 0; i < hits->count; ++ i)
+        if (hits->hits[i].kind == VIEWPORT_NODE)
+            draw_node(job, canvas, &hits->hits[i]);
+}
+
+// Paths don't fit in PATH_MAX, snprintf got @arg length instead
+static bool is_cut_off(int length) {
+    return length < 0 || length >= PATH_MAX;
+}
+
+static stack_trace* write_tile(const tile_job* job, const tile_canvas* canvas,
+                               size_t column, size_t row) {
+    char path[PATH_MAX] = {};
+    if (is_cut_off(snprintf(path, PATH_MAX, "%s/%zu/%zu_%zu.png",
+                            job->files, job->level, column, row)))
+        return FAILURE(RUNTIME_ERROR, "Path of tile %zu_%zu is too long!", column, row);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't create %s: %s", path, strerror(errno));
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_for_fd(&writer, fd) CATCH({
+        close(fd);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to create writer for %s!", path);
+    });
+
+    stack_trace* encoded = png_write_rgb(&writer, canvas->pixels, canvas->width, canvas->height);
+
+    bool is_failed = writer.failed;
+    stack_trace* destroyed = buffered_writer_destroy(&writer);
+    close(fd);
+
+    TRY encoded CATCH({
+        trace_destruct(destroyed);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to encode %s!", path);
+    });
+
+    TRY destroyed FAIL("Failed to write %s!", path);
+
+    if (is_failed)
+        return FAILURE(RUNTIME_ERROR, "Failed to write %s!", path);
+
+    return SUCCESS();
+}
+
+static stack_trace* render_tile(tile_job* job, tile_canvas* canvas, viewport_result* hits,
+                                size_t tile) {
+    const size_t tile_size = job->options.tile_size,
+                 column = tile % job->columns, row = tile / job->columns;
+
+    canvas->left  = (double) (column * tile_size), canvas->top = (double) (row * tile_size);
+    canvas->width  = job->level_width  - column * tile_size < tile_size ?
+                     job->level_width  - column * tile_size : tile_size;
+    canvas->height = job->level_height - row    * tile_size < tile_size ?
+                     job->level_height - row    * tile_size : tile_size;
+
+    // Area of tile with a pixel around, where lines touching it are
+    const double pixel = 1 / job->zoom;
+    layout_box area = {
+        .left   = job->bounds.left + canvas->left / job->zoom - pixel,
+        .bottom = job->bounds.top  - (canvas->top + (double) canvas->height) / job->zoom - pixel,
+        .right  = job->bounds.left + (canvas->left + (double) canvas->width) / job->zoom + pixel,
+        .top    = job->bounds.top  - canvas->top / job->zoom + pixel
+    };
+
+    TRY query_viewport(job->index, area, job->zoom, hits)
+        FAIL("Failed to find elements of tile %zu_%zu!", column, row);
+
+    if (hits->count == 0)
+        return SUCCESS();
+
+    // Background is white
+    memset(canvas->pixels, 0xff, 3 * canvas->width * canvas->height);
+    canvas->is_drawn = false;
+
+    draw_hits(job, canvas, hits);
+
+    // Elements may overlap tile's area, but miss it's pixels
+    if (!canvas->is_drawn)
+        return SUCCESS();
+
+    TRY write_tile(job, canvas, column, row)
+        FAIL("Failed to write tile %zu_%zu!", column, row);
+
+    __atomic_add_fetch(&job->written, 1, __ATOMIC_RELAXED);
+    return SUCCESS();
+}
+
+static void render_tiles(size_t begin, size_t end, void* argument) {
+    tile_job* job = (tile_job*) argument;
+
+    // Every chunk has one tile's pixels, however big the picture is
+    tile_canvas canvas = {};
+    viewport_result hits = {};
+
+    stack_trace* result = safe_calloc(3 * job->options.tile_size * job->options.tile_size,
+                                      &canvas.pixels);
+
+    for (size_t tile = begin; tile < end && trace_is_success(result); ++ tile)
+        result = render_tile(job, &canvas, &hits, tile);
+
+    if (!trace_is_success(result))
+        __atomic_store_n(&job->failed, true, __ATOMIC_RELAXED);
+
+    trace_destruct(result);
+
+    free(canvas.pixels);
+    viewport_result_destroy(&hits);
+}
+
+// -------------------------------- PYRAMID -----------------------------------
+
+static stack_trace* make_directory(const char* path) {
+    if (mkdir(path, 0755) == -1 && errno != EEXIST)
+        return FAILURE(RUNTIME_ERROR, "Can't create %s: %s", path, strerror(errno));
+
+    return SUCCESS();
+}
+
+static stack_trace* write_descriptor(const char* directory, const char* name,
+                                     size_t width, size_t height, size_t tile_size) {
+    char path[PATH_MAX] = {};
+    if (is_cut_off(snprintf(path, PATH_MAX, "%s/%s.dzi", directory, name)))
+        return FAILURE(RUNTIME_ERROR, "Path of %s.dzi is too long!", name);
+
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        return FAILURE(RUNTIME_ERROR, "Can't create %s: %s", path, strerror(errno));
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_for_file(&writer, file) CATCH({
+        fclose(file);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to create writer for %s!", path);
+    });
+
+    buffered_writer_printf(&writer,
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"                                       "\n"
+        "<Image xmlns=\"http://schemas.microsoft.com/deepzoom/2008\" TileSize=\"%zu\" "
+        "Overlap=\"0\" Format=\"png\">"                                                    "\n"
+        "  <Size Width=\"%zu\" Height=\"%zu\"/>"                                           "\n"
+        "</Image>"                                                                         "\n",
+        tile_size, width, height);
+
+    stack_trace* destroyed = buffered_writer_destroy(&writer);
+    fclose(file);
+
+    TRY destroyed FAIL("Failed to write %s!", path);
+    return SUCCESS();
+}
+
+static stack_trace* render_level(tile_job* job, size_t level, size_t max_level,
+                                 size_t width, size_t height) {
+    const size_t divisor = (size_t) 1 << (max_level - level), tile_size = job->options.tile_size;
+
+    job->level        = level;
+    job->zoom         = job->options.scale / (double) divisor;
+    job->level_width  = (width  + divisor - 1) / divisor;
+    job->level_height = (height + divisor - 1) / divisor;
+    job->columns      = (job->level_width + tile_size - 1) / tile_size;
+
+    const size_t rows = (job->level_height + tile_size - 1) / tile_size;
+
+    char path[PATH_MAX] = {};
+    if (is_cut_off(snprintf(path, PATH_MAX, "%s/%zu", job->files, level)))
+        return FAILURE(RUNTIME_ERROR, "Path of level %zu is too long!", level);
+
+    TRY make_directory(path) FAIL("Failed to create directory of level %zu!", level);
+
+    graphviz_parallel_for(job->columns * rows, render_tiles, job);
+
+    if (job->failed)
+        return FAILURE(RUNTIME_ERROR, "Failed to render tiles of level %zu!", level);
+
+    return SUCCESS();
+}
+
+static stack_trace* render_pyramid(tile_job* job, const char* directory, const char* name) {
+    const layout_box* bounds = &job->bounds;
+
+    // Picture is at least a pixel, even for a single point
+    const size_t width  = (size_t) fmax(ceil((bounds->right - bounds->left)   * job->options.scale), 1),
+                 height = (size_t) fmax(ceil((bounds->top   - bounds->bottom) * job->options.scale), 1);
+
+    size_t max_level = 0;
+    while (((size_t) 1 << max_level) < (width > height ? width : height))
+        ++ max_level;
+
+    TRY make_directory(directory) FAIL("Failed to create directory of pyramid!");
+
+    if (is_cut_off(snprintf(job->files, PATH_MAX, "%s/%s_files", directory, name)))
+        return FAILURE(RUNTIME_ERROR, "Path of %s_files is too long!", name);
+
+    TRY make_directory(job->files) FAIL("Failed to create directory of tiles!");
+
+    TRY write_descriptor(directory, name, width, height, job->options.tile_size)
+        FAIL("Failed to describe pyramid!");
+
+    for (size_t level = 0; level <= max_level; ++ level)
+        TRY render_level(job, level, max_level, width, height)
+            FAIL("Failed to render level %zu of %zu!", level, max_level);
+
+    return SUCCESS();
+}
+
+stack_trace* graph_layout_write_tiles(const graph_layout* layout, const viewport_index* index,
+                                      digraph* graph, const char* directory, const char* name,
+                                      tile_pyramid_options options, size_t* written) {
+    if (!(options.scale > 0) || options.tile_size == 0)
+        return FAILURE(RUNTIME_ERROR, "Tiles %zu at scale %g aren't valid!",
+                       options.tile_size, options.scale);
+
+    viewport_index own_index = {};
+    if (index == NULL) {
+        TRY viewport_index_create(&own_index, layout)
+            FAIL("Failed to index layout!");
+
+        index = &own_index;
+    }
+
+    tile_job job = {
+        .layout = layout, .index = index, .options = options,
+        .bounds = graph_layout_bounds(layout)
+    };
+
+    stack_trace* result = collect_paints(&job, graph);
+
+    if (trace_is_success(result))
+        result = render_pyramid(&job, directory, name);
+
+    free(job.node_paints);
+    free(job.edge_paints);
+    viewport_index_destroy(&own_index);
+
+    TRY result FAIL("Failed to write tiles of %s!", name);
+
+    if (written != NULL)
+        *written = job.written;
+
+    return SUCCESS();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "graphviz.h"
+#include "graphviz-layout.h"
+#include "graphviz-viewport.h"
+#include "trace.h"
+
+#include <stddef.h>
+
+struct tile_pyramid_options {
+    double scale;     // Pixels per point at the deepest level
+    size_t tile_size; // Width and height of tiles in pixels
+};
+
+const tile_pyramid_options TILE_PYRAMID_DEFAULT = { .scale = 1, .tile_size = 256 };
+
+/**
+ * Render @arg layout as a Deep Zoom (DZI) pyramid: @arg directory/@arg name.dzi
+ * describes the picture, tiles are in @arg name_files/<level>/<column>_<row>.png.
+ * The deepest level is the whole picture at @arg options.scale, every
+ * level above is half of it, down to a single pixel.
+ *
+ * Tiles are rasterized concurrently, each gets only elements, that
+ * @arg index finds in it, so memory is a tile per thread, whatever the
+ * size of the picture. Tiles without elements aren't written, viewers
+ * show background in their place. If @arg index is NULL it's built for
+ * the call, hits of index past the layout's elements are skipped. If
+ * @arg graph is not NULL, colors and styles are taken from it, labels
+ * aren't drawn, edges removed since layout was made are drawn black.
+ *
+ * @arg written, if not NULL, is set to the number of written tiles
+ */
+stack_trace* graph_layout_write_tiles(const graph_layout* layout, const viewport_index* index,
+                                      digraph* graph, const char* directory, const char* name,
+                                      tile_pyramid_options options = TILE_PYRAMID_DEFAULT,
+                                      size_t* written = NULL);
@@ -0,0 +1,472 @@
+#include "graphviz-viewport.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphviz-parallel.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+// Leaf's index has this bit set, if it's element is an edge
+const uint32_t VIEWPORT_EDGE_BIT = (uint32_t) 1 << 31;
+
+// Deepest tree, that 32 bit indices can address
+const size_t VIEWPORT_MAX_LEVELS = 9;
+
+// ------------------------------- ELEMENTS -----------------------------------
+
+static viewport_box round_outwards(layout_box box) {
+    viewport_box rounded = {
+        .left  = (float) box.left,  .bottom = (float) box.bottom,
+        .right = (float) box.right, .top    = (float) box.top
+    };
+
+    if (rounded.left   > box.left)   rounded.left   = nextafterf(rounded.left,   -INFINITY);
+    if (rounded.bottom > box.bottom) rounded.bottom = nextafterf(rounded.bottom, -INFINITY);
+    if (rounded.right  < box.right)  rounded.right  = nextafterf(rounded.right,   INFINITY);
+    if (rounded.top    < box.top)    rounded.top    = nextafterf(rounded.top,     INFINITY);
+
+    return rounded;
+}
+
+static void extend_box(viewport_box* box, const viewport_box* other) {
+    box->left   = fminf(box->left,   other->left);
+    box->bottom = fminf(box->bottom, other->bottom);
+    box->right  = fmaxf(box->right,  other->right);
+    box->top    = fmaxf(box->top,    other->top);
+}
+
+static layout_box edge_box(const graph_layout* layout, const layout_edge* current) {
+    if (current->point_count == 0) {
+        layout_point from = layout_box_center(graph_layout_node_box(layout, current->from)),
+                     to   = layout_box_center(graph_layout_node_box(layout, current->to));
+
+        return { fmin(from.x, to.x), fmin(from.y, to.y), fmax(from.x, to.x), fmax(from.y, to.y) };
+    }
+
+    const layout_point* points = &layout->points[current->first_point];
+    layout_box box = { points[0].x, points[0].y, points[0].x, points[0].y };
+
+    for (size_t i = 1; i < current->point_count; ++ i) {
+        box.left   = fmin(box.left,   points[i].x);
+        box.bottom = fmin(box.bottom, points[i].y);
+        box.right  = fmax(box.right,  points[i].x);
+        box.top    = fmax(box.top,    points[i].y);
+    }
+
+    return box;
+}
+
+// Position of point on Hilbert curve, that fills 2^16 x 2^16 square
+static uint32_t hilbert_value(uint32_t x, uint32_t y) {
+    const uint32_t side = 1u << 16;
+    uint32_t value = 0;
+
+    for (uint32_t half = side / 2; half > 0; half /= 2) {
+        uint32_t right = (x & half) > 0, upper = (y & half) > 0;
+        value += half * half * ((3 * right) ^ upper);
+
+        // Rotate quadrant, so curve in it starts and ends where it should
+        if (upper == 0) {
+            if (right == 1)
+                x = side - 1 - x, y = side - 1 - y;
+
+            uint32_t swapped = x;
+            x = y, y = swapped;
+        }
+    }
+
+    return value;
+}
+
+/** State of building, shared by parallel steps */
+struct viewport_build {
+    const graph_layout* layout;
+    size_t item_count;
+
+    viewport_box* items; // Nodes first, then edges
+    viewport_box bounds;
+
+    uint64_t* keys; // Hilbert value in high half, item in low half
+    uint64_t* buffer;
+
+    viewport_box* boxes;
+    uint32_t* indices;
+    const uint64_t* level_ends;
+    size_t level; // Level, that is built by build_level
+};
+
+static void box_items(size_t begin, size_t end, void* argument) {
+    viewport_build* build = (viewport_build*) argument;
+    const graph_layout* layout = build->layout;
+
+    for (size_t i = begin; i < end; ++ i)
+        build->items[i] = round_outwards(i < layout->node_count ? layout->nodes[i].box :
+                                         edge_box(layout, &layout->edges[i - layout->node_count]));
+}
+
+static void key_items(size_t begin, size_t end, void* argument) {
+    viewport_build* build = (viewport_build*) argument;
+    const viewport_box* bounds = &build->bounds;
+
+    const double width  = fmax((double) bounds->right - bounds->left,   1e-9),
+                 height = fmax((double) bounds->top   - bounds->bottom, 1e-9);
+
+    for (size_t i = begin; i < end; ++ i) {
+        const viewport_box* item = &build->items[i];
+
+        double x = ((item->left + item->right) / 2.0 - bounds->left)   / width,
+               y = ((item->bottom + item->top) / 2.0 - bounds->bottom) / height;
+
+        uint32_t cell_x = (uint32_t) fmin(fmax(x * 65535.0, 0), 65535.0),
+                 cell_y = (uint32_t) fmin(fmax(y * 65535.0, 0), 65535.0);
+
+        build->keys[i] = (uint64_t) hilbert_value(cell_x, cell_y) << 32 | (uint64_t) i;
+    }
+}
+
+// Stable radix sort by the high half of keys, so equal values keep item order
+static void sort_keys(viewport_build* build, size_t begin, size_t end) {
+    uint64_t *source = build->keys + begin, *target = build->buffer + begin;
+
+    for (unsigned shift = 32; shift < 64; shift += 8) {
+        size_t counts[256 + 1] = {};
+
+        for (size_t i = 0; i < end - begin; ++ i)
+            ++ counts[((source[i] >> shift) & 0xff) + 1];
+
+        for (size_t digit = 0; digit < 256; ++ digit)
+            counts[digit + 1] += counts[digit];
+
+        for (size_t i = 0; i < end - begin; ++ i)
+            target[counts[(source[i] >> shift) & 0xff] ++] = source[i];
+
+        uint64_t* swapped = source;
+        source = target, target = swapped;
+    }
+
+    // Even number of passes, so sorted keys are back in place
+}
+
+static void fill_leaves(size_t begin, size_t end, void* argument) {
+    viewport_build* build = (viewport_build*) argument;
+    const size_t node_count = build->layout->node_count;
+
+    for (size_t i = begin; i < end; ++ i) {
+        uint32_t item = (uint32_t) build->keys[i];
+
+        build->boxes[i]   = build->items[item];
+        build->indices[i] = item < node_count ? item : (uint32_t) (item - node_count) |
+                                                       VIEWPORT_EDGE_BIT;
+    }
+}
+
+static void build_level(size_t begin, size_t end, void* argument) {
+    viewport_build* build = (viewport_build*) argument;
+
+    const size_t children_begin = build->level > 1 ? build->level_ends[build->level - 2] : 0,
+                 children_end   = build->level_ends[build->level - 1],
+                 level_begin    = children_end;
+
+    for (size_t i = begin; i < end; ++ i) {
+        size_t first = children_begin + i * VIEWPORT_NODE_SIZE,
+               last  = first + VIEWPORT_NODE_SIZE < children_end ?
+                       first + VIEWPORT_NODE_SIZE : children_end;
+
+        viewport_box box = build->boxes[first];
+        for (size_t child = first + 1; child < last; ++ child)
+            extend_box(&box, &build->boxes[child]);
+
+        build->boxes  [level_begin + i] = box;
+        build->indices[level_begin + i] = (uint32_t) first;
+    }
+}
+
+// ------------------------------- STORAGE ------------------------------------
+
+static uint64_t align(uint64_t offset) {
+    return (offset + 7) / 8 * 8;
+}
+
+// Lay out header and arrays of index with @arg level_count levels
+static void place_arrays(viewport_header* header) {
+    header->level_ends = align(sizeof(*header));
+    header->boxes      = align(header->level_ends + header->level_count * sizeof(uint64_t));
+    header->indices    = align(header->boxes + header->box_count * sizeof(viewport_box));
+    header->size       = align(header->indices + header->box_count * sizeof(uint32_t));
+}
+
+static void view_arrays(viewport_index* index, const viewport_header* header) {
+    const char* bytes = (const char*) header;
+
+    index->header     = header;
+    index->level_ends = (const uint64_t*)     (bytes + header->level_ends);
+    index->boxes      = (const viewport_box*) (bytes + header->boxes);
+    index->indices    = (const uint32_t*)     (bytes + header->indices);
+}
+
+// Leaves and boxes of every level above them, up to the root
+static uint64_t count_boxes(uint64_t item_count) {
+    uint64_t box_count = item_count;
+
+    for (uint64_t count = item_count; count > 1; box_count += count)
+        count = (count + VIEWPORT_NODE_SIZE - 1) / VIEWPORT_NODE_SIZE;
+
+    return box_count;
+}
+
+static stack_trace* allocate_storage(viewport_index* index, size_t item_count) {
+    viewport_header header = {
+        .item_count = item_count, .node_size = VIEWPORT_NODE_SIZE,
+        .level_count = 1, .box_count = item_count
+    };
+
+    memcpy(header.magic, VIEWPORT_MAGIC, sizeof(header.magic));
+
+    uint64_t level_ends[VIEWPORT_MAX_LEVELS] = { item_count };
+
+    for (size_t count = item_count; count > 1; ++ header.level_count) {
+        count = (count + VIEWPORT_NODE_SIZE - 1) / VIEWPORT_NODE_SIZE;
+
+        header.box_count += count;
+        level_ends[header.level_count] = header.box_count;
+    }
+
+    place_arrays(&header);
+
+    char* storage = NULL;
+    TRY safe_calloc(header.size, &storage)
+        FAIL("Can't allocate index of %zu bytes!", (size_t) header.size);
+
+    memcpy(storage, &header, sizeof(header));
+    memcpy(storage + header.level_ends, level_ends, header.level_count * sizeof(uint64_t));
+
+    index->storage = storage;
+    view_arrays(index, (const viewport_header*) storage);
+
+    return SUCCESS();
+}
+
+static void build_destroy(viewport_build* build) {
+    free(build->items);
+    free(build->keys);
+    free(build->buffer);
+}
+
+stack_trace* viewport_index_create(viewport_index* index, const graph_layout* layout) {
+    *index = {};
+
+    const size_t item_count = layout->node_count + layout->edge_count;
+
+    // Top bit of leaf index marks edges, and positions of boxes are 32 bit
+    if (layout->node_count >= VIEWPORT_EDGE_BIT || layout->edge_count >= VIEWPORT_EDGE_BIT ||
+        count_boxes(item_count) > UINT32_MAX)
+        return FAILURE(RUNTIME_ERROR, "Can't index %zu elements!", item_count);
+
+    viewport_build build = { .layout = layout, .item_count = item_count };
+
+    TRY safe_calloc(item_count + 1, &build.items) CATCH({
+        build_destroy(&build);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate boxes of elements!");
+    });
+
+    TRY safe_calloc(item_count + 1, &build.keys) CATCH({
+        build_destroy(&build);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate keys of elements!");
+    });
+
+    TRY safe_calloc(item_count + 1, &build.buffer) CATCH({
+        build_destroy(&build);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate keys of elements!");
+    });
+
+    TRY allocate_storage(index, item_count) CATCH({
+        build_destroy(&build);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate index!");
+    });
+
+    graphviz_parallel_for(item_count, box_items, &build);
+
+    if (item_count > 0) {
+        build.bounds = build.items[0];
+        for (size_t i = 1; i < item_count; ++ i)
+            extend_box(&build.bounds, &build.items[i]);
+    }
+
+    graphviz_parallel_for(item_count, key_items, &build);
+
+    // Nodes and edges are sorted apart, so subtrees of small nodes aren't
+    // spread by long edges and still become clusters from afar
+    sort_keys(&build, 0, layout->node_count);
+    sort_keys(&build, layout->node_count, item_count);
+
+    build.boxes      = (viewport_box*) index->boxes;
+    build.indices    = (uint32_t*)     index->indices;
+    build.level_ends = index->level_ends;
+
+    graphviz_parallel_for(item_count, fill_leaves, &build);
+
+    for (build.level = 1; build.level < index->header->level_count; ++ build.level)
+        graphviz_parallel_for(build.level_ends[build.level] - build.level_ends[build.level - 1],
+                              build_level, &build);
+
+    build_destroy(&build);
+    return SUCCESS();
+}
+
+stack_trace* viewport_index_open(viewport_index* index, const void* data, size_t size) {
+    const viewport_header* header = (const viewport_header*) data;
+
+    if (size < sizeof(*header) || memcmp(header->magic, VIEWPORT_MAGIC,
+                                         sizeof(header->magic)) != 0)
+        return FAILURE(RUNTIME_ERROR, "Data isn't a viewport index!");
+
+    if (header->size > size)
+        return FAILURE(RUNTIME_ERROR, "Viewport index is truncated, "
+                       "%zu bytes instead of %zu!", size, (size_t) header->size);
+
+    // Counts are limited by the size first, so placing arrays can't overflow
+    const uint64_t max_boxes = (size - sizeof(*header)) / (sizeof(viewport_box) + sizeof(uint32_t));
+
+    if (header->node_size != VIEWPORT_NODE_SIZE || header->level_count == 0 ||
+        header->level_count > VIEWPORT_MAX_LEVELS || header->box_count > UINT32_MAX ||
+        header->box_count < header->item_count || header->box_count > max_boxes)
+        return FAILURE(RUNTIME_ERROR, "Viewport index is corrupted!");
+
+    // Arrays are checked to be where builder puts them, so they are in bounds
+    viewport_header expected = *header;
+    place_arrays(&expected);
+
+    if (memcmp(&expected, header, sizeof(expected)) != 0)
+        return FAILURE(RUNTIME_ERROR, "Arrays of viewport index are misplaced!");
+
+    *index = {};
+    view_arrays(index, header);
+
+    // Levels should shrink the same way they do, when index is built
+    uint64_t count = header->item_count, end = header->item_count;
+    for (uint64_t level = 0; level < header->level_count; ++ level) {
+        if (index->level_ends[level] != end || (level + 1 == header->level_count) != (count <= 1))
+            return FAILURE(RUNTIME_ERROR, "Levels of viewport index are corrupted!");
+
+        count = (count + VIEWPORT_NODE_SIZE - 1) / VIEWPORT_NODE_SIZE, end += count;
+    }
+
+    // Root is the last box, there's nothing after it
+    if (header->box_count != index->level_ends[header->level_count - 1])
+        return FAILURE(RUNTIME_ERROR, "Viewport index has %zu boxes instead of %zu!",
+                       (size_t) header->box_count,
+                       (size_t) index->level_ends[header->level_count - 1]);
+
+    return SUCCESS();
+}
+
+void viewport_index_destroy(viewport_index* index) {
+    free(index->storage);
+    *index = {};
+}
+
+void viewport_index_write(buffered_writer* writer, const viewport_index* index) {
+    buffered_writer_write(writer, index->header, index->header->size);
+}
+
+// -------------------------------- QUERIES -----------------------------------
+
+static bool boxes_overlap(const viewport_box* box, const layout_box* area) {
+    return box->left <= area->right && area->left <= box->right &&
+           box->bottom <= area->top && area->bottom <= box->top;
+}
+
+static uint8_t detail_at(const viewport_box* box, double zoom) {
+    const double width  = ((double) box->right - box->left)   * zoom,
+                 height = ((double) box->top   - box->bottom) * zoom;
+
+    if (fmax(width, height) < VIEWPORT_OUTLINE_PIXELS)
+        return DETAIL_POINT;
+
+    return height >= VIEWPORT_LABEL_PIXELS ? DETAIL_OUTLINE | DETAIL_LABEL : DETAIL_OUTLINE;
+}
+
+static stack_trace* add_hit(viewport_result* result, viewport_hit hit) {
+    if (result->count == result->capacity) {
+        size_t new_capacity = result->capacity > 0 ? result->capacity * 2 : 256;
+
+        viewport_hit* grown = (viewport_hit*) realloc(result->hits, new_capacity * sizeof(hit));
+        if (grown == NULL)
+            return FAILURE(RUNTIME_ERROR, "Can't grow result to %zu hits!", new_capacity);
+
+        result->hits = grown, result->capacity = new_capacity;
+    }
+
+    result->hits[result->count ++] = hit;
+    return SUCCESS();
+}
+
+stack_trace* query_viewport(const viewport_index* index, layout_box area, double zoom,
+                            viewport_result* result) {
+    result->count = 0;
+
+    const uint64_t box_count = index->header->box_count, leaf_end = index->level_ends[0];
+    if (box_count == 0 || !boxes_overlap(&index->boxes[box_count - 1], &area))
+        return SUCCESS();
+
+    // Every level adds at most a node's children to the stack
+    uint32_t stack[VIEWPORT_MAX_LEVELS * VIEWPORT_NODE_SIZE] = {};
+    size_t depth = 0;
+
+    stack[depth ++] = (uint32_t) (box_count - 1);
+
+    while (depth > 0) {
+        const uint32_t position = stack[-- depth];
+        const viewport_box* box = &index->boxes[position];
+
+        if (position < leaf_end) {
+            uint32_t element = index->indices[position];
+
+            TRY add_hit(result, {
+                .box = *box, .element = element & ~VIEWPORT_EDGE_BIT,
+                .kind = element & VIEWPORT_EDGE_BIT ? VIEWPORT_EDGE : VIEWPORT_NODE,
+                .detail = detail_at(box, zoom)
+            }) FAIL("Failed to add element!");
+
+            continue;
+        }
+
+        const double size = fmax((double) box->right - box->left, (double) box->top - box->bottom);
+
+        if (size * zoom < VIEWPORT_CLUSTER_PIXELS) {
+            TRY add_hit(result, {
+                .box = *box, .element = position, .kind = VIEWPORT_CLUSTER,
+                .detail = DETAIL_POINT
+            }) FAIL("Failed to add cluster!");
+
+            continue;
+        }
+
+        // Children of node are on the previous level, the last node may have fewer
+        size_t level = 1;
+        while (position >= index->level_ends[level])
+            ++ level;
+
+        const uint64_t first = index->indices[position], children_end = index->level_ends[level - 1];
+        const uint64_t last  = first + VIEWPORT_NODE_SIZE < children_end ?
+                               first + VIEWPORT_NODE_SIZE : children_end;
+
+        // Mapped index may be corrupted, children are checked to be on their level
+        if (first >= children_end || (level > 1 && first < index->level_ends[level - 2]))
+            return FAILURE(RUNTIME_ERROR, "Box %u of viewport index is corrupted!", position);
+
+        // Children are pushed backwards, so hits keep Hilbert order
+        for (uint64_t child = last; child-- > first; )
+            if (boxes_overlap(&index->boxes[child], &area))
+                stack[depth ++] = (uint32_t) child;
+    }
+
+    return SUCCESS();
+}
+
+void viewport_result_destroy(viewport_result* result) {
+    free(result->hits);
+    *result = {};
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "graphviz-layout.h"
+#include "graphviz-writer.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// First bytes of every serialized viewport index, includes format version
+const char VIEWPORT_MAGIC[8] = "GVRTR01";
+
+// Children of every node of the tree
+const size_t VIEWPORT_NODE_SIZE = 16;
+
+/** Box, that is rounded outwards to floats, so it still covers the element */
+struct viewport_box {
+    float left, bottom, right, top;
+};
+
+/**
+ * Header of serialized index, followed by arrays. Every array is aligned
+ * to 8 bytes and starts at given offset from the start of the file, so
+ * index can be memory mapped next to a columnar graph and used as is.
+ *
+ * Tree is packed: level 0 are boxes of elements sorted by Hilbert curve,
+ * every next level has a box around each VIEWPORT_NODE_SIZE boxes of the
+ * previous one, the root is the last box.
+ */
+struct viewport_header {
+    char magic[8];
+
+    uint64_t item_count, node_size, level_count, box_count;
+
+    uint64_t level_ends; // uint64_t, level i ends before box level_ends[i]
+    uint64_t boxes;      // viewport_box
+    uint64_t indices;    // uint32_t, element of leaf or first child of node
+
+    uint64_t size; // Size of the whole file
+};
+
+/**
+ * Packed Hilbert R-tree over boxes of nodes and edges of a layout. Built
+ * index owns it's memory in serialized form, opened one is a view into
+ * someone else's data
+ */
+struct viewport_index {
+    const viewport_header* header;
+
+    const uint64_t* level_ends;
+    const viewport_box* boxes;
+    const uint32_t* indices;
+
+    void* storage; // NULL if index is a view
+};
+
+enum viewport_kind : uint8_t {
+    VIEWPORT_NODE,   // Element is position of node in layout's nodes
+    VIEWPORT_EDGE,   // Element is position of edge in layout's edges
+    VIEWPORT_CLUSTER // Elements too small to be told apart, element is tree's box
+};
+
+/** Level of detail flags, what of element is worth drawing at given zoom */
+enum viewport_detail : uint8_t {
+    DETAIL_POINT   = 1 << 0, // Smaller than VIEWPORT_OUTLINE_PIXELS, just a dot
+    DETAIL_OUTLINE = 1 << 1, // Shape or route
+    DETAIL_LABEL   = 1 << 2  // Big enough for a readable label
+};
+
+// Elements smaller than this on screen are drawn as dots
+const double VIEWPORT_OUTLINE_PIXELS = 2;
+
+// Elements lower than this on screen don't get labels
+const double VIEWPORT_LABEL_PIXELS = 12;
+
+// Nodes of tree smaller than this on screen are returned as clusters, so
+// zoomed out view gets one hit per cluster instead of one per element
+const double VIEWPORT_CLUSTER_PIXELS = 8;
+
+struct viewport_hit {
+    viewport_box box;
+
+    uint32_t element;
+    viewport_kind kind;
+    uint8_t detail;
+};
+
+/** Hits of a query, reused between queries, so they don't allocate */
+struct viewport_result {
+    viewport_hit* hits;
+    size_t count, capacity;
+};
+
+/**
+ * Index nodes of @arg layout and it's edges, edges are indexed by boxes
+ * of their routes, or by centers of their nodes if they aren't routed
+ */
+stack_trace* viewport_index_create(viewport_index* index, const graph_layout* layout);
+
+/**
+ * Check that @arg size bytes of @arg data are a serialized index, and
+ * view it in place, @arg data should outlive the index
+ */
+stack_trace* viewport_index_open(viewport_index* index, const void* data, size_t size);
+
+void viewport_index_destroy(viewport_index* index);
+
+/**
+ * Write index in the form, that viewport_index_open understands
+ */
+void viewport_index_write(buffered_writer* writer, const viewport_index* index);
+
+/**
+ * Find elements, that overlap @arg area, given in layout's coordinates,
+ * when it's shown with @arg zoom pixels per point. Old hits of @arg result
+ * are replaced. Whole subtrees, that are smaller than a few pixels,
+ * are returned as one cluster, so work depends on what is visible on the
+ * screen, rather than on the size of the graph
+ */
+stack_trace* query_viewport(const viewport_index* index, layout_box area, double zoom,
+                            viewport_result* result);
+
+void viewport_result_destroy(viewport_result* result);
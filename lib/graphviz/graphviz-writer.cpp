@@ -0,0 +1,250 @@
+#include "graphviz-writer.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "safe-alloc.h"
+#include "trace.h"
+
+// Big enough to make syscalls rare, small enough to stay in cache
+const size_t WRITER_BUFFER_CAPACITY = 64 * 1024;
+
+// How much in memory writer grows when it runs out of space
+const double WRITER_GROW = 2.0;
+
+static stack_trace* buffered_writer_create(buffered_writer* writer,
+                                           buffered_writer_sink sink) {
+    *writer = {
+        .buffer = NULL, .size = 0, .capacity = WRITER_BUFFER_CAPACITY,
+        .sink = sink, .file = NULL, .fd = -1, .failed = false
+    };
+
+    TRY safe_calloc(writer->capacity, &writer->buffer)
+        FAIL("Failed to allocate writer's buffer!");
+
+    return SUCCESS();
+}
+
+stack_trace* buffered_writer_create_for_file(buffered_writer* writer, FILE* file) {
+    TRY buffered_writer_create(writer, WRITER_FILE)
+        FAIL("Failed to create writer for file!");
+
+    writer->file = file;
+    return SUCCESS();
+}
+
+stack_trace* buffered_writer_create_for_fd(buffered_writer* writer, int fd) {
+    TRY buffered_writer_create(writer, WRITER_FD)
+        FAIL("Failed to create writer for descriptor %d!", fd);
+
+    writer->fd = fd;
+    return SUCCESS();
+}
+
+stack_trace* buffered_writer_create_in_memory(buffered_writer* writer) {
+    TRY buffered_writer_create(writer, WRITER_MEMORY)
+        FAIL("Failed to create in memory writer!");
+
+    return SUCCESS();
+}
+
+static stack_trace* write_to_sink(buffered_writer* writer, const char* data, size_t size) {
+    if (writer->sink == WRITER_FILE) {
+        if (fwrite(data, sizeof(char), size, writer->file) != size)
+            return FAILURE(RUNTIME_ERROR, "Failed to write %zu bytes: %s",
+                           size, strerror(errno));
+
+        return SUCCESS();
+    }
+
+    while (size > 0) {
+        ssize_t written = write(writer->fd, data, size);
+
+        if (written == -1 && errno == EINTR)
+            continue;
+
+        if (written == -1)
+            return FAILURE(RUNTIME_ERROR, "Failed to write %zu bytes: %s",
+                           size, strerror(errno));
+
+        data += written, size -= (size_t) written;
+    }
+
+    return SUCCESS();
+}
+
+stack_trace* buffered_writer_flush(buffered_writer* writer) {
+    if (writer->sink == WRITER_MEMORY || writer->size == 0)
+        return SUCCESS();
+
+    // Buffer is emptied anyway, so failed writer won't grow forever
+    stack_trace* trace = write_to_sink(writer, writer->buffer, writer->size);
+    writer->size = 0;
+
+    if (!trace_is_success(trace)) {
+        writer->failed = true;
+        return PASS_FAILURE(trace, RUNTIME_ERROR, "Failed to flush writer!");
+    }
+
+    return SUCCESS();
+}
+
+stack_trace* buffered_writer_destroy(buffered_writer* writer) {
+    stack_trace* trace = buffered_writer_flush(writer);
+
+    free(writer->buffer), writer->buffer = NULL;
+    writer->size = writer->capacity = 0;
+
+    if (!trace_is_success(trace))
+        return PASS_FAILURE(trace, RUNTIME_ERROR, "Writer's output was lost!");
+
+    if (writer->failed)
+        return FAILURE(RUNTIME_ERROR, "Part of writer's output was lost!");
+
+    return SUCCESS();
+}
+
+char* buffered_writer_take(buffered_writer* writer, size_t* size) {
+    char* output = writer->buffer;
+    *size = writer->size;
+
+    // New buffer is allocated by the next write
+    writer->buffer = NULL;
+    writer->size = writer->capacity = 0;
+
+    return output;
+}
+
+// Make sure that @arg size more bytes fit into in memory writer
+static bool reserve(buffered_writer* writer, size_t size) {
+    size_t new_capacity = writer->capacity > 0 ? writer->capacity : WRITER_BUFFER_CAPACITY;
+    while (new_capacity - writer->size < size)
+        new_capacity = (size_t) ((double) new_capacity * WRITER_GROW);
+
+    if (new_capacity == writer->capacity)
+        return true;
+
+    char* new_buffer = (char*) realloc(writer->buffer, new_capacity);
+    if (new_buffer == NULL)
+        return false;
+
+    writer->buffer = new_buffer;
+    writer->capacity = new_capacity;
+
+    return true;
+}
+
+// Make space for @arg size more bytes, by flushing or growing buffer
+static bool make_space(buffered_writer* writer, size_t size) {
+    if (writer->capacity - writer->size >= size)
+        return true;
+
+    if (writer->sink == WRITER_MEMORY)
+        return reserve(writer, size);
+
+    stack_trace* trace = buffered_writer_flush(writer);
+    trace_destruct(trace); // Failure is remembered by writer
+
+    return writer->capacity >= size;
+}
+
+void buffered_writer_write(buffered_writer* writer, const void* data, size_t size) {
+    if (make_space(writer, size)) {
+        memcpy(writer->buffer + writer->size, data, size);
+        writer->size += size;
+        return;
+    }
+
+    // Too big for the buffer, it's faster to pass it to the sink as is
+    if (writer->sink != WRITER_MEMORY) {
+        stack_trace* trace = write_to_sink(writer, (const char*) data, size);
+
+        writer->failed = writer->failed || !trace_is_success(trace);
+        trace_destruct(trace);
+    } else writer->failed = true;
+}
+
+void buffered_writer_puts(buffered_writer* writer, const char* string) {
+    buffered_writer_write(writer, string, strlen(string));
+}
+
+void buffered_writer_vprintf(buffered_writer* writer, const char* format, va_list args) {
+    // This allows to then restore changes to diagnostic rules
+    #pragma clang diagnostic push
+
+    // This function itself is intended for use with string
+    // literals, so it should be ok to disable warning:
+
+    #pragma clang diagnostic ignored "-Wformat-nonliteral"
+
+    // We need to copy args, because we may use them twice
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    // Usually output fits in the buffer, and is printed right into it
+    size_t space = writer->capacity - writer->size;
+    int size = vsnprintf(writer->buffer + writer->size, space, format, args_copy);
+
+    va_end(args_copy);
+
+    if (size < 0) {
+        writer->failed = true;
+        return;
+    }
+
+    if ((size_t) size < space) {
+        writer->size += (size_t) size;
+        return;
+    }
+
+    if (make_space(writer, (size_t) size + 1 /* For '\0' */)) {
+        vsnprintf(writer->buffer + writer->size, (size_t) size + 1, format, args);
+        writer->size += (size_t) size;
+        return;
+    }
+
+    // Doesn't fit even in the empty buffer
+    char* output = (char*) calloc((size_t) size + 1, sizeof(*output));
+    if (output == NULL) {
+        writer->failed = true;
+        return;
+    }
+
+    vsnprintf(output, (size_t) size + 1, format, args);
+    buffered_writer_write(writer, output, (size_t) size);
+
+    free(output), output = NULL;
+
+    // And restore warning back
+    #pragma clang diagnostic pop
+}
+
+void buffered_writer_printf(buffered_writer* writer, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    buffered_writer_vprintf(writer, format, args);
+
+    va_end(args);
+}
+
+void buffered_writer_write_int(buffered_writer* writer, int64_t number) {
+    const size_t max_digits = 20;
+    char digits[max_digits];
+
+    // Negate in unsigned arithmetic, so the smallest number works too
+    uint64_t magnitude = number < 0 ? 0 - (uint64_t) number : (uint64_t) number;
+
+    size_t begin = max_digits;
+    do {
+        digits[-- begin] = (char) ('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (number < 0)
+        buffered_writer_putc(writer, '-');
+
+    buffered_writer_write(writer, digits + begin, max_digits - begin);
+}
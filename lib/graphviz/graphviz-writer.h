@@ -0,0 +1,69 @@
+#pragma once
+
+#include "trace.h"
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/** Where buffered writer puts it's output */
+enum buffered_writer_sink {
+    WRITER_FILE,  // stdio FILE, output is passed to fwrite in big chunks
+    WRITER_FD,    // File descriptor, output is passed to write directly
+    WRITER_MEMORY // Buffer just grows, output stays in it
+};
+
+/**
+ * Output buffer, that is shared by every graph writer. It collects small
+ * writes and passes them to it's sink in big chunks.
+ */
+struct buffered_writer {
+    char* buffer;
+    size_t size, capacity;
+
+    buffered_writer_sink sink;
+    FILE* file;
+    int fd;
+
+    bool failed; // Set if some write to the sink failed, output is lost
+};
+
+stack_trace* buffered_writer_create_for_file(buffered_writer* writer, FILE* file);
+stack_trace* buffered_writer_create_for_fd  (buffered_writer* writer, int fd);
+stack_trace* buffered_writer_create_in_memory(buffered_writer* writer);
+
+/**
+ * Pass buffered output to the sink, does nothing for in memory writers
+ */
+stack_trace* buffered_writer_flush(buffered_writer* writer);
+
+/**
+ * Flush writer and free it's buffer, output of in memory
+ * writer should be taken before with buffered_writer_take
+ */
+stack_trace* buffered_writer_destroy(buffered_writer* writer);
+
+/**
+ * Take output of in memory writer, it should be freed by the caller
+ * and writer becomes empty
+ */
+char* buffered_writer_take(buffered_writer* writer, size_t* size);
+
+void buffered_writer_write(buffered_writer* writer, const void* data, size_t size);
+
+void buffered_writer_puts(buffered_writer* writer, const char* string);
+
+inline void buffered_writer_putc(buffered_writer* writer, char symbol) {
+    if (writer->size == writer->capacity)
+        buffered_writer_write(writer, &symbol, 1);
+    else
+        writer->buffer[writer->size ++] = symbol;
+}
+
+void buffered_writer_vprintf(buffered_writer* writer, const char* format, va_list args);
+
+void buffered_writer_printf(buffered_writer* writer, const char* format, ...);
+
+// Write decimal representation of @arg number, faster than printf
+void buffered_writer_write_int(buffered_writer* writer, int64_t number);
@@ -4,11 +4,13 @@
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "trace.h"
 #include "hash-table.h"
 #include "default-hash-functions.h"
 #include "printf-utils.h"
+#include "graphviz-parallel-writer.h"
 
 hash_table<int, const char*> graphviz_rank_names =
     HASH_TABLE(int, const char*, int_hash,
@@ -108,7 +110,7 @@ subgraph_id digraph_create_subgraph(digraph* graph, graphviz_rank_type rank) {
 }
 
 
-node_id subgraph_insert_node(digraph* graph, subgraph_id subgraph_pos, node new_node) {
+static node_id subgraph_append_node(digraph* graph, subgraph_id subgraph_pos, node new_node) {
     subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
 
     TRY linked_list_push_back(&current_subgraph->nodes, new_node)
@@ -118,9 +120,101 @@ node_id subgraph_insert_node(digraph* graph, subgraph_id subgraph_pos, node new_
     return linked_list_tail_index(&current_subgraph->nodes);
 }
 
+static inline bool digraph_has_name_index(digraph* graph) {
+    return graph->name_index.hash_table != NULL;
+}
+
+node_id subgraph_insert_node(digraph* graph, subgraph_id subgraph_pos, node new_node) {
+    node_id new_node_id = subgraph_append_node(graph, subgraph_pos, new_node);
+
+    // Keep name index up to date, existing names aren't replaced
+    if (digraph_has_name_index(graph) && new_node.label != NULL)
+        hash_table_insert(&graph->name_index,
+                          (const char*) new_node.label, new_node_id);
+
+    return new_node_id;
+}
+
+void digraph_create_name_index(digraph* graph) {
+    if (digraph_has_name_index(graph))
+        return;
+
+    TRY hash_table_create(&graph->name_index, str_hash, 32, 10, str_equals)
+        THROW("Failed to create name index!");
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.nodes, node, current_node)
+            if (current_node->element.label != NULL)
+                hash_table_insert(&graph->name_index,
+                                  (const char*) current_node->element.label,
+                                  linked_list_get_index(&current->element.nodes,
+                                                        current_node));
+}
+
+node_id subgraph_get_or_insert_node(digraph* graph, subgraph_id subgraph_pos,
+                                    const char* name, node default_node) {
+    digraph_create_name_index(graph);
+
+    bool inserted = false;
+    hash_table_pair<const char*, node_id>* pair =
+        hash_table_lookup_or_insert(&graph->name_index, name,
+                                    linked_list_end_index, &inserted);
+
+    if (!inserted)
+        return pair->value;
+
+    // Node owns it's label, and index shares it, so there's no second copy
+    default_node.label = strdup(name);
+    pair->key = default_node.label;
+
+    // Pair is already in the index, so node is appended without indexing
+    pair->value = subgraph_append_node(graph, subgraph_pos, default_node);
+    return pair->value;
+}
+
+size_t vlabel_size(const char* default_label, const char* format, va_list args) {
+    if (format == NULL)
+        return (default_label != NULL ? strlen(default_label) : 0) + 1;
+
+    #pragma clang diagnostic push
+
+    // This function itself is intended for use with string
+    // literals, so it should be ok to disable warning:
+
+    #pragma clang diagnostic ignored "-Wformat-nonliteral"
+
+    // Args are used again to format label, so only their copy is consumed
+    va_list args_copy;
+    va_copy(args_copy, args);
+
+    size_t label_size = (size_t) vsnprintf(NULL, 0, format, args_copy) + 1;
+
+    va_end(args_copy);
+
+    #pragma clang diagnostic pop
+
+    return label_size;
+}
+
+void vformat_label(char* destination, size_t size, const char* default_label,
+                   const char* format, va_list args) {
+    if (format == NULL) {
+        snprintf(destination, size, "%s", default_label != NULL ? default_label : "");
+        return;
+    }
+
+    #pragma clang diagnostic push
+    #pragma clang diagnostic ignored "-Wformat-nonliteral"
+
+    vsnprintf(destination, size, format, args);
+
+    #pragma clang diagnostic pop
+}
+
 node vnode_from_default(node default_node, const char* format, va_list args) {
     // Default node is copied
-    default_node.label = vsprintf_to_new_buffer(format, args);
+    if (format != NULL)
+        default_node.label = vsprintf_to_new_buffer(format, args);
 
     return default_node;
 }
@@ -150,11 +244,202 @@ node_id subgraph_insert_default_node(digraph* graph, subgraph_id subgraph_pos,
 }
 
 
-void subgraph_insert_edge(digraph* graph, subgraph_id subgraph_pos, edge new_edge) {
+// Pairs of entries, that incidence index starts with
+const size_t INCIDENCE_DEFAULT_PAIRS = 32;
+
+static inline bool digraph_has_incidence_index(digraph* graph) {
+    return graph->incidence.entries != NULL;
+}
+
+// Capacity, doubled from @arg capacity until @arg index fits in it
+static size_t incidence_grown_capacity(size_t capacity, size_t index) {
+    size_t new_capacity = capacity > 0 ? capacity : 1;
+    while (new_capacity <= index)
+        new_capacity *= 2;
+
+    return new_capacity;
+}
+
+static stack_trace* incidence_reserve_node(digraph_incidence* incidence, node_id node) {
+    if ((size_t) node < incidence->node_capacity)
+        return SUCCESS();
+
+    size_t new_capacity = incidence_grown_capacity(incidence->node_capacity, (size_t) node);
+
+    size_t* new_first = (size_t*) realloc(incidence->first, new_capacity * sizeof(*new_first));
+    if (new_first == NULL)
+        return FAILURE(RUNTIME_ERROR, "Can't index edges of %zu nodes!", new_capacity);
+
+    incidence->first = new_first;
+    for (; incidence->node_capacity < new_capacity; ++ incidence->node_capacity)
+        incidence->first[incidence->node_capacity] = INCIDENCE_NONE;
+
+    return SUCCESS();
+}
+
+static stack_trace* incidence_reserve_edge(digraph_incidence* incidence,
+                                           subgraph_id subgraph_pos, edge_id edge_pos) {
+    if ((size_t) subgraph_pos >= incidence->subgraph_capacity) {
+        size_t new_capacity = incidence_grown_capacity(incidence->subgraph_capacity,
+                                                       (size_t) subgraph_pos);
+
+        incidence_pairs* new_pairs = (incidence_pairs*)
+            realloc(incidence->subgraph_pairs, new_capacity * sizeof(*new_pairs));
+
+        if (new_pairs == NULL)
+            return FAILURE(RUNTIME_ERROR, "Can't index edges of %zu subgraphs!", new_capacity);
+
+        incidence->subgraph_pairs = new_pairs;
+        for (; incidence->subgraph_capacity < new_capacity; ++ incidence->subgraph_capacity)
+            incidence->subgraph_pairs[incidence->subgraph_capacity] = {};
+    }
+
+    incidence_pairs* pairs = &incidence->subgraph_pairs[subgraph_pos];
+    if ((size_t) edge_pos < pairs->capacity)
+        return SUCCESS();
+
+    size_t new_capacity = incidence_grown_capacity(pairs->capacity, (size_t) edge_pos);
+
+    size_t* new_pairs = (size_t*) realloc(pairs->pairs, new_capacity * sizeof(*new_pairs));
+    if (new_pairs == NULL)
+        return FAILURE(RUNTIME_ERROR, "Can't index %zu edges of subgraph %d!",
+                       new_capacity, subgraph_pos);
+
+    pairs->pairs = new_pairs, pairs->capacity = new_capacity;
+    return SUCCESS();
+}
+
+// Add new pairs to the free list, index is seen as created after first call
+static stack_trace* incidence_grow(digraph_incidence* incidence) {
+    size_t old_capacity = incidence->entry_capacity,
+           new_capacity = old_capacity > 0 ? old_capacity * 2 : INCIDENCE_DEFAULT_PAIRS * 2;
+
+    incidence_entry* new_entries = (incidence_entry*)
+        realloc(incidence->entries, new_capacity * sizeof(*new_entries));
+
+    if (new_entries == NULL)
+        return FAILURE(RUNTIME_ERROR, "Can't index %zu edges!", new_capacity / 2);
+
+    incidence->entries = new_entries;
+    incidence->entry_capacity = new_capacity;
+
+    for (size_t pair = old_capacity; pair < new_capacity; pair += 2)
+        incidence->entries[pair].next = pair + 2 < new_capacity ? pair + 2 : incidence->free_pair;
+
+    incidence->free_pair = old_capacity;
+    return SUCCESS();
+}
+
+static void incidence_link(digraph_incidence* incidence, size_t entry, node_id node,
+                           subgraph_id subgraph_pos, edge_id edge_pos) {
+    size_t* first = &incidence->first[node];
+
+    incidence->entries[entry] = {
+        .node = node, .subgraph = subgraph_pos, .edge = edge_pos,
+        .next = *first, .prev = INCIDENCE_NONE
+    };
+
+    if (*first != INCIDENCE_NONE)
+        incidence->entries[*first].prev = entry;
+
+    *first = entry;
+}
+
+static void incidence_unlink(digraph_incidence* incidence, size_t entry) {
+    incidence_entry* current = &incidence->entries[entry];
+
+    if (current->prev != INCIDENCE_NONE)
+        incidence->entries[current->prev].next = current->next;
+    else
+        incidence->first[current->node] = current->next;
+
+    if (current->next != INCIDENCE_NONE)
+        incidence->entries[current->next].prev = current->prev;
+}
+
+static stack_trace* incidence_insert_edge(digraph_incidence* incidence, subgraph_id subgraph_pos,
+                                          edge_id edge_pos, edge* current_edge) {
+    if (incidence->free_pair == INCIDENCE_NONE)
+        TRY incidence_grow(incidence) FAIL("Failed to grow incidence index!");
+
+    TRY incidence_reserve_node(incidence, current_edge->from > current_edge->to ?
+                                          current_edge->from : current_edge->to)
+        FAIL("Failed to index edge %d -> %d!", current_edge->from, current_edge->to);
+
+    TRY incidence_reserve_edge(incidence, subgraph_pos, edge_pos)
+        FAIL("Failed to index edge %d of subgraph %d!", edge_pos, subgraph_pos);
+
+    size_t pair = incidence->free_pair;
+    incidence->free_pair = incidence->entries[pair].next;
+
+    incidence_link(incidence, pair,     current_edge->from, subgraph_pos, edge_pos);
+    incidence_link(incidence, pair + 1, current_edge->to,   subgraph_pos, edge_pos);
+
+    incidence->subgraph_pairs[subgraph_pos].pairs[edge_pos] = pair;
+    return SUCCESS();
+}
+
+static void incidence_delete_edge(digraph_incidence* incidence,
+                                  subgraph_id subgraph_pos, edge_id edge_pos) {
+    size_t pair = incidence->subgraph_pairs[subgraph_pos].pairs[edge_pos];
+
+    incidence_unlink(incidence, pair);
+    incidence_unlink(incidence, pair + 1);
+
+    incidence->entries[pair].next = incidence->free_pair;
+    incidence->free_pair = pair;
+}
+
+static void incidence_destroy(digraph_incidence* incidence) {
+    free(incidence->entries);
+    free(incidence->first);
+
+    for (size_t i = 0; i < incidence->subgraph_capacity; ++ i)
+        free(incidence->subgraph_pairs[i].pairs);
+
+    free(incidence->subgraph_pairs);
+
+    *incidence = {};
+}
+
+void digraph_create_incidence_index(digraph* graph) {
+    if (digraph_has_incidence_index(graph))
+        return;
+
+    graph->incidence = {
+        .entries = NULL, .entry_capacity = 0, .free_pair = INCIDENCE_NONE,
+        .first = NULL, .node_capacity = 0,
+        .subgraph_pairs = NULL, .subgraph_capacity = 0
+    };
+
+    TRY incidence_grow(&graph->incidence)
+        THROW("Failed to create incidence index!");
+
+    LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
+        LINKED_LIST_TRAVERSE(&current->element.edges, edge, current_edge)
+            TRY incidence_insert_edge(&graph->incidence,
+                                      linked_list_get_index(&graph->subgraphs, current),
+                                      linked_list_get_index(&current->element.edges, current_edge),
+                                      &current_edge->element)
+                THROW("Failed to index edges!");
+}
+
+
+edge_id subgraph_insert_edge(digraph* graph, subgraph_id subgraph_pos, edge new_edge) {
     subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
 
     TRY linked_list_push_back(&current_subgraph->edges, new_edge)
         THROW("Failed to insert new edge!");
+
+    edge_id new_edge_id = linked_list_tail_index(&current_subgraph->edges);
+
+    // Keep incidence index up to date
+    if (digraph_has_incidence_index(graph))
+        TRY incidence_insert_edge(&graph->incidence, subgraph_pos, new_edge_id,
+                                  subgraph_get_edge(graph, subgraph_pos, new_edge_id))
+            THROW("Failed to index new edge!");
+
+    return new_edge_id;
 }
 
 
@@ -185,8 +470,8 @@ edge edge_from_default(edge default_edge, node_id from, node_id to,
     return new_edge;
 }
 
-void subgraph_insert_default_edge(digraph* graph, subgraph_id subgraph_pos, edge default_edge,
-                                  node_id node_from, node_id node_to, const char* format, ...) {
+edge_id subgraph_insert_default_edge(digraph* graph, subgraph_id subgraph_pos, edge default_edge,
+                                     node_id node_from, node_id node_to, const char* format, ...) {
 
     va_list args;
     va_start(args, format);
@@ -196,65 +481,350 @@ void subgraph_insert_default_edge(digraph* graph, subgraph_id subgraph_pos, edge
 
     va_end(args);
 
-    subgraph_insert_edge(graph, subgraph_pos, edge_to_insert);
+    return subgraph_insert_edge(graph, subgraph_pos, edge_to_insert);
+}
+
+
+typedef hash_table<element_index_t, attribute_run*> attribute_table;
+
+static attribute_run* attributes_lookup(attribute_table* attributes, element_index_t element) {
+    if (attributes->hash_table == NULL)
+        return NULL;
+
+    attribute_run** run = hash_table_lookup(attributes, element);
+    return run != NULL ? *run : NULL;
+}
+
+static void attributes_set(attribute_table* attributes, element_index_t element,
+                           attribute value) {
+    if (attributes->hash_table == NULL)
+        TRY hash_table_create(attributes, int_hash)
+            THROW("Failed to create table of extra attributes!");
+
+    bool inserted = false;
+    hash_table_pair<element_index_t, attribute_run*>* pair =
+        hash_table_lookup_or_insert(attributes, element, (attribute_run*) NULL, &inserted);
+
+    TRY attribute_run_set(&pair->value, value)
+        THROW("Failed to set attribute %s!", attribute_key_name(value.key));
+}
+
+static bool attributes_remove(attribute_table* attributes, element_index_t element,
+                              attribute_key key) {
+    attribute_run* run = attributes_lookup(attributes, element);
+    if (run == NULL)
+        return false;
+
+    bool is_removed = attribute_run_remove(run, key);
+
+    // Element without extras costs nothing again
+    if (run->count == 0) {
+        attribute_run_destroy(run);
+        hash_table_delete(attributes, element);
+    }
+
+    return is_removed;
+}
+
+// Drop every extra of removed element, so it's slot is reused clean
+static void attributes_forget(attribute_table* attributes, element_index_t element) {
+    attribute_run* run = attributes_lookup(attributes, element);
+    if (run == NULL)
+        return;
+
+    attribute_run_destroy(run);
+    hash_table_delete(attributes, element);
+}
+
+static void attributes_destroy(attribute_table* attributes) {
+    if (attributes->hash_table == NULL)
+        return;
+
+    HASH_TABLE_TRAVERSE(attributes, element_index_t, attribute_run*, current)
+        attribute_run_destroy(VALUE(current));
+
+    hash_table_destroy(attributes);
+    *attributes = {};
+}
+
+void subgraph_set_node_attribute(digraph* graph, subgraph_id subgraph_pos, node_id node_pos,
+                                 attribute value) {
+    attributes_set(&digraph_get_subgraph(graph, subgraph_pos)->node_attributes, node_pos, value);
+}
+
+void subgraph_set_edge_attribute(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos,
+                                 attribute value) {
+    attributes_set(&digraph_get_subgraph(graph, subgraph_pos)->edge_attributes, edge_pos, value);
+}
+
+const attribute* subgraph_get_node_attribute(digraph* graph, subgraph_id subgraph_pos,
+                                             node_id node_pos, attribute_key key) {
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    return attribute_run_get(attributes_lookup(&current_subgraph->node_attributes, node_pos), key);
+}
+
+const attribute* subgraph_get_edge_attribute(digraph* graph, subgraph_id subgraph_pos,
+                                             edge_id edge_pos, attribute_key key) {
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    return attribute_run_get(attributes_lookup(&current_subgraph->edge_attributes, edge_pos), key);
+}
+
+bool subgraph_remove_node_attribute(digraph* graph, subgraph_id subgraph_pos, node_id node_pos,
+                                    attribute_key key) {
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    return attributes_remove(&current_subgraph->node_attributes, node_pos, key);
+}
+
+bool subgraph_remove_edge_attribute(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos,
+                                    attribute_key key) {
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    return attributes_remove(&current_subgraph->edge_attributes, edge_pos, key);
+}
+
+
+node* subgraph_get_node(digraph* graph, subgraph_id subgraph_pos, node_id node_pos) {
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    return &linked_list_get_pointer(&current_subgraph->nodes, node_pos)->element;
+}
+
+edge* subgraph_get_edge(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos) {
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    return &linked_list_get_pointer(&current_subgraph->edges, edge_pos)->element;
+}
+
+// Element is in the list, not a terminal one or in the free list
+template <typename E>
+static bool is_used_element(linked_list<E>* list, element_index_t index) {
+    return index > linked_list_end_index && (size_t) index <= list->capacity + 1 &&
+           !linked_list_get_pointer(list, index)->is_free;
+}
+
+edge* subgraph_find_edge(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos) {
+    if (!is_used_element(&graph->subgraphs, subgraph_pos))
+        return NULL;
+
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    if (!is_used_element(&current_subgraph->edges, edge_pos))
+        return NULL;
+
+    return subgraph_get_edge(graph, subgraph_pos, edge_pos);
+}
+
+// Name index shares node's label, so it forgets node before label is freed
+static void name_index_forget(digraph* graph, node_id node_pos, const char* label) {
+    if (!digraph_has_name_index(graph) || label == NULL)
+        return;
+
+    // Node with the same label may be indexed instead, it stays
+    node_id* indexed = hash_table_lookup(&graph->name_index, label);
+    if (indexed != NULL && *indexed == node_pos)
+        hash_table_delete(&graph->name_index, label);
+}
+
+void subgraph_remove_edge(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos) {
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    edge* current_edge = subgraph_get_edge(graph, subgraph_pos, edge_pos);
+
+    if (digraph_has_incidence_index(graph))
+        incidence_delete_edge(&graph->incidence, subgraph_pos, edge_pos);
+
+    free(current_edge->label), current_edge->label = NULL;
+    attributes_forget(&current_subgraph->edge_attributes, edge_pos);
+
+    TRY linked_list_delete(&current_subgraph->edges, edge_pos)
+        THROW("Failed to remove edge %d!", edge_pos);
+}
+
+void subgraph_remove_node(digraph* graph, subgraph_id subgraph_pos, node_id node_pos) {
+    digraph_create_incidence_index(graph);
+
+    digraph_incidence* incidence = &graph->incidence;
+
+    // Both entries of a loop are here, removing edge unlinks both of them
+    while ((size_t) node_pos < incidence->node_capacity &&
+           incidence->first[node_pos] != INCIDENCE_NONE) {
+
+        incidence_entry* entry = &incidence->entries[incidence->first[node_pos]];
+        subgraph_remove_edge(graph, entry->subgraph, entry->edge);
+    }
+
+    subgraph* current_subgraph = digraph_get_subgraph(graph, subgraph_pos);
+    node* current_node = subgraph_get_node(graph, subgraph_pos, node_pos);
+
+    name_index_forget(graph, node_pos, current_node->label);
+    free(current_node->label), current_node->label = NULL;
+    attributes_forget(&current_subgraph->node_attributes, node_pos);
+
+    TRY linked_list_delete(&current_subgraph->nodes, node_pos)
+        THROW("Failed to remove node %d!", node_pos);
+}
+
+
+// Node, that is about to be changed, change is seen by list's recorder
+static node* subgraph_change_node(digraph* graph, subgraph_id subgraph_pos, node_id node_pos) {
+    linked_list_mark_dirty(&digraph_get_subgraph(graph, subgraph_pos)->nodes, node_pos);
+    return subgraph_get_node(graph, subgraph_pos, node_pos);
+}
+
+static edge* subgraph_change_edge(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos) {
+    linked_list_mark_dirty(&digraph_get_subgraph(graph, subgraph_pos)->edges, edge_pos);
+    return subgraph_get_edge(graph, subgraph_pos, edge_pos);
+}
+
+void subgraph_set_node_label(digraph* graph, subgraph_id subgraph_pos, node_id node_pos,
+                             const char* format, ...) {
+    node* current_node = subgraph_change_node(graph, subgraph_pos, node_pos);
+
+    va_list args;
+    va_start(args, format);
+
+    char* new_label = vsprintf_to_new_buffer(format, args);
+
+    va_end(args);
+
+    name_index_forget(graph, node_pos, current_node->label);
+
+    free(current_node->label);
+    current_node->label = new_label;
+
+    // Existing names aren't replaced, same as on insertion
+    if (digraph_has_name_index(graph) && new_label != NULL)
+        hash_table_insert(&graph->name_index, (const char*) new_label, node_pos);
+}
+
+void subgraph_set_node_color(digraph* graph, subgraph_id subgraph_pos, node_id node_pos,
+                             graphviz_color color) {
+    subgraph_change_node(graph, subgraph_pos, node_pos)->color = color;
+}
+
+void subgraph_set_node_style(digraph* graph, subgraph_id subgraph_pos, node_id node_pos,
+                             graphviz_style style) {
+    subgraph_change_node(graph, subgraph_pos, node_pos)->style = style;
+}
+
+void subgraph_set_node_shape(digraph* graph, subgraph_id subgraph_pos, node_id node_pos,
+                             graphviz_node_shape shape) {
+    subgraph_change_node(graph, subgraph_pos, node_pos)->shape = shape;
 }
 
+void subgraph_set_edge_label(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos,
+                             const char* format, ...) {
+    edge* current_edge = subgraph_change_edge(graph, subgraph_pos, edge_pos);
 
-void subgraph_write_to_file(FILE* file, subgraph* graph) {
-    fprintf(file, "\t" "subgraph {" "\n");
+    va_list args;
+    va_start(args, format);
+
+    char* new_label = vsprintf_to_new_buffer(format, args);
+
+    va_end(args);
+
+    free(current_edge->label);
+    current_edge->label = new_label;
+}
+
+void subgraph_set_edge_color(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos,
+                             graphviz_color color) {
+    subgraph_change_edge(graph, subgraph_pos, edge_pos)->color = color;
+}
+
+void subgraph_set_edge_style(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos,
+                             graphviz_style style) {
+    subgraph_change_edge(graph, subgraph_pos, edge_pos)->style = style;
+}
+
+void subgraph_set_edge_weight(digraph* graph, subgraph_id subgraph_pos, edge_id edge_pos,
+                              double weight) {
+    subgraph_change_edge(graph, subgraph_pos, edge_pos)->weight = weight;
+}
+
+
+void subgraph_write_begin(buffered_writer* writer, subgraph* graph) {
+    buffered_writer_puts(writer, "\t" "subgraph {" "\n");
 
     const char** rank =
         hash_table_lookup(&graphviz_rank_names, (int) graph->rank);
 
     if (rank != NULL)
-        fprintf(file, "\t\t" "rank = %s;" "\n", *rank);
+        buffered_writer_printf(writer, "\t\t" "rank = %s;" "\n", *rank);
+}
 
-    LINKED_LIST_TRAVERSE(&graph->nodes, node, current) {
-        node* current_node = &current->element;
+void subgraph_write_node(buffered_writer* writer, subgraph* graph, node_id node_identity) {
+    node* current_node = &linked_list_get_pointer(&graph->nodes, node_identity)->element;
 
-        const char* shape =
-            *hash_table_lookup(&graphviz_node_shapes, (int) current_node->shape);
+    const char* shape =
+        *hash_table_lookup(&graphviz_node_shapes, (int) current_node->shape);
 
-        const char* color =
-            *hash_table_lookup(&graphviz_colors,      (int) current_node->color);
+    const char* color =
+        *hash_table_lookup(&graphviz_colors,      (int) current_node->color);
 
-        const char* style =
-            *hash_table_lookup(&graphviz_styles,      (int) current_node->style);
+    const char* style =
+        *hash_table_lookup(&graphviz_styles,      (int) current_node->style);
 
-        node_id node_identity = linked_list_get_index(&graph->nodes, current);
+    buffered_writer_printf(writer, "\t\t" "node_%d [" "label = \"%s\","
+                           "shape = \"%s\", color = \"%s\", style = \"%s\"",
+                           node_identity, current_node->label != NULL ? current_node->label : "",
+                           shape, color, style);
 
-        fprintf(file, "\t\t" "node_%d [" "label = \"%s\","
-                "shape = \"%s\", color = \"%s\", style = \"%s\"];" "\n",
-                node_identity, current_node->label, shape, color, style);
-    }
+    // Extras are merged right into the list, nodes without them add nothing
+    attribute_run_write(writer, attributes_lookup(&graph->node_attributes, node_identity));
 
-    LINKED_LIST_TRAVERSE(&graph->edges, edge, current) {
-        edge* current_edge = &current->element;
+    buffered_writer_puts(writer, "];" "\n");
+}
 
-        node_id from_node_id = current_edge->from, to_node_id = current_edge->to;
+void subgraph_write_edge(buffered_writer* writer, subgraph* graph, edge_id edge_identity) {
+    edge* current_edge = &linked_list_get_pointer(&graph->edges, edge_identity)->element;
 
-        const char* color =
-            *hash_table_lookup(&graphviz_colors, (int) current_edge->color);
+    node_id from_node_id = current_edge->from, to_node_id = current_edge->to;
 
-        const char* style =
-            *hash_table_lookup(&graphviz_styles, (int) current_edge->style);
+    const char* color =
+        *hash_table_lookup(&graphviz_colors, (int) current_edge->color);
 
-        fprintf(file, "\t\t" "node_%d -> node_%d [label = \" %s \","
-                "color = %s, style = %s, margin = \"1.5\"];" "\n",
-                from_node_id, to_node_id, current_edge->label, color, style);
+    const char* style =
+        *hash_table_lookup(&graphviz_styles, (int) current_edge->style);
 
-    }
+    buffered_writer_printf(writer, "\t\t" "node_%d -> node_%d [label = \" %s \","
+                           "color = %s, style = %s, margin = \"1.5\"",
+                           from_node_id, to_node_id,
+                           current_edge->label != NULL ? current_edge->label : "", color, style);
+
+    // Weight is written only if it was set, so unweighted output is the same
+    if (current_edge->weight != 0)
+        buffered_writer_printf(writer, ", weight = %d", edge_dot_weight(current_edge->weight));
+
+    attribute_run_write(writer, attributes_lookup(&graph->edge_attributes, edge_identity));
 
-    fprintf(file, "\t" "}"          "\n");
+    buffered_writer_puts(writer, "];" "\n");
 }
 
-void digraph_write_to_file(FILE* file, digraph* graph) {
-    fprintf(file, "digraph {" "\n");
+void subgraph_write_end(buffered_writer* writer) {
+    buffered_writer_puts(writer, "\t" "}"          "\n");
+}
+
+void subgraph_write(buffered_writer* writer, subgraph* graph) {
+    subgraph_write_begin(writer, graph);
+
+    LINKED_LIST_TRAVERSE(&graph->nodes, node, current)
+        subgraph_write_node(writer, graph, linked_list_get_index(&graph->nodes, current));
+
+    LINKED_LIST_TRAVERSE(&graph->edges, edge, current)
+        subgraph_write_edge(writer, graph, linked_list_get_index(&graph->edges, current));
+
+    subgraph_write_end(writer);
+}
+
+void digraph_write(buffered_writer* writer, digraph* graph) {
+    buffered_writer_puts(writer, "digraph {" "\n");
 
     LINKED_LIST_TRAVERSE(&graph->subgraphs, subgraph, current)
-        subgraph_write_to_file(file, &current->element);
+        subgraph_write(writer, &current->element);
+
+    buffered_writer_puts(writer, "}" "\n");
+}
 
-    fprintf(file, "}" "\n");
+void digraph_write_to_file(FILE* file, digraph* graph) {
+    // Big graphs are formatted on every core, small ones sequentially.
+    // Failures are ignored, the same way fprintf's ones are
+    trace_destruct(digraph_write_parallel_to_file(file, graph));
 }
 
 
@@ -269,10 +839,19 @@ void digraph_destroy(digraph *graph) {
             free(current_edge->element.label);
 
         linked_list_destroy(&current->element.edges);
+
+        attributes_destroy(&current->element.node_attributes);
+        attributes_destroy(&current->element.edge_attributes);
     }
 
     linked_list_destroy(&graph->subgraphs),
         graph->subgraphs = {};
+
+    if (digraph_has_name_index(graph))
+        hash_table_destroy(&graph->name_index),
+            graph->name_index = {};
+
+    incidence_destroy(&graph->incidence);
 };
 
 
@@ -3,6 +3,11 @@
 #include "linked-list.h"
 #include "hash-table.h"
 #include "trace.h"
+#include "graphviz-writer.h"
+#include "graphviz-attributes.h"
+
+#include <limits.h>
+#include <stdarg.h>
 
 /** Different node placements inside of a subgraph */
 enum graphviz_rank_type {
@@ -68,24 +73,95 @@ struct edge {
     graphviz_style style;
 
     char* label;
+
+    double weight; // Zero means default weight, which is one
 };
 
+typedef element_index_t edge_id;
+
+inline double edge_weight(const edge* current_edge) {
+    return current_edge->weight != 0 ? current_edge->weight : 1.0;
+}
+
+/**
+ * Weight in the form dot accepts, which is a non negative integer, so
+ * it's rounded to the nearest one
+ */
+inline int edge_dot_weight(double weight) {
+    if (!(weight > 0))
+        return 0;
+
+    return weight < (double) INT_MAX ? (int) (weight + 0.5) : INT_MAX;
+}
+
 struct subgraph {
     linked_list<node> nodes;
     linked_list<edge> edges;
 
     graphviz_rank_type rank;
+
+    // Extra attributes of elements, that have them, by element's id.
+    // Created on first set attribute, NULL table if absent
+    hash_table<element_index_t, attribute_run*> node_attributes;
+    hash_table<element_index_t, attribute_run*> edge_attributes;
+};
+
+typedef element_index_t subgraph_id;
+
+// Marks absent entry in incidence index
+const size_t INCIDENCE_NONE = (size_t) -1;
+
+/**
+ * Edge as seen from one of it's endpoints. Entries of the same node form
+ * a doubly linked list, entries are allocated in pairs: even one belongs
+ * to edge's source, odd one to it's target.
+ */
+struct incidence_entry {
+    node_id node;
+
+    subgraph_id subgraph;
+    edge_id edge;
+
+    size_t next, prev; // Free pairs are linked by next
+};
+
+/** Pair of entries of every edge of a subgraph, by edge id */
+struct incidence_pairs {
+    size_t* pairs;
+    size_t capacity;
+};
+
+/**
+ * Index from node id to edges, that start or end in it, so node is
+ * removed in time proportional to it's degree instead of graph's size.
+ * Edges don't keep their pairs, so graphs without index don't pay for it
+ */
+struct digraph_incidence {
+    incidence_entry* entries;
+    size_t entry_capacity, free_pair;
+
+    size_t* first; // First entry of every node id, INCIDENCE_NONE if none
+    size_t node_capacity;
+
+    incidence_pairs* subgraph_pairs; // By subgraph id
+    size_t subgraph_capacity;
 };
 
 struct digraph {
     linked_list<subgraph> subgraphs;
+
+    // Optional index from node label to node, it's keys are node's own
+    // labels. Created by digraph_create_name_index, NULL table if absent
+    hash_table<const char*, node_id> name_index;
+
+    // Optional index of edges by their endpoints, created by
+    // digraph_create_incidence_index, NULL entries if absent
+    digraph_incidence incidence;
 };
 
 
 digraph digraph_create();
 
-typedef element_index_t subgraph_id;
-
 /**
  * Create new subgraph and immediately insert it in a graph
  *
@@ -107,12 +183,26 @@ subgraph_id digraph_create_subgraph(digraph* graph, graphviz_rank_type rank);
 subgraph* digraph_get_subgraph(digraph* graph, subgraph_id subgraph);
 
 element_index_t subgraph_insert_node(digraph* graph, subgraph_id subgraph, node new_node);
-void  subgraph_insert_edge(digraph* graph, subgraph_id subgraph, edge new_edge);
+edge_id         subgraph_insert_edge(digraph* graph, subgraph_id subgraph, edge new_edge);
 
 node node_from_default(node default_node, const char *format, ...);
 edge edge_from_default(edge default_edge, node_id from, node_id to,
                        const char *format, ...);
 
+/**
+ * Size of label, that @arg format gives, null terminator included. Without
+ * format @arg default_label is kept, the same way elements from default
+ * keep it, and NULL default label is empty. @arg args aren't consumed
+ */
+size_t vlabel_size(const char* default_label, const char* format, va_list args);
+
+/**
+ * Format label, measured with vlabel_size, into @arg size bytes of
+ * @arg destination, so builders can put labels right into their storage
+ */
+void vformat_label(char* destination, size_t size, const char* default_label,
+                   const char* format, va_list args);
+
 /**
  * Insert new node with style inherited from default node
  *
@@ -123,15 +213,120 @@ node_id subgraph_insert_default_node(digraph* graph, subgraph_id subgraph,
 
 /**
  * Insert new edge that connects two nodes, identified by their id's
+ *
+ * @return value that identifies edge, it can be used to remove edge
  */
-void    subgraph_insert_default_edge(digraph* graph, subgraph_id subgraph, edge default_edge,
+edge_id subgraph_insert_default_edge(digraph* graph, subgraph_id subgraph, edge default_edge,
                                      node_id from, node_id to, const char* format, ...);
 
 /**
- * Write to @arg file description of the @arg graph in graphviz dot's lang
+ * Index labels of all nodes in the graph, after that nodes can be found
+ * by their label with subgraph_get_or_insert_node. Every node inserted
+ * later is indexed too, first node with the same label wins
+ */
+void    digraph_create_name_index(digraph* graph);
+
+/**
+ * Find node labeled @arg name, or create one with style inherited from
+ * default node, if there's none. Creates name index if graph has none
+ *
+ * @return value that identifies found or inserted node
+ */
+node_id subgraph_get_or_insert_node(digraph* graph, subgraph_id subgraph,
+                                    const char* name, node default_node = {});
+
+/**
+ * Index edges of the graph by their endpoints, after that nodes are removed
+ * in time proportional to their degree. Every edge inserted later is
+ * indexed too
+ */
+void    digraph_create_incidence_index(digraph* graph);
+
+/**
+ * Remove node and every edge, that starts or ends in it. Edges are
+ * found by node's id in every subgraph, the same way dot connects them.
+ * Creates incidence index if graph has none, freed slot is reused by the
+ * next inserted node
+ */
+void    subgraph_remove_node(digraph* graph, subgraph_id subgraph, node_id node);
+
+void    subgraph_remove_edge(digraph* graph, subgraph_id subgraph, edge_id edge);
+
+node*   subgraph_get_node(digraph* graph, subgraph_id subgraph, node_id node);
+edge*   subgraph_get_edge(digraph* graph, subgraph_id subgraph, edge_id edge);
+
+/**
+ * Same as subgraph_get_edge, but ids may be stale: NULL if edge or it's
+ * subgraph were removed, or never existed
+ */
+edge*   subgraph_find_edge(digraph* graph, subgraph_id subgraph, edge_id edge);
+
+/**
+ * Change attributes of existing node or edge in place, changes are seen
+ * by list recorders. New label is formatted like in insertion functions
+ * and keeps name index up to date
+ */
+void    subgraph_set_node_label(digraph* graph, subgraph_id subgraph, node_id node,
+                                const char* format, ...);
+void    subgraph_set_node_color(digraph* graph, subgraph_id subgraph, node_id node,
+                                graphviz_color color);
+void    subgraph_set_node_style(digraph* graph, subgraph_id subgraph, node_id node,
+                                graphviz_style style);
+void    subgraph_set_node_shape(digraph* graph, subgraph_id subgraph, node_id node,
+                                graphviz_node_shape shape);
+
+void    subgraph_set_edge_label (digraph* graph, subgraph_id subgraph, edge_id edge,
+                                 const char* format, ...);
+void    subgraph_set_edge_color (digraph* graph, subgraph_id subgraph, edge_id edge,
+                                 graphviz_color color);
+void    subgraph_set_edge_style (digraph* graph, subgraph_id subgraph, edge_id edge,
+                                 graphviz_style style);
+void    subgraph_set_edge_weight(digraph* graph, subgraph_id subgraph, edge_id edge,
+                                 double weight);
+
+/**
+ * Set extra attribute of node or edge, like attribute_number(ATTRIBUTE_PENWIDTH, 2),
+ * old value with the same key is replaced. String values are copied
+ */
+void    subgraph_set_node_attribute(digraph* graph, subgraph_id subgraph, node_id node,
+                                    attribute value);
+void    subgraph_set_edge_attribute(digraph* graph, subgraph_id subgraph, edge_id edge,
+                                    attribute value);
+
+/**
+ * @return extra attribute, or NULL if element doesn't have it
+ */
+const attribute* subgraph_get_node_attribute(digraph* graph, subgraph_id subgraph, node_id node,
+                                             attribute_key key);
+const attribute* subgraph_get_edge_attribute(digraph* graph, subgraph_id subgraph, edge_id edge,
+                                             attribute_key key);
+
+bool    subgraph_remove_node_attribute(digraph* graph, subgraph_id subgraph, node_id node,
+                                       attribute_key key);
+bool    subgraph_remove_edge_attribute(digraph* graph, subgraph_id subgraph, edge_id edge,
+                                       attribute_key key);
+
+/**
+ * Write to @arg file description of the @arg graph in graphviz dot's lang.
+ * Failures to write are ignored, digraph_write_parallel_to_file reports them
  */
 void  digraph_write_to_file(FILE* file,  digraph* graph);
 
+/**
+ * Same as digraph_write_to_file, but output goes to @arg writer
+ */
+void  digraph_write (buffered_writer* writer, digraph*  graph);
+void  subgraph_write(buffered_writer* writer, subgraph* graph);
+
+/**
+ * Parts of subgraph_write, so subgraph can be written piece by piece,
+ * possibly by different threads into different buffers
+ */
+void  subgraph_write_begin(buffered_writer* writer, subgraph* graph);
+void  subgraph_write_node (buffered_writer* writer, subgraph* graph, node_id node);
+void  subgraph_write_edge (buffered_writer* writer, subgraph* graph, edge_id edge);
+void  subgraph_write_end  (buffered_writer* writer);
+
 
 char* digraph_render(digraph* graph);
 
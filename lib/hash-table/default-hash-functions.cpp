@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 uint32_t int_hash(const int number) {
     uint32_t hash = (uint32_t) number;
@@ -45,3 +46,7 @@ uint32_t combine_hash(uint32_t lhs, uint32_t rhs) {
     // Idea borrowed from boost's /hash_combine/
     return lhs ^= rhs + 0x9e3779b9 + (lhs << 6) + (lhs >> 2);
 }
+
+bool str_equals(const char** first, const char** second) {
+    return strcmp(*first, *second) == 0;
+}
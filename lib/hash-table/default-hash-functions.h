@@ -8,3 +8,6 @@ uint32_t char_hash(const char  symbol);
 uint32_t  str_hash(const char* string);
 
 uint32_t combine_hash(uint32_t lhs, uint32_t rhs);
+
+// Key equality for hash tables with string keys
+bool str_equals(const char** first, const char** second);
@@ -1,5 +1,8 @@
 #include "hash-table.h"
 #include "default-hash-functions.h"
+#include "hash-table-vizualizer.h"
+#include "linked-list-recorder.h"
+#include "string-hash-table.h"
 
 #include "test-framework.h"
 
@@ -67,6 +70,217 @@ TEST(test_hash_table_inline_construction) {
     CALL_TEST_FINALIZER();
 }
 
+static uint32_t bad_hash(int key) {
+    // Every eighth key collides, so chains are long
+    return key % 8 == 0 ? 0 : int_hash(key);
+}
+
+static int print_int_pair(char* buffer, size_t size, hash_table_pair<int, int>* pair) {
+    return snprintf(buffer, size, "%d: %d", pair->key, pair->value);
+}
+
+// How many nodes in @arg dot are declared with the same name as node labeled with @arg label
+static int count_namesakes(const char* dot, const char* label) {
+    const char* labeled = strstr(dot, label);
+    if (labeled == NULL)
+        return 0;
+
+    const char* name = labeled;
+    while (name > dot && name[-1] != '\t')
+        -- name;
+
+    char declaration[64] = "";
+    snprintf(declaration, sizeof(declaration), "\t%.*s", (int) (labeled - name), name);
+
+    int count = 0;
+    for (const char* current = strstr(dot, declaration); current != NULL;
+         current = strstr(current + 1, declaration))
+        ++ count;
+
+    return count;
+}
+
+TEST(visualize_hash_table_with_bad_hash) {
+    hash_table<int, int> table;
+
+    TRY hash_table_create(&table, bad_hash)
+        ASSERT_SUCCESS();
+
+    TEST_FINALIZER({ hash_table_destroy(&table); });
+
+    for (int i = 0; i < 10000; ++ i)
+        hash_table_insert(&table, i, i);
+
+    hash_table_graph_options options = HASH_TABLE_GRAPH_DEFAULT_OPTIONS;
+    options.node_budget = 100;
+
+    digraph graph = hash_table_create_graph(&table, print_int_pair, options);
+
+    size_t nodes = 0;
+    LINKED_LIST_TRAVERSE(&graph.subgraphs, subgraph, current)
+        nodes += current->element.nodes.used;
+
+    ASSERT_EQUAL((int) nodes, (int) options.node_budget);
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_write(&writer, &graph);
+
+    size_t size = 0;
+    char* dot = buffered_writer_take(&writer, &size);
+
+    // The longest chain is the one with colliding keys, it goes first
+    const char* longest = "label = \"bucket 0 (1250 pairs)\"";
+    const char* first_bucket = strstr(dot, "label = \"bucket ");
+    ASSERT_EQUAL(first_bucket != NULL, true);
+    ASSERT_EQUAL(strncmp(first_bucket, longest, strlen(longest)), 0);
+
+    // Chains don't take names of histogram nodes, every bar is still there
+    size_t histogram[HASH_TABLE_HISTOGRAM_SIZE] = {};
+    for (size_t i = 0; i < table.buckets_capacity; ++ i) {
+        const size_t bucket_size = table.hash_table[i].size;
+        ++ histogram[bucket_size < HASH_TABLE_HISTOGRAM_SIZE ? bucket_size
+                                                             : HASH_TABLE_HISTOGRAM_SIZE - 1];
+    }
+
+    for (size_t i = 0; i < HASH_TABLE_HISTOGRAM_SIZE; ++ i) {
+        if (histogram[i] == 0)
+            continue;
+
+        char label[64] = "";
+        snprintf(label, sizeof(label), i + 1 == HASH_TABLE_HISTOGRAM_SIZE ?
+                 "label = \"size %zu+: %zu\"" : "label = \"size %zu: %zu\"", i, histogram[i]);
+        ASSERT_EQUAL(count_namesakes(dot, label), 1);
+    }
+
+    free(dot);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_destroy(&graph);
+    CALL_TEST_FINALIZER();
+}
+
+TEST(delete_first_pair_of_bucket) {
+    hash_table<int, int> table;
+
+    TRY hash_table_create(&table, bad_hash)
+        ASSERT_SUCCESS();
+
+    TEST_FINALIZER({ hash_table_destroy(&table); });
+
+    // Keys divisible by eight share the same bucket
+    for (int i = 0; i < 64; i += 8)
+        hash_table_insert(&table, i, i);
+
+    for (int i = 0; i < 32; i += 8)
+        ASSERT_EQUAL(hash_table_delete(&table, i), true);
+
+    for (int i = 0; i < 32; i += 8)
+        HASH_TABLE_ASSERT_NOT_PRESENT(&table, i);
+
+    for (int i = 32; i < 64; i += 8)
+        HASH_TABLE_ASSERT_VALUE(&table, i, i);
+
+    hash_table_insert(&table, 0, 42);
+    HASH_TABLE_ASSERT_VALUE(&table, 0, 42);
+
+    CALL_TEST_FINALIZER();
+}
+
+TEST(record_hash_table_through_rehashes) {
+    typedef element<hash_table_pair<int, int>> pair_element;
+
+    hash_table<int, int> table = {};
+    TRY hash_table_create(&table, int_hash, 4, 4)
+        ASSERT_SUCCESS();
+
+    linked_list_recorder<hash_table_pair<int, int>> recorder = {};
+    TRY linked_list_recorder_create(&recorder, &table.values, 8)
+        ASSERT_SUCCESS();
+
+    const size_t initial_capacity = table.buckets_capacity;
+
+    // Every frame's values are kept, so restored ones can be compared
+    const int steps = 200;
+    pair_element* expected[steps] = {};
+
+    for (int i = 0; i < steps; ++ i) {
+        hash_table_insert(&table, i * 7, i);
+        linked_list_recorder_snapshot(&recorder);
+
+        const size_t size = (table.values.capacity + 2) * sizeof(pair_element);
+        expected[i] = (pair_element*) malloc(size);
+        memcpy(expected[i], table.values.elements, size);
+    }
+
+    ASSERT_EQUAL(table.buckets_capacity >= initial_capacity * 8, true);
+
+    linked_list<hash_table_pair<int, int>> restored = {};
+    for (int i = 0; i < steps; ++ i) {
+        TRY linked_list_recorder_restore(&recorder, (size_t) i + 1, &restored)
+            ASSERT_SUCCESS();
+
+        const size_t size = (restored.capacity + 2) * sizeof(pair_element);
+        ASSERT_EQUAL(memcmp(restored.elements, expected[i], size), 0);
+
+        free(expected[i]);
+    }
+
+    linked_list_destroy(&restored);
+    linked_list_recorder_destroy(&recorder);
+    hash_table_destroy(&table);
+}
+
+TEST(own_short_and_long_string_keys) {
+    string_hash_table<int> table = {};
+    TRY string_hash_table_create(&table)
+        ASSERT_SUCCESS();
+
+    TEST_FINALIZER({ string_hash_table_destroy(&table); });
+
+    // Keys are built in one buffer, so table can't rely on caller's storage
+    char key[64] = {};
+    for (int i = 0; i < 1000; ++ i) {
+        snprintf(key, sizeof(key), i % 2 == 0 ? "node_%d" : "very_long_node_label_%d", i);
+        ASSERT_EQUAL(string_hash_table_insert(&table, key, i), true);
+    }
+
+    ASSERT_EQUAL(string_hash_table_insert(&table, "node_0", 1), false);
+    ASSERT_EQUAL(string_hash_table_insert(&table, "very_long_node_label_1", 0), false);
+
+    for (int i = 0; i < 1000; ++ i) {
+        snprintf(key, sizeof(key), i % 2 == 0 ? "node_%d" : "very_long_node_label_%d", i);
+
+        int* value = string_hash_table_lookup(&table, key);
+        ASSERT_EQUAL(value != NULL && *value == i, true);
+    }
+
+    // Length is part of the key, prefixes don't match
+    ASSERT_EQUAL(string_hash_table_contains(&table, "node_"), false);
+    ASSERT_EQUAL(string_hash_table_contains(&table, "very_long_node_label_"), false);
+
+    ASSERT_EQUAL(string_hash_table_delete(&table, "node_10"), true);
+    ASSERT_EQUAL(string_hash_table_delete(&table, "very_long_node_label_11"), true);
+    ASSERT_EQUAL(string_hash_table_contains(&table, "node_10"), false);
+    ASSERT_EQUAL(string_hash_table_contains(&table, "very_long_node_label_11"), false);
+
+    size_t long_keys = 0;
+    STRING_HASH_TABLE_TRAVERSE(&table, int, current) {
+        const string_key* current_key = &KEY(current);
+
+        ASSERT_EQUAL(strlen(string_key_chars(current_key)), (size_t) current_key->length);
+        long_keys += !string_key_is_inline(current_key);
+    }
+
+    ASSERT_EQUAL(long_keys, (size_t) 499);
+
+    CALL_TEST_FINALIZER();
+}
+
 int main(void) {
     return test_framework_run_all_unit_tests();
 }
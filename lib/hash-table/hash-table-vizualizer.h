@@ -0,0 +1,197 @@
+#pragma once
+
+#include "hash-table.h"
+#include "graphviz.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** What part of hash table gets into it's graph */
+struct hash_table_graph_options {
+    size_t node_budget;    // Graph never has more nodes than that
+    size_t longest_chains; // How many of the longest chains are shown
+    size_t samples;        // How many of the other buckets are sampled
+    uint64_t seed;         // Seed of bucket sampling
+};
+
+const hash_table_graph_options HASH_TABLE_GRAPH_DEFAULT_OPTIONS = {
+    .node_budget = 256, .longest_chains = 4, .samples = 16, .seed = 42
+};
+
+// Buckets with this many pairs or more share the last histogram bar
+const size_t HASH_TABLE_HISTOGRAM_SIZE = 16;
+
+// Same as snprintf, writes description of @arg pair to @arg buffer
+template <typename K, typename V>
+using hash_table_pair_printer = int (*) (char* buffer, size_t size,
+                                         hash_table_pair<K, V>* pair);
+
+static inline uint64_t __hash_table_xorshift(uint64_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+/**
+ * Show chain of @arg bucket, that starts from @arg bucket_node, until
+ * @arg budget runs out
+ */
+template <typename K, typename V>
+void __hash_table_graph_chain(digraph* graph, subgraph_id chains, node style,
+                              hash_table<K, V>* table, hash_table_bucket* bucket,
+                              node_id bucket_node, hash_table_pair_printer<K, V> print,
+                              size_t* budget) {
+
+    element<hash_table_pair<K, V>>* current =
+        linked_list_get_pointer(&table->values, bucket->value_index);
+
+    edge default_edge = { .color = style.color, .style = STYLE_SOLID };
+
+    node_id previous = bucket_node;
+    for (size_t i = 0; i < bucket->size; ++ i) {
+        if (*budget == 0)
+            return;
+
+        // Last node left shows how much didn't fit
+        if (*budget == 1 && i + 1 < bucket->size) {
+            -- *budget;
+
+            node_id rest = subgraph_insert_default_node(graph, chains, style,
+                "... %zu more", bucket->size - i);
+            subgraph_insert_default_edge(graph, chains, default_edge, previous, rest, "");
+
+            return;
+        }
+
+        char description[64] = "";
+        if (print != NULL)
+            print(description, sizeof(description), &current->element);
+        else
+            snprintf(description, sizeof(description), "pair at %d",
+                     linked_list_get_index(&table->values, current));
+
+        node_id pair = subgraph_insert_default_node(graph, chains, style, "%s", description);
+        subgraph_insert_default_edge(graph, chains, default_edge, previous, pair, "");
+
+        previous = pair, -- *budget;
+        current = linked_list_next(&table->values, current);
+    }
+}
+
+/**
+ * Create graph, that shows how pairs are distributed among buckets of
+ * @arg table: histogram of bucket sizes, the longest chains in full, and
+ * a few sampled buckets. Size of the graph is bounded by options, so only
+ * bucket array is scanned, and it's done once.
+ *
+ * @arg print describes pairs, if NULL pairs are shown by their position
+ */
+template <typename K, typename V>
+digraph hash_table_create_graph(hash_table<K, V>* table,
+                                hash_table_pair_printer<K, V> print = NULL,
+                                hash_table_graph_options options =
+                                    HASH_TABLE_GRAPH_DEFAULT_OPTIONS) {
+
+    size_t histogram[HASH_TABLE_HISTOGRAM_SIZE] = {};
+
+    // Positions of the longest buckets, the longest goes first
+    size_t longest[options.longest_chains + 1];
+    size_t longest_count = 0;
+
+    for (size_t i = 0; i < table->buckets_capacity; ++ i) {
+        const size_t size = table->hash_table[i].size;
+        ++ histogram[size < HASH_TABLE_HISTOGRAM_SIZE ? size : HASH_TABLE_HISTOGRAM_SIZE - 1];
+
+        if (size == 0 || options.longest_chains == 0)
+            continue;
+
+        if (longest_count == options.longest_chains &&
+            table->hash_table[longest[longest_count - 1]].size >= size)
+            continue;
+
+        // Insertion into short sorted array, last one drops out when it's full
+        size_t place = longest_count < options.longest_chains ? longest_count ++
+                                                              : longest_count - 1;
+        for (; place > 0 && table->hash_table[longest[place - 1]].size < size; -- place)
+            longest[place] = longest[place - 1];
+
+        longest[place] = i;
+    }
+
+    digraph graph = digraph_create();
+    size_t budget = options.node_budget;
+
+    // Node names in DOT are numbered per subgraph, but share one namespace,
+    // so histogram and chains have to live in the same subgraph
+    subgraph_id nodes = digraph_create_subgraph(&graph, RANK_NONE);
+
+    // Histogram and summary
+    node bar = { .style = STYLE_FILLED, .color = GRAPHVIZ_BLUE, .shape = SHAPE_BOX };
+
+    if (budget > 0) {
+        subgraph_insert_default_node(&graph, nodes, bar,
+            "%zu buckets, %zu pairs, load %.2lf",
+            table->buckets_capacity, table->values.used,
+            (double) table->values.used / (double) table->buckets_capacity);
+        -- budget;
+    }
+
+    for (size_t size = 0; size < HASH_TABLE_HISTOGRAM_SIZE && budget > 0; ++ size) {
+        if (histogram[size] == 0)
+            continue;
+
+        subgraph_insert_default_node(&graph, nodes, bar,
+            size + 1 == HASH_TABLE_HISTOGRAM_SIZE ? "size %zu+: %zu" : "size %zu: %zu",
+            size, histogram[size]);
+        -- budget;
+    }
+
+    node longest_style = { .style = STYLE_ROUNDED, .color = GRAPHVIZ_RED,   .shape = SHAPE_BOX };
+    node sampled_style = { .style = STYLE_ROUNDED, .color = GRAPHVIZ_GREEN, .shape = SHAPE_BOX };
+
+    for (size_t i = 0; i < longest_count && budget > 0; ++ i) {
+        hash_table_bucket* bucket = &table->hash_table[longest[i]];
+
+        node_id bucket_node = subgraph_insert_default_node(&graph, nodes, longest_style,
+            "bucket %zu (%zu pairs)", longest[i], bucket->size);
+        -- budget;
+
+        __hash_table_graph_chain(&graph, nodes, longest_style, table, bucket,
+                                 bucket_node, print, &budget);
+    }
+
+    // Sample non empty buckets, that aren't shown already. Number
+    // of attempts is bounded, so sparse tables won't take long
+    uint64_t state = options.seed != 0 ? options.seed : 1;
+
+    size_t samples[options.samples + 1];
+    size_t sampled = 0;
+    for (size_t attempt = 0; attempt < options.samples * 8 && sampled < options.samples &&
+                             budget > 0 && table->values.used > 0; ++ attempt) {
+
+        size_t position = __hash_table_xorshift(&state) & (table->buckets_capacity - 1);
+        hash_table_bucket* bucket = &table->hash_table[position];
+
+        bool is_shown = bucket->size == 0;
+        for (size_t i = 0; i < longest_count && !is_shown; ++ i)
+            is_shown = longest[i] == position;
+
+        for (size_t i = 0; i < sampled && !is_shown; ++ i)
+            is_shown = samples[i] == position;
+
+        if (is_shown)
+            continue;
+
+        node_id bucket_node = subgraph_insert_default_node(&graph, nodes, sampled_style,
+            "bucket %zu (%zu pairs)", position, bucket->size);
+        -- budget;
+
+        __hash_table_graph_chain(&graph, nodes, sampled_style, table, bucket,
+                                 bucket_node, print, &budget);
+        samples[sampled ++] = position;
+    }
+
+    return graph;
+}
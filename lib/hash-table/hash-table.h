@@ -161,8 +161,15 @@ void hash_table_rehash(hash_table<K, V>* table,
     HASH_TABLE_TRAVERSE(table, K, V, current)
         hash_table_insert(&new_table, KEY(current), VALUE(current));
 
+    // Recorder of values keeps it's pointer, every slot of them is rewritten
+    const bool is_recorded = table->values.dirty != NULL;
+
     hash_table_destroy(table);
     *table = new_table; // Replace hash_table with a new one
+
+    if (is_recorded)
+        TRY linked_list_track_all_dirty(&table->values)
+            THROW("Failed to keep recording rehashed values!");
 }
 
 template <typename K, typename V>
@@ -179,11 +186,17 @@ bool hash_table_delete(hash_table<K, V>* table, K key) {
     if (index == linked_list_end_index)
         return false;
 
+    // Bucket starts from the next pair, if it's first one is deleted
+    if (bucket->value_index == index)
+        bucket->value_index = linked_list_get_pointer(&table->values, index)->next_index;
+
     TRY linked_list_delete(&table->values, index)
         THROW("Value deletion failed!");
 
     -- bucket->size; // Since we found element
-    // Bucket should be bigger than 1 in any case
+
+    if (bucket->size == 0)
+        -- table->buckets_used;
 
     return true; // Deletion succeeded
 }
@@ -193,6 +206,10 @@ bool hash_table_contains(hash_table<K, V>* table, K key) {
     return __hash_table_lookup_index(table, key) != linked_list_end_index;
 }
 
+// How much table grows when it's load factor gets too big
+const double HASH_TABLE_GROW = 2.0;
+const double HASH_TABLE_MAX_LOAD_FACTOR = 0.5;
+
 template <typename K, typename V>
 bool hash_table_insert(hash_table<K, V>* table, K key, V value) {
     hash_table_bucket* bucket;
@@ -210,17 +227,59 @@ bool hash_table_insert(hash_table<K, V>* table, K key, V value) {
 
     ++ bucket->size;
 
-    const double GROW = 2.0;
-    const double MAX_LOAD_FACTOR = 0.5;
-
     if ((double) table->buckets_used /
-        (double) table->buckets_capacity >= MAX_LOAD_FACTOR)
-        hash_table_rehash(table, table->buckets_capacity * GROW,
-                                 table-> values.capacity * GROW);
+        (double) table->buckets_capacity >= HASH_TABLE_MAX_LOAD_FACTOR)
+        hash_table_rehash(table, table->buckets_capacity * HASH_TABLE_GROW,
+                                 table-> values.capacity * HASH_TABLE_GROW);
 
     return true; // Inserted successfully
 }
 
+/**
+ * Find pair with @arg key or insert new pair with @arg value, hashing
+ * key and probing table only once
+ *
+ * @return Pointer to found or inserted pair. Key of inserted pair can
+ * be replaced with an equal one (e.g. to share storage with the caller)
+ *
+ * @note Pointer is only valid until next insertion in the table
+ */
+template <typename K, typename V>
+hash_table_pair<K, V>* hash_table_lookup_or_insert(hash_table<K, V>* table, K key, V value,
+                                                   bool* inserted = NULL) {
+
+    // Grow before probing, insertion after it shouldn't move found bucket
+    if ((double) (table->buckets_used + 1) /
+        (double)  table->buckets_capacity >= HASH_TABLE_MAX_LOAD_FACTOR)
+        hash_table_rehash(table, table->buckets_capacity * HASH_TABLE_GROW,
+                                 table-> values.capacity * HASH_TABLE_GROW);
+
+    hash_table_bucket* bucket;
+    element_index_t index = __hash_table_lookup_index(table, key, &bucket);
+
+    if (inserted != NULL)
+        *inserted = index == linked_list_end_index;
+
+    if (index != linked_list_end_index)
+        return &linked_list_get_pointer(&table->values, index)->element;
+
+    if (bucket->size > 0)
+        TRY linked_list_insert_after(&table->values, { key, value },
+                                     bucket->value_index, &index)
+            THROW("Failed to insert new value in existing bucket!");
+    else {
+        ++ table->buckets_used;
+        TRY linked_list_push_back(   &table->values, { key, value }, &index)
+            THROW("Failed to insert new value in a new bucket (size: %d)!", bucket->size);
+
+        bucket->value_index = index;
+    }
+
+    ++ bucket->size;
+
+    return &linked_list_get_pointer(&table->values, index)->element;
+}
+
 template <typename K, typename V>
 void hash_table_destroy(hash_table<K, V>* table) {
     linked_list_destroy(&table->values);
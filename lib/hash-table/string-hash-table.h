@@ -0,0 +1,180 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "default-hash-functions.h"
+#include "hash-table.h"
+#include "trace.h"
+
+// Longest key, that is stored right in the pair, one byte is for '\0'
+const size_t STRING_KEY_INLINE_CAPACITY = 15;
+
+/**
+ * Owned string key. Hash and length are compared first, so most probes
+ * are rejected without touching characters. Short keys are compared
+ * without leaving the pair, long ones live in table's arena.
+ */
+struct string_key {
+    uint32_t hash, length;
+
+    union {
+        char chars[STRING_KEY_INLINE_CAPACITY + 1];
+        const char* pointer;
+    };
+};
+
+inline bool string_key_is_inline(const string_key* key) {
+    return key->length <= STRING_KEY_INLINE_CAPACITY;
+}
+
+inline const char* string_key_chars(const string_key* key) {
+    return string_key_is_inline(key) ? key->chars : key->pointer;
+}
+
+/**
+ * Key, that refers to @arg string without copying it, it's good
+ * for lookups only, since string is not owned
+ */
+inline string_key string_key_borrow(const char* string) {
+    string_key key = {
+        .hash = str_hash(string), .length = (uint32_t) strlen(string), .chars = {}
+    };
+
+    if (string_key_is_inline(&key))
+        memcpy(key.chars, string, key.length);
+    else
+        key.pointer = string;
+
+    return key;
+}
+
+inline uint32_t string_key_hash(string_key key) {
+    return key.hash;
+}
+
+inline bool string_key_equals(string_key* first, string_key* second) {
+    if (first->hash != second->hash || first->length != second->length)
+        return false;
+
+    // Inline keys are zero padded, so they are compared as a whole
+    if (string_key_is_inline(first))
+        return memcmp(first->chars, second->chars, sizeof(first->chars)) == 0;
+
+    return memcmp(first->pointer, second->pointer, first->length) == 0;
+}
+
+/** Chunk of memory for long keys, chunks are freed with the table */
+struct string_arena_chunk {
+    string_arena_chunk* previous;
+    size_t used, capacity;
+
+    char bytes[];
+};
+
+// Smallest chunk, bigger keys get chunk of their own size
+const size_t STRING_ARENA_CHUNK_CAPACITY = 4096;
+
+/**
+ * Hash table, that owns it's string keys, so callers don't need to keep
+ * them alive. Keys of deleted pairs stay in the arena until table is
+ * destroyed.
+ */
+template <typename V>
+struct string_hash_table {
+    hash_table<string_key, V> table;
+    string_arena_chunk* arena;
+};
+
+template <typename V>
+stack_trace* string_hash_table_create(string_hash_table<V>* table,
+                                      size_t bucket_capacity = 32,
+                                      size_t value_list_size = 10) {
+    table->arena = NULL;
+
+    TRY hash_table_create(&table->table, string_key_hash, bucket_capacity,
+                          value_list_size, string_key_equals)
+        FAIL("Failed to create table for string keys!");
+
+    return SUCCESS();
+}
+
+template <typename V>
+void string_hash_table_destroy(string_hash_table<V>* table) {
+    hash_table_destroy(&table->table);
+
+    while (table->arena != NULL) {
+        string_arena_chunk* previous = table->arena->previous;
+        free(table->arena), table->arena = previous;
+    }
+}
+
+// Copy long key to the arena, so table owns it
+template <typename V>
+static stack_trace* __string_hash_table_store(string_hash_table<V>* table, const char* string,
+                                              size_t length, const char** stored) {
+    string_arena_chunk* chunk = table->arena;
+
+    if (chunk == NULL || chunk->capacity - chunk->used < length + 1) {
+        size_t capacity = length + 1 > STRING_ARENA_CHUNK_CAPACITY ?
+                          length + 1 : STRING_ARENA_CHUNK_CAPACITY;
+
+        char* memory = NULL;
+        TRY safe_calloc(sizeof(string_arena_chunk) + capacity, &memory)
+            FAIL("Failed to allocate arena chunk of %zu bytes!", capacity);
+
+        chunk = (string_arena_chunk*) memory;
+        *chunk = { .previous = table->arena, .used = 0, .capacity = capacity };
+
+        table->arena = chunk;
+    }
+
+    char* copy = chunk->bytes + chunk->used;
+    memcpy(copy, string, length + 1);
+
+    chunk->used += length + 1;
+
+    *stored = copy;
+    return SUCCESS();
+}
+
+/**
+ * Insert copy of @arg key, existing values aren't replaced
+ *
+ * @return false if there's same key in the table
+ */
+template <typename V>
+bool string_hash_table_insert(string_hash_table<V>* table, const char* key, V value) {
+    string_key new_key = string_key_borrow(key);
+
+    // Long key is copied before insertion, table never points to caller's string
+    if (!string_key_is_inline(&new_key)) {
+        if (hash_table_contains(&table->table, new_key))
+            return false;
+
+        TRY __string_hash_table_store(table, key, new_key.length, &new_key.pointer)
+            THROW("Failed to store key of %u bytes!", new_key.length);
+    }
+
+    return hash_table_insert(&table->table, new_key, value);
+}
+
+template <typename V>
+V* string_hash_table_lookup(string_hash_table<V>* table, const char* key) {
+    return hash_table_lookup(&table->table, string_key_borrow(key));
+}
+
+template <typename V>
+bool string_hash_table_contains(string_hash_table<V>* table, const char* key) {
+    return hash_table_contains(&table->table, string_key_borrow(key));
+}
+
+template <typename V>
+bool string_hash_table_delete(string_hash_table<V>* table, const char* key) {
+    return hash_table_delete(&table->table, string_key_borrow(key));
+}
+
+#define STRING_HASH_TABLE_TRAVERSE(strings, value_type, current)                \
+    HASH_TABLE_TRAVERSE(&(strings)->table, string_key, value_type, current)
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "linked-list.h"
+#include "simple-stack.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Records step by step history of linked list, so it can be visualized
+ * later. Instead of full dump per step, only elements written since the
+ * previous frame are stored, list tracks them in it's dirty bitmap. Every
+ * few frames all elements are stored, so any frame is reconstructed from
+ * the closest keyframe with a few deltas.
+ *
+ * @note hash_table is built on linked_list, so it's steps can be recorded
+ *       by recording it's /values/ list, rehash marks every slot written
+ */
+template <typename E>
+struct linked_list_slot {
+    element_index_t index;
+    element<E> value;
+};
+
+struct linked_list_frame {
+    size_t capacity, used;
+    element_index_t free;
+    bool is_linearized;
+
+    // Frame's slots are [first_slot, first_slot + slot_count) of recorder
+    size_t first_slot, slot_count;
+};
+
+template <typename E>
+struct linked_list_recorder {
+    linked_list<E>* list;
+
+    simple_stack<linked_list_frame> frames;
+    simple_stack<linked_list_slot<E>> slots;
+
+    size_t keyframe_interval;
+};
+
+template <typename E>
+static inline
+void __linked_list_recorder_push_slot(linked_list_recorder<E>* recorder,
+                                      element_index_t index) {
+    simple_stack_push(&recorder->slots, (linked_list_slot<E>) {
+        .index = index, .value = recorder->list->elements[index]
+    });
+}
+
+/**
+ * Store current state of the list as a new frame
+ */
+template <typename E>
+void linked_list_recorder_snapshot(linked_list_recorder<E>* recorder) {
+    linked_list<E>* list = recorder->list;
+
+    const bool is_keyframe = recorder->frames.used % recorder->keyframe_interval == 0;
+    const size_t words = linked_list_dirty_words(list->capacity);
+
+    linked_list_frame frame = {
+        .capacity = list->capacity, .used = list->used,
+        .free = list->free, .is_linearized = list->is_linearized,
+        .first_slot = recorder->slots.used, .slot_count = 0
+    };
+
+    if (is_keyframe) {
+        for (element_index_t i = 0; i <= (element_index_t) list->capacity + 1; ++ i)
+            __linked_list_recorder_push_slot(recorder, i);
+    } else {
+        for (size_t word = 0; word < words; ++ word)
+            for (uint64_t bits = list->dirty[word]; bits != 0; bits &= bits - 1) {
+                size_t bit = (size_t) __builtin_ctzll(bits);
+                __linked_list_recorder_push_slot(recorder, (element_index_t)
+                    (word * LINKED_LIST_DIRTY_WORD_BITS + bit));
+            }
+    }
+
+    memset(list->dirty, 0, words * sizeof(*list->dirty));
+
+    frame.slot_count = recorder->slots.used - frame.first_slot;
+    simple_stack_push(&recorder->frames, frame);
+}
+
+/**
+ * Start tracking writes to @arg list and record it's initial state,
+ * recorder should be destroyed before the list
+ */
+template <typename E>
+stack_trace* linked_list_recorder_create(linked_list_recorder<E>* recorder,
+                                         linked_list<E>* list,
+                                         const size_t keyframe_interval = 64) {
+
+    if (list->dirty != NULL)
+        return FAILURE(RUNTIME_ERROR, "List is already recorded!");
+
+    list->dirty = (uint64_t*) calloc(linked_list_dirty_words(list->capacity),
+                                     sizeof(*list->dirty));
+    if (list->dirty == NULL)
+        return FAILURE(RUNTIME_ERROR, strerror(errno));
+
+    *recorder = {
+        .list = list, .frames = {}, .slots = {},
+        .keyframe_interval = keyframe_interval > 0 ? keyframe_interval : 1
+    };
+
+    simple_stack_create(&recorder->frames);
+    simple_stack_create(&recorder->slots);
+
+    linked_list_recorder_snapshot(recorder);
+
+    return SUCCESS();
+}
+
+/**
+ * Restore state of the list in @arg frame into @arg restored, which
+ * should be empty or restored by a previous call
+ */
+template <typename E>
+stack_trace* linked_list_recorder_restore(linked_list_recorder<E>* recorder,
+                                          const size_t frame, linked_list<E>* restored) {
+
+    if (frame >= recorder->frames.used)
+        return FAILURE(RUNTIME_ERROR, "There's only %zu frames, can't restore %zu!",
+                       recorder->frames.used, frame);
+
+    const linked_list_frame* last = &recorder->frames.elements[frame];
+
+    element<E>* new_space = (element<E>*)
+        realloc(restored->elements, sizeof(*new_space) * (last->capacity + 2));
+
+    if (new_space == NULL)
+        return FAILURE(RUNTIME_ERROR, strerror(errno));
+
+    *restored = {
+        .elements = new_space, .capacity = last->capacity, .used = last->used,
+        .free = last->free, .is_linearized = last->is_linearized, .dirty = NULL
+    };
+
+    const size_t keyframe = frame - frame % recorder->keyframe_interval;
+    for (size_t i = keyframe; i <= frame; ++ i) {
+        const linked_list_frame* current = &recorder->frames.elements[i];
+
+        for (size_t slot = current->first_slot;
+             slot < current->first_slot + current->slot_count; ++ slot) {
+
+            // List may have been replaced by a smaller one since keyframe
+            const linked_list_slot<E>* written = &recorder->slots.elements[slot];
+            if ((size_t) written->index <= last->capacity + 1)
+                restored->elements[written->index] = written->value;
+        }
+    }
+
+    return SUCCESS();
+}
+
+/**
+ * Write DOT of @arg frame to @arg file, the same linked_list_create_graph
+ * would write at the moment frame was recorded
+ */
+template <typename E>
+stack_trace* linked_list_recorder_write_frame(FILE* file, linked_list_recorder<E>* recorder,
+                                              const size_t frame) {
+    linked_list<E> restored = {};
+
+    TRY linked_list_recorder_restore(recorder, frame, &restored) CATCH({
+        linked_list_destroy(&restored);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't restore frame %zu!", frame);
+    });
+
+    linked_list_create_graph(file, &restored);
+    linked_list_destroy(&restored);
+
+    return SUCCESS();
+}
+
+/**
+ * Free recorded frames and stop tracking writes to the list
+ */
+template <typename E>
+void linked_list_recorder_destroy(linked_list_recorder<E>* recorder) {
+    free(recorder->list->dirty), recorder->list->dirty = NULL;
+
+    simple_stack_destruct(&recorder->frames);
+    simple_stack_destruct(&recorder->slots);
+
+    *recorder = {};
+}
@@ -1,4 +1,5 @@
 #include "linked-list.h"
+#include "linked-list-recorder.h"
 #include "test-framework.h"
 
 #include "simple-stack.h"
@@ -159,6 +160,76 @@ TEST(test_linked_list) {
     linked_list_destroy(&list);
 }
 
+static char* read_graph(void (*write)(FILE* file, void* data), void* data) {
+    char* graph = NULL;
+    size_t size = 0;
+
+    FILE* file = open_memstream(&graph, &size);
+    write(file, data);
+    fclose(file);
+
+    return graph;
+}
+
+static void write_list(FILE* file, void* list) {
+    linked_list_create_graph(file, (linked_list<int>*) list);
+}
+
+struct recorded_frame { linked_list_recorder<int>* recorder; size_t frame; };
+
+static void write_recorded(FILE* file, void* data) {
+    recorded_frame* frame = (recorded_frame*) data;
+    trace_destruct(linked_list_recorder_write_frame(file, frame->recorder, frame->frame));
+}
+
+TEST(record_linked_list_steps) {
+    linked_list<int> list = {};
+    TRY linked_list_create(&list, 4)
+        ASSERT_SUCCESS();
+
+    linked_list_recorder<int> recorder = {};
+    TRY linked_list_recorder_create(&recorder, &list, 4)
+        ASSERT_SUCCESS();
+
+    simple_stack<frame_t> expected = frame_stack_create();
+    simple_stack_push(&expected, read_graph(write_list, &list));
+
+    element_index_t places[20] = {};
+    for (int i = 0; i < 20; ++ i) {
+        linked_list_push_back(&list, i, &places[i]);
+
+        if (i % 3 == 2)
+            linked_list_delete(&list, places[i - 1]);
+
+        linked_list_recorder_snapshot(&recorder);
+        simple_stack_push(&expected, read_graph(write_list, &list));
+    }
+
+    linked_list_linearize(&list);
+    linked_list_recorder_snapshot(&recorder);
+    simple_stack_push(&expected, read_graph(write_list, &list));
+
+    ASSERT_EQUAL((int) recorder.frames.used, (int) expected.used);
+
+    // Every step writes only a few elements
+    ASSERT_EQUAL(recorder.slots.used < expected.used * (list.capacity + 2) / 2, true);
+
+    for (size_t i = 0; i < expected.used; ++ i) {
+        recorded_frame frame = { &recorder, i };
+        char* restored = read_graph(write_recorded, &frame);
+
+        ASSERT_EQUAL(strcmp(restored, expected.elements[i]), 0);
+
+        free(restored);
+        free(expected.elements[i]);
+    }
+
+    simple_stack_destruct(&expected);
+
+    linked_list_recorder_destroy(&recorder);
+    linked_list_destroy(&list);
+}
+
 int main(void) {
     return test_framework_run_all_unit_tests();
 }
@@ -1,4 +1,5 @@
 #include "graphviz.h"
+#include "graphviz-label-template.h"
 
 template <typename E>
 digraph create_linked_list_graph(linked_list<E>* list) {
@@ -10,18 +11,26 @@ digraph create_linked_list_graph(linked_list<E>* list) {
                 .shape = SHAPE_BOX
             };
 
-            node_id nodes[list->capacity + 1];
-
-            for (int i = 1; i <= (int) list->capacity + 1; ++ i) {
-                const element<E>* el = &list->elements[i];
-                nodes[i] = NODE(R"(node_%03d [label = <<table border="0" cellborder="1" cellspacing="0">
+            // Record is parsed once, nodes only fill it's slots
+            label_template record = {};
+            TRY label_template_create(&record,
+                R"(node_%03d [label = <<table border="0" cellborder="1" cellspacing="0">
                             <tr> <td port="index" colspan="2"> %d </td> </tr>
                             <tr> <td> elem </td> <td port="elem"> %d </td> </tr>
                             <tr> <td> prev </td> <td port="prev"> %d </td> </tr>
                             <tr> <td> next </td> <td port="next"> %d </td> </tr>
-                        </table>>];)" "\n", i, i, el->element, el->prev_index, el->next_index);
+                        </table>>];)" "\n") THROW("Invalid record template!");
+
+            node_id nodes[list->capacity + 2];
+
+            for (int i = 1; i <= (int) list->capacity + 1; ++ i) {
+                const element<E>* el = &list->elements[i];
+                nodes[i] = TEMPLATE_NODE(&record, i, i, el->element,
+                                         el->prev_index, el->next_index);
             }
 
+            label_template_destroy(&record);
+
             for (int i = list->elements[0].next_index != 0? 0 : 1; i <= (int) list->capacity + 1; ++ i) {
                 const element<E>* el = &list->elements[i];
 
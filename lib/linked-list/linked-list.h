@@ -7,6 +7,7 @@
 #include <malloc.h>
 #include <string.h>
 #include <errno.h>
+#include <stdint.h>
 
 typedef int element_index_t;
 
@@ -26,8 +27,50 @@ struct linked_list {
 
     element_index_t free;
     bool is_linearized;
+
+    // Bitmap of elements written since it was last cleared,
+    // NULL if writes aren't tracked (see linked-list-recorder.h)
+    uint64_t* dirty;
 };
 
+const size_t LINKED_LIST_DIRTY_WORD_BITS = 64;
+
+inline size_t linked_list_dirty_words(const size_t capacity) {
+    // Two more for terminal nodes
+    return (capacity + 2 + LINKED_LIST_DIRTY_WORD_BITS - 1) / LINKED_LIST_DIRTY_WORD_BITS;
+}
+
+template <typename E>
+inline void linked_list_mark_dirty(linked_list<E>* list, element_index_t index) {
+    if (list->dirty != NULL)
+        list->dirty[(size_t) index / LINKED_LIST_DIRTY_WORD_BITS] |=
+            (uint64_t) 1 << ((size_t) index % LINKED_LIST_DIRTY_WORD_BITS);
+}
+
+/**
+ * Track writes to @arg list as if every element was just written, for
+ * lists that replace a tracked one (e.g. when hash table is rehashed)
+ */
+template <typename E>
+stack_trace* linked_list_track_all_dirty(linked_list<E>* list) {
+    const size_t words = linked_list_dirty_words(list->capacity);
+
+    uint64_t* dirty = (uint64_t*) realloc(list->dirty, words * sizeof(*dirty));
+    if (dirty == NULL)
+        return FAILURE(RUNTIME_ERROR, strerror(errno));
+
+    memset(dirty, 0xff, words * sizeof(*dirty));
+
+    // Bits past the last element stay clear, snapshot stores every set one
+    const size_t tail = (list->capacity + 2) % LINKED_LIST_DIRTY_WORD_BITS;
+    if (tail != 0)
+        dirty[words - 1] = ((uint64_t) 1 << tail) - 1;
+
+    list->dirty = dirty;
+
+    return SUCCESS();
+}
+
 
 template <typename E>
 inline element<E>* linked_list_next(linked_list<E>* list, element<E>* current) {
@@ -94,6 +137,7 @@ stack_trace* linked_list_create(linked_list<E>* list, const size_t capacity = 10
     list->capacity = capacity;
 
     list->is_linearized = true;
+    list->dirty = NULL;
 
     // Memory is assumed to be zeroed after calloc
     linked_list_head(list)->is_free = false;
@@ -139,6 +183,18 @@ stack_trace* linked_list_resize(linked_list<E>* list, const size_t new_capacity)
 
     list->elements = new_space;
 
+    if (list->dirty != NULL) {
+        const size_t old_words = linked_list_dirty_words(list->capacity),
+                     new_words = linked_list_dirty_words(new_capacity);
+
+        uint64_t* new_dirty = (uint64_t*) realloc(list->dirty, new_words * sizeof(*new_dirty));
+        if (new_dirty == NULL)
+            return FAILURE(RUNTIME_ERROR, strerror(errno));
+
+        memset(new_dirty + old_words, 0, (new_words - old_words) * sizeof(*new_dirty));
+        list->dirty = new_dirty;
+    }
+
     for (element_index_t i = list->capacity + 2; i <= (element_index_t) new_capacity + 1; ++ i)
         add_free_element(list, i);
 
@@ -216,6 +272,10 @@ void __linked_list_insert_after_in_place(linked_list<E>* list, E value,
     list->elements[prev_index].next_index = place_for_new_element;
     list->elements[next_index].prev_index = place_for_new_element;
 
+    linked_list_mark_dirty(list, prev_index);
+    linked_list_mark_dirty(list, next_index);
+    linked_list_mark_dirty(list, place_for_new_element);
+
     // Construct new element in the new place
     list->elements[place_for_new_element] = {
         .next_index = next_index,
@@ -295,6 +355,9 @@ stack_trace* linked_list_unlink(linked_list<E>* list, element_index_t actual_ind
     list->elements[prev_index].next_index = current->next_index;
     list->elements[next_index].prev_index = current->prev_index;
 
+    linked_list_mark_dirty(list, prev_index);
+    linked_list_mark_dirty(list, next_index);
+
     return SUCCESS();
 }
 
@@ -386,6 +449,13 @@ stack_trace* linked_list_swap(linked_list<E>* list,
 
     swap(first, second); // We've prepared elements, now we can swap
 
+    linked_list_mark_dirty(list, linked_list_get_index(list, fst_prev));
+    linked_list_mark_dirty(list, linked_list_get_index(list, fst_next));
+    linked_list_mark_dirty(list, linked_list_get_index(list, snd_prev));
+    linked_list_mark_dirty(list, linked_list_get_index(list, snd_next));
+    linked_list_mark_dirty(list, fst_index);
+    linked_list_mark_dirty(list, snd_index);
+
     return SUCCESS();
 }
 
@@ -452,6 +522,7 @@ template <typename E>
 void linked_list_destroy(linked_list<E> *list) {
     if (list != NULL) {
         free(list->elements);
+        free(list->dirty);
         *list = {}; // Zero list out
     }
 
@@ -0,0 +1,37 @@
+#include "mapped-array.h"
+#include "test-framework.h"
+
+#include <stdio.h>
+
+TEST(grow_mapped_array_and_reopen_it) {
+    char file_name[256] = { 0 };
+    ASSERT_EQUAL((tmpnam(file_name) != 0), true);
+
+    mapped_array<int> array = {};
+    TRY mapped_array_create(&array, file_name, 2)
+        ASSERT_SUCCESS();
+
+    const int element_count = 100000;
+    for (int i = 0; i < element_count; ++ i)
+        TRY mapped_array_push_back(&array, i * 2)
+            ASSERT_SUCCESS();
+
+    TRY mapped_array_close(&array)
+        ASSERT_SUCCESS();
+
+    TRY mapped_array_open(&array, file_name)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL((int) array.used, element_count);
+
+    int index = 0;
+    MAPPED_ARRAY_TRAVERSE(&array, int, current)
+        ASSERT_EQUAL(*current, 2 * index ++);
+
+    TRY mapped_array_close(&array)
+        ASSERT_SUCCESS();
+
+    remove(file_name);
+}
+
+TEST_MAIN()
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Growable array that lives in a memory mapped file, so it can be bigger
+ * than memory, page cache decides what stays resident. File holds exactly
+ * /used/ elements after array is closed, so it can be reopened later.
+ *
+ * @note Elements have no reference stability, growing can move mapping
+ */
+template <typename E>
+struct mapped_array {
+    E* elements;
+    size_t capacity, used;
+
+    int fd;
+};
+
+// How much array grows when it runs out of space
+const double MAPPED_ARRAY_GROW = 2.0;
+
+template <typename E>
+static inline
+stack_trace* __mapped_array_map(mapped_array<E>* array, size_t capacity) {
+    // Mapping of zero bytes isn't allowed
+    if (capacity == 0)
+        capacity = 1;
+
+    if (ftruncate(array->fd, (off_t) (capacity * sizeof(E))) == -1)
+        return FAILURE(RUNTIME_ERROR, "Failed to resize file to %zu elements: %s",
+                       capacity, strerror(errno));
+
+    void* new_space = array->elements == NULL ?
+        mmap(NULL, capacity * sizeof(E), PROT_READ | PROT_WRITE,
+             MAP_SHARED, array->fd, 0) :
+        mremap(array->elements, array->capacity * sizeof(E),
+               capacity * sizeof(E), MREMAP_MAYMOVE);
+
+    if (new_space == MAP_FAILED)
+        return FAILURE(RUNTIME_ERROR, "Failed to map %zu elements: %s",
+                       capacity, strerror(errno));
+
+    array->elements = (E*) new_space;
+    array->capacity = capacity;
+
+    return SUCCESS();
+}
+
+/**
+ * Create empty array in file @arg file_name, file is truncated if it exists
+ */
+template <typename E>
+stack_trace* mapped_array_create(mapped_array<E>* array, const char* file_name,
+                                 const size_t capacity = 1024) {
+    *array = { .elements = NULL, .capacity = 0, .used = 0, .fd = -1 };
+
+    array->fd = open(file_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (array->fd == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't create %s: %s", file_name, strerror(errno));
+
+    TRY __mapped_array_map(array, capacity) CATCH({
+        close(array->fd); array->fd = -1;
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't map %s!", file_name);
+    });
+
+    return SUCCESS();
+}
+
+/**
+ * Map existing file @arg file_name, created by mapped_array_create
+ */
+template <typename E>
+stack_trace* mapped_array_open(mapped_array<E>* array, const char* file_name) {
+    *array = { .elements = NULL, .capacity = 0, .used = 0, .fd = -1 };
+
+    array->fd = open(file_name, O_RDWR);
+    if (array->fd == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't open %s: %s", file_name, strerror(errno));
+
+    struct stat file_stats;
+    if (fstat(array->fd, &file_stats) == -1) {
+        close(array->fd), array->fd = -1;
+        return FAILURE(RUNTIME_ERROR, "Can't get size of %s: %s",
+                       file_name, strerror(errno));
+    }
+
+    const size_t used = (size_t) file_stats.st_size / sizeof(E);
+
+    TRY __mapped_array_map(array, used) CATCH({
+        close(array->fd); array->fd = -1;
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't map %s!", file_name);
+    });
+
+    array->used = used;
+    return SUCCESS();
+}
+
+template <typename E>
+stack_trace* mapped_array_reserve(mapped_array<E>* array, const size_t count) {
+    if (array->used + count <= array->capacity)
+        return SUCCESS();
+
+    size_t new_capacity = array->capacity;
+    while (new_capacity < array->used + count)
+        new_capacity = (size_t) ((double) new_capacity * MAPPED_ARRAY_GROW) + 1;
+
+    TRY __mapped_array_map(array, new_capacity)
+        FAIL("Failed to grow mapped array from %zu to %zu elements!",
+             array->capacity, new_capacity);
+
+    return SUCCESS();
+}
+
+/**
+ * Append @arg count elements to the end of array
+ *
+ * @arg first is set to index of the first appended element, if not NULL
+ */
+template <typename E>
+stack_trace* mapped_array_append(mapped_array<E>* array, const E* values,
+                                 const size_t count, size_t* first = NULL) {
+
+    TRY mapped_array_reserve(array, count)
+        FAIL("Not enough space for %zu elements!", count);
+
+    memcpy(array->elements + array->used, values, count * sizeof(E));
+
+    if (first != NULL)
+        *first = array->used;
+
+    array->used += count;
+    return SUCCESS();
+}
+
+template <typename E>
+inline stack_trace* mapped_array_push_back(mapped_array<E>* array, E value,
+                                           size_t* index = NULL) {
+    return mapped_array_append(array, &value, 1, index);
+}
+
+/**
+ * Tell kernel that array is going to be read from the start to the end,
+ * so it reads ahead more aggressively and drops pages that were read
+ */
+template <typename E>
+void mapped_array_advise_sequential(mapped_array<E>* array) {
+    madvise(array->elements, array->capacity * sizeof(E), MADV_SEQUENTIAL);
+}
+
+/**
+ * Unmap array, file is truncated to the used elements and kept
+ */
+template <typename E>
+stack_trace* mapped_array_close(mapped_array<E>* array) {
+    if (array->elements != NULL)
+        munmap(array->elements, array->capacity * sizeof(E));
+
+    bool truncated = true;
+    if (array->fd != -1) {
+        truncated = ftruncate(array->fd, (off_t) (array->used * sizeof(E))) != -1;
+        close(array->fd);
+    }
+
+    *array = { .elements = NULL, .capacity = 0, .used = 0, .fd = -1 };
+
+    if (!truncated)
+        return FAILURE(RUNTIME_ERROR, "Failed to truncate file: %s", strerror(errno));
+
+    return SUCCESS();
+}
+
+#define MAPPED_ARRAY_TRAVERSE(array, type, current)                     \
+    for (type* current = (array)->elements;                             \
+         current < (array)->elements + (array)->used; ++ current)
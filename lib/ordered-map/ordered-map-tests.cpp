@@ -0,0 +1,145 @@
+#include "ordered-map.h"
+#include "test-framework.h"
+
+#include <stdio.h>
+
+TEST(insert_random_keys_and_traverse_in_order) {
+    ordered_map<int, int> map = {};
+    TRY ordered_map_create(&map)
+        ASSERT_SUCCESS();
+
+    const int key_count = 20000;
+    static bool is_inserted[key_count] = {};
+
+    // Keys are shuffled with a multiplicative permutation, half are repeated
+    size_t inserted = 0;
+    for (int i = 0; i < 2 * key_count; ++ i) {
+        int key = (int) ((i * 7919u) % key_count) - key_count / 2;
+
+        bool is_new = ordered_map_insert(&map, key, key * 3);
+        ASSERT_EQUAL(is_new, !is_inserted[key + key_count / 2]);
+
+        is_inserted[key + key_count / 2] = true;
+        inserted += is_new;
+    }
+
+    ASSERT_EQUAL(map.size, inserted);
+    ASSERT_EQUAL(map.height > 2, true);
+
+    int expected = -key_count / 2;
+    ORDERED_MAP_TRAVERSE(&map, int, int, current) {
+        ASSERT_EQUAL(*ordered_map_iterator_key(&current), expected);
+        ASSERT_EQUAL(*ordered_map_iterator_value(&current), expected * 3);
+        ++ expected;
+    }
+
+    ASSERT_EQUAL(expected, key_count / 2);
+
+    ASSERT_EQUAL(*ordered_map_lookup(&map, -7), -21);
+    ASSERT_EQUAL(ordered_map_lookup(&map, key_count), (int*) NULL);
+
+    // Deleted keys disappear from lookups and ranges
+    for (int key = 100; key < 200; ++ key)
+        ASSERT_EQUAL(ordered_map_delete(&map, key), true);
+
+    ASSERT_EQUAL(ordered_map_delete(&map, 150), false);
+    ASSERT_EQUAL(ordered_map_contains(&map, 150), false);
+
+    int in_range = 0;
+    ORDERED_MAP_TRAVERSE_RANGE(&map, int, int, 50, 250, current) {
+        int key = *ordered_map_iterator_key(&current);
+        ASSERT_EQUAL(key < 100 || key >= 200, true);
+        ++ in_range;
+    }
+
+    ASSERT_EQUAL(in_range, 100);
+
+    ordered_map_destroy(&map);
+}
+
+TEST(bulk_load_and_scan_ranges) {
+    const size_t count = 100000;
+
+    int* keys = NULL;
+    size_t* values = NULL;
+
+    TRY safe_calloc(count, &keys)   ASSERT_SUCCESS();
+    TRY safe_calloc(count, &values) ASSERT_SUCCESS();
+
+    for (size_t i = 0; i < count; ++ i)
+        keys[i] = (int) i * 2, values[i] = i;
+
+    ordered_map<int, size_t> map = {};
+    TRY ordered_map_create(&map)
+        ASSERT_SUCCESS();
+
+    TRY ordered_map_bulk_load(&map, keys, values, count)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(map.size, count);
+
+    for (size_t i = 0; i < count; i += 97) {
+        ASSERT_EQUAL(*ordered_map_lookup(&map, (int) i * 2), i);
+        ASSERT_EQUAL(ordered_map_lookup(&map, (int) i * 2 + 1), (size_t*) NULL);
+    }
+
+    // Odd bound starts from the next even key
+    size_t scanned = 0;
+    ORDERED_MAP_TRAVERSE_RANGE(&map, int, size_t, 1001, 3001, current) {
+        ASSERT_EQUAL(*ordered_map_iterator_value(&current), 501 + scanned);
+        ++ scanned;
+    }
+
+    ASSERT_EQUAL(scanned, (size_t) 1000);
+
+    // Tree built by bulk load keeps growing with inserts
+    ASSERT_EQUAL(ordered_map_insert(&map, 1001, (size_t) 0), true);
+    ASSERT_EQUAL(ordered_map_insert(&map, 1002, (size_t) 0), false);
+
+    ordered_map_iterator<int, size_t> found = ordered_map_lower_bound(&map, 1000);
+    ordered_map_iterator_next(&found);
+    ASSERT_EQUAL(*ordered_map_iterator_key(&found), 1001);
+
+    ordered_map_destroy(&map);
+
+    // Unsorted input is rejected
+    keys[10] = keys[11];
+
+    TRY ordered_map_create(&map) ASSERT_SUCCESS();
+
+    stack_trace* unsorted = ordered_map_bulk_load(&map, keys, values, count);
+    ASSERT_EQUAL(trace_is_success(unsorted), false);
+    trace_destruct(unsorted);
+
+    ordered_map_destroy(&map);
+
+    free(keys);
+    free(values);
+}
+
+TEST(order_labels_lexicographically) {
+    ordered_map<const char*, int> map = {};
+    TRY ordered_map_create(&map, ordered_map_string_compare)
+        ASSERT_SUCCESS();
+
+    const char* labels[] = { "node", "edge", "subgraph", "digraph", "label", "rank" };
+    for (int i = 0; i < 6; ++ i)
+        ordered_map_insert(&map, labels[i], i);
+
+    const char* expected[] = { "digraph", "edge", "label", "node", "rank", "subgraph" };
+
+    int index = 0;
+    ORDERED_MAP_TRAVERSE(&map, const char*, int, current)
+        ASSERT_EQUAL(strcmp(*ordered_map_iterator_key(&current), expected[index ++]), 0);
+
+    // Labels starting with "e" up to "n"
+    int in_range = 0;
+    ORDERED_MAP_TRAVERSE_RANGE(&map, const char*, int, "e", "n", current)
+        ++ in_range;
+
+    ASSERT_EQUAL(in_range, 2);
+
+    ordered_map_destroy(&map);
+}
+
+TEST_MAIN()
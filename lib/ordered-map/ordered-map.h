@@ -0,0 +1,544 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "safe-alloc.h"
+#include "trace.h"
+
+// Nodes start on cache line, so key search touches as few lines as possible
+const size_t ORDERED_MAP_CACHE_LINE = 64;
+
+// Keys of one node take four cache lines, multiple of four keys for SIMD
+template <typename K>
+constexpr size_t ordered_map_node_keys = sizeof(K) > 64 ? 4 : 256 / sizeof(K);
+
+// Deepest tree, that can be traversed, it's way more than 64-bit size needs
+const size_t ORDERED_MAP_MAX_HEIGHT = 32;
+
+template <typename K, typename V>
+struct ordered_map_leaf {
+    alignas(ORDERED_MAP_CACHE_LINE) K keys[ordered_map_node_keys<K>];
+    size_t count;
+
+    // Leaves are linked in key order, so ranges are scanned without descent
+    ordered_map_leaf *next, *previous;
+
+    V values[ordered_map_node_keys<K>];
+};
+
+/**
+ * Inner node, @arg keys[i] is the smallest key in subtree @arg children[i + 1]
+ */
+template <typename K>
+struct ordered_map_inner {
+    alignas(ORDERED_MAP_CACHE_LINE) K keys[ordered_map_node_keys<K>];
+    size_t count; // Number of keys, there's one more child
+
+    void* children[ordered_map_node_keys<K> + 1];
+};
+
+/**
+ * B+-tree, that keeps keys in order, so it answers range queries, that
+ * hash_table can't. Wide nodes are searched with SIMD when keys are
+ * ints in natural order.
+ *
+ * @note Deleted keys are removed only from leaves, leaves aren't merged,
+ *       so tree doesn't shrink until it's destroyed
+ */
+template <typename K, typename V>
+struct ordered_map {
+    int (*key_compare_function) (K* first, K* second);
+
+    void* root;
+    size_t height; // Zero for empty map, one if root is a leaf
+
+    ordered_map_leaf<K, V> *first, *last;
+    size_t size;
+};
+
+template <typename K>
+int ordered_map_natural_compare(K* first, K* second) {
+    return *first < *second ? -1 : *second < *first;
+}
+
+inline int ordered_map_string_compare(const char** first, const char** second) {
+    return strcmp(*first, *second);
+}
+
+template <typename K, typename V>
+stack_trace* ordered_map_create(ordered_map<K, V>* map,
+                                int (*key_compare_function) (K* first, K* second) =
+                                    ordered_map_natural_compare<K>) {
+    *map = {
+        .key_compare_function = key_compare_function,
+        .root = NULL, .height = 0,
+        .first = NULL, .last = NULL, .size = 0
+    };
+
+    return SUCCESS();
+}
+
+template <typename N>
+inline static stack_trace* __ordered_map_allocate_node(N** node) {
+    // Size should be multiple of alignment for aligned_alloc
+    const size_t size = (sizeof(N) + ORDERED_MAP_CACHE_LINE - 1) &
+                        ~(ORDERED_MAP_CACHE_LINE - 1);
+
+    *node = (N*) aligned_alloc(ORDERED_MAP_CACHE_LINE, size);
+    if (*node == NULL)
+        return FAILURE(RUNTIME_ERROR, "Failed to allocate node of %zu bytes!", size);
+
+    memset((void*) *node, 0, size);
+    return SUCCESS();
+}
+
+template <typename K, typename V>
+static void __ordered_map_destroy_subtree(void* node, size_t height) {
+    if (height > 1) {
+        ordered_map_inner<K>* inner = (ordered_map_inner<K>*) node;
+
+        for (size_t i = 0; i <= inner->count; ++ i)
+            __ordered_map_destroy_subtree<K, V>(inner->children[i], height - 1);
+    }
+
+    free(node);
+}
+
+template <typename K, typename V>
+void ordered_map_destroy(ordered_map<K, V>* map) {
+    if (map->root != NULL)
+        __ordered_map_destroy_subtree<K, V>(map->root, map->height);
+
+    *map = {};
+}
+
+/**
+ * Count keys of node that are less than (or equal to, if @arg inclusive)
+ * key, keys are sorted, so it's position of the key in node
+ */
+template <typename K, typename V>
+inline static size_t __ordered_map_count_less(ordered_map<K, V>* map, K* keys,
+                                              size_t count, K key, bool inclusive) {
+    size_t less = 0, i = 0;
+
+#ifdef __SSE2__
+    if constexpr (std::is_same<K, int>::value) {
+        if (map->key_compare_function == ordered_map_natural_compare<int>) {
+            const __m128i needle = _mm_set1_epi32(key);
+
+            // Every key of the block is compared at once, nodes are aligned
+            for (; i + 4 <= count; i += 4) {
+                __m128i block = _mm_load_si128((const __m128i*) (keys + i));
+
+                __m128i mask = inclusive ?
+                    _mm_andnot_si128(_mm_cmpgt_epi32(block, needle), _mm_set1_epi32(-1)) :
+                    _mm_cmplt_epi32(block, needle);
+
+                less += (size_t) __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(mask)));
+            }
+        }
+    }
+#endif
+
+    for (; i < count; ++ i) {
+        int order = map->key_compare_function(&keys[i], &key);
+        less += order < 0 || (inclusive && order == 0);
+    }
+
+    return less;
+}
+
+template <typename K, typename V>
+static ordered_map_leaf<K, V>* __ordered_map_find_leaf(ordered_map<K, V>* map, K key,
+                                                       ordered_map_inner<K>** path = NULL,
+                                                       size_t* path_children = NULL) {
+    void* node = map->root;
+
+    for (size_t level = 0; level + 1 < map->height; ++ level) {
+        ordered_map_inner<K>* inner = (ordered_map_inner<K>*) node;
+
+        size_t child = __ordered_map_count_less(map, inner->keys, inner->count, key, true);
+
+        if (path != NULL)
+            path[level] = inner, path_children[level] = child;
+
+        node = inner->children[child];
+    }
+
+    return (ordered_map_leaf<K, V>*) node;
+}
+
+template <typename K, typename V>
+V* ordered_map_lookup(ordered_map<K, V>* map, K key) {
+    if (map->root == NULL)
+        return NULL;
+
+    ordered_map_leaf<K, V>* leaf = __ordered_map_find_leaf(map, key);
+
+    size_t position = __ordered_map_count_less(map, leaf->keys, leaf->count, key, false);
+    if (position == leaf->count || map->key_compare_function(&leaf->keys[position], &key) != 0)
+        return NULL;
+
+    return &leaf->values[position];
+}
+
+template <typename K, typename V>
+bool ordered_map_contains(ordered_map<K, V>* map, K key) {
+    return ordered_map_lookup(map, key) != NULL;
+}
+
+template <typename E>
+inline static void __ordered_map_insert_at(E* elements, size_t count, size_t position, E element) {
+    memmove((void*) (elements + position + 1), (void*) (elements + position),
+            (count - position) * sizeof(E));
+
+    elements[position] = element;
+}
+
+// Insert key and it's right child in inner node, that has space for them
+template <typename K>
+inline static void __ordered_map_inner_insert(ordered_map_inner<K>* inner, size_t position,
+                                              K key, void* child) {
+    __ordered_map_insert_at(inner->keys, inner->count, position, key);
+    __ordered_map_insert_at(inner->children, inner->count + 1, position + 1, child);
+
+    ++ inner->count;
+}
+
+/**
+ * Insert new key, existing values aren't replaced
+ *
+ * @return false if there's same key in the map
+ */
+template <typename K, typename V>
+bool ordered_map_insert(ordered_map<K, V>* map, K key, V value) {
+    const size_t capacity = ordered_map_node_keys<K>;
+
+    if (map->root == NULL) {
+        ordered_map_leaf<K, V>* leaf = NULL;
+        TRY __ordered_map_allocate_node(&leaf)
+            THROW("Failed to allocate first leaf!");
+
+        map->root = map->first = map->last = leaf;
+        map->height = 1;
+    }
+
+    ordered_map_inner<K>* path[ORDERED_MAP_MAX_HEIGHT] = {};
+    size_t path_children[ORDERED_MAP_MAX_HEIGHT] = {};
+
+    ordered_map_leaf<K, V>* leaf = __ordered_map_find_leaf(map, key, path, path_children);
+
+    size_t position = __ordered_map_count_less(map, leaf->keys, leaf->count, key, false);
+    if (position < leaf->count && map->key_compare_function(&leaf->keys[position], &key) == 0)
+        return false;
+
+    ++ map->size;
+
+    if (leaf->count < capacity) {
+        __ordered_map_insert_at(leaf->keys,   leaf->count, position, key);
+        __ordered_map_insert_at(leaf->values, leaf->count, position, value);
+
+        ++ leaf->count;
+        return true;
+    }
+
+    // Split full leaf in halves, upper half goes to the new right leaf
+    ordered_map_leaf<K, V>* right = NULL;
+    TRY __ordered_map_allocate_node(&right)
+        THROW("Failed to allocate leaf!");
+
+    const size_t half = capacity / 2;
+
+    memcpy((void*) right->keys,   (void*) (leaf->keys   + half), (capacity - half) * sizeof(K));
+    memcpy((void*) right->values, (void*) (leaf->values + half), (capacity - half) * sizeof(V));
+
+    right->count = capacity - half, leaf->count = half;
+
+    right->previous = leaf, right->next = leaf->next;
+    if (leaf->next != NULL)
+        leaf->next->previous = right;
+    else
+        map->last = right;
+
+    leaf->next = right;
+
+    ordered_map_leaf<K, V>* target = position <= half ? leaf : right;
+    if (target == right)
+        position -= half;
+
+    __ordered_map_insert_at(target->keys,   target->count, position, key);
+    __ordered_map_insert_at(target->values, target->count, position, value);
+    ++ target->count;
+
+    // Push separator up, splitting full inner nodes on the way
+    K separator = right->keys[0];
+    void* new_child = right;
+
+    for (size_t level = map->height - 1; level -- > 0;) {
+        ordered_map_inner<K>* inner = path[level];
+        size_t child = path_children[level];
+
+        if (inner->count < capacity) {
+            __ordered_map_inner_insert(inner, child, separator, new_child);
+            return true;
+        }
+
+        ordered_map_inner<K>* inner_right = NULL;
+        TRY __ordered_map_allocate_node(&inner_right)
+            THROW("Failed to allocate inner node!");
+
+        // Middle key goes up, keys after it go to the right node
+        K middle = inner->keys[half];
+
+        inner_right->count = capacity - half - 1;
+        memcpy((void*) inner_right->keys, (void*) (inner->keys + half + 1),
+               inner_right->count * sizeof(K));
+        memcpy((void*) inner_right->children, (void*) (inner->children + half + 1),
+               (inner_right->count + 1) * sizeof(void*));
+
+        inner->count = half;
+
+        if (child <= half)
+            __ordered_map_inner_insert(inner, child, separator, new_child);
+        else
+            __ordered_map_inner_insert(inner_right, child - half - 1, separator, new_child);
+
+        separator = middle, new_child = inner_right;
+    }
+
+    // Root was split, tree grows by one level
+    ordered_map_inner<K>* root = NULL;
+    TRY __ordered_map_allocate_node(&root)
+        THROW("Failed to allocate new root!");
+
+    root->keys[0] = separator, root->count = 1;
+    root->children[0] = map->root, root->children[1] = new_child;
+
+    map->root = root;
+    ++ map->height;
+
+    return true;
+}
+
+/**
+ * @return false if there's no such key in the map
+ */
+template <typename K, typename V>
+bool ordered_map_delete(ordered_map<K, V>* map, K key) {
+    if (map->root == NULL)
+        return false;
+
+    ordered_map_leaf<K, V>* leaf = __ordered_map_find_leaf(map, key);
+
+    size_t position = __ordered_map_count_less(map, leaf->keys, leaf->count, key, false);
+    if (position == leaf->count || map->key_compare_function(&leaf->keys[position], &key) != 0)
+        return false;
+
+    -- leaf->count;
+
+    memmove((void*) (leaf->keys   + position), (void*) (leaf->keys   + position + 1),
+            (leaf->count - position) * sizeof(K));
+    memmove((void*) (leaf->values + position), (void*) (leaf->values + position + 1),
+            (leaf->count - position) * sizeof(V));
+
+    -- map->size;
+    return true;
+}
+
+// Free leaves of partially built map, that has no inner nodes yet
+template <typename K, typename V>
+static void __ordered_map_free_leaves(ordered_map<K, V>* map) {
+    for (ordered_map_leaf<K, V>* current = map->first; current != NULL;) {
+        ordered_map_leaf<K, V>* next = current->next;
+        free(current), current = next;
+    }
+
+    *map = { .key_compare_function = map->key_compare_function };
+}
+
+/**
+ * Build map from @arg count keys sorted in strictly increasing order,
+ * leaves are filled completely and tree is built level by level, which
+ * is much faster than inserting keys one by one. Map should be empty.
+ */
+template <typename K, typename V>
+stack_trace* ordered_map_bulk_load(ordered_map<K, V>* map, K* keys, V* values, size_t count) {
+    const size_t capacity = ordered_map_node_keys<K>;
+
+    if (map->root != NULL)
+        return FAILURE(RUNTIME_ERROR, "Bulk load needs empty map!");
+
+    for (size_t i = 1; i < count; ++ i)
+        if (map->key_compare_function(&keys[i - 1], &keys[i]) >= 0)
+            return FAILURE(RUNTIME_ERROR, "Keys aren't strictly increasing at %zu!", i);
+
+    if (count == 0)
+        return SUCCESS();
+
+    // Nodes of the level that is built and their smallest keys
+    size_t level_count = (count + capacity - 1) / capacity;
+
+    void** level = NULL;
+    K* level_keys = NULL;
+
+    TRY safe_calloc(level_count, &level)
+        FAIL("Failed to allocate %zu leaves!", level_count);
+
+    TRY safe_calloc(level_count, &level_keys) CATCH({
+        free(level);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate leaf keys!");
+    });
+
+    // Nodes are owned by map as soon as they are linked, so it can be destroyed on failure
+    ordered_map_leaf<K, V>* previous = NULL;
+    for (size_t i = 0; i < level_count; ++ i) {
+        ordered_map_leaf<K, V>* leaf = NULL;
+
+        TRY __ordered_map_allocate_node(&leaf) CATCH({
+            __ordered_map_free_leaves(map);
+            free(level); free(level_keys);
+
+            return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate leaf!");
+        });
+
+        leaf->count = i + 1 < level_count ? capacity : count - i * capacity;
+
+        memcpy((void*) leaf->keys,   (void*) (keys   + i * capacity), leaf->count * sizeof(K));
+        memcpy((void*) leaf->values, (void*) (values + i * capacity), leaf->count * sizeof(V));
+
+        leaf->previous = previous;
+        if (previous != NULL)
+            previous->next = leaf;
+        else
+            map->first = leaf;
+
+        previous = map->last = leaf;
+        level[i] = leaf, level_keys[i] = leaf->keys[0];
+    }
+
+    map->size = count, map->height = 1;
+
+    // Every inner node takes up to capacity + 1 nodes of the level below
+    while (level_count > 1) {
+        size_t parent_count = (level_count + capacity) / (capacity + 1);
+
+        for (size_t parent = 0; parent < parent_count; ++ parent) {
+            ordered_map_inner<K>* inner = NULL;
+            TRY __ordered_map_allocate_node(&inner)
+                THROW("Failed to allocate inner node!");
+
+            size_t begin = parent * (capacity + 1),
+                   end   = begin + capacity + 1 < level_count ? begin + capacity + 1 : level_count;
+
+            inner->count = end - begin - 1;
+            for (size_t child = begin; child < end; ++ child) {
+                inner->children[child - begin] = level[child];
+
+                if (child > begin)
+                    inner->keys[child - begin - 1] = level_keys[child];
+            }
+
+            // Parents are written behind nodes, that are already read
+            level[parent] = inner, level_keys[parent] = level_keys[begin];
+        }
+
+        level_count = parent_count;
+        ++ map->height;
+    }
+
+    map->root = level[0];
+
+    free(level);
+    free(level_keys);
+
+    return SUCCESS();
+}
+
+// -------------------------------- ITERATION --------------------------------
+
+template <typename K, typename V>
+struct ordered_map_iterator {
+    ordered_map_leaf<K, V>* leaf;
+    size_t index;
+};
+
+// Move to the next existing key, leaves emptied by deletes are skipped
+template <typename K, typename V>
+inline static void __ordered_map_iterator_settle(ordered_map_iterator<K, V>* iterator) {
+    while (iterator->leaf != NULL && iterator->index >= iterator->leaf->count)
+        iterator->leaf = iterator->leaf->next, iterator->index = 0;
+}
+
+template <typename K, typename V>
+ordered_map_iterator<K, V> ordered_map_begin(ordered_map<K, V>* map) {
+    ordered_map_iterator<K, V> iterator = { .leaf = map->first, .index = 0 };
+    __ordered_map_iterator_settle(&iterator);
+
+    return iterator;
+}
+
+/**
+ * @return iterator to the first key, that isn't less than @arg key
+ */
+template <typename K, typename V>
+ordered_map_iterator<K, V> ordered_map_lower_bound(ordered_map<K, V>* map, K key) {
+    if (map->root == NULL)
+        return { .leaf = NULL, .index = 0 };
+
+    ordered_map_leaf<K, V>* leaf = __ordered_map_find_leaf(map, key);
+
+    ordered_map_iterator<K, V> iterator = {
+        .leaf = leaf,
+        .index = __ordered_map_count_less(map, leaf->keys, leaf->count, key, false)
+    };
+
+    __ordered_map_iterator_settle(&iterator);
+    return iterator;
+}
+
+template <typename K, typename V>
+inline bool ordered_map_iterator_is_end(ordered_map_iterator<K, V>* iterator) {
+    return iterator->leaf == NULL;
+}
+
+template <typename K, typename V>
+inline void ordered_map_iterator_next(ordered_map_iterator<K, V>* iterator) {
+    ++ iterator->index;
+    __ordered_map_iterator_settle(iterator);
+}
+
+template <typename K, typename V>
+inline K* ordered_map_iterator_key(ordered_map_iterator<K, V>* iterator) {
+    return &iterator->leaf->keys[iterator->index];
+}
+
+template <typename K, typename V>
+inline V* ordered_map_iterator_value(ordered_map_iterator<K, V>* iterator) {
+    return &iterator->leaf->values[iterator->index];
+}
+
+#define ORDERED_MAP_TRAVERSE(map, key_type, value_type, iterator)                        \
+    for (ordered_map_iterator<key_type, value_type> iterator = ordered_map_begin(map);  \
+         !ordered_map_iterator_is_end(&iterator);                                      \
+         ordered_map_iterator_next(&iterator))
+
+/**
+ * Traverse keys in range [from, to) in order, only leaves are read
+ */
+#define ORDERED_MAP_TRAVERSE_RANGE(map, key_type, value_type, from, to, iterator)        \
+    for (ordered_map_iterator<key_type, value_type> iterator =                          \
+             ordered_map_lower_bound(map, from);                                        \
+         !ordered_map_iterator_is_end(&iterator) && ({                                  \
+             key_type __range_end = to;                                                 \
+             (map)->key_compare_function(ordered_map_iterator_key(&iterator),           \
+                                         &__range_end) < 0;                             \
+         });                                                                            \
+         ordered_map_iterator_next(&iterator))
@@ -0,0 +1,148 @@
+#include "render-cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "safe-alloc.h"
+#include "trace.h"
+
+render_cache_key render_cache_key_create(const void* graph, size_t size) {
+    // 64-bit FNV-1a, collisions are resolved by comparing graphs anyway
+    uint64_t hash = 0xCBF29CE484222325;
+
+    const unsigned char* bytes = (const unsigned char*) graph;
+    for (size_t i = 0; i < size; ++ i)
+        hash = (hash ^ bytes[i]) * 0x100000001B3;
+
+    return { .hash = hash, .graph = (const char*) graph, .size = size };
+}
+
+static uint32_t render_cache_key_hash(render_cache_key key) {
+    return (uint32_t) (key.hash ^ (key.hash >> 32));
+}
+
+static bool render_cache_key_equals(render_cache_key* first, render_cache_key* second) {
+    return first->hash == second->hash && first->size == second->size &&
+           memcmp(first->graph, second->graph, first->size) == 0;
+}
+
+stack_trace* render_cache_create(render_cache* cache, size_t capacity) {
+    *cache = {};
+    cache->capacity = capacity;
+
+    TRY linked_list_create(&cache->recent)
+        FAIL("Can't create list of cache entries!");
+
+    TRY hash_table_create(&cache->index, render_cache_key_hash, 32, 10,
+                          render_cache_key_equals) CATCH({
+        linked_list_destroy(&cache->recent);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't create cache index!");
+    });
+
+    return SUCCESS();
+}
+
+static void entry_destroy(render_cache_entry* entry) {
+    free((char*) entry->key.graph);
+    free(entry->image);
+
+    *entry = {};
+}
+
+void render_cache_destroy(render_cache* cache) {
+    LINKED_LIST_TRAVERSE(&cache->recent, render_cache_entry, current)
+        entry_destroy(&current->element);
+
+    linked_list_destroy(&cache->recent);
+    hash_table_destroy(&cache->index);
+
+    *cache = {};
+}
+
+// Move entry to the front of the list, it's index changes
+static element_index_t touch(render_cache* cache, element_index_t index) {
+    render_cache_entry entry = linked_list_get_pointer(&cache->recent, index)->element;
+
+    TRY linked_list_delete(&cache->recent, index)
+        THROW("Can't unlink cache entry!");
+
+    TRY linked_list_push_front(&cache->recent, entry, &index)
+        THROW("Can't move cache entry to the front!");
+
+    return index;
+}
+
+bool render_cache_lookup(render_cache* cache, render_cache_key key,
+                         char** image, size_t* image_size) {
+
+    element_index_t* index = hash_table_lookup(&cache->index, key);
+    if (index == NULL) {
+        ++ cache->misses;
+        return false;
+    }
+
+    *index = touch(cache, *index);
+    render_cache_entry* entry = &linked_list_get_pointer(&cache->recent, *index)->element;
+
+    *image = (char*) malloc(entry->image_size + 1);
+    if (*image == NULL)
+        return false;
+
+    memcpy(*image, entry->image, entry->image_size);
+    *image_size = entry->image_size;
+
+    ++ cache->hits;
+    return true;
+}
+
+static void evict_least_recent(render_cache* cache) {
+    element_index_t tail = linked_list_tail_index(&cache->recent);
+    render_cache_entry* entry = &linked_list_get_pointer(&cache->recent, tail)->element;
+
+    hash_table_delete(&cache->index, entry->key);
+    cache->size -= entry->key.size + entry->image_size;
+
+    entry_destroy(entry);
+
+    TRY linked_list_delete(&cache->recent, tail)
+        THROW("Can't delete evicted entry!");
+}
+
+stack_trace* render_cache_insert(render_cache* cache, render_cache_key key,
+                                 const char* image, size_t image_size) {
+
+    const size_t entry_size = key.size + image_size;
+    if (entry_size > cache->capacity || hash_table_contains(&cache->index, key))
+        return SUCCESS();
+
+    while (cache->size + entry_size > cache->capacity)
+        evict_least_recent(cache);
+
+    render_cache_entry entry = { .key = key, .image = NULL, .image_size = image_size };
+
+    char* graph = NULL;
+    TRY safe_calloc(key.size + 1, &graph)
+        FAIL("Can't copy graph of %zu bytes!", key.size);
+
+    memcpy(graph, key.graph, key.size);
+    entry.key.graph = graph;
+
+    TRY safe_calloc(image_size + 1, &entry.image) CATCH({
+        free(graph);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't copy image!");
+    });
+
+    memcpy(entry.image, image, image_size);
+
+    element_index_t index = linked_list_end_index;
+    TRY linked_list_push_front(&cache->recent, entry, &index) CATCH({
+        entry_destroy(&entry);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't add cache entry!");
+    });
+
+    // Index shares graph with the entry
+    hash_table_insert(&cache->index, entry.key, index);
+    cache->size += entry_size;
+
+    return SUCCESS();
+}
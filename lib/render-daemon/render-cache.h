@@ -0,0 +1,57 @@
+#pragma once
+
+#include "hash-table.h"
+#include "linked-list.h"
+#include "trace.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Graph, that was rendered, it's hash is computed once */
+struct render_cache_key {
+    uint64_t hash;
+
+    const char* graph;
+    size_t size;
+};
+
+struct render_cache_entry {
+    render_cache_key key; // Graph is owned by entry
+    char* image;
+    size_t image_size;
+};
+
+/**
+ * Images of the recently rendered graphs, least recently used are evicted
+ * when cache gets over it's capacity. Recent entries go first in the list,
+ * index maps graphs to their entries in the list.
+ */
+struct render_cache {
+    hash_table<render_cache_key, element_index_t> index;
+    linked_list<render_cache_entry> recent;
+
+    size_t size, capacity; // In bytes of graphs and images
+    size_t hits, misses;
+};
+
+render_cache_key render_cache_key_create(const void* graph, size_t size);
+
+stack_trace* render_cache_create(render_cache* cache, size_t capacity);
+
+void render_cache_destroy(render_cache* cache);
+
+/**
+ * Find image of graph @arg key, it's copied so it stays valid after the
+ * entry is evicted
+ *
+ * @return false if graph wasn't rendered
+ */
+bool render_cache_lookup(render_cache* cache, render_cache_key key,
+                         char** image, size_t* image_size);
+
+/**
+ * Add image of graph @arg key to the cache, both are copied. Images that
+ * are bigger than the whole cache aren't kept.
+ */
+stack_trace* render_cache_insert(render_cache* cache, render_cache_key key,
+                                 const char* image, size_t image_size);
@@ -0,0 +1,152 @@
+#include "render-daemon.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "graphviz-writer.h"
+#include "render-io.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+stack_trace* render_client_connect(render_client* client, const char* socket_path) {
+    *client = { .fd = -1 };
+
+    sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+        return FAILURE(RUNTIME_ERROR, "Socket path \"%s\" is too long!", socket_path);
+
+    strcpy(address.sun_path, socket_path);
+
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd == -1)
+        return FAILURE(RUNTIME_ERROR, "Can't create socket: %s", strerror(errno));
+
+    if (connect(client->fd, (sockaddr*) &address, sizeof(address)) == -1) {
+        int error = errno;
+        render_client_close(client);
+
+        return FAILURE(RUNTIME_ERROR, "Can't connect to \"%s\": %s",
+                       socket_path, strerror(error));
+    }
+
+    return SUCCESS();
+}
+
+stack_trace* render_client_render(render_client* client, render_format format,
+                                  const void* graph, size_t size,
+                                  char** image, size_t* image_size) {
+
+    render_request_header request = {
+        .magic = RENDER_MAGIC, .format = format, .size = size
+    };
+
+    TRY render_write_all(client->fd, &request, sizeof(request))
+        FAIL("Can't send request!");
+
+    TRY render_write_all(client->fd, graph, size)
+        FAIL("Can't send graph!");
+
+    render_response_header response = {};
+    TRY render_read_exact(client->fd, &response, sizeof(response))
+        FAIL("Can't receive response!");
+
+    if (response.magic != RENDER_MAGIC)
+        return FAILURE(RUNTIME_ERROR, "Response has wrong magic %x!", response.magic);
+
+    if (response.status != RENDER_OK)
+        return FAILURE(RUNTIME_ERROR, "Daemon failed to render graph!");
+
+    char* received = NULL;
+    TRY safe_calloc(response.size + 1, &received)
+        FAIL("Can't allocate image of %zu bytes!", (size_t) response.size);
+
+    TRY render_read_exact(client->fd, received, response.size) CATCH({
+        free(received);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't receive image!");
+    });
+
+    *image = received, *image_size = response.size;
+    return SUCCESS();
+}
+
+stack_trace* render_client_render_digraph(render_client* client, digraph* graph,
+                                          char** image, size_t* image_size) {
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        FAIL("Can't create buffer for graph!");
+
+    digraph_write(&writer, graph);
+
+    size_t size = 0;
+    char* dot = buffered_writer_take(&writer, &size);
+
+    bool failed = writer.failed;
+    trace_destruct(buffered_writer_destroy(&writer));
+
+    if (failed) {
+        free(dot);
+        return FAILURE(RUNTIME_ERROR, "Graph doesn't fit in memory!");
+    }
+
+    stack_trace* rendered = render_client_render(client, RENDER_DOT, dot, size,
+                                                 image, image_size);
+    free(dot);
+
+    TRY rendered FAIL("Can't render graph with daemon!");
+    return SUCCESS();
+}
+
+void render_client_close(render_client* client) {
+    if (client->fd != -1)
+        close(client->fd);
+
+    *client = { .fd = -1 };
+}
+
+static char* render_with_daemon(digraph* graph) {
+    render_client client = {};
+
+    stack_trace* connected = render_client_connect(&client);
+    if (!trace_is_success(connected)) {
+        trace_destruct(connected); // Daemon isn't running
+        return NULL;
+    }
+
+    char* image = NULL;
+    size_t image_size = 0;
+
+    stack_trace* rendered = render_client_render_digraph(&client, graph,
+                                                         &image, &image_size);
+    render_client_close(&client);
+
+    if (!trace_is_success(rendered)) {
+        trace_destruct(rendered);
+        return NULL;
+    }
+
+    char* image_name = (char*) calloc(L_tmpnam + sizeof(".png"), sizeof(char));
+    FILE* file = image_name != NULL ? fopen(strcat(tmpnam(image_name), ".png"), "w") : NULL;
+
+    bool is_written = file != NULL && fwrite(image, sizeof(char), image_size, file) == image_size;
+    free(image);
+
+    if (file != NULL)
+        is_written = fclose(file) == 0 && is_written;
+
+    if (!is_written) {
+        free(image_name);
+        return NULL;
+    }
+
+    return image_name;
+}
+
+char* digraph_render_with_daemon(digraph* graph) {
+    char* image_name = render_with_daemon(graph);
+    return image_name != NULL ? image_name : digraph_render(graph);
+}
@@ -0,0 +1,48 @@
+#include "render-daemon.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/**
+ * Usage: render-daemon [socket] [renderer] [workers] [cache capacity in MiB]
+ *                      [max request size in MiB]
+ *
+ * Socket defaults to GRAPHVIZ_RENDER_SOCKET, daemon runs until
+ * it's interrupted or terminated.
+ */
+int main(int argc, char* argv[]) {
+    render_daemon_options options = RENDER_DAEMON_DEFAULT_OPTIONS;
+    options.socket_path = render_daemon_socket_path();
+
+    if (argc > 1) options.socket_path      = argv[1];
+    if (argc > 2) options.renderer         = argv[2];
+    if (argc > 3) options.worker_count     = strtoul(argv[3], NULL, 10);
+    if (argc > 4) options.cache_capacity   = strtoul(argv[4], NULL, 10) * 1024 * 1024;
+    if (argc > 5) options.max_request_size = strtoul(argv[5], NULL, 10) * 1024 * 1024;
+
+    // Workers inherit this mask, so only main thread waits for signals
+    sigset_t stop_signals;
+    sigemptyset(&stop_signals);
+    sigaddset(&stop_signals, SIGINT);
+    sigaddset(&stop_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_signals, NULL);
+
+    render_daemon daemon = {};
+    TRY render_daemon_start(&daemon, options)
+        THROW("Can't start render daemon!");
+
+    fprintf(stderr, "Rendering with \"%s\" on %s\n", options.renderer, options.socket_path);
+
+    int signal = 0;
+    sigwait(&stop_signals, &signal);
+
+    fprintf(stderr, "Stopping, cache hits: %zu, misses: %zu\n",
+            daemon.cache.hits, daemon.cache.misses);
+
+    render_daemon_stop(&daemon);
+    return EXIT_SUCCESS;
+}
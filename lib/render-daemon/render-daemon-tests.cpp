@@ -0,0 +1,208 @@
+#include "render-daemon.h"
+#include "graphviz-export.h"
+#include "render-io.h"
+#include "test-framework.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+TEST(render_cache_evicts_least_recent) {
+    render_cache cache = {};
+    TRY render_cache_create(&cache, 16)
+        ASSERT_SUCCESS();
+
+    const char* graphs[] = { "a", "b", "c" };
+    for (int i = 0; i < 3; ++ i)
+        TRY render_cache_insert(&cache, render_cache_key_create(graphs[i], 1), "image", 5)
+            ASSERT_SUCCESS();
+
+    // Each entry takes 6 bytes, so only two last fit
+    char* image = NULL;
+    size_t image_size = 0;
+
+    ASSERT_EQUAL(render_cache_lookup(&cache, render_cache_key_create("a", 1),
+                                     &image, &image_size), false);
+
+    ASSERT_EQUAL(render_cache_lookup(&cache, render_cache_key_create("b", 1),
+                                     &image, &image_size), true);
+
+    ASSERT_EQUAL(strncmp(image, "image", image_size), 0);
+    free(image);
+
+    // "b" was used recently, so "c" is evicted
+    TRY render_cache_insert(&cache, render_cache_key_create("d", 1), "image", 5)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(render_cache_lookup(&cache, render_cache_key_create("c", 1),
+                                     &image, &image_size), false);
+
+    ASSERT_EQUAL(render_cache_lookup(&cache, render_cache_key_create("b", 1),
+                                     &image, &image_size), true);
+    free(image);
+
+    render_cache_destroy(&cache);
+}
+
+TEST(render_with_daemon) {
+    render_daemon_options options = RENDER_DAEMON_DEFAULT_OPTIONS;
+
+    // Renderer just echoes graph, so image can be checked
+    options.socket_path = tmpnam(NULL);
+    options.renderer = "cat";
+    options.worker_count = 2;
+
+    render_daemon daemon = {};
+    TRY render_daemon_start(&daemon, options)
+        ASSERT_SUCCESS();
+
+    digraph graph = NEW_GRAPH({
+        NEW_SUBGRAPH(RANK_NONE, {
+            node_id from = NODE("from"), to = NODE("to");
+            EDGE(from, to);
+        });
+    });
+
+    render_client client = {};
+    TRY render_client_connect(&client, options.socket_path)
+        ASSERT_SUCCESS();
+
+    buffered_writer writer = {};
+    TRY buffered_writer_create_in_memory(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_write(&writer, &graph);
+
+    size_t dot_size = 0;
+    char* dot = buffered_writer_take(&writer, &dot_size);
+
+    for (int i = 0; i < 2; ++ i) {
+        char* image = NULL;
+        size_t image_size = 0;
+
+        TRY render_client_render_digraph(&client, &graph, &image, &image_size)
+            ASSERT_SUCCESS();
+
+        ASSERT_EQUAL(image_size, dot_size);
+        ASSERT_EQUAL(memcmp(image, dot, dot_size), 0);
+        free(image);
+    }
+
+    ASSERT_EQUAL(daemon.cache.hits, (size_t) 1);
+
+    // Columnar graph is converted to the same nodes and edges
+    TRY digraph_write_columnar(&writer, &graph)
+        ASSERT_SUCCESS();
+
+    size_t columnar_size = 0;
+    char* columnar = buffered_writer_take(&writer, &columnar_size);
+
+    char* image = NULL;
+    size_t image_size = 0;
+
+    TRY render_client_render(&client, RENDER_COLUMNAR, columnar, columnar_size,
+                             &image, &image_size)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(strstr(image, "label = \"from\"") != NULL, true);
+    ASSERT_EQUAL(strstr(image, "node_1 -> node_2") != NULL, true);
+
+    free(image);
+    free(columnar);
+    free(dot);
+
+    // Garbage isn't rendered, but connection stays usable
+    stack_trace* garbage = render_client_render(&client, RENDER_COLUMNAR, "garbage", 7,
+                                                &image, &image_size);
+    ASSERT_EQUAL(trace_is_success(garbage), false);
+    trace_destruct(garbage);
+
+    render_client_close(&client);
+
+    // Size, that doesn't fit in memory, is refused before allocation
+    TRY render_client_connect(&client, options.socket_path)
+        ASSERT_SUCCESS();
+
+    render_request_header huge = {
+        .magic = RENDER_MAGIC, .format = RENDER_DOT, .size = UINT64_MAX
+    };
+    TRY render_write_all(client.fd, &huge, sizeof(huge))
+        ASSERT_SUCCESS();
+
+    render_response_header refused = {};
+    TRY render_read_exact(client.fd, &refused, sizeof(refused))
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(refused.status, RENDER_FAILED);
+    render_client_close(&client);
+
+    TRY buffered_writer_destroy(&writer)
+        ASSERT_SUCCESS();
+
+    digraph_destroy(&graph);
+    render_daemon_stop(&daemon);
+}
+
+TEST(serve_requests_past_idle_clients) {
+    render_daemon_options options = RENDER_DAEMON_DEFAULT_OPTIONS;
+
+    options.socket_path = tmpnam(NULL);
+    options.renderer = "cat";
+    options.worker_count = 2;
+
+    render_daemon daemon = {};
+    TRY render_daemon_start(&daemon, options)
+        ASSERT_SUCCESS();
+
+    // Idle connections outnumber workers, they shouldn't hold any of them
+    const int idle_count = 4;
+    render_client idle[idle_count] = {};
+
+    for (int i = 0; i < idle_count; ++ i)
+        TRY render_client_connect(&idle[i], options.socket_path)
+            ASSERT_SUCCESS();
+
+    render_client client = {};
+    TRY render_client_connect(&client, options.socket_path)
+        ASSERT_SUCCESS();
+
+    // Without reply request fails after timeout, instead of hanging
+    timeval timeout = { .tv_sec = 5, .tv_usec = 0 };
+    ASSERT_EQUAL(setsockopt(client.fd, SOL_SOCKET, SO_RCVTIMEO,
+                            &timeout, sizeof(timeout)), 0);
+
+    for (int i = 0; i < 3; ++ i) {
+        char* image = NULL;
+        size_t image_size = 0;
+
+        TRY render_client_render(&client, RENDER_DOT, "digraph {}", 10, &image, &image_size)
+            ASSERT_SUCCESS();
+
+        ASSERT_EQUAL(image_size, (size_t) 10);
+        free(image);
+    }
+
+    // Idle clients are still served, when they send something
+    ASSERT_EQUAL(setsockopt(idle[0].fd, SOL_SOCKET, SO_RCVTIMEO,
+                            &timeout, sizeof(timeout)), 0);
+
+    char* image = NULL;
+    size_t image_size = 0;
+
+    TRY render_client_render(&idle[0], RENDER_DOT, "digraph {}", 10, &image, &image_size)
+        ASSERT_SUCCESS();
+
+    free(image);
+
+    render_client_close(&client);
+    for (int i = 0; i < idle_count; ++ i)
+        render_client_close(&idle[i]);
+
+    render_daemon_stop(&daemon);
+}
+
+int main(void) {
+    return test_framework_run_all_unit_tests();
+}
@@ -0,0 +1,526 @@
+#include "render-daemon.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "graphviz-export.h"
+#include "graphviz-writer.h"
+#include "render-io.h"
+#include "safe-alloc.h"
+#include "trace.h"
+
+extern char** environ;
+
+const char* render_daemon_socket_path() {
+    const char* path = getenv("GRAPHVIZ_RENDER_SOCKET");
+    return path != NULL ? path : RENDER_DAEMON_DEFAULT_SOCKET;
+}
+
+// ------------------------------ CONVERSION ---------------------------------
+
+static const char* attribute_name(hash_table<int, const char*>* names, int value) {
+    const char** name = hash_table_lookup(names, value);
+    return name != NULL ? *name : "";
+}
+
+/**
+ * Write columnar graph in dot's language, nodes of each subgraph are kept
+ * together. Columnar format doesn't keep ranks, and edges can refer to
+ * any node, so edges are written after subgraphs.
+ */
+static void columnar_write_dot(buffered_writer* writer, columnar_view* view) {
+    const size_t node_count = view->header->node_count,
+                 edge_count = view->header->edge_count;
+
+    buffered_writer_puts(writer, "digraph {" "\n");
+
+    for (size_t i = 0; i < node_count; ++ i) {
+        if (i == 0 || view->node_subgraphs[i] != view->node_subgraphs[i - 1])
+            buffered_writer_puts(writer, i == 0 ? "\t" "subgraph {" "\n"
+                                                : "\t" "}" "\n" "\t" "subgraph {" "\n");
+
+        buffered_writer_printf(writer, "\t\t" "node_%d [" "label = \"%s\","
+                               "shape = \"%s\", color = \"%s\", style = \"%s\"];" "\n",
+                               view->node_ids[i],
+                               columnar_view_string(view, view->node_labels[i]),
+                               attribute_name(&graphviz_node_shapes, view->node_shapes[i]),
+                               attribute_name(&graphviz_colors,      view->node_colors[i]),
+                               attribute_name(&graphviz_styles,      view->node_styles[i]));
+    }
+
+    if (node_count > 0)
+        buffered_writer_puts(writer, "\t" "}" "\n");
+
+    for (size_t i = 0; i < edge_count; ++ i) {
+        buffered_writer_printf(writer, "\t" "node_%d -> node_%d [label = \" %s \","
+                               "color = %s, style = %s, margin = \"1.5\"",
+                               view->edge_froms[i], view->edge_tos[i],
+                               columnar_view_string(view, view->edge_labels[i]),
+                               attribute_name(&graphviz_colors, view->edge_colors[i]),
+                               attribute_name(&graphviz_styles, view->edge_styles[i]));
+
+        if (view->edge_weights[i] != 0)
+            buffered_writer_printf(writer, ", weight = %d", edge_dot_weight(view->edge_weights[i]));
+
+        buffered_writer_puts(writer, "];" "\n");
+    }
+
+    buffered_writer_puts(writer, "}" "\n");
+}
+
+// ------------------------------- RENDERING ---------------------------------
+
+/**
+ * Run renderer with @arg dot on it's stdin and collect it's stdout. Input
+ * and output are interleaved with poll, so big graphs can't fill both
+ * pipes and deadlock.
+ */
+static stack_trace* run_renderer(const char* renderer, const char* dot, size_t dot_size,
+                                 buffered_writer* image) {
+    int input[2] = { -1, -1 }, output[2] = { -1, -1 };
+
+    if (pipe(input) == -1 || pipe(output) == -1) {
+        close(input[0]); close(input[1]);
+        return FAILURE(RUNTIME_ERROR, "Can't create pipes: %s", strerror(errno));
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+
+    posix_spawn_file_actions_adddup2(&actions, input[0],  STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, input[1]);
+    posix_spawn_file_actions_addclose(&actions, output[0]);
+
+    const char* arguments[] = { "sh", "-c", renderer, NULL };
+
+    pid_t renderer_pid = -1;
+    int spawned = posix_spawn(&renderer_pid, "/bin/sh", &actions, NULL,
+                              (char* const*) arguments, environ);
+
+    posix_spawn_file_actions_destroy(&actions);
+    close(input[0]); close(output[1]);
+
+    if (spawned != 0) {
+        close(input[1]); close(output[0]);
+        return FAILURE(RUNTIME_ERROR, "Can't start \"%s\": %s", renderer, strerror(spawned));
+    }
+
+    size_t written = 0;
+    if (dot_size == 0)
+        close(input[1]), input[1] = -1;
+
+    bool is_reading = true;
+    while (is_reading) {
+        pollfd fds[2] = {
+            { .fd = output[0], .events = POLLIN,  .revents = 0 },
+            { .fd = input[1],  .events = POLLOUT, .revents = 0 }
+        };
+
+        if (poll(fds, input[1] != -1 ? 2 : 1, -1) == -1) {
+            if (errno == EINTR)
+                continue;
+
+            break;
+        }
+
+        if (input[1] != -1 && fds[1].revents != 0) {
+            ssize_t count = write(input[1], dot + written, dot_size - written);
+
+            if (count > 0)
+                written += (size_t) count;
+
+            // Renderer may exit without reading everything
+            if (count == -1 || written == dot_size)
+                close(input[1]), input[1] = -1;
+        }
+
+        if (fds[0].revents != 0) {
+            char buffer[64 * 1024];
+            ssize_t count = read(output[0], buffer, sizeof(buffer));
+
+            if (count > 0)
+                buffered_writer_write(image, buffer, (size_t) count);
+            else if (count == 0 || errno != EINTR)
+                is_reading = false;
+        }
+    }
+
+    if (input[1] != -1)
+        close(input[1]);
+
+    close(output[0]);
+
+    int status = 0;
+    while (waitpid(renderer_pid, &status, 0) == -1 && errno == EINTR);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return FAILURE(RUNTIME_ERROR, "Renderer \"%s\" failed!", renderer);
+
+    return SUCCESS();
+}
+
+// Convert graph from request to dot's language and run renderer on it
+static stack_trace* render_uncached(render_daemon* daemon, render_format format,
+                                    const char* graph, size_t size,
+                                    buffered_writer* image) {
+    if (format == RENDER_DOT)
+        return run_renderer(daemon->options.renderer, graph, size, image);
+
+    if (format != RENDER_COLUMNAR)
+        return FAILURE(RUNTIME_ERROR, "Unknown graph format %u!", (unsigned) format);
+
+    columnar_view view = {};
+    TRY columnar_view_open(&view, graph, size)
+        FAIL("Request has invalid columnar graph!");
+
+    buffered_writer dot = {};
+    TRY buffered_writer_create_in_memory(&dot)
+        FAIL("Can't create dot buffer!");
+
+    columnar_write_dot(&dot, &view);
+
+    stack_trace* rendered = dot.failed
+        ? FAILURE(RUNTIME_ERROR, "Graph doesn't fit in memory!")
+        : run_renderer(daemon->options.renderer, dot.buffer, dot.size, image);
+
+    trace_destruct(buffered_writer_destroy(&dot));
+
+    TRY rendered FAIL("Failed to render columnar graph!");
+    return SUCCESS();
+}
+
+/**
+ * Render graph from request, cached image is used if there's one
+ *
+ * @arg image is set to a new buffer, that should be freed by caller
+ */
+static stack_trace* render(render_daemon* daemon, render_format format,
+                           const char* graph, size_t size,
+                           char** image, size_t* image_size) {
+
+    // Key includes format, since the same bytes mean different graphs
+    char* keyed = NULL;
+    TRY safe_calloc(size + sizeof(format), &keyed)
+        FAIL("Can't allocate cache key!");
+
+    memcpy(keyed, &format, sizeof(format));
+    memcpy(keyed + sizeof(format), graph, size);
+
+    render_cache_key key = render_cache_key_create(keyed, size + sizeof(format));
+
+    pthread_mutex_lock(&daemon->cache_lock);
+    bool is_cached = render_cache_lookup(&daemon->cache, key, image, image_size);
+    pthread_mutex_unlock(&daemon->cache_lock);
+
+    if (is_cached) {
+        free(keyed);
+        return SUCCESS();
+    }
+
+    buffered_writer output = {};
+    TRY buffered_writer_create_in_memory(&output) CATCH({
+        free(keyed);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't create image buffer!");
+    });
+
+    stack_trace* rendered = render_uncached(daemon, format, graph, size, &output);
+    if (trace_is_success(rendered) && output.failed)
+        rendered = FAILURE(RUNTIME_ERROR, "Image doesn't fit in memory!");
+
+    if (trace_is_success(rendered)) {
+        *image = buffered_writer_take(&output, image_size);
+
+        pthread_mutex_lock(&daemon->cache_lock);
+        stack_trace* cached = render_cache_insert(&daemon->cache, key, *image, *image_size);
+        pthread_mutex_unlock(&daemon->cache_lock);
+
+        trace_destruct(cached); // Image is rendered, cache is optional
+    }
+
+    free(keyed);
+    trace_destruct(buffered_writer_destroy(&output));
+
+    TRY rendered FAIL("Failed to render graph!");
+    return SUCCESS();
+}
+
+// -------------------------------- SERVING ----------------------------------
+
+// How often idle workers check if daemon is stopping, and see connections,
+// that other workers made idle
+const int RENDER_DAEMON_POLL_MILLISECONDS = 100;
+
+static stack_trace* serve_request(render_daemon* daemon, int client) {
+    render_request_header request = {};
+    TRY render_read_exact(client, &request, sizeof(request))
+        FAIL("Can't read request!");
+
+    if (request.magic != RENDER_MAGIC)
+        return FAILURE(RUNTIME_ERROR, "Request has wrong magic %x!", request.magic);
+
+    // Graph can't be skipped, so client is told and connection is dropped
+    if (request.size > daemon->options.max_request_size) {
+        render_response_header refused = {
+            .magic = RENDER_MAGIC, .status = RENDER_FAILED, .size = 0
+        };
+
+        trace_destruct(render_write_all(client, &refused, sizeof(refused)));
+
+        return FAILURE(RUNTIME_ERROR, "Graph of %llu bytes is bigger than %zu!",
+                       (unsigned long long) request.size, daemon->options.max_request_size);
+    }
+
+    char* graph = NULL;
+    TRY safe_calloc(request.size + 1, &graph)
+        FAIL("Can't allocate graph of %zu bytes!", (size_t) request.size);
+
+    TRY render_read_exact(client, graph, request.size) CATCH({
+        free(graph);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't read graph!");
+    });
+
+    char* image = NULL;
+    size_t image_size = 0;
+
+    stack_trace* rendered = render(daemon, request.format, graph, request.size,
+                                   &image, &image_size);
+    free(graph);
+
+    render_response_header response = {
+        .magic = RENDER_MAGIC, .status = RENDER_OK, .size = image_size
+    };
+
+    if (!trace_is_success(rendered)) {
+        response = { .magic = RENDER_MAGIC, .status = RENDER_FAILED, .size = 0 };
+        trace_print_stack_trace(stderr, rendered);
+        trace_destruct(rendered);
+    }
+
+    stack_trace* sent = render_write_all(client, &response, sizeof(response));
+    if (trace_is_success(sent))
+        sent = render_write_all(client, image, response.size);
+
+    free(image);
+
+    TRY sent FAIL("Can't send response!");
+    return SUCCESS();
+}
+
+// Put connection among idle ones, so any worker can serve it's next request
+static void release_client(render_daemon* daemon, int client) {
+    pthread_mutex_lock(&daemon->idle_clients_lock);
+
+    if (daemon->idle_client_count == daemon->idle_client_capacity) {
+        const size_t new_capacity = daemon->idle_client_capacity != 0 ?
+                                    daemon->idle_client_capacity * 2 : 16;
+
+        int* new_clients = (int*) realloc(daemon->idle_clients, new_capacity * sizeof(int));
+        if (new_clients == NULL) {
+            pthread_mutex_unlock(&daemon->idle_clients_lock);
+            close(client); // Client will reconnect, daemon shouldn't stop
+            return;
+        }
+
+        daemon->idle_clients = new_clients, daemon->idle_client_capacity = new_capacity;
+    }
+
+    daemon->idle_clients[daemon->idle_client_count ++] = client;
+    pthread_mutex_unlock(&daemon->idle_clients_lock);
+}
+
+// Take connection from idle ones, @return false if other worker took it first
+static bool claim_client(render_daemon* daemon, int client) {
+    pthread_mutex_lock(&daemon->idle_clients_lock);
+
+    bool is_claimed = false;
+    for (size_t i = 0; i < daemon->idle_client_count && !is_claimed; ++ i)
+        if (daemon->idle_clients[i] == client) {
+            daemon->idle_clients[i] = daemon->idle_clients[-- daemon->idle_client_count];
+            is_claimed = true;
+        }
+
+    pthread_mutex_unlock(&daemon->idle_clients_lock);
+    return is_claimed;
+}
+
+/**
+ * Fill @arg polled with listening socket, followed by idle connections
+ *
+ * @return number of descriptors to poll, that fit in @arg polled, if
+ * there's no memory for all of them
+ */
+static size_t prepare_poll(render_daemon* daemon, pollfd** polled, size_t* capacity) {
+    pthread_mutex_lock(&daemon->idle_clients_lock);
+
+    size_t count = daemon->idle_client_count + 1;
+    if (count > *capacity) {
+        pollfd* new_polled = (pollfd*) realloc(*polled, count * sizeof(pollfd));
+
+        if (new_polled != NULL)
+            *polled = new_polled, *capacity = count;
+    }
+
+    if (count > *capacity)
+        count = *capacity;
+
+    for (size_t i = 1; i < count; ++ i)
+        (*polled)[i] = { .fd = daemon->idle_clients[i - 1], .events = POLLIN, .revents = 0 };
+
+    pthread_mutex_unlock(&daemon->idle_clients_lock);
+
+    if (count > 0)
+        (*polled)[0] = { .fd = daemon->listen_fd, .events = POLLIN, .revents = 0 };
+
+    return count;
+}
+
+// Serve one request of claimed @arg client, connection is kept until client closes it
+static void serve_client(render_daemon* daemon, int client) {
+    // Descriptor may have been closed and reused by a new connection, since
+    // it was polled, so request may be not there yet, and read would block
+    pollfd readable = { .fd = client, .events = POLLIN, .revents = 0 };
+    if (poll(&readable, 1, 0) == 0) {
+        release_client(daemon, client);
+        return;
+    }
+
+    stack_trace* served = serve_request(daemon, client);
+
+    if (!trace_is_success(served)) {
+        trace_destruct(served); // Client disconnected or broke protocol
+        close(client);
+        return;
+    }
+
+    release_client(daemon, client);
+}
+
+static void* run_worker(void* daemon_pointer) {
+    render_daemon* daemon = (render_daemon*) daemon_pointer;
+
+    // Renderer or client may go away, this shouldn't kill the daemon
+    sigset_t pipe_signal;
+    sigemptyset(&pipe_signal);
+    sigaddset(&pipe_signal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+
+    pollfd* polled = NULL;
+    size_t capacity = 0;
+
+    // Connections are scanned from different places, so they are served fairly
+    for (size_t round = 0; !__atomic_load_n(&daemon->is_stopping, __ATOMIC_ACQUIRE); ++ round) {
+        const size_t count = prepare_poll(daemon, &polled, &capacity);
+
+        // Without memory for descriptors worker just waits, while others serve
+        if (poll(polled, count, RENDER_DAEMON_POLL_MILLISECONDS) <= 0 || count == 0)
+            continue;
+
+        if (polled[0].revents & POLLIN) {
+            int client = accept(daemon->listen_fd, NULL, NULL);
+
+            // Other worker may have taken this connection
+            if (client != -1)
+                release_client(daemon, client);
+        }
+
+        // One request per round, connections, that other workers release
+        // meanwhile, get into the next one
+        for (size_t i = 0; i + 1 < count; ++ i) {
+            const int client = polled[1 + (round + i) % (count - 1)].fd;
+            const short events = polled[1 + (round + i) % (count - 1)].revents;
+
+            if (events != 0 && claim_client(daemon, client)) {
+                serve_client(daemon, client);
+                break;
+            }
+        }
+    }
+
+    free(polled);
+    return NULL;
+}
+
+stack_trace* render_daemon_start(render_daemon* daemon, render_daemon_options options) {
+    *daemon = { .options = options, .listen_fd = -1 };
+
+    sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(options.socket_path) >= sizeof(address.sun_path))
+        return FAILURE(RUNTIME_ERROR, "Socket path \"%s\" is too long!", options.socket_path);
+
+    strcpy(address.sun_path, options.socket_path);
+
+    TRY render_cache_create(&daemon->cache, options.cache_capacity)
+        FAIL("Can't create render cache!");
+
+    pthread_mutex_init(&daemon->cache_lock, NULL);
+    pthread_mutex_init(&daemon->idle_clients_lock, NULL);
+
+    // Non blocking, so workers don't hang in accept, when other one took client
+    daemon->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (daemon->listen_fd == -1) {
+        stack_trace* failure = FAILURE(RUNTIME_ERROR, "Can't create socket: %s", strerror(errno));
+        render_daemon_stop(daemon);
+        return failure;
+    }
+
+    unlink(options.socket_path); // Socket of the previous daemon
+
+    if (bind(daemon->listen_fd, (sockaddr*) &address, sizeof(address)) == -1 ||
+        listen(daemon->listen_fd, SOMAXCONN) == -1) {
+        stack_trace* failure = FAILURE(RUNTIME_ERROR, "Can't listen on \"%s\": %s",
+                                       options.socket_path, strerror(errno));
+        render_daemon_stop(daemon);
+        return failure;
+    }
+
+    TRY safe_calloc(options.worker_count, &daemon->workers) CATCH({
+        render_daemon_stop(daemon);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Can't allocate workers!");
+    });
+
+    for (; daemon->started_workers < options.worker_count; ++ daemon->started_workers)
+        if (pthread_create(&daemon->workers[daemon->started_workers], NULL,
+                           run_worker, daemon) != 0)
+            break;
+
+    if (daemon->started_workers == 0) {
+        render_daemon_stop(daemon);
+        return FAILURE(RUNTIME_ERROR, "Can't start any worker!");
+    }
+
+    return SUCCESS();
+}
+
+void render_daemon_stop(render_daemon* daemon) {
+    __atomic_store_n(&daemon->is_stopping, true, __ATOMIC_RELEASE);
+
+    for (size_t i = 0; i < daemon->started_workers; ++ i)
+        pthread_join(daemon->workers[i], NULL);
+
+    free(daemon->workers);
+
+    for (size_t i = 0; i < daemon->idle_client_count; ++ i)
+        close(daemon->idle_clients[i]);
+
+    free(daemon->idle_clients);
+    pthread_mutex_destroy(&daemon->idle_clients_lock);
+
+    if (daemon->listen_fd != -1) {
+        close(daemon->listen_fd);
+        unlink(daemon->options.socket_path);
+    }
+
+    render_cache_destroy(&daemon->cache);
+    pthread_mutex_destroy(&daemon->cache_lock);
+
+    *daemon = { .listen_fd = -1 };
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "graphviz.h"
+#include "render-cache.h"
+#include "trace.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ------------------------------- PROTOCOL ----------------------------------
+
+// First bytes of every request and response, "GVRD" in little endian
+const uint32_t RENDER_MAGIC = 0x44525647;
+
+/** How graph in request is encoded */
+enum render_format : uint32_t {
+    RENDER_DOT,     // Text in dot's language
+    RENDER_COLUMNAR // Columnar binary format, see graphviz-export.h
+};
+
+enum render_status : uint32_t {
+    RENDER_OK, RENDER_FAILED
+};
+
+/**
+ * Client sends header with the graph after it, and gets response
+ * header with the image after it, on the same connection. Connection
+ * can be used for many requests.
+ */
+struct render_request_header {
+    uint32_t magic;
+    render_format format;
+    uint64_t size;
+};
+
+struct render_response_header {
+    uint32_t magic;
+    render_status status;
+    uint64_t size;
+};
+
+// Socket daemon listens on, if it's not set in GRAPHVIZ_RENDER_SOCKET
+const char RENDER_DAEMON_DEFAULT_SOCKET[] = "/tmp/graphviz-render.sock";
+
+const char* render_daemon_socket_path();
+
+// -------------------------------- DAEMON -----------------------------------
+
+struct render_daemon_options {
+    const char* socket_path;
+
+    // Shell command, that reads dot from stdin and writes image to stdout
+    const char* renderer;
+
+    size_t worker_count;     // Requests served concurrently
+    size_t cache_capacity;   // Bytes of graphs and images kept in cache
+    size_t max_request_size; // Bigger graphs are refused and connection is closed
+};
+
+const render_daemon_options RENDER_DAEMON_DEFAULT_OPTIONS = {
+    .socket_path = RENDER_DAEMON_DEFAULT_SOCKET, .renderer = "dot -Tpng",
+    .worker_count = 4, .cache_capacity = 64 * 1024 * 1024,
+    .max_request_size = 256 * 1024 * 1024
+};
+
+/**
+ * Local render server. Workers are started once and wait for requests
+ * on the listening socket and on every idle connection, so connection
+ * takes a worker only while it's request is served, and idle clients
+ * don't keep others waiting. Renders of the same graph are shared by all
+ * clients through the cache, so repeated renders don't run renderer.
+ */
+struct render_daemon {
+    render_daemon_options options;
+    int listen_fd;
+
+    pthread_t* workers;
+    size_t started_workers;
+
+    // Connections waiting for their next request, any worker can take them
+    int* idle_clients;
+    size_t idle_client_count, idle_client_capacity;
+    pthread_mutex_t idle_clients_lock;
+
+    render_cache cache;
+    pthread_mutex_t cache_lock;
+
+    bool is_stopping;
+};
+
+/**
+ * Listen on options' socket and start workers, returns immediately
+ */
+stack_trace* render_daemon_start(render_daemon* daemon, render_daemon_options options =
+                                     RENDER_DAEMON_DEFAULT_OPTIONS);
+
+/**
+ * Stop accepting connections, wait for workers, remove socket and free cache
+ */
+void render_daemon_stop(render_daemon* daemon);
+
+// -------------------------------- CLIENT -----------------------------------
+
+struct render_client {
+    int fd;
+};
+
+stack_trace* render_client_connect(render_client* client, const char* socket_path =
+                                       render_daemon_socket_path());
+
+/**
+ * Send graph to daemon and wait for the image
+ *
+ * @arg image is set to a new buffer, that should be freed by caller
+ */
+stack_trace* render_client_render(render_client* client, render_format format,
+                                  const void* graph, size_t size,
+                                  char** image, size_t* image_size);
+
+stack_trace* render_client_render_digraph(render_client* client, digraph* graph,
+                                          char** image, size_t* image_size);
+
+void render_client_close(render_client* client);
+
+/**
+ * Same as digraph_render, but rendered by daemon, if it's available.
+ * Falls back to digraph_render otherwise.
+ *
+ * @return name of the image file, that should be freed by caller
+ */
+char* digraph_render_with_daemon(digraph* graph);
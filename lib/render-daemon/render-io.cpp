@@ -0,0 +1,49 @@
+#include "render-io.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+stack_trace* render_read_exact(int fd, void* data, size_t size) {
+    char* bytes = (char*) data;
+
+    while (size > 0) {
+        ssize_t count = read(fd, bytes, size);
+
+        if (count == 0)
+            return FAILURE(RUNTIME_ERROR, "Connection closed with %zu bytes left!", size);
+
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+
+            return FAILURE(RUNTIME_ERROR, "Can't read: %s", strerror(errno));
+        }
+
+        bytes += count, size -= (size_t) count;
+    }
+
+    return SUCCESS();
+}
+
+stack_trace* render_write_all(int fd, const void* data, size_t size) {
+    const char* bytes = (const char*) data;
+
+    while (size > 0) {
+        ssize_t count = send(fd, bytes, size, MSG_NOSIGNAL);
+
+        if (count == -1) {
+            if (errno == EINTR)
+                continue;
+
+            return FAILURE(RUNTIME_ERROR, "Can't write: %s", strerror(errno));
+        }
+
+        bytes += count, size -= (size_t) count;
+    }
+
+    return SUCCESS();
+}
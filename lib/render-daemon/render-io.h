@@ -0,0 +1,16 @@
+#pragma once
+
+#include "trace.h"
+
+#include <stddef.h>
+
+/**
+ * Read exactly @arg size bytes from socket, fails if it's closed before
+ */
+stack_trace* render_read_exact(int fd, void* data, size_t size);
+
+/**
+ * Write all @arg size bytes to socket, closed socket fails
+ * without raising SIGPIPE
+ */
+stack_trace* render_write_all(int fd, const void* data, size_t size);
@@ -133,13 +133,35 @@ stack_trace* read_file(const char* const file_name, wchar_t** const file_content
     return SUCCESS();
 }
 
-stack_trace* get_text(const char* const file_name, text* txt) {
-    wchar_t* buffer = NULL;
-    stack_trace* read_trace = read_file(file_name, &buffer);
+stack_trace* decode_text(const char* const bytes, size_t size, wchar_t** const content) {
+    // Every byte decodes to at most one wide character
+    wchar_t* buffer = (wchar_t*)
+        calloc(sizeof *buffer, size + 1 /* for '\0's */);
 
     if (buffer == NULL)
-        return PASS_FAILURE(read_trace, RUNTIME_ERROR, "Reading file failed!");
+        return FAILURE(RUNTIME_ERROR, strerror(errno));
+
+    mbstate_t state = {};
+
+    wchar_t* eof = buffer;
+    for (size_t offset = 0; offset < size; ++ eof) {
+        size_t length = mbrtowc(eof, bytes + offset, size - offset, &state);
+
+        // Broken or truncated sequence ends text, like it does for fgetws
+        if (length == (size_t) -1 || length == (size_t) -2)
+            break;
+
+        // Null character is stored, but it takes one byte
+        offset += length == 0 ? 1 : length;
+    }
+
+    *eof = L'\0';
+
+    *content = buffer;
+    return SUCCESS();
+}
 
+static stack_trace* split_text(wchar_t* buffer, text* txt) {
     size_t number_of_lines = 0;
  
     line* lines = NULL;
@@ -155,6 +177,26 @@ stack_trace* get_text(const char* const file_name, text* txt) {
     return SUCCESS();
 }
 
+stack_trace* get_text(const char* const file_name, text* txt) {
+    wchar_t* buffer = NULL;
+    stack_trace* read_trace = read_file(file_name, &buffer);
+
+    if (buffer == NULL)
+        return PASS_FAILURE(read_trace, RUNTIME_ERROR, "Reading file failed!");
+
+    return split_text(buffer, txt);
+}
+
+stack_trace* get_text_from_bytes(const char* const bytes, size_t size, text* txt) {
+    wchar_t* buffer = NULL;
+    stack_trace* decode_trace = decode_text(bytes, size, &buffer);
+
+    if (buffer == NULL)
+        return PASS_FAILURE(decode_trace, RUNTIME_ERROR, "Decoding file failed!");
+
+    return split_text(buffer, txt);
+}
+
 void text_destruct(text* txt) {
     free(txt->buffer), txt->buffer = NULL;
     free(txt->lines ), txt->lines  = NULL;
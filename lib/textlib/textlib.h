@@ -30,4 +30,10 @@ stack_trace* split_in_lines_with_terminator(wchar_t* const buffer,
 
 stack_trace* get_text(const char* const file_name, text* txt);
 
+// Decode bytes of a file, that were read some other way, in current locale
+stack_trace* decode_text(const char* const bytes, size_t size, wchar_t** const content);
+
+// Same as get_text, but file is already read in @arg bytes
+stack_trace* get_text_from_bytes(const char* const bytes, size_t size, text* txt);
+
 void text_destruct(text* txt);
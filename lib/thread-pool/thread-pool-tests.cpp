@@ -0,0 +1,142 @@
+#include "thread-pool.h"
+#include "test-framework.h"
+
+#include <stdio.h>
+
+struct fibonacci_task {
+    thread_pool* pool;
+
+    int number;
+    long result;
+};
+
+// Recursion spawns tasks from inside of tasks, so workers steal from each other
+static stack_trace* compute_fibonacci(void* argument) {
+    fibonacci_task* task = (fibonacci_task*) argument;
+
+    if (task->number < 2) {
+        task->result = task->number;
+        return SUCCESS();
+    }
+
+    fibonacci_task first  = { .pool = task->pool, .number = task->number - 1, .result = 0 };
+    fibonacci_task second = { .pool = task->pool, .number = task->number - 2, .result = 0 };
+
+    thread_pool_future future = {};
+    TRY thread_pool_spawn(task->pool, compute_fibonacci, &first, &future)
+        FAIL("Failed to spawn task!");
+
+    TRY compute_fibonacci(&second)
+        FAIL("Fibonacci of %d failed!", second.number);
+
+    TRY thread_pool_wait(task->pool, &future)
+        FAIL("Fibonacci of %d failed!", first.number);
+
+    task->result = first.result + second.result;
+    return SUCCESS();
+}
+
+TEST(spawn_nested_tasks) {
+    thread_pool pool = {};
+    TRY thread_pool_create(&pool, 4)
+        ASSERT_SUCCESS();
+
+    fibonacci_task task = { .pool = &pool, .number = 20, .result = 0 };
+
+    thread_pool_future future = {};
+    TRY thread_pool_spawn(&pool, compute_fibonacci, &task, &future)
+        ASSERT_SUCCESS();
+
+    TRY thread_pool_wait(&pool, &future)
+        ASSERT_SUCCESS();
+
+    ASSERT_EQUAL(task.result, 6765l);
+
+    thread_pool_destroy(&pool);
+}
+
+static stack_trace* fail_on_odd(void* argument) {
+    int number = *(int*) argument;
+
+    if (number % 2 != 0)
+        return FAILURE(RUNTIME_ERROR, "Number %d is odd!", number);
+
+    return SUCCESS();
+}
+
+TEST(pass_failure_of_task_to_waiter) {
+    thread_pool pool = {};
+    TRY thread_pool_create(&pool, 3)
+        ASSERT_SUCCESS();
+
+    const int task_count = 16;
+
+    int numbers[task_count] = {};
+    thread_pool_future futures[task_count] = {};
+
+    for (int i = 0; i < task_count; ++ i) {
+        numbers[i] = i;
+
+        TRY thread_pool_spawn(&pool, fail_on_odd, &numbers[i], &futures[i])
+            ASSERT_SUCCESS();
+    }
+
+    stack_trace* even = thread_pool_wait(&pool, &futures[0]);
+    ASSERT_EQUAL(trace_is_success(even), true);
+
+    stack_trace* odd = thread_pool_wait(&pool, &futures[1]);
+    ASSERT_EQUAL(trace_is_success(odd), false);
+    trace_destruct(odd);
+
+    // Remaining tasks are still waited, even though some of them fail
+    stack_trace* rest = thread_pool_wait_all(&pool, futures + 2, task_count - 2);
+    ASSERT_EQUAL(trace_is_success(rest), false);
+    trace_destruct(rest);
+
+    for (int i = 0; i < task_count; ++ i)
+        ASSERT_EQUAL(futures[i].is_done, true);
+
+    thread_pool_destroy(&pool);
+}
+
+static void mark_range(size_t begin, size_t end, void* argument) {
+    int* marks = (int*) argument;
+
+    for (size_t i = begin; i < end; ++ i)
+        ++ marks[i];
+}
+
+TEST(parallel_for_covers_range_once) {
+    thread_pool pool = {};
+    TRY thread_pool_create(&pool, 5)
+        ASSERT_SUCCESS();
+
+    const size_t counts[] = { 0, 1, 3, 5, 1000 };
+
+    for (size_t count : counts) {
+        int marks[1000] = {};
+
+        TRY thread_pool_parallel_for(&pool, count, mark_range, marks)
+            ASSERT_SUCCESS();
+
+        for (size_t i = 0; i < 1000; ++ i)
+            ASSERT_EQUAL(marks[i], i < count ? 1 : 0);
+    }
+
+    thread_pool_destroy(&pool);
+
+    // Pool of single thread runs everything in place
+    TRY thread_pool_create(&pool, 1)
+        ASSERT_SUCCESS();
+
+    int marks[10] = {};
+    TRY thread_pool_parallel_for(&pool, 10, mark_range, marks)
+        ASSERT_SUCCESS();
+
+    for (size_t i = 0; i < 10; ++ i)
+        ASSERT_EQUAL(marks[i], 1);
+
+    thread_pool_destroy(&pool);
+}
+
+TEST_MAIN()
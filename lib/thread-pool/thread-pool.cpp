@@ -0,0 +1,423 @@
+#include "thread-pool.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "safe-alloc.h"
+#include "trace.h"
+
+// First capacity of deque, deques grow when they get full
+const size_t THREAD_POOL_DEQUE_CAPACITY = 64;
+
+// How long waiting thread sleeps, when there's nothing to steal
+const long THREAD_POOL_WAIT_NANOSECONDS = 1000 * 1000;
+
+// Index of current thread's deque in each pool, external threads have none
+static thread_local thread_pool* current_pool = NULL;
+static thread_local size_t current_worker = 0;
+
+// --------------------------------- DEQUE -----------------------------------
+
+static stack_trace* deque_create(thread_pool_deque* deque) {
+    *deque = { .tasks = NULL, .top = 0, .bottom = 0, .capacity = THREAD_POOL_DEQUE_CAPACITY };
+
+    TRY safe_calloc(deque->capacity, &deque->tasks)
+        FAIL("Failed to allocate deque of %zu tasks!", deque->capacity);
+
+    pthread_mutex_init(&deque->lock, NULL);
+    return SUCCESS();
+}
+
+static void deque_destroy(thread_pool_deque* deque) {
+    pthread_mutex_destroy(&deque->lock);
+    free(deque->tasks), deque->tasks = NULL;
+}
+
+static stack_trace* deque_push_bottom(thread_pool_deque* deque, thread_pool_task task) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom - deque->top == deque->capacity) {
+        thread_pool_task* tasks = NULL;
+
+        TRY safe_calloc(deque->capacity * 2, &tasks) CATCH({
+            pthread_mutex_unlock(&deque->lock);
+            return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to grow deque!");
+        });
+
+        for (size_t i = deque->top; i < deque->bottom; ++ i)
+            tasks[i % (deque->capacity * 2)] = deque->tasks[i % deque->capacity];
+
+        free(deque->tasks);
+        deque->tasks = tasks, deque->capacity *= 2;
+    }
+
+    deque->tasks[deque->bottom ++ % deque->capacity] = task;
+
+    pthread_mutex_unlock(&deque->lock);
+    return SUCCESS();
+}
+
+static bool deque_pop_bottom(thread_pool_deque* deque, thread_pool_task* task) {
+    pthread_mutex_lock(&deque->lock);
+
+    bool is_popped = deque->bottom != deque->top;
+    if (is_popped)
+        *task = deque->tasks[-- deque->bottom % deque->capacity];
+
+    pthread_mutex_unlock(&deque->lock);
+    return is_popped;
+}
+
+static bool deque_steal_top(thread_pool_deque* deque, thread_pool_task* task) {
+    // Busy deque isn't worth waiting for, there are others to steal from
+    if (pthread_mutex_trylock(&deque->lock) != 0)
+        return false;
+
+    bool is_stolen = deque->bottom != deque->top;
+    if (is_stolen)
+        *task = deque->tasks[deque->top ++ % deque->capacity];
+
+    pthread_mutex_unlock(&deque->lock);
+    return is_stolen;
+}
+
+// -------------------------------- TASKS ------------------------------------
+
+// External threads push to the shared deque after workers' ones
+static size_t own_deque(thread_pool* pool) {
+    return current_pool == pool ? current_worker : pool->worker_count;
+}
+
+static bool find_task(thread_pool* pool, thread_pool_task* task) {
+    if (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0)
+        return false;
+
+    const size_t own = own_deque(pool), deque_count = pool->worker_count + 1;
+
+    if (deque_pop_bottom(&pool->deques[own], task))
+        return true;
+
+    // Victims are tried starting from the next one, so thieves spread out
+    for (size_t i = 1; i < deque_count; ++ i)
+        if (deque_steal_top(&pool->deques[(own + i) % deque_count], task))
+            return true;
+
+    return false;
+}
+
+static void run_task(thread_pool* pool, thread_pool_task task) {
+    __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+
+    stack_trace* result = task.function(task.argument);
+
+    task.future->result = result;
+    __atomic_store_n(&task.future->is_done, true, __ATOMIC_RELEASE);
+
+    // Waiters sleep only when they have nothing to run, wake them up
+    pthread_mutex_lock(&pool->sleep_lock);
+    if (pool->waiting > 0)
+        pthread_cond_broadcast(&pool->has_completed);
+
+    pthread_mutex_unlock(&pool->sleep_lock);
+}
+
+static void* run_worker(void* pool_pointer) {
+    thread_pool* pool = (thread_pool*) pool_pointer;
+
+    current_pool = pool;
+
+    thread_pool_task task = {};
+    while (true) {
+        if (find_task(pool, &task)) {
+            run_task(pool, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->sleep_lock);
+
+        // Tasks are counted before spawn takes the lock, so wakeup isn't lost
+        while (__atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0 && !pool->is_stopping) {
+            ++ pool->sleeping;
+            pthread_cond_wait(&pool->has_work, &pool->sleep_lock);
+            -- pool->sleeping;
+        }
+
+        bool is_finished = pool->is_stopping &&
+                           __atomic_load_n(&pool->pending, __ATOMIC_ACQUIRE) == 0;
+
+        pthread_mutex_unlock(&pool->sleep_lock);
+
+        if (is_finished)
+            break;
+    }
+
+    return NULL;
+}
+
+struct worker_start {
+    thread_pool* pool;
+    size_t index;
+};
+
+static void* start_worker(void* start_pointer) {
+    worker_start start = *(worker_start*) start_pointer;
+    free(start_pointer);
+
+    current_worker = start.index;
+    return run_worker(start.pool);
+}
+
+stack_trace* thread_pool_spawn(thread_pool* pool, stack_trace* (*function)(void* argument),
+                               void* argument, thread_pool_future* future) {
+
+    *future = { .result = NULL, .is_done = false };
+
+    // Pool without workers runs everything in place
+    if (pool->worker_count == 0) {
+        future->result = function(argument), future->is_done = true;
+        return SUCCESS();
+    }
+
+    thread_pool_task task = { .function = function, .argument = argument, .future = future };
+
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+
+    TRY deque_push_bottom(&pool->deques[own_deque(pool)], task) CATCH({
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to spawn task!");
+    });
+
+    pthread_mutex_lock(&pool->sleep_lock);
+    if (pool->sleeping > 0)
+        pthread_cond_signal(&pool->has_work);
+
+    pthread_mutex_unlock(&pool->sleep_lock);
+
+    return SUCCESS();
+}
+
+stack_trace* thread_pool_wait(thread_pool* pool, thread_pool_future* future) {
+    thread_pool_task task = {};
+
+    while (!__atomic_load_n(&future->is_done, __ATOMIC_ACQUIRE)) {
+        if (find_task(pool, &task)) {
+            run_task(pool, task);
+            continue;
+        }
+
+        // Task is running on other thread, sleep until something completes
+        pthread_mutex_lock(&pool->sleep_lock);
+
+        if (!__atomic_load_n(&future->is_done, __ATOMIC_ACQUIRE)) {
+            timespec deadline = {};
+            clock_gettime(CLOCK_REALTIME, &deadline);
+
+            deadline.tv_nsec += THREAD_POOL_WAIT_NANOSECONDS;
+            if (deadline.tv_nsec >= 1000 * 1000 * 1000)
+                deadline.tv_nsec -= 1000 * 1000 * 1000, ++ deadline.tv_sec;
+
+            ++ pool->waiting;
+            pthread_cond_timedwait(&pool->has_completed, &pool->sleep_lock, &deadline);
+            -- pool->waiting;
+        }
+
+        pthread_mutex_unlock(&pool->sleep_lock);
+    }
+
+    TRY future->result FAIL("Task failed!");
+    return SUCCESS();
+}
+
+stack_trace* thread_pool_wait_all(thread_pool* pool, thread_pool_future* futures, size_t count) {
+    stack_trace* first_failure = NULL;
+
+    for (size_t i = 0; i < count; ++ i) {
+        stack_trace* result = thread_pool_wait(pool, &futures[i]);
+
+        if (trace_is_success(result) || first_failure != NULL)
+            trace_destruct(result);
+        else
+            first_failure = result;
+    }
+
+    if (first_failure != NULL)
+        return PASS_FAILURE(first_failure, RUNTIME_ERROR, "Some of %zu tasks failed!", count);
+
+    return SUCCESS();
+}
+
+// -------------------------------- POOL -------------------------------------
+
+// Free everything but threads, only first @arg deque_count deques exist
+static void release_pool(thread_pool* pool, size_t deque_count) {
+    for (size_t i = 0; i < deque_count; ++ i)
+        deque_destroy(&pool->deques[i]);
+
+    pthread_cond_destroy(&pool->has_completed);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_mutex_destroy(&pool->sleep_lock);
+
+    free(pool->deques);
+    free(pool->workers);
+
+    *pool = {};
+}
+
+stack_trace* thread_pool_create(thread_pool* pool, size_t thread_count) {
+    *pool = {};
+
+    pthread_mutex_init(&pool->sleep_lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->has_completed, NULL);
+
+    const size_t worker_count = thread_count > 1 ? thread_count - 1 : 0;
+
+    TRY safe_calloc(worker_count + 1, &pool->deques) CATCH({
+        release_pool(pool, 0);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate deques!");
+    });
+
+    TRY safe_calloc(worker_count + 1, &pool->workers) CATCH({
+        release_pool(pool, 0);
+        return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to allocate workers!");
+    });
+
+    // No thread is started yet, so there's nothing to join on failure
+    for (size_t i = 0; i <= worker_count; ++ i)
+        TRY deque_create(&pool->deques[i]) CATCH({
+            release_pool(pool, i);
+            return PASS_FAILURE(__trace, RUNTIME_ERROR, "Failed to create deque!");
+        });
+
+    // Workers that failed to start are just missing, pool still works
+    for (size_t i = 0; i < worker_count; ++ i) {
+        worker_start* start = (worker_start*) malloc(sizeof(worker_start));
+        if (start == NULL)
+            break;
+
+        *start = { .pool = pool, .index = pool->worker_count };
+
+        if (pthread_create(&pool->workers[pool->worker_count], NULL, start_worker, start) != 0) {
+            free(start);
+            break;
+        }
+
+        ++ pool->worker_count;
+    }
+
+    // Deques of workers, that didn't start, are never used
+    for (size_t i = pool->worker_count; i < worker_count; ++ i)
+        deque_destroy(&pool->deques[i + 1]);
+
+    return SUCCESS();
+}
+
+void thread_pool_destroy(thread_pool* pool) {
+    pthread_mutex_lock(&pool->sleep_lock);
+    pool->is_stopping = true;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->sleep_lock);
+
+    for (size_t i = 0; i < pool->worker_count; ++ i)
+        pthread_join(pool->workers[i], NULL);
+
+    release_pool(pool, pool->worker_count + 1);
+}
+
+size_t thread_pool_thread_count(thread_pool* pool) {
+    return pool->worker_count + 1;
+}
+
+// ------------------------------ PARALLEL FOR -------------------------------
+
+struct parallel_chunk {
+    size_t begin, end;
+
+    void (*body)(size_t begin, size_t end, void* argument);
+    void* argument;
+};
+
+static stack_trace* run_chunk(void* chunk_pointer) {
+    parallel_chunk* chunk = (parallel_chunk*) chunk_pointer;
+    chunk->body(chunk->begin, chunk->end, chunk->argument);
+
+    return SUCCESS();
+}
+
+stack_trace* thread_pool_parallel_for(thread_pool* pool, size_t count,
+                                      void (*body)(size_t begin, size_t end, void* argument),
+                                      void* argument) {
+    size_t chunk_count = thread_pool_thread_count(pool);
+    if (chunk_count > count)
+        chunk_count = count;
+
+    if (chunk_count <= 1) {
+        if (count > 0)
+            body(0, count, argument);
+
+        return SUCCESS();
+    }
+
+    parallel_chunk     chunks [chunk_count];
+    thread_pool_future futures[chunk_count];
+
+    for (size_t i = 0; i < chunk_count; ++ i)
+        chunks[i] = {
+            .begin = count *  i      / chunk_count,
+            .end   = count * (i + 1) / chunk_count,
+            .body  = body, .argument = argument
+        };
+
+    // Chunk that can't be spawned is run in place, so range is always processed
+    for (size_t i = 1; i < chunk_count; ++ i) {
+        stack_trace* spawned = thread_pool_spawn(pool, run_chunk, &chunks[i], &futures[i]);
+
+        if (!trace_is_success(spawned))
+            futures[i] = { .result = run_chunk(&chunks[i]), .is_done = true };
+
+        trace_destruct(spawned);
+    }
+
+    trace_destruct(run_chunk(&chunks[0]));
+
+    TRY thread_pool_wait_all(pool, futures + 1, chunk_count - 1)
+        FAIL("Parallel for failed!");
+
+    return SUCCESS();
+}
+
+// ------------------------------ DEFAULT POOL -------------------------------
+
+static thread_pool default_pool = {};
+static size_t default_thread_count = 0;
+
+static pthread_once_t default_pool_once = PTHREAD_ONCE_INIT;
+
+static void create_default_pool() {
+    size_t thread_count = default_thread_count;
+
+    const char* configured = getenv("GRAPHVIZ_THREADS");
+    if (thread_count == 0 && configured != NULL)
+        thread_count = strtoul(configured, NULL, 10);
+
+    if (thread_count == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        thread_count = cores > 0 ? (size_t) cores : 1;
+    }
+
+    TRY thread_pool_create(&default_pool, thread_count)
+        THROW("Failed to create default thread pool!");
+}
+
+thread_pool* thread_pool_default() {
+    pthread_once(&default_pool_once, create_default_pool);
+    return &default_pool;
+}
+
+void thread_pool_set_default_thread_count(size_t thread_count) {
+    default_thread_count = thread_count;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "trace.h"
+
+#include <pthread.h>
+#include <stddef.h>
+
+/**
+ * Result of spawned task. Future is owned by the one, who spawned task,
+ * and should stay alive until thread_pool_wait returns.
+ */
+struct thread_pool_future {
+    stack_trace* result;
+    bool is_done;
+};
+
+struct thread_pool_task {
+    stack_trace* (*function)(void* argument);
+    void* argument;
+
+    thread_pool_future* future;
+};
+
+/**
+ * Double ended queue of tasks. Owner pushes and pops from the bottom, so
+ * recently spawned (and cache hot) tasks run first, thieves steal from
+ * the top, where the oldest and usually biggest tasks are.
+ */
+struct thread_pool_deque {
+    pthread_mutex_t lock;
+
+    thread_pool_task* tasks; // Ring buffer
+    size_t top, bottom, capacity;
+};
+
+/**
+ * Work-stealing pool, that is shared by everything parallel in the
+ * library, so nested parallel code doesn't oversubscribe cores. Threads
+ * that wait for futures run pending tasks instead of blocking.
+ */
+struct thread_pool {
+    pthread_t* workers;
+    size_t worker_count;
+
+    // One deque per worker and one more for tasks from other threads
+    thread_pool_deque* deques;
+
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t  has_work, has_completed;
+    size_t sleeping, waiting;
+
+    size_t pending; // Tasks in deques, accessed atomically
+    bool is_stopping;
+};
+
+/**
+ * @arg thread_count is the number of threads, that run tasks, including
+ * the one that waits, so pool starts one thread less
+ */
+stack_trace* thread_pool_create(thread_pool* pool, size_t thread_count);
+
+/**
+ * Finish tasks, that were already spawned, and stop workers
+ */
+void thread_pool_destroy(thread_pool* pool);
+
+/**
+ * Number of threads, that run tasks of the pool, including the waiting one
+ */
+size_t thread_pool_thread_count(thread_pool* pool);
+
+/**
+ * Run @arg function on the pool, it's result goes to @arg future
+ */
+stack_trace* thread_pool_spawn(thread_pool* pool, stack_trace* (*function)(void* argument),
+                               void* argument, thread_pool_future* future);
+
+/**
+ * Wait until task is done, running other tasks meanwhile
+ *
+ * @return failure of the task, if it failed
+ */
+stack_trace* thread_pool_wait(thread_pool* pool, thread_pool_future* future);
+
+/**
+ * Wait for every future, every task is waited even if some fail
+ *
+ * @return first failure
+ */
+stack_trace* thread_pool_wait_all(thread_pool* pool, thread_pool_future* futures, size_t count);
+
+/**
+ * Split range [0, @arg count) in contiguous chunks, one per thread of the
+ * pool, and call @arg body for each of them concurrently. Calling thread
+ * processes first chunk itself.
+ */
+stack_trace* thread_pool_parallel_for(thread_pool* pool, size_t count,
+                                      void (*body)(size_t begin, size_t end, void* argument),
+                                      void* argument);
+
+/**
+ * Pool, that is shared by the whole library, it's created on first use
+ * with thread count from GRAPHVIZ_THREADS or one thread per core
+ */
+thread_pool* thread_pool_default();
+
+/**
+ * Set thread count of the default pool, it takes effect only before
+ * default pool is used for the first time
+ */
+void thread_pool_set_default_thread_count(size_t thread_count);